@@ -0,0 +1,53 @@
+# Copyright (c) 2018 by contributors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+# coding: utf-8
+# This file tests the in-memory prediction of the xlearn python package.
+# The model is loaded once, and the rows of a scipy csr_matrix are
+# predicted without writing any file.
+from __future__ import absolute_import
+import numpy as np
+import scipy.sparse as sp
+import xlearn as xl
+
+# Training task
+fm_model = xl.create_fm()
+fm_model.setTrain("./small_train.txt")
+param = {'task':'binary', 'lr':0.2, 'lambda':0.002}
+fm_model.fit(param, './model.out')
+
+# File-based prediction
+fm_model.setTest("./small_test.txt")
+fm_model.predict("./model.out", "./output.txt")
+
+# Read the test data into a csr_matrix of int32 indices and
+# float32 values, so the arrays are used without copying.
+indptr, indices, values = [0], [], []
+with open("./small_test.txt") as f:
+    for line in f:
+        for node in line.split()[1:]:
+            field, feat, value = node.split(':')
+            indices.append(int(feat))
+            values.append(float(value))
+        indptr.append(len(indices))
+data = sp.csr_matrix((np.array(values, dtype=np.float32),
+                      np.array(indices, dtype=np.int32),
+                      np.array(indptr, dtype=np.int32)))
+
+# In-memory prediction
+model = xl.load_model('./model.out')
+out = model.predict(xl.DMatrix(data))
+expected = np.loadtxt("./output.txt")
+assert np.allclose(out, expected, atol=1e-4)
@@ -13,6 +13,66 @@
 # limitations under the License.
 
 # coding: utf-8
+import ctypes
+
+def _as_uint32(array):
+    """View the int32 array as uint32 without copying, or
+    convert the other arrays to uint32."""
+    import numpy as np
+    array = np.asarray(array)
+    if array.dtype == np.int32 and array.flags['C_CONTIGUOUS']:
+        return array.view(np.uint32)
+    return np.ascontiguousarray(array, dtype=np.uint32)
+
+def _pointer(array, ctype):
+    """Get the pointer of a numpy array, or NULL for None."""
+    if array is None:
+        return None
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
 
 class DMatrix(object):
-    pass
\ No newline at end of file
+    """DMatrix keeps the rows of in-memory data in the CSR format,
+    which is used by XLearnModel.predict().
+
+    The arrays of a scipy csr_matrix are used without copying if the
+    indices are int32 (or uint32) and the data is float32. The other
+    types are converted once when the DMatrix is created.
+    """
+
+    def __init__(self, data, field_map=None):
+        """Initalizes a new DMatrix
+
+        Parameters
+        ----------
+        data : scipy.sparse matrix or 2-D numpy.ndarray
+            The rows to predict. The zeros of a dense array are
+            not stored.
+        field_map : array-like, optional
+            The field of each column, which is required by ffm.
+        """
+        import numpy as np
+        if hasattr(data, 'tocsr'):
+            csr = data.tocsr()
+            indptr, indices, values = csr.indptr, csr.indices, csr.data
+            num_col = csr.shape[1]
+        else:
+            dense = np.asarray(data, dtype=np.float32)
+            if dense.ndim != 2:
+                raise ValueError('DMatrix needs a 2-D array')
+            rows, indices = np.nonzero(dense)
+            values = dense[rows, indices]
+            count = np.bincount(rows, minlength=dense.shape[0])
+            indptr = np.concatenate(([0], np.cumsum(count)))
+            num_col = dense.shape[1]
+        self.num_row = len(indptr) - 1
+        self.indptr = np.ascontiguousarray(indptr, dtype=np.uint64)
+        self.indices = _as_uint32(indices)
+        self.values = np.ascontiguousarray(values, dtype=np.float32)
+        self.fields = None
+        if field_map is not None:
+            field_map = _as_uint32(field_map)
+            if len(field_map) != num_col:
+                raise ValueError('The length of field_map (%d) must be the '
+                                 'number of columns (%d)' %
+                                 (len(field_map), num_col))
+            self.fields = field_map[self.indices]
\ No newline at end of file
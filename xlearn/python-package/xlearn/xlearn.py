@@ -18,6 +18,7 @@ import os
 import ctypes
 from .base import _LIB, XLearnHandle
 from .base import _check_call, c_str
+from .data import DMatrix, _pointer
 
 class XLearn(object):
     """XLearn is the core interface used by python API."""
@@ -57,6 +58,21 @@ class XLearn(object):
             elif key == 'log':
                 _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
                                               c_str(key), c_str(value)))
+            elif key == 'quantize':
+                _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
+                                              c_str(key), c_str(value)))
+            elif key == 'best_model':
+                _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
+                                              c_str(key), c_str(value)))
+            elif key == 'checkpoint':
+                _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
+                                              c_str(key), c_str(value)))
+            elif key == 'profile':
+                _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
+                                              c_str(key), c_str(value)))
+            elif key == 'shuffle':
+                _check_call(_LIB.XLearnSetStr(ctypes.byref(self.handle),
+                                              c_str(key), c_str(value)))
             elif key == 'lr':
                 _check_call(_LIB.XLearnSetFloat(ctypes.byref(self.handle),
                                                 c_str(key), ctypes.c_float(value)))
@@ -87,15 +103,48 @@ class XLearn(object):
             elif key == 'lambda_2':
                 _check_call(_LIB.XLearnSetFloat(ctypes.byref(self.handle),
                                                 c_str(key), ctypes.c_float(value)))
+            elif key == 'prune':
+                _check_call(_LIB.XLearnSetFloat(ctypes.byref(self.handle),
+                                                c_str(key), ctypes.c_float(value)))
             elif key == 'nthread':
                 _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
                                               c_str(key), ctypes.c_uint(value)))
             elif key == 'block_size':
                 _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
                                               c_str(key), ctypes.c_uint(value)))
+            elif key == 'prefetch_depth':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
             elif key == 'stop_window':
                 _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
                                               c_str(key), ctypes.c_uint(value)))
+            elif key == 'numa_sync':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'sync_batch':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'cv_parallel':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'hash_bits':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'stream_batch':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'stream_window':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'nfield':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'checkpoint_rows':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
+            elif key == 'checkpoint_sec':
+                _check_call(_LIB.XLearnSetInt(ctypes.byref(self.handle),
+                                              c_str(key), ctypes.c_uint(value)))
             else:
                 raise Exception("Invalid key!", key)
 
@@ -181,6 +230,47 @@ class XLearn(object):
         _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
                                        c_str(key), ctypes.c_bool(False)))
 
+    def setSparseFeature(self):
+        """Map the feature ids to compact ids, so the model size
+        depends on the number of distinct features"""
+        key = 'sparse_feature'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
+    def setExactAUC(self):
+        """Compute the exact AUC by sorting all the
+        validation scores"""
+        key = 'exact_auc'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
+    def setNUMA(self):
+        """Set xlearn to use NUMA-aware lock-free training"""
+        key = 'numa'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
+    def setSync(self):
+        """Set xlearn to use the synchronous mini-batch training,
+        which gives the same model for any number of threads"""
+        key = 'sync'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
+    def setStream(self):
+        """Train in one pass over the stream of the training
+        file, such as a FIFO. The hash_bits must be set"""
+        key = 'stream'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
+    def setVerifyBinary(self):
+        """Hash the whole data file to check its binary
+        cache, instead of the fingerprint only"""
+        key = 'verify_binary'
+        _check_call(_LIB.XLearnSetBool(ctypes.byref(self.handle),
+                                       c_str(key), ctypes.c_bool(True)))
+
     def disableEarlyStop(self):
         """Disable early-stopping"""
         key = 'early_stop'
@@ -234,6 +324,68 @@ class XLearn(object):
         _check_call(_LIB.XLearnPredict(ctypes.byref(self.handle),
                                        c_str(model_path), c_str(out_path)))
 
+class XLearnModel(object):
+    """XLearnModel is a model loaded once for the in-memory prediction."""
+
+    def __init__(self, model_path, nthread=0, norm=True):
+        """Load the model
+
+        Parameters
+        ----------
+        model_path : str. path of model checkpoint.
+        nthread : int. number of threads, 0 for the number of CPUs.
+        norm : bool. use the instance-wise normalization.
+        """
+        self.handle = ctypes.c_void_p()
+        _check_call(_LIB.XLearnModelLoad(c_str(model_path),
+                                         ctypes.c_int(nthread),
+                                         ctypes.c_bool(norm),
+                                         ctypes.byref(self.handle)))
+
+    def __del__(self):
+        if self.handle:
+            _check_call(_LIB.XLearnModelFree(ctypes.byref(self.handle)))
+
+    def predict(self, data, out=None, sign=False, sigmoid=False):
+        """Predict the rows in memory
+
+        Parameters
+        ----------
+        data : DMatrix, scipy.sparse matrix or 2-D numpy.ndarray.
+        out : numpy.ndarray of float32, optional. the output buffer.
+        sign : bool. convert output to 0 and 1.
+        sigmoid : bool. convert output to 0~1 (probability).
+
+        Returns
+        -------
+        out : numpy.ndarray of float32.
+        """
+        import numpy as np
+        if not isinstance(data, DMatrix):
+            data = DMatrix(data)
+        if out is None:
+            out = np.empty(data.num_row, dtype=np.float32)
+        elif out.dtype != np.float32 or not out.flags['C_CONTIGUOUS'] or \
+             out.size < data.num_row:
+            raise ValueError('out must be a contiguous float32 array '
+                             'of at least %d elements' % data.num_row)
+        _check_call(_LIB.XLearnPredictCSR(ctypes.byref(self.handle),
+                                          ctypes.c_uint64(data.num_row),
+                                          _pointer(data.indptr, ctypes.c_uint64),
+                                          _pointer(data.indices, ctypes.c_uint32),
+                                          _pointer(data.fields, ctypes.c_uint32),
+                                          _pointer(data.values, ctypes.c_float),
+                                          ctypes.c_bool(sign),
+                                          ctypes.c_bool(sigmoid),
+                                          _pointer(out, ctypes.c_float)))
+        return out
+
+def load_model(model_path, nthread=0, norm=True):
+    """
+    Load a model for the in-memory prediction.
+    """
+    return XLearnModel(model_path, nthread, norm)
+
 def create_linear():
     """
     Create a linear model.
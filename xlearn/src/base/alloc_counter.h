@@ -0,0 +1,44 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file provides a counter of heap allocations, which is used
+by the tests and benchmarks to check the allocation-free paths.
+*/
+
+#ifndef XLEARN_BASE_ALLOC_COUNTER_H_
+#define XLEARN_BASE_ALLOC_COUNTER_H_
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// The alloc_counter library replaces the global operator new, and
+// counts every call of it in all the threads. Only the tests and the
+// benchmarks link this library:
+//
+//   uint64 before = GetAllocCount();
+//   score->CalcScore(row, model, norm);
+//   /* The number of heap allocations of CalcScore() */
+//   uint64 count = GetAllocCount() - before;
+//
+// The memory allocated by malloc() directly is not counted.
+//------------------------------------------------------------------------------
+
+// Number of calls of operator new since the program started.
+uint64 GetAllocCount();
+
+#endif  // XLEARN_BASE_ALLOC_COUNTER_H_
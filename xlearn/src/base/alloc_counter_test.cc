@@ -0,0 +1,64 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests alloc_counter.h and scratch_arena.h
+*/
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "src/base/alloc_counter.h"
+#include "src/base/scratch_arena.h"
+
+// The new-expressions can be optimized out by the compiler,
+// so we call the operator new directly.
+TEST(ALLOC_COUNTER_TEST, Count_New) {
+  uint64 before = GetAllocCount();
+  void* a = ::operator new(sizeof(int));
+  void* b = ::operator new[](10 * sizeof(int));
+  EXPECT_EQ(GetAllocCount() - before, 2);
+  ::operator delete(a);
+  ::operator delete[](b);
+  EXPECT_EQ(GetAllocCount() - before, 2);
+}
+
+TEST(SCRATCH_ARENA_TEST, Grow_Only) {
+  ScratchArena<float> arena;
+  float* buf = arena.Get(16);
+  EXPECT_EQ(arena.Capacity(), 16);
+  // The smaller buffer is the same memory
+  uint64 before = GetAllocCount();
+  EXPECT_EQ(arena.Get(8), buf);
+  EXPECT_EQ(arena.Get(16), buf);
+  EXPECT_EQ(GetAllocCount() - before, 0);
+  arena.Get(100);
+  EXPECT_EQ(arena.Capacity(), 100);
+  EXPECT_EQ(GetAllocCount() - before, 1);
+}
+
+TEST(SCRATCH_ARENA_TEST, Thread_Local) {
+  ScratchArena<float>* arena = ScratchArena<float>::ThreadLocal();
+  EXPECT_EQ(ScratchArena<float>::ThreadLocal(), arena);
+  ScratchArena<float>* other = nullptr;
+  std::thread thread([&other]() {
+    other = ScratchArena<float>::ThreadLocal();
+  });
+  thread.join();
+  EXPECT_NE(other, arena);
+}
@@ -0,0 +1,85 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file provides the run-time detection of the SIMD instruction
+set supported by current CPU.
+*/
+
+#ifndef XLEARN_BASE_CPU_FEATURE_H_
+#define XLEARN_BASE_CPU_FEATURE_H_
+
+#include <string>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// xLearn ships SSE, AVX2 (with FMA) and AVX-512 versions of its hot
+// kernels, and the widest one supported by current CPU is chosen once
+// at startup. We can use these functions like this:
+//
+//   SIMDLevel level = GetSIMDLevel();   /* kSSE, kAVX2 or kAVX512 */
+//   int width = SIMDWidth(level);       /* 4, 8 or 16 floats */
+//   std::string name = SIMDName(level); /* "sse", "avx2" or "avx512" */
+//------------------------------------------------------------------------------
+
+enum SIMDLevel {
+  kSSE = 0,     /* 128-bit, the fallback */
+  kAVX2 = 1,    /* 256-bit with FMA */
+  kAVX512 = 2   /* 512-bit */
+};
+
+// Detect the widest SIMD instruction set of current CPU.
+inline SIMDLevel detect_simd_level() {
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return kAVX512;
+  }
+  if (__builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma")) {
+    return kAVX2;
+  }
+#endif
+  return kSSE;
+}
+
+// The detection is done only once.
+inline SIMDLevel GetSIMDLevel() {
+  static const SIMDLevel level = detect_simd_level();
+  return level;
+}
+
+// Number of 32-bit floats in one register.
+inline int SIMDWidth(SIMDLevel level) {
+  switch (level) {
+    case kAVX512: return 16;
+    case kAVX2: return 8;
+    default: return 4;
+  }
+}
+
+// Name of the instruction set.
+inline std::string SIMDName(SIMDLevel level) {
+  switch (level) {
+    case kAVX512: return "avx512";
+    case kAVX2: return "avx2";
+    default: return "sse";
+  }
+}
+
+#endif  // XLEARN_BASE_CPU_FEATURE_H_
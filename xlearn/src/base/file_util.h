@@ -24,10 +24,15 @@ This file contains facilitlies to control the file.
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "src/base/common.h"
 #include "src/base/stringprintf.h"
 #include "src/base/scoped_ptr.h"
+#include "src/base/murmur_hash.h"
 
 //------------------------------------------------------------------------------
 // Useage:
@@ -97,10 +102,18 @@ This file contains facilitlies to control the file.
 //    /* (14) Generate hash value for file  */
 //    uint64 hash_1 = HashFile(filename, true);   /* for one block */
 //    uint64 hash_2 = HashFile(filename, false);  /* for the whole file */
+//    uint64 hash_3 = FingerprintFile(filename);  /* stat and sampled blocks */
+//    uint64 hash_4 = HashFileContent(filename);  /* fast hash of whole file */
 //
 //    /* (15) Read the whole file into in-memory buffer */
 //    char *buffer = nullptr;
 //    uint64 file_size = ReadFileToMemory(filename, &buffer);
+//
+//    /* (16) Map the whole file into memory (zero-copy) */
+//    MmapFile mmap_file;
+//    mmap_file.Open(filename);
+//    char* data = mmap_file.data();
+//    uint64 size = mmap_file.size();
 //------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
@@ -115,6 +128,9 @@ const size_t GB = 1024.0 * 1024.0 * 1024.0;
 static const uint32 kMaxLineSize = 500 * 1024;  // 500 KB
 /* Chunk size for hash block */
 static const uint32 kChunkSize = 1000 * 1024; // 1000 KB
+/* Blocks sampled by FingerprintFile() */
+static const uint32 kFingerprintBlocks = 16;
+static const uint32 kFingerprintBlockSize = 64 * 1024; // 64 KB
 
 // Check whether the file exists.
 inline bool FileExist(const char* filename) {
@@ -338,6 +354,82 @@ inline uint64_t HashFile(const std::string& filename, bool one_block=false) {
   return magic;
 }
 
+// Hash the content of a memory buffer by MurmurHash64.
+// The buffer is hashed chunk by chunk, so the hash value is
+// the same as HashFileContent() of a file with this content.
+inline uint64 HashBufferContent(const char* buf, uint64 size) {
+  uint64 magic = 0;
+  uint64 index = 0;
+  for (uint64 pos = 0; pos < size; pos += kChunkSize) {
+    uint64 len = std::min((uint64)kChunkSize, size - pos);
+    magic = MurmurMix64(magic ^ MurmurHash64(buf + pos, len, index++));
+  }
+  return MurmurMix64(magic ^ size);
+}
+
+// Hash all the content of file, which is much faster than
+// HashFile(). Return 0 if the file cannot be read.
+inline uint64 HashFileContent(const std::string& filename) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) { return 0; }
+  std::vector<char> buffer(kChunkSize);
+  uint64 magic = 0;
+  uint64 index = 0;
+  uint64 size = 0;
+  for (;;) {
+    size_t len = fread(buffer.data(), 1, kChunkSize, file);
+    if (len == 0) { break; }
+    magic = MurmurMix64(magic ^ MurmurHash64(buffer.data(), len, index++));
+    size += len;
+  }
+  fclose(file);
+  return MurmurMix64(magic ^ size);
+}
+
+// Fingerprint of file, which only reads a small part of it:
+// the size, modification time and inode of the file, and the
+// hash of kFingerprintBlocks blocks evenly sampled from the
+// file (including the first and the last block). It is used to
+// check whether a file has been changed in milliseconds.
+// Return 0 if the file cannot be read.
+inline uint64 FingerprintFile(const std::string& filename) {
+#ifdef _WIN32
+  return HashFileContent(filename);
+#else
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) { return 0; }
+  uint64 meta[5];
+  meta[0] = st.st_size;
+  meta[1] = st.st_mtime;
+#ifdef __linux__
+  meta[2] = st.st_mtim.tv_nsec;
+#else
+  meta[2] = 0;
+#endif
+  meta[3] = st.st_ino;
+  meta[4] = st.st_dev;
+  uint64 magic = MurmurHash64((const char*)meta, sizeof(meta));
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) { return 0; }
+  uint64 size = st.st_size;
+  uint64 block = kFingerprintBlockSize;
+  std::vector<char> buffer(block);
+  for (uint32 i = 0; i < kFingerprintBlocks && size > 0; ++i) {
+    uint64 offset = 0;
+    if (size > block) {
+      offset = (size - block) / (kFingerprintBlocks - 1) * i;
+    }
+    if (fseeko(file, offset, SEEK_SET) != 0) { break; }
+    size_t len = fread(buffer.data(), 1, block, file);
+    magic = MurmurMix64(magic ^ MurmurHash64(buffer.data(), len, offset));
+    // The file has only one block
+    if (size <= block) { break; }
+  }
+  fclose(file);
+  return magic;
+#endif
+}
+
 // Read the whole file to a memory buffer and 
 // Return size (byte) of current file.
 inline uint64 ReadFileToMemory(const std::string& filename, char **buf) {
@@ -355,4 +447,72 @@ inline uint64 ReadFileToMemory(const std::string& filename, char **buf) {
   return len;
 }
 
+//------------------------------------------------------------------------------
+// MmapFile maps the whole file into the memory of current process,
+// and the file is unmapped in the destructor or by Close(). The pages
+// are private copy-on-write: they are read from the page cache lazily,
+// shared with the other processes that map the same file, and writing
+// to them never changes the file. On the platform without mmap(),
+// we just read the whole file into a memory buffer.
+//------------------------------------------------------------------------------
+class MmapFile {
+ public:
+  // Constructor and Destructor
+  MmapFile() : data_(nullptr), size_(0) { }
+  ~MmapFile() { Close(); }
+
+  // Map the whole file. Program crashes if failed.
+  void Open(const std::string& filename) {
+    CHECK(!filename.empty());
+    Close();
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      LOG(FATAL) << "Cannot open file: " << filename;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      LOG(FATAL) << "Error: invoke fstat().";
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        LOG(FATAL) << "Cannot mmap file: " << filename;
+      }
+      data_ = reinterpret_cast<char*>(addr);
+      // Read ahead the whole file asynchronously
+      madvise(data_, size_, MADV_WILLNEED);
+    }
+    close(fd);
+#else
+    size_ = ReadFileToMemory(filename, &data_);
+#endif
+  }
+
+  // Unmap the file.
+  void Close() {
+    if (data_ != nullptr) {
+#ifndef _WIN32
+      munmap(data_, size_);
+#else
+      delete [] data_;
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  // The mapped data and its size (byte).
+  inline char* data() const { return data_; }
+  inline uint64 size() const { return size_; }
+
+ private:
+  char* data_;
+  uint64 size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MmapFile);
+};
+
 #endif  // XLEARN_BASE_FILE_UTIL_H_
@@ -160,6 +160,55 @@ TEST(FileTest, HashFile) {
   RemoveFile("./tmp_3");
 }
 
+// Change a byte of file in place, and keep its modification time
+void change_byte(const char* filename, long offset) {
+  struct stat st;
+  ASSERT_EQ(stat(filename, &st), 0);
+  FILE* file = OpenFileOrDie(filename, "r+");
+  fseek(file, offset, SEEK_SET);
+  fputc('#', file);
+  Close(file);
+  struct timespec times[2] = { st.st_atim, st.st_mtim };
+  ASSERT_EQ(utimensat(AT_FDCWD, filename, times, 0), 0);
+}
+
+TEST(FileTest, FingerprintFile) {
+  const char* filename = "./tmp_fingerprint";
+  FILE* file = OpenFileOrDie(filename, "w");
+  std::string line("0 1:0.123 2:0.456 3:0.789\n");
+  for (int i = 0; i < 100000; ++i) {
+    WriteDataToDisk(file, line.data(), line.size());
+  }
+  Close(file);
+  uint64 fp = FingerprintFile(filename);
+  uint64 content = HashFileContent(filename);
+  EXPECT_NE(fp, 0);
+  EXPECT_EQ(FingerprintFile(filename), fp);
+  // The content hash of file and memory buffer is the same
+  char* buffer = nullptr;
+  uint64 size = ReadFileToMemory(filename, &buffer);
+  EXPECT_EQ(HashBufferContent(buffer, size), content);
+  delete [] buffer;
+  // The first block is sampled by fingerprint
+  change_byte(filename, 10);
+  EXPECT_NE(FingerprintFile(filename), fp);
+  fp = FingerprintFile(filename);
+  EXPECT_NE(HashFileContent(filename), content);
+  content = HashFileContent(filename);
+  // The byte between two sampled blocks is only found by
+  // the content hash if the modification time is kept
+  change_byte(filename, 100 * 1024);
+  EXPECT_EQ(FingerprintFile(filename), fp);
+  EXPECT_NE(HashFileContent(filename), content);
+  // Any write changes the modification time
+  struct timespec times[2] = { {0, UTIME_OMIT}, {12345, 0} };
+  ASSERT_EQ(utimensat(AT_FDCWD, filename, times, 0), 0);
+  EXPECT_NE(FingerprintFile(filename), fp);
+  EXPECT_EQ(FingerprintFile("./non-exist-file"), 0);
+  EXPECT_EQ(HashFileContent("./non-exist-file"), 0);
+  RemoveFile(filename);
+}
+
 TEST(FileTest, ReadFile) {
   FILE* file = OpenFileOrDie("./tmp.bin", "w");
   int num = 999;
@@ -171,3 +220,30 @@ TEST(FileTest, ReadFile) {
   EXPECT_EQ((*(int*)ch_num), 999);
   RemoveFile("./tmp.bin");
 }
+
+TEST(FileTest, MmapFile) {
+  FILE* file = OpenFileOrDie("./tmp.bin", "w");
+  int num[3] = {1, 2, 3};
+  WriteDataToDisk(file, (char*)num, sizeof(num));
+  Close(file);
+  {
+    MmapFile mmap_file;
+    mmap_file.Open("./tmp.bin");
+    EXPECT_EQ(mmap_file.size(), sizeof(num));
+    int* data = (int*)mmap_file.data();
+    EXPECT_EQ(data[0], 1);
+    EXPECT_EQ(data[2], 3);
+    // Private copy-on-write mapping
+    data[1] = 100;
+    EXPECT_EQ(data[1], 100);
+    mmap_file.Close();
+    EXPECT_EQ(mmap_file.data(), nullptr);
+    EXPECT_EQ(mmap_file.size(), 0);
+  }
+  // The file is not changed
+  char* buf = nullptr;
+  ReadFileToMemory("./tmp.bin", &buf);
+  EXPECT_EQ(((int*)buf)[1], 2);
+  delete [] buf;
+  RemoveFile("./tmp.bin");
+}
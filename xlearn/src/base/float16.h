@@ -0,0 +1,110 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file provides the conversion between float and the IEEE 754
+half-precision (fp16) number.
+*/
+
+#ifndef XLEARN_BASE_FLOAT16_H_
+#define XLEARN_BASE_FLOAT16_H_
+
+#include <string.h>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// A fp16 number is stored in uint16, which has 1 sign bit, 5 exponent
+// bits and 10 mantissa bits. It has about 3 decimal digits and its max
+// value is 65504, which is enough for the latent factors of a model:
+//
+//   uint16 h = FloatToHalf(0.1f);
+//   float f = HalfToFloat(h);     /* f == 0.099975586f */
+//
+//   /* Without the check of inf and nan */
+//   f = HalfToFloatFast(h);
+//
+// FloatToHalf() rounds to the nearest even, the values out of range
+// become inf, and the small values become subnormal or zero.
+//------------------------------------------------------------------------------
+
+inline uint32 float_bits(float f) {
+  uint32 u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bits_float(uint32 u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+inline uint16 FloatToHalf(float f) {
+  uint32 u = float_bits(f);
+  uint32 sign = (u >> 16) & 0x8000;
+  uint32 abs = u & 0x7fffffff;
+  // nan or inf
+  if (abs >= 0x7f800000) {
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+  // Overflow: larger than 65520 is rounded to inf
+  if (abs >= 0x477ff000) {
+    return sign | 0x7c00;
+  }
+  // Subnormal or zero: smaller than 2^-14
+  if (abs < 0x38800000) {
+    // Adding 0.5 makes the float arithmetic do the rounding
+    // of the mantissa for us, i.e., the result is in the low
+    // bits of the mantissa of 0.5 + abs.
+    float v = bits_float(abs) + 0.5f;
+    return sign | (uint16)(float_bits(v) - 0x3f000000);
+  }
+  // Normal: rebias the exponent from 127 to 15,
+  // and round the mantissa to the nearest even.
+  uint32 odd = (abs >> 13) & 1;
+  abs += 0xc8000fff + odd;
+  return sign | (uint16)(abs >> 13);
+}
+
+inline float HalfToFloat(uint16 h) {
+  uint32 sign = (uint32)(h & 0x8000) << 16;
+  uint32 exp = h & 0x7c00;
+  uint32 man = h & 0x03ff;
+  if (exp == 0x7c00) {
+    // nan or inf
+    return bits_float(sign | 0x7f800000 | (man << 13));
+  }
+  if (exp == 0) {
+    // Subnormal or zero: man * 2^-24
+    float v = (float)man * bits_float(0x33800000);
+    return bits_float(sign | float_bits(v));
+  }
+  return bits_float(sign | ((exp + 0x1c000) << 13) | (man << 13));
+}
+
+// The same as HalfToFloat() for the finite numbers, but it has no
+// branch, so the loops of it can be vectorized by the compiler.
+// The exponent is rebiased by a multiplication of 2^112, which
+// also handles the subnormal numbers.
+inline float HalfToFloatFast(uint16 h) {
+  uint32 sign = (uint32)(h & 0x8000) << 16;
+  float v = bits_float((uint32)(h & 0x7fff) << 13) * bits_float(0x77800000);
+  return bits_float(sign | float_bits(v));
+}
+
+#endif  // XLEARN_BASE_FLOAT16_H_
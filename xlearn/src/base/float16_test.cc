@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests float16.h
+*/
+
+#include "gtest/gtest.h"
+
+#include <math.h>
+
+#include <random>
+
+#include "src/base/float16.h"
+
+TEST(FLOAT16_TEST, Known_value) {
+  EXPECT_EQ(FloatToHalf(0.0f), 0x0000);
+  EXPECT_EQ(FloatToHalf(-0.0f), 0x8000);
+  EXPECT_EQ(FloatToHalf(1.0f), 0x3c00);
+  EXPECT_EQ(FloatToHalf(-2.0f), 0xc000);
+  EXPECT_EQ(FloatToHalf(0.5f), 0x3800);
+  EXPECT_EQ(FloatToHalf(65504.0f), 0x7bff);
+  EXPECT_EQ(FloatToHalf(1e6f), 0x7c00);
+  EXPECT_EQ(FloatToHalf(-INFINITY), 0xfc00);
+  EXPECT_EQ(FloatToHalf(1e-10f), 0x0000);
+  // Smallest subnormal: 2^-24
+  EXPECT_EQ(FloatToHalf(5.9604645e-8f), 0x0001);
+  EXPECT_TRUE(isnan(HalfToFloat(FloatToHalf(NAN))));
+  EXPECT_FLOAT_EQ(HalfToFloat(0x3555), 0.33325195f);
+}
+
+TEST(FLOAT16_TEST, Round_trip) {
+  // Every fp16 number except nan can be converted
+  // to float and back without any change.
+  for (uint32 h = 0; h < 65536; ++h) {
+    if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0) { continue; }
+    EXPECT_EQ(FloatToHalf(HalfToFloat(h)), h);
+  }
+}
+
+TEST(FLOAT16_TEST, Fast_conversion) {
+  for (uint32 h = 0; h < 65536; ++h) {
+    if ((h & 0x7c00) == 0x7c00) { continue; }
+    EXPECT_EQ(float_bits(HalfToFloatFast(h)),
+              float_bits(HalfToFloat(h))) << h;
+  }
+}
+
+TEST(FLOAT16_TEST, Round_to_nearest_even) {
+  // 1 + 2^-11 is the middle of 1 and 1 + 2^-10
+  EXPECT_EQ(FloatToHalf(1.0f + 1.0f / 2048), 0x3c00);
+  EXPECT_EQ(FloatToHalf(1.0f + 3.0f / 2048), 0x3c02);
+  EXPECT_EQ(FloatToHalf(1.0f + 1.5f / 2048), 0x3c01);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dis(-100.0f, 100.0f);
+  for (int i = 0; i < 100000; ++i) {
+    float f = dis(gen);
+    if (fabs(f) < 1e-3) { continue; }
+    float g = HalfToFloat(FloatToHalf(f));
+    EXPECT_LE(fabs(g - f), fabs(f) / 2048);
+  }
+}
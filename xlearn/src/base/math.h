@@ -24,6 +24,7 @@ mathmatic methods.
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <cmath>
 #include <random>
@@ -168,11 +169,24 @@ static inline real_t fastersigmoid(real_t x) {
 //------------------------------------------------------------------------------
 static inline real_t InvSqrt(real_t x) {
   real_t xhalf = 0.5f*x;
-  int i = *reinterpret_cast<int*>(&x);  // get bits for floating VALUE
+  // memcpy() copies the bits without breaking the strict aliasing
+  int32_t i;
+  memcpy(&i, &x, sizeof(i));  // get bits for floating VALUE
   i = 0x5f375a86- (i>>1);  // gives initial guess y0
-  x = *reinterpret_cast<real_t*>(&i);  // convert bits BACK to float
+  memcpy(&x, &i, sizeof(x));  // convert bits BACK to float
   x = x*(1.5f-xhalf*x*x);  // Newton step, repeating increases accuracy
   return x;
 }
 
+//------------------------------------------------------------------------------
+// Number of bits set in x
+//------------------------------------------------------------------------------
+static inline uint32 PopCount64(uint64 x) {
+#ifdef _MSC_VER
+  return (uint32)__popcnt64(x);
+#else
+  return (uint32)__builtin_popcountll(x);
+#endif
+}
+
 #endif   // XLEARN_BASE_MATH_H_
@@ -0,0 +1,79 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file provides the MurmurHash functions used by
+the feature hashing.
+*/
+
+#ifndef XLEARN_BASE_MURMUR_HASH_H_
+#define XLEARN_BASE_MURMUR_HASH_H_
+
+#include <string.h>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// MurmurHash64A by Austin Appleby, which is fast and well distributed
+// for short keys, such as the feature ids of the CTR logs. The result
+// does not depend on the byte order of the platform.
+//
+//   const char* feat = "user_123";
+//   uint64 key = MurmurHash64(feat, strlen(feat));
+//
+// MurmurMix64() is the finalizer of MurmurHash3, which spreads the bits
+// of an integer key. It is used to place the keys in a hash table.
+//------------------------------------------------------------------------------
+
+inline uint64 MurmurHash64(const char* data, size_t len, uint64 seed = 0) {
+  const uint64 m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  uint64 h = seed ^ (len * m);
+  const char* end = data + (len / 8) * 8;
+  for (const char* p = data; p != end; p += 8) {
+    uint64 k = 0;
+    for (int i = 7; i >= 0; --i) {
+      k = (k << 8) | (unsigned char)p[i];
+    }
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  size_t tail = len & 7;
+  if (tail > 0) {
+    for (int i = (int)tail - 1; i >= 0; --i) {
+      h ^= (uint64)(unsigned char)end[i] << (8 * i);
+    }
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+inline uint64 MurmurMix64(uint64 k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+#endif  // XLEARN_BASE_MURMUR_HASH_H_
@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file provides the detection of NUMA nodes and the
+binding of threads to CPUs.
+*/
+
+#ifndef XLEARN_BASE_NUMA_H_
+#define XLEARN_BASE_NUMA_H_
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// A NUMA node is a group of CPUs that share the same local memory.
+// We read the nodes from sysfs on Linux, and current machine is
+// treated as one node on the other systems:
+//
+//   std::vector<NumaNode> nodes = GetNumaNodes();
+//   for (size_t i = 0; i < nodes.size(); ++i) {
+//     /* nodes[i].cpus is the list of CPU id of node i */
+//   }
+//
+//   /* Run current thread on the CPUs of node 0 only */
+//   BindToCPUs(nodes[0].cpus);
+//
+// Memory pages are placed on the node of the thread that first writes
+// them (first-touch), so a thread bound to a node should initialize
+// the memory it is going to use.
+//------------------------------------------------------------------------------
+
+struct NumaNode {
+  /* Id of the node */
+  int id;
+  /* CPUs of the node */
+  std::vector<int> cpus;
+};
+
+// Parse the cpu list of sysfs, such as "0-3,8-11".
+inline std::vector<int> ParseCPUList(const std::string& str) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < str.size()) {
+    size_t comma = str.find(',', pos);
+    if (comma == std::string::npos) { comma = str.size(); }
+    std::string item = str.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (item.empty() || item[0] < '0' || item[0] > '9') { continue; }
+    size_t dash = item.find('-');
+    int first = atoi(item.c_str());
+    int last = first;
+    if (dash != std::string::npos) {
+      last = atoi(item.c_str() + dash + 1);
+    }
+    for (int c = first; c <= last; ++c) {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+// Detect the NUMA nodes of current machine. It returns one node
+// with all the CPUs if the NUMA information is not available.
+inline std::vector<NumaNode> detect_numa_nodes() {
+  std::vector<NumaNode> nodes;
+#ifdef __linux__
+  // The node ids can have holes, so we stop after some
+  // continuous missing ids instead of the first one.
+  for (int id = 0, missing = 0; missing < 64; ++id) {
+    std::string path = "/sys/devices/system/node/node" +
+                       std::to_string(id) + "/cpulist";
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line)) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+    NumaNode node;
+    node.id = id;
+    node.cpus = ParseCPUList(line);
+    // Skip the memory-only nodes
+    if (!node.cpus.empty()) {
+      nodes.push_back(node);
+    }
+  }
+#endif
+  if (nodes.empty()) {
+    NumaNode node;
+    node.id = 0;
+    int num = std::thread::hardware_concurrency();
+    for (int c = 0; c < (num > 0 ? num : 1); ++c) {
+      node.cpus.push_back(c);
+    }
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+// The detection is done only once.
+inline const std::vector<NumaNode>& GetNumaNodes() {
+  static const std::vector<NumaNode> nodes = detect_numa_nodes();
+  return nodes;
+}
+
+// Bind current thread to the given CPUs. Return false if the
+// binding is not supported or failed. An empty list does nothing.
+inline bool BindToCPUs(const std::vector<int>& cpus) {
+  if (cpus.empty()) { return false; }
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+      CPU_SET(cpus[i], &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(),
+                                sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+#endif  // XLEARN_BASE_NUMA_H_
@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests numa.h file.
+*/
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "src/base/numa.h"
+#include "src/base/thread_pool.h"
+
+TEST(NumaTest, ParseCPUList) {
+  std::vector<int> cpus = ParseCPUList("0-3,8,10-11\n");
+  std::vector<int> expect = {0, 1, 2, 3, 8, 10, 11};
+  EXPECT_EQ(cpus, expect);
+  cpus = ParseCPUList("5");
+  EXPECT_EQ(cpus.size(), 1);
+  EXPECT_EQ(cpus[0], 5);
+  EXPECT_TRUE(ParseCPUList("").empty());
+  EXPECT_TRUE(ParseCPUList("\n").empty());
+}
+
+TEST(NumaTest, GetNumaNodes) {
+  const std::vector<NumaNode>& nodes = GetNumaNodes();
+  ASSERT_GT(nodes.size(), 0);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    EXPECT_GT(nodes[i].cpus.size(), 0);
+  }
+}
+
+TEST(NumaTest, Bind_thread_pool) {
+  const std::vector<NumaNode>& nodes = GetNumaNodes();
+  ThreadPool pool(2, nodes[0].cpus);
+  size_t sum = pool.ParallelReduce(0, 1000, 10, (size_t)0,
+    [](size_t start, size_t end) {
+      size_t s = 0;
+      for (size_t i = start; i < end; ++i) { s += i; }
+      return s;
+  });
+  EXPECT_EQ(sum, 999 * 1000 / 2);
+  EXPECT_FALSE(BindToCPUs(std::vector<int>()));
+}
@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file provides the fast number parsing utilities.
+*/
+
+#ifndef XLEARN_BASE_PARSE_NUMBER_H_
+#define XLEARN_BASE_PARSE_NUMBER_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// Parse number from the range [begin, end) of a memory buffer, which
+// does not need to be terminated by '\0'. These functions return the
+// position after the number, and the position of begin if there is
+// no number. For example:
+//
+//   const char* str = "12:0.25 ";
+//   const char* end = str + 8;
+//   uint32 idx = 0;
+//   float val = 0;
+//   const char* p = ParseUInt(str, end, &idx);   /* idx == 12 */
+//   p = ParseReal(p+1, end, &val);               /* val == 0.25 */
+//
+// ParseReal() gives the same result as atof() and it is much faster,
+// because the common decimal numbers (less than 19 significant digits
+// and small exponent) are converted with only one exact multiplication
+// or division. The other numbers (such as 'inf' and '1e300') fall back
+// to strtod().
+//------------------------------------------------------------------------------
+
+// Skip the space and tab.
+inline const char* SkipBlank(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t')) { ++p; }
+  return p;
+}
+
+// Parse an unsigned integer.
+template <typename T>
+inline const char* ParseUInt(const char* begin, const char* end, T* value) {
+  const char* p = begin;
+  if (p < end && *p == '+') { ++p; }
+  const char* digit = p;
+  T x = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    x = x * 10 + (*p - '0');
+    ++p;
+  }
+  if (p == digit) { return begin; }
+  *value = x;
+  return p;
+}
+
+// Parse a real number by strtod(). The number is copied to a
+// small buffer because [begin, end) may not end with '\0'.
+template <typename T>
+inline const char* parse_real_slow(const char* begin,
+                                   const char* end,
+                                   T* value) {
+  char buf[64];
+  size_t len = end - begin;
+  if (len > sizeof(buf) - 1) { len = sizeof(buf) - 1; }
+  memcpy(buf, begin, len);
+  buf[len] = '\0';
+  char* stop = nullptr;
+  double x = strtod(buf, &stop);
+  if (stop == buf) { return begin; }
+  *value = x;
+  return begin + (stop - buf);
+}
+
+// Parse a real number.
+template <typename T>
+inline const char* ParseReal(const char* begin, const char* end, T* value) {
+  // Exact powers of 10 in double
+  static const double kPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  uint64 mantissa = 0;
+  int digit_num = 0;   // significant digits in mantissa
+  int exponent = 0;
+  bool has_digit = false;
+  // Integer part
+  while (p < end && *p >= '0' && *p <= '9') {
+    has_digit = true;
+    if (digit_num < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) { digit_num++; }
+    } else {
+      exponent++;
+    }
+    ++p;
+  }
+  // Fraction part
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end && *p >= '0' && *p <= '9') {
+      has_digit = true;
+      if (digit_num < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) { digit_num++; }
+        exponent--;
+      }
+      ++p;
+    }
+  }
+  if (!has_digit) {
+    // Such as 'inf' and 'nan'
+    return parse_real_slow(begin, end, value);
+  }
+  // Exponent part
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool exp_negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      exp_negative = (*q == '-');
+      ++q;
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      while (q < end && *q >= '0' && *q <= '9') {
+        if (e < 10000) { e = e * 10 + (*q - '0'); }
+        ++q;
+      }
+      exponent += exp_negative ? -e : e;
+      p = q;
+    }
+  }
+  // The mantissa is exact in double (< 2^53), and
+  // hence one operation gives the correct rounding.
+  if (mantissa >= (1ULL << 53) || exponent > 22 || exponent < -22) {
+    return parse_real_slow(begin, end, value);
+  }
+  double x = static_cast<double>(mantissa);
+  if (exponent < 0) {
+    x /= kPow10[-exponent];
+  } else {
+    x *= kPow10[exponent];
+  }
+  *value = negative ? -x : x;
+  return p;
+}
+
+#endif  // XLEARN_BASE_PARSE_NUMBER_H_
@@ -0,0 +1,110 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests parse_number.h
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+
+#include "src/base/parse_number.h"
+
+// Check that ParseReal() gives the same result as atof()
+void check_real(const std::string& str) {
+  const char* begin = str.data();
+  const char* end = begin + str.size();
+  double value = 0;
+  const char* pos = ParseReal(begin, end, &value);
+  EXPECT_EQ(pos, end) << str;
+  double expected = atof(str.c_str());
+  float value_f = 0;
+  ParseReal(begin, end, &value_f);
+  if (isnan(expected)) {
+    EXPECT_TRUE(isnan(value)) << str;
+    EXPECT_TRUE(isnan(value_f)) << str;
+  } else {
+    EXPECT_EQ(value, expected) << str;
+    EXPECT_EQ(value_f, (float)expected) << str;
+  }
+}
+
+TEST(PARSE_NUMBER_TEST, ParseReal) {
+  check_real("0");
+  check_real("1");
+  check_real("-1");
+  check_real("+1");
+  check_real("0.12");
+  check_real("-0.000123");
+  check_real(".5");
+  check_real("5.");
+  check_real("3.1415926535");
+  check_real("1e-5");
+  check_real("1.5E+3");
+  check_real("123456789012345678901234");
+  check_real("0.1234567890123456789012");
+  check_real("1e300");
+  check_real("2.5e-30");
+  check_real("inf");
+  check_real("-inf");
+  check_real("nan");
+  for (int i = 0; i < 10000; ++i) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*g", 1 + i % 17,
+             (rand() - RAND_MAX / 2.0) / (1 + rand() % 100000));
+    check_real(buf);
+  }
+}
+
+TEST(PARSE_NUMBER_TEST, ParseReal_not_terminated) {
+  std::string str = "0.25:12 abc";
+  const char* begin = str.data();
+  const char* end = begin + str.size();
+  float value = 0;
+  const char* pos = ParseReal(begin, begin + 3, &value);
+  EXPECT_EQ(pos, begin + 3);
+  EXPECT_FLOAT_EQ(value, 0.2);
+  pos = ParseReal(begin, end, &value);
+  EXPECT_EQ(*pos, ':');
+  EXPECT_FLOAT_EQ(value, 0.25);
+  // No number
+  value = 7;
+  pos = ParseReal(begin + 8, end, &value);
+  EXPECT_EQ(pos, begin + 8);
+  EXPECT_FLOAT_EQ(value, 7);
+}
+
+TEST(PARSE_NUMBER_TEST, ParseUInt) {
+  std::string str = "123:+45 x";
+  const char* begin = str.data();
+  const char* end = begin + str.size();
+  uint32 value = 0;
+  const char* pos = ParseUInt(begin, end, &value);
+  EXPECT_EQ(value, 123);
+  EXPECT_EQ(*pos, ':');
+  pos = ParseUInt(pos + 1, end, &value);
+  EXPECT_EQ(value, 45);
+  pos = SkipBlank(pos, end);
+  EXPECT_EQ(*pos, 'x');
+  // No number
+  EXPECT_EQ(ParseUInt(pos, end, &value), pos);
+  EXPECT_EQ(value, 45);
+  EXPECT_EQ(SkipBlank(end, end), end);
+}
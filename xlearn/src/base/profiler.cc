@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the Profiler class.
+*/
+
+#include "src/base/profiler.h"
+
+#include "src/base/file_util.h"
+
+Profiler::~Profiler() {
+  if (pool_ != nullptr) { pool_->SetTiming(false); }
+  if (file_ != nullptr) { Close(file_); }
+}
+
+const char* Profiler::PhaseName(Phase phase) {
+  static const char* names[kNumPhase] = {
+    "read", "grad", "predict", "metric", "model"
+  };
+  CHECK_GE(phase, 0);
+  CHECK_LT(phase, kNumPhase);
+  return names[phase];
+}
+
+void Profiler::Open(const std::string& filename, ThreadPool* pool) {
+  CHECK_NE(filename.empty(), true);
+  CHECK(file_ == nullptr);
+  file_ = OpenFileOrDie(filename.c_str(), "w");
+  csv_ = filename.size() >= 4 &&
+         filename.compare(filename.size() - 4, 4, ".csv") == 0;
+  pool_ = pool;
+  if (pool_ != nullptr) { pool_->SetTiming(true); }
+}
+
+void Profiler::reset() {
+  for (int i = 0; i < kNumPhase; ++i) {
+    phase_sec_[i] = 0;
+  }
+  train_rows_ = 0;
+  test_rows_ = 0;
+  update_nodes_ = 0;
+  bytes_read_ = 0;
+}
+
+void Profiler::StartEpoch(int epoch) {
+  epoch_ = epoch;
+  reset();
+  // Drop the time before this epoch
+  std::vector<double> busy;
+  if (pool_ != nullptr) { pool_->TakeTime(&busy); }
+  start_ = std::chrono::steady_clock::now();
+}
+
+void Profiler::EndEpoch() {
+  CHECK_NOTNULL(file_);
+  double wall = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start_).count();
+  std::vector<double> busy;
+  double wait = pool_ != nullptr ? pool_->TakeTime(&busy) : 0;
+  if (csv_) {
+    write_csv(wall, wait, busy);
+  } else {
+    write_json(wall, wait, busy);
+  }
+  // The record is complete even if the training is killed
+  fflush(file_);
+  record_++;
+}
+
+// {"epoch":1,"wall_sec":1.5,"read_sec":0.1,...,"busy_sec":[..]}
+void Profiler::write_json(double wall, double wait,
+                          const std::vector<double>& busy) {
+  fprintf(file_, "{\"epoch\":%d,\"wall_sec\":%.6f", epoch_, wall);
+  double other = wall;
+  for (int i = 0; i < kNumPhase; ++i) {
+    fprintf(file_, ",\"%s_sec\":%.6f",
+            PhaseName((Phase)i), phase_sec_[i]);
+    other -= phase_sec_[i];
+  }
+  fprintf(file_, ",\"other_sec\":%.6f", other > 0 ? other : 0);
+  fprintf(file_, ",\"train_rows\":%llu,\"test_rows\":%llu,"
+                 "\"update_nodes\":%llu,\"bytes_read\":%llu",
+          (unsigned long long)train_rows_,
+          (unsigned long long)test_rows_,
+          (unsigned long long)update_nodes_,
+          (unsigned long long)bytes_read_);
+  fprintf(file_, ",\"rows_per_sec\":%.2f,\"pool_wait_sec\":%.6f",
+          wall > 0 ? (train_rows_ + test_rows_) / wall : 0.0, wait);
+  fprintf(file_, ",\"busy_sec\":[");
+  for (size_t i = 0; i < busy.size(); ++i) {
+    fprintf(file_, "%s%.6f", i == 0 ? "" : ",", busy[i]);
+  }
+  fprintf(file_, "],\"idle_sec\":[");
+  for (size_t i = 0; i < busy.size(); ++i) {
+    double idle = wall - busy[i];
+    fprintf(file_, "%s%.6f", i == 0 ? "" : ",", idle > 0 ? idle : 0);
+  }
+  fprintf(file_, "]}\n");
+}
+
+// The header is written before the first record. The number of
+// threads does not change, so all the records have the same columns.
+void Profiler::write_csv(double wall, double wait,
+                         const std::vector<double>& busy) {
+  if (record_ == 0) {
+    fprintf(file_, "epoch,wall_sec");
+    for (int i = 0; i < kNumPhase; ++i) {
+      fprintf(file_, ",%s_sec", PhaseName((Phase)i));
+    }
+    fprintf(file_, ",other_sec,train_rows,test_rows,update_nodes,"
+                   "bytes_read,rows_per_sec,pool_wait_sec");
+    for (size_t i = 0; i < busy.size(); ++i) {
+      fprintf(file_, ",busy_sec_%d,idle_sec_%d", (int)i, (int)i);
+    }
+    fprintf(file_, "\n");
+  }
+  fprintf(file_, "%d,%.6f", epoch_, wall);
+  double other = wall;
+  for (int i = 0; i < kNumPhase; ++i) {
+    fprintf(file_, ",%.6f", phase_sec_[i]);
+    other -= phase_sec_[i];
+  }
+  fprintf(file_, ",%.6f,%llu,%llu,%llu,%llu,%.2f,%.6f",
+          other > 0 ? other : 0,
+          (unsigned long long)train_rows_,
+          (unsigned long long)test_rows_,
+          (unsigned long long)update_nodes_,
+          (unsigned long long)bytes_read_,
+          wall > 0 ? (train_rows_ + test_rows_) / wall : 0.0,
+          wait);
+  for (size_t i = 0; i < busy.size(); ++i) {
+    double idle = wall - busy[i];
+    fprintf(file_, ",%.6f,%.6f", busy[i], idle > 0 ? idle : 0);
+  }
+  fprintf(file_, "\n");
+}
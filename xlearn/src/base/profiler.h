@@ -0,0 +1,153 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the Profiler class, which records where the
+time of each training epoch goes.
+*/
+
+#ifndef XLEARN_BASE_PROFILER_H_
+#define XLEARN_BASE_PROFILER_H_
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/thread_pool.h"
+
+//------------------------------------------------------------------------------
+// Profiler accumulates the time of the phases of an epoch in the
+// caller thread, the counters of the trained rows, and the busy time
+// of each thread of the pool. Each EndEpoch() writes one record to
+// the file: a line of CSV if the file name ends with ".csv", and a
+// JSON object per line (JSON Lines) otherwise. We can use it like this:
+//
+//   Profiler profiler;
+//   profiler.Open("train_prof.json", &pool);
+//   for (int n = 1; n <= epoch; ++n) {
+//     profiler.StartEpoch(n);
+//     {
+//       Profiler::Scope scope(&profiler, Profiler::kRead);
+//       reader->Samples(matrix);
+//     }
+//     profiler.AddTrainRows(rows, nodes, bytes);
+//     ...
+//     profiler.EndEpoch();
+//   }
+//
+// The Scope of a nullptr profiler does nothing, so the code that is
+// instrumented costs one branch per mini-batch when profiling is off.
+//------------------------------------------------------------------------------
+class Profiler {
+ public:
+  // The phases of an epoch
+  enum Phase {
+    kRead = 0,   // Reader::Samples(), which waits for the parser on disk
+    kGrad,       // Loss::CalcGrad()
+    kPredict,    // Loss::Predict() of the validation
+    kMetric,     // Loss::Evalute() and Metric::Accumulate()
+    kModel,      // copy or pull of the model, such as SetBestModel()
+    kNumPhase
+  };
+
+  // Measure the time from construction to destruction
+  class Scope {
+   public:
+    Scope(Profiler* profiler, Phase phase)
+      : profiler_(profiler), phase_(phase) {
+      if (profiler_ != nullptr) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+    ~Scope() {
+      if (profiler_ != nullptr) {
+        profiler_->AddTime(phase_, std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start_).count());
+      }
+    }
+
+   private:
+    Profiler* profiler_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+  };
+
+  // Constructor and Destructor
+  Profiler() : file_(nullptr), csv_(false), pool_(nullptr),
+               epoch_(0), record_(0) { reset(); }
+  ~Profiler();
+
+  // Write the records to filename. The threads of pool (which
+  // can be nullptr) are timed until the profiler is destroyed.
+  void Open(const std::string& filename, ThreadPool* pool);
+
+  // Start and finish the record of an epoch
+  void StartEpoch(int epoch);
+  void EndEpoch();
+
+  // Add seconds to a phase of current epoch
+  void AddTime(Phase phase, double sec) { phase_sec_[phase] += sec; }
+
+  // Count the rows trained, whose nodes are the model updates
+  void AddTrainRows(uint64 rows, uint64 nodes, uint64 bytes) {
+    train_rows_ += rows;
+    update_nodes_ += nodes;
+    bytes_read_ += bytes;
+  }
+
+  // Count the rows of the validation
+  void AddTestRows(uint64 rows, uint64 bytes) {
+    test_rows_ += rows;
+    bytes_read_ += bytes;
+  }
+
+  // Return the name of a phase, such as "read"
+  static const char* PhaseName(Phase phase);
+
+  // Number of records written
+  int RecordNumber() const { return record_; }
+
+ private:
+  FILE* file_;
+  bool csv_;
+  ThreadPool* pool_;
+  int epoch_;
+  int record_;
+  std::chrono::steady_clock::time_point start_;
+  double phase_sec_[kNumPhase];
+  uint64 train_rows_;
+  uint64 test_rows_;
+  uint64 update_nodes_;
+  uint64 bytes_read_;
+
+  // Clear the counters of an epoch
+  void reset();
+
+  // Write the record of current epoch
+  void write_json(double wall, double wait,
+                  const std::vector<double>& busy);
+  void write_csv(double wall, double wait,
+                 const std::vector<double>& busy);
+
+  DISALLOW_COPY_AND_ASSIGN(Profiler);
+};
+
+#endif  // XLEARN_BASE_PROFILER_H_
@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests profiler.h
+*/
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/file_util.h"
+#include "src/base/profiler.h"
+
+const std::string kJsonFile = "./test_profile.json";
+const std::string kCsvFile = "./test_profile.csv";
+
+// Read all the lines of a file
+std::vector<std::string> read_lines(const std::string& filename) {
+  char* buf = nullptr;
+  uint64 size = ReadFileToMemory(filename, &buf);
+  std::string data(buf, size);
+  delete [] buf;
+  std::vector<std::string> lines;
+  size_t begin = 0;
+  for (size_t end = data.find('\n'); end != std::string::npos;
+       end = data.find('\n', begin)) {
+    lines.push_back(data.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return lines;
+}
+
+// Busy for ms milliseconds
+void spin(int ms) {
+  auto end = std::chrono::steady_clock::now() +
+             std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) { }
+}
+
+TEST(PROFILER_TEST, Pool_timing) {
+  ThreadPool pool(2);
+  std::vector<double> busy;
+  // Nothing is measured without timing
+  pool.ParallelFor(0, 4, 1, [&](size_t, size_t) { spin(5); });
+  EXPECT_EQ(pool.TakeTime(&busy), 0);
+  ASSERT_EQ(busy.size(), 2);
+  EXPECT_EQ(busy[0] + busy[1], 0);
+  pool.SetTiming(true);
+  pool.ParallelFor(0, 8, 1, [&](size_t, size_t) { spin(5); });
+  EXPECT_GE(pool.TakeTime(&busy), 0);
+  // The enqueued task is run by a thread of the pool, which adds
+  // its time after the future is ready
+  pool.enqueue(spin, 20).get();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(pool.TakeTime(&busy), 0);
+  EXPECT_GE(busy[0] + busy[1], 0.02);
+  EXPECT_LE(busy[0] + busy[1], 1.0);
+  // Reset by TakeTime()
+  pool.TakeTime(&busy);
+  EXPECT_EQ(busy[0] + busy[1], 0);
+}
+
+TEST(PROFILER_TEST, Null_scope) {
+  Profiler::Scope scope(nullptr, Profiler::kRead);
+  EXPECT_STREQ(Profiler::PhaseName(Profiler::kRead), "read");
+  EXPECT_STREQ(Profiler::PhaseName(Profiler::kModel), "model");
+}
+
+TEST(PROFILER_TEST, Json_record) {
+  ThreadPool pool(2);
+  {
+    Profiler profiler;
+    profiler.Open(kJsonFile, &pool);
+    for (int n = 1; n <= 2; ++n) {
+      profiler.StartEpoch(n);
+      {
+        Profiler::Scope scope(&profiler, Profiler::kGrad);
+        pool.ParallelFor(0, 8, 1, [&](size_t, size_t) { spin(2); });
+      }
+      profiler.AddTime(Profiler::kRead, 0.5);
+      profiler.AddTrainRows(100, 1000, 12800);
+      profiler.AddTestRows(10, 80);
+      profiler.EndEpoch();
+    }
+    EXPECT_EQ(profiler.RecordNumber(), 2);
+  }
+  std::vector<std::string> lines = read_lines(kJsonFile);
+  ASSERT_EQ(lines.size(), 2);
+  EXPECT_EQ(lines[0].find("{\"epoch\":1,"), 0);
+  EXPECT_EQ(lines[1].find("{\"epoch\":2,"), 0);
+  EXPECT_NE(lines[0].find("\"read_sec\":0.500000"), std::string::npos);
+  EXPECT_NE(lines[0].find("\"train_rows\":100,\"test_rows\":10,"
+                          "\"update_nodes\":1000,\"bytes_read\":12880"),
+            std::string::npos);
+  EXPECT_NE(lines[0].find("\"busy_sec\":["), std::string::npos);
+  EXPECT_NE(lines[0].find("\"idle_sec\":["), std::string::npos);
+  EXPECT_EQ(lines[0].back(), '}');
+  // The counters are of each epoch
+  EXPECT_NE(lines[1].find("\"train_rows\":100,"), std::string::npos);
+  RemoveFile(kJsonFile.c_str());
+}
+
+TEST(PROFILER_TEST, Csv_record) {
+  {
+    Profiler profiler;
+    profiler.Open(kCsvFile, nullptr);
+    for (int n = 1; n <= 3; ++n) {
+      profiler.StartEpoch(n);
+      profiler.AddTrainRows(5, 50, 640);
+      profiler.EndEpoch();
+    }
+  }
+  std::vector<std::string> lines = read_lines(kCsvFile);
+  ASSERT_EQ(lines.size(), 4);
+  EXPECT_EQ(lines[0], "epoch,wall_sec,read_sec,grad_sec,predict_sec,"
+                      "metric_sec,model_sec,other_sec,train_rows,"
+                      "test_rows,update_nodes,bytes_read,rows_per_sec,"
+                      "pool_wait_sec");
+  EXPECT_EQ(lines[3].find("3,"), 0);
+  EXPECT_NE(lines[3].find(",5,0,50,640,"), std::string::npos);
+  RemoveFile(kCsvFile.c_str());
+}
@@ -0,0 +1,72 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the ScratchArena class, which provides the
+per-thread temporary buffers of the inner loops.
+*/
+
+#ifndef XLEARN_BASE_SCRATCH_ARENA_H_
+#define XLEARN_BASE_SCRATCH_ARENA_H_
+
+#include <vector>
+
+#include "src/base/common.h"
+
+//------------------------------------------------------------------------------
+// ScratchArena is a buffer that only grows. The inner loops use it
+// for the temporary arrays (e.g., the sum vector of fm), so that the
+// memory is allocated for the first rows only instead of every row:
+//
+//   float* s = ScratchArena<float>::ThreadLocal()->Get(aligned_k);
+//   /* use s[0], ..., s[aligned_k-1] */
+//
+// Each thread has its own arena, so the threads never share a buffer.
+// The next Get() of the same thread returns the same memory, hence the
+// buffer must not be kept after current function returns. The buffer
+// is not cleared, so it keeps the content of the last use.
+//------------------------------------------------------------------------------
+template <typename T>
+class ScratchArena {
+ public:
+  ScratchArena() { }
+  ~ScratchArena() { }
+
+  // Return a buffer of at least size elements.
+  inline T* Get(size_t size) {
+    if (buf_.size() < size) {
+      buf_.resize(size);
+    }
+    return buf_.data();
+  }
+
+  // Size of the buffer
+  inline size_t Capacity() const { return buf_.size(); }
+
+  // The arena of current thread
+  static ScratchArena* ThreadLocal() {
+    static thread_local ScratchArena arena;
+    return &arena;
+  }
+
+ private:
+  std::vector<T> buf_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScratchArena);
+};
+
+#endif  // XLEARN_BASE_SCRATCH_ARENA_H_
@@ -15,7 +15,7 @@
 //------------------------------------------------------------------------------
 
 /*
-This file provides a simple implementation of the 
+This file provides a work-stealing implementation of the
 thread pool that used by xLearn.
 */
 
@@ -23,7 +23,8 @@ thread pool that used by xLearn.
 #define XLEARN_BASE_THREAD_POOL_H_
 
 #include <vector>
-#include <queue>
+#include <deque>
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -32,82 +33,386 @@ thread pool that used by xLearn.
 #include <functional>
 #include <stdexcept>
 #include <atomic>
+#include <chrono>
 
 #include "src/base/common.h"
+#include "src/base/numa.h"
+
+class ThreadPool;
 
 //------------------------------------------------------------------------------
-// Simple ThreadPool that creates N threads upon its creation,
-// and pulls from a queue to get new jobs.
-// Basic Usage:
+// TaskGroup is a set of tasks that run in the ThreadPool, and we can
+// wait for all of them. The destructor waits for the tasks, so a task
+// group on the stack is a scoped join:
+//
+//   {
+//     TaskGroup group(&pool);
+//     group.Run([&]() { ... task 1 ... });
+//     group.Run([&]() { ... task 2 ... });
+//   }  /* task 1 and task 2 are finished here */
+//
+// The waiting thread also runs the tasks in the pool, so we can
+// wait for a group inside another task of the same pool.
+//------------------------------------------------------------------------------
+class TaskGroup {
+ public:
+  // Constructor and Destructor
+  explicit TaskGroup(ThreadPool* pool) : pool_(pool), pending_(0) { }
+  ~TaskGroup() { Wait(); }
+
+  // Add a task to the pool.
+  void Run(std::function<void()> func);
+
+  // Wait all the tasks of this group to finish.
+  void Wait();
+
+ private:
+  friend class ThreadPool;
+
+  // Wait() without timing.
+  void wait();
+
+  // Add count to the pending tasks.
+  void add(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ += count;
+  }
+
+  // Invoked when a task of this group is finished.
+  void done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      cond_.notify_all();
+    }
+  }
+
+  ThreadPool* pool_;
+  /* Number of unfinished tasks */
+  size_t pending_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+//------------------------------------------------------------------------------
+// ThreadPool creates N threads upon its creation. Each thread has
+// its own task deque: it takes the newest task from the back of its own
+// deque, and steals the oldest task from the front of the other deques
+// when its own deque is empty. Basic Usage:
 //
 //   /* Create thread pool with 4 threads */
-//   ThreadPool pool(4);  
+//   ThreadPool pool(4);
+//
+//   /* Run fn(start, end) on the chunks of [0, 10000), and each
+//   chunk has at least 64 elements. The caller thread also runs
+//   the chunks, and returns when all of them are finished */
+//   pool.ParallelFor(0, 10000, 64, [&](size_t start, size_t end) {
+//     for (size_t i = start; i < end; ++i) { ... }
+//   });
+//
+//   /* Sum the result of each chunk in order */
+//   real_t sum = pool.ParallelReduce(0, 10000, 64, (real_t)0,
+//     [&](size_t start, size_t end) { ... return chunk_sum; });
+//
 //   /* Enqueue and store future */
 //   auto result = pool.enqueue([](int answer) { return answer; }, 42);
-//   /* Get result from future*/
 //   std::cout << result.get() << std::endl;
-//  
-// This class requires a number of c++11 features be present in your compiler.
+//
+// If the range is not larger than the grain size, ParallelFor() runs
+// it in the caller thread without scheduling, so it is cheap for small
+// mini-batches. ParallelFor() does not allocate memory for its tasks.
+// Different threads can use the same pool at the same time.
+//
+// The threads can be bound to some CPUs, such as the CPUs of one
+// NUMA node, by giving the CPU list to the constructor:
+//
+//   ThreadPool pool(4, GetNumaNodes()[0].cpus);
+//
+// The pool can also measure the time each thread spends in the tasks,
+// and the time the callers wait for a TaskGroup (see Profiler):
+//
+//   pool.SetTiming(true);
+//   ... /* run tasks */
+//   std::vector<double> busy;
+//   double wait = pool.TakeTime(&busy);
 //------------------------------------------------------------------------------
 class ThreadPool {
  public:
   // Constructor and Destructor
-  ThreadPool(size_t);
+  explicit ThreadPool(size_t threads,
+                      const std::vector<int>& cpus = std::vector<int>());
   ~ThreadPool();
 
-  // Add task to current queue
+  // Add task to current pool and return its future
   template<class F, class... Args>
   auto enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type>;
 
-  // Sync threads
-  void Sync(int wait_count);
+  // Run fn(start, end) on the chunks of [begin, end) in parallel.
+  template <typename Func>
+  void ParallelFor(size_t begin, size_t end, size_t grain, Func fn);
+
+  // Run fn(start, end) on the chunks of [begin, end) in parallel
+  // and return init + the sum of their results. The results are
+  // summed in the order of chunks.
+  template <typename T, typename Func>
+  T ParallelReduce(size_t begin, size_t end, size_t grain,
+                   T init, Func fn);
 
   // Return the number of threads
   size_t ThreadNumber();
 
-private:
-    // need to keep track of threads so we can join them
-    std::vector<std::thread> workers;
-    // the task queue
-    std::queue<std::function<void()>> tasks;
-    // synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    std::mutex sync_mutex;
-    std::condition_variable sync_condition;
-    bool stop;
-    std::atomic_int sync { 0 };
+  // Measure the busy time of the threads and the wait time of the
+  // callers. It costs one branch per task when it is off.
+  void SetTiming(bool timing) {
+    timing_.store(timing, std::memory_order_relaxed);
+  }
+
+  // Return the seconds the callers waited in TaskGroup::Wait() since
+  // the last call, and set busy[i] to the seconds the i-th thread ran
+  // tasks in the same period. Both are reset to zero.
+  double TakeTime(std::vector<double>* busy);
+
+ private:
+  friend class TaskGroup;
+
+  // A task is either a function or a range of ParallelFor
+  struct Task {
+    Task() : range_func(nullptr), ctx(nullptr),
+             begin(0), end(0), group(nullptr) { }
+    std::function<void()> func;
+    void (*range_func)(void* ctx, size_t begin, size_t end);
+    void* ctx;
+    size_t begin;
+    size_t end;
+    TaskGroup* group;
+  };
+
+  // Task deque of each thread
+  struct TaskQueue {
+    std::deque<Task> tasks;
+    std::mutex mutex;
+  };
+
+  /* Each thread gets 4 chunks of ParallelFor on average */
+  static const size_t kChunksPerThread = 4;
+
+  // need to keep track of threads so we can join them
+  std::vector<std::thread> workers_;
+  // the task deque of each thread
+  std::vector<std::unique_ptr<TaskQueue> > queues_;
+  // number of tasks in all the deques
+  std::atomic<long> pending_;
+  // deque for the next task from outside
+  std::atomic<size_t> next_;
+  // synchronization
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  bool stop_;
+  // busy nanoseconds of each thread and wait nanoseconds of the callers
+  std::atomic<bool> timing_;
+  std::unique_ptr<std::atomic<uint64>[]> busy_ns_;
+  std::atomic<uint64> wait_ns_;
+
+  // The pool and the index of current thread.
+  // Index is -1 if it is not a thread of this pool.
+  int current_thread() {
+    return current_pool() == this ? current_index() : -1;
+  }
+  static ThreadPool*& current_pool() {
+    static thread_local ThreadPool* pool = nullptr;
+    return pool;
+  }
+  static int& current_index() {
+    static thread_local int index = -1;
+    return index;
+  }
+
+  // CPUs that the threads are bound to
+  std::vector<int> cpus_;
+
+  // Main loop of each thread
+  void worker_loop(int index);
+
+  // Add task to the deque of current thread, or to the
+  // deques in round robin if it is not a thread of this pool.
+  void push(Task&& task);
+
+  // Add the chunks of [begin, end) to the deques.
+  void push_range(void (*range_func)(void*, size_t, size_t),
+                  void* ctx, size_t begin, size_t end,
+                  size_t chunk, TaskGroup* group);
+
+  // Wake up the sleeping threads
+  void notify(bool all);
+
+  // Get a task from own deque, or steal one from the others.
+  bool pop(Task* task);
+
+  // Run the task and tell its group.
+  void run(Task& task) {
+    if (task.range_func != nullptr) {
+      task.range_func(task.ctx, task.begin, task.end);
+    } else {
+      task.func();
+    }
+    if (task.group != nullptr) {
+      task.group->done();
+    }
+  }
+
+  // The size of each chunk of ParallelFor.
+  size_t chunk_size(size_t count, size_t grain) {
+    if (grain == 0) { grain = 1; }
+    if (workers_.empty()) { return count; }
+    size_t parts = kChunksPerThread * (workers_.size() + 1);
+    size_t chunk = (count + parts - 1) / parts;
+    return chunk > grain ? chunk : grain;
+  }
+
+  template <typename Func>
+  static void call_range(void* ctx, size_t begin, size_t end) {
+    (*static_cast<Func*>(ctx))(begin, end);
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
 // The constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    : stop(false) {
-  for(size_t i = 0; i<threads; ++i)
-    workers.emplace_back(
-      [this]
-      {
-        for(;;) {
-            std::function<void()> task;
-            {
-              std::unique_lock<std::mutex> lock(this->queue_mutex);
-              this->condition.wait(lock,
-                [this]{ return this->stop || !this->tasks.empty(); });
-              if (this->stop && this->tasks.empty()) {
-                return;
-              }
-              task = std::move(this->tasks.front());
-              this->tasks.pop();
-            }
-         task();
-         sync++;
-         {
-           std::unique_lock<std::mutex> lock(this->sync_mutex);
-           sync_condition.notify_one();
-         }
+inline ThreadPool::ThreadPool(size_t threads,
+                              const std::vector<int>& cpus)
+    : pending_(0), next_(0), stop_(false), timing_(false),
+      busy_ns_(new std::atomic<uint64>[threads > 0 ? threads : 1]),
+      wait_ns_(0), cpus_(cpus) {
+  size_t num = threads > 0 ? threads : 1;
+  for (size_t i = 0; i < num; ++i) {
+    busy_ns_[i].store(0);
+  }
+  for (size_t i = 0; i < num; ++i) {
+    queues_.emplace_back(new TaskQueue);
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this, (int)i);
+  }
+}
+
+// the destructor joins all threads
+inline ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cond_.notify_all();
+  for (std::thread &worker: workers_) {
+    worker.join();
+  }
+}
+
+// Each thread runs tasks until the pool is stopped
+inline void ThreadPool::worker_loop(int index) {
+  current_pool() = this;
+  current_index() = index;
+  BindToCPUs(cpus_);
+  for (;;) {
+    Task task;
+    if (pop(&task)) {
+      if (timing_.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+        run(task);
+        busy_ns_[index] += std::chrono::duration_cast<
+          std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+      } else {
+        run(task);
       }
+      continue;
     }
-  );
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cond_.wait(lock,
+      [this]{ return stop_ || pending_.load() > 0; });
+    if (stop_ && pending_.load() <= 0) {
+      return;
+    }
+  }
+}
+
+inline void ThreadPool::notify(bool all) {
+  // Lock here so that no thread misses the wake up
+  { std::unique_lock<std::mutex> lock(sleep_mutex_); }
+  if (all) {
+    sleep_cond_.notify_all();
+  } else {
+    sleep_cond_.notify_one();
+  }
+}
+
+inline void ThreadPool::push(Task&& task) {
+  int self = current_thread();
+  size_t index = self >= 0 ? self : next_++ % queues_.size();
+  pending_++;
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  notify(false);
+}
+
+inline void ThreadPool::push_range(void (*range_func)(void*, size_t, size_t),
+                                   void* ctx, size_t begin, size_t end,
+                                   size_t chunk, TaskGroup* group) {
+  size_t num = (end - begin + chunk - 1) / chunk;
+  pending_ += num;
+  // Spread the chunks to all the deques, so the
+  // threads don't need to steal at the beginning.
+  size_t queue_num = queues_.size();
+  size_t first = next_++;
+  for (size_t q = 0; q < queue_num && q < num; ++q) {
+    TaskQueue* queue = queues_[(first + q) % queue_num].get();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (size_t i = q; i < num; i += queue_num) {
+      Task task;
+      task.range_func = range_func;
+      task.ctx = ctx;
+      task.begin = begin + i * chunk;
+      task.end = std::min(end, task.begin + chunk);
+      task.group = group;
+      queue->tasks.push_back(std::move(task));
+    }
+  }
+  notify(true);
+}
+
+inline bool ThreadPool::pop(Task* task) {
+  if (pending_.load() <= 0) { return false; }
+  size_t queue_num = queues_.size();
+  int self = current_thread();
+  // Newest task of own deque
+  if (self >= 0) {
+    TaskQueue* queue = queues_[self].get();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      *task = std::move(queue->tasks.back());
+      queue->tasks.pop_back();
+      pending_--;
+      return true;
+    }
+  }
+  // Steal the oldest task of others
+  size_t start = self >= 0 ? self + 1 : next_.load();
+  for (size_t i = 0; i < queue_num; ++i) {
+    size_t index = (start + i) % queue_num;
+    if ((int)index == self) { continue; }
+    TaskQueue* queue = queues_[index].get();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      *task = std::move(queue->tasks.front());
+      queue->tasks.pop_front();
+      pending_--;
+      return true;
+    }
+  }
+  return false;
 }
 
 // Add new work item to the pool
@@ -115,45 +420,109 @@ template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type> {
   using return_type = typename std::result_of<F(Args...)>::type;
-  auto task = std::make_shared< std::packaged_task<return_type()> >(
+  auto packaged = std::make_shared< std::packaged_task<return_type()> >(
     std::bind(std::forward<F>(f), std::forward<Args>(args)...)
   );
-  std::future<return_type> res = task->get_future();
+  std::future<return_type> res = packaged->get_future();
   {
-    std::unique_lock<std::mutex> lock(queue_mutex);
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
     // don't allow enqueueing after stopping the pool
-    if (stop) {
+    if (stop_) {
       throw std::runtime_error("enqueue on stopped ThreadPool");
     }
-    tasks.emplace([task](){ (*task)(); });
   }
-  condition.notify_one();
+  Task task;
+  task.func = [packaged](){ (*packaged)(); };
+  push(std::move(task));
   return res;
 }
 
-// Wait all thread to finish their jobs
-inline void ThreadPool::Sync(int wait_count) {
-  std::unique_lock<std::mutex> lock(sync_mutex);
-  this->sync_condition.wait(lock, [&]() {
-    return sync == wait_count;
+template <typename Func>
+void ThreadPool::ParallelFor(size_t begin, size_t end,
+                             size_t grain, Func fn) {
+  if (begin >= end) { return; }
+  size_t count = end - begin;
+  size_t chunk = chunk_size(count, grain);
+  // Small range: we don't need scheduling
+  if (chunk >= count) {
+    fn(begin, end);
+    return;
+  }
+  TaskGroup group(this);
+  size_t num = (count + chunk - 1) / chunk;
+  group.add(num - 1);
+  push_range(&call_range<Func>, &fn, begin + chunk, end, chunk, &group);
+  // The first chunk is run by the caller thread
+  fn(begin, begin + chunk);
+  group.Wait();
+}
+
+template <typename T, typename Func>
+T ThreadPool::ParallelReduce(size_t begin, size_t end, size_t grain,
+                             T init, Func fn) {
+  if (begin >= end) { return init; }
+  size_t chunk = chunk_size(end - begin, grain);
+  size_t num = (end - begin + chunk - 1) / chunk;
+  std::vector<T> partial(num);
+  ParallelFor(begin, end, chunk, [&](size_t start, size_t stop) {
+    partial[(start - begin) / chunk] = fn(start, stop);
   });
-  sync = 0;
+  for (size_t i = 0; i < num; ++i) {
+    init += partial[i];
+  }
+  return init;
 }
 
 // Return the number of threads
 inline size_t ThreadPool::ThreadNumber() {
-  return workers.size();
+  return workers_.size();
 }
 
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool() {
-  {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    stop = true;
+inline double ThreadPool::TakeTime(std::vector<double>* busy) {
+  CHECK_NOTNULL(busy);
+  busy->resize(workers_.size());
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    (*busy)[i] = busy_ns_[i].exchange(0) * 1e-9;
   }
-  condition.notify_all();
-  for (std::thread &worker: workers) {
-    worker.join();
+  return wait_ns_.exchange(0) * 1e-9;
+}
+
+inline void TaskGroup::Run(std::function<void()> func) {
+  add(1);
+  ThreadPool::Task task;
+  task.func = std::move(func);
+  task.group = this;
+  pool_->push(std::move(task));
+}
+
+inline void TaskGroup::Wait() {
+  if (pool_->timing_.load(std::memory_order_relaxed)) {
+    auto start = std::chrono::steady_clock::now();
+    wait();
+    pool_->wait_ns_ += std::chrono::duration_cast<
+      std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+  } else {
+    wait();
+  }
+}
+
+inline void TaskGroup::wait() {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (pending_ == 0) { return; }
+    }
+    // Help the pool instead of sleeping
+    ThreadPool::Task task;
+    if (pool_->pop(&task)) {
+      pool_->run(task);
+      continue;
+    }
+    // All the remaining tasks are running
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]{ return pending_ == 0; });
+    return;
   }
 }
 
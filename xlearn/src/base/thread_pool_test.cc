@@ -20,6 +20,8 @@ This file tests thread_pool.h file.
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 #include "src/base/thread_pool.h"
 
 void func(int id) {
@@ -29,15 +31,16 @@ void func(int id) {
 TEST(ThreadPoolTest, Print_test) {
   ThreadPool pool(4);
   for (int i = 0; i < 3; ++i) {
-    pool.enqueue(std::bind(func, 1));
-    pool.enqueue(std::bind(func, 2));
-    pool.enqueue(std::bind(func, 3));
-    pool.enqueue(std::bind(func, 4));
-    pool.Sync(4);
+    {
+      TaskGroup group(&pool);
+      group.Run(std::bind(func, 1));
+      group.Run(std::bind(func, 2));
+      group.Run(std::bind(func, 3));
+      group.Run(std::bind(func, 4));
+    }
     printf("Hello master\n");
   }
   printf("final\n");
-  usleep(100);
 }
 
 int a1 = 0;
@@ -55,13 +58,125 @@ void Sum(int *val) {
 TEST(ThreadPoolTest, Sum_test) {
   ThreadPool pool(5);
   for (int i = 0; i < 3; ++i) {
-    pool.enqueue(std::bind(Sum, &a1));
-    pool.enqueue(std::bind(Sum, &a2));
-    pool.enqueue(std::bind(Sum, &a3));
-    pool.enqueue(std::bind(Sum, &a4));
-    pool.enqueue(std::bind(Sum, &a5));
-    pool.Sync(5);
+    TaskGroup group(&pool);
+    group.Run(std::bind(Sum, &a1));
+    group.Run(std::bind(Sum, &a2));
+    group.Run(std::bind(Sum, &a3));
+    group.Run(std::bind(Sum, &a4));
+    group.Run(std::bind(Sum, &a5));
+    group.Wait();
   }
   int sum = a1 + a2 + a3 + a4 + a5;
   EXPECT_EQ(sum, 75);
 }
+
+TEST(ThreadPoolTest, Enqueue_test) {
+  ThreadPool pool(2);
+  auto result = pool.enqueue([](int answer) { return answer; }, 42);
+  EXPECT_EQ(result.get(), 42);
+}
+
+TEST(ThreadPoolTest, ParallelFor_test) {
+  ThreadPool pool(4);
+  const size_t kSize = 100003;
+  for (size_t grain = 1; grain <= kSize * 2; grain *= 7) {
+    std::vector<int> count(kSize, 0);
+    pool.ParallelFor(3, kSize, grain, [&](size_t start, size_t end) {
+      EXPECT_LT(start, end);
+      for (size_t i = start; i < end; ++i) {
+        count[i]++;
+      }
+    });
+    for (size_t i = 0; i < kSize; ++i) {
+      EXPECT_EQ(count[i], i < 3 ? 0 : 1);
+    }
+  }
+  // Empty range
+  pool.ParallelFor(5, 5, 1, [&](size_t start, size_t end) {
+    ADD_FAILURE();
+  });
+}
+
+TEST(ThreadPoolTest, Small_range_test) {
+  ThreadPool pool(4);
+  std::thread::id caller = std::this_thread::get_id();
+  pool.ParallelFor(0, 100, 100, [&](size_t start, size_t end) {
+    EXPECT_EQ(start, 0);
+    EXPECT_EQ(end, 100);
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+  });
+}
+
+TEST(ThreadPoolTest, ParallelReduce_test) {
+  ThreadPool pool(3);
+  long sum = pool.ParallelReduce(0, 10001, 16, (long)5,
+    [&](size_t start, size_t end) {
+      long s = 0;
+      for (size_t i = start; i < end; ++i) { s += i; }
+      return s;
+  });
+  EXPECT_EQ(sum, 5 + 10000L * 10001 / 2);
+  // The float result does not depend on the scheduling.
+  std::vector<float> val(100000);
+  for (size_t i = 0; i < val.size(); ++i) {
+    val[i] = 1.0 / (i + 1);
+  }
+  auto partial = [&](size_t start, size_t end) {
+    float s = 0;
+    for (size_t i = start; i < end; ++i) { s += val[i]; }
+    return s;
+  };
+  float first = pool.ParallelReduce(0, val.size(), 64, 0.0f, partial);
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(pool.ParallelReduce(0, val.size(), 64, 0.0f, partial),
+              first);
+  }
+}
+
+TEST(ThreadPoolTest, Concurrent_users_test) {
+  ThreadPool pool(4);
+  const int kUser = 4;
+  std::vector<long> result(kUser, 0);
+  std::vector<std::thread> users;
+  for (int u = 0; u < kUser; ++u) {
+    users.emplace_back([&, u]() {
+      for (int r = 0; r < 200; ++r) {
+        result[u] += pool.ParallelReduce(0, 1000, 8, 0L,
+          [&](size_t start, size_t end) { return (long)(end - start); });
+      }
+    });
+  }
+  for (std::thread& user : users) {
+    user.join();
+  }
+  for (int u = 0; u < kUser; ++u) {
+    EXPECT_EQ(result[u], 200 * 1000);
+  }
+}
+
+TEST(ThreadPoolTest, Nested_test) {
+  ThreadPool pool(3);
+  std::vector<long> sum(64, 0);
+  pool.ParallelFor(0, sum.size(), 1, [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      sum[i] = pool.ParallelReduce(0, 1000, 1, 0L,
+        [&](size_t b, size_t e) { return (long)(e - b); });
+    }
+  });
+  for (size_t i = 0; i < sum.size(); ++i) {
+    EXPECT_EQ(sum[i], 1000);
+  }
+}
+
+TEST(ThreadPoolTest, No_thread_test) {
+  ThreadPool pool(0);
+  EXPECT_EQ(pool.ThreadNumber(), 0);
+  long sum = pool.ParallelReduce(0, 1000, 1, 0L,
+    [&](size_t start, size_t end) { return (long)(end - start); });
+  EXPECT_EQ(sum, 1000);
+  int value = 0;
+  TaskGroup group(&pool);
+  group.Run([&]() { value = 1; });
+  group.Wait();
+  EXPECT_EQ(value, 1);
+}
@@ -193,6 +193,42 @@ XL_DLL int XLearnPredict(XL *out, const char *model_path, const char *out_path)
   API_END();
 }
 
+// Load model for the in-memory prediction
+XL_DLL int XLearnModelLoad(const char *model_path, int nthread,
+                           bool norm, XLModel *out) {
+  API_BEGIN();
+  CHECK_GE(nthread, 0);
+  xLearn::MemoryPredictor* predictor = new xLearn::MemoryPredictor;
+  predictor->Initialize(std::string(model_path), nthread, norm);
+  *out = predictor;
+  API_END();
+}
+
+// Free the loaded model
+XL_DLL int XLearnModelFree(XLModel *out) {
+  API_BEGIN();
+  delete reinterpret_cast<xLearn::MemoryPredictor*>(*out);
+  *out = nullptr;
+  API_END();
+}
+
+// Predict the CSR matrix in memory
+XL_DLL int XLearnPredictCSR(XLModel *model, uint64_t num_row,
+                            const uint64_t *indptr,
+                            const uint32_t *indices,
+                            const uint32_t *fields,
+                            const float *values,
+                            bool sign, bool sigmoid,
+                            float *out) {
+  API_BEGIN();
+  xLearn::MemoryPredictor* predictor = 
+      reinterpret_cast<xLearn::MemoryPredictor*>(*model);
+  CHECK_NOTNULL(predictor);
+  predictor->Predict(num_row, indptr, indices, fields, 
+                     values, out, sign, sigmoid);
+  API_END();
+}
+
 // Set string param
 XL_DLL int XLearnSetStr(XL *out, const char *key, const char *value) {
   API_BEGIN();
@@ -213,6 +249,16 @@ XL_DLL int XLearnSetStr(XL *out, const char *key, const char *value) {
   	xl->GetHyperParam().loss_func = std::string(value);
   } else if (strcmp(key, "opt") == 0) {
     xl->GetHyperParam().opt_type = std::string(value);
+  } else if (strcmp(key, "quantize") == 0) {
+    xl->GetHyperParam().quantize = std::string(value);
+  } else if (strcmp(key, "best_model") == 0) {
+    xl->GetHyperParam().best_model_file = std::string(value);
+  } else if (strcmp(key, "checkpoint") == 0) {
+    xl->GetHyperParam().checkpoint_file = std::string(value);
+  } else if (strcmp(key, "profile") == 0) {
+    xl->GetHyperParam().profile_file = std::string(value);
+  } else if (strcmp(key, "shuffle") == 0) {
+    xl->GetHyperParam().shuffle_mode = std::string(value);
   }
   API_END();
 }
@@ -231,6 +277,16 @@ XL_DLL int XLearnGetStr(XL *out, const char *key, std::string& value) {
     value = xl->GetHyperParam().loss_func;
   } else if (strcmp(key, "opt") == 0) {
     value = xl->GetHyperParam().opt_type;
+  } else if (strcmp(key, "quantize") == 0) {
+    value = xl->GetHyperParam().quantize;
+  } else if (strcmp(key, "best_model") == 0) {
+    value = xl->GetHyperParam().best_model_file;
+  } else if (strcmp(key, "checkpoint") == 0) {
+    value = xl->GetHyperParam().checkpoint_file;
+  } else if (strcmp(key, "profile") == 0) {
+    value = xl->GetHyperParam().profile_file;
+  } else if (strcmp(key, "shuffle") == 0) {
+    value = xl->GetHyperParam().shuffle_mode;
   }
   API_END();
 }
@@ -247,10 +303,30 @@ XL_DLL int XLearnSetInt(XL *out, const char *key, const int value) {
   	xl->GetHyperParam().num_folds = value;
   } else if (strcmp(key, "block_size") == 0) {
   	xl->GetHyperParam().block_size = value;
+  } else if (strcmp(key, "prefetch_depth") == 0) {
+    xl->GetHyperParam().prefetch_depth = value;
   } else if (strcmp(key, "nthread") == 0) {
     xl->GetHyperParam().thread_number = value;
   } else if (strcmp(key, "stop_window") == 0) {
     xl->GetHyperParam().stop_window = value;
+  } else if (strcmp(key, "numa_sync") == 0) {
+    xl->GetHyperParam().numa_sync = value;
+  } else if (strcmp(key, "sync_batch") == 0) {
+    xl->GetHyperParam().sync_batch = value;
+  } else if (strcmp(key, "cv_parallel") == 0) {
+    xl->GetHyperParam().cv_parallel = value;
+  } else if (strcmp(key, "hash_bits") == 0) {
+    xl->GetHyperParam().hash_bits = value;
+  } else if (strcmp(key, "stream_batch") == 0) {
+    xl->GetHyperParam().stream_batch = value;
+  } else if (strcmp(key, "stream_window") == 0) {
+    xl->GetHyperParam().stream_window = value;
+  } else if (strcmp(key, "nfield") == 0) {
+    xl->GetHyperParam().num_field = value;
+  } else if (strcmp(key, "checkpoint_rows") == 0) {
+    xl->GetHyperParam().checkpoint_rows = value;
+  } else if (strcmp(key, "checkpoint_sec") == 0) {
+    xl->GetHyperParam().checkpoint_sec = value;
   }
   API_END();
 }
@@ -267,10 +343,30 @@ XL_DLL int XLearnGetInt(XL *out, const char *key, int *value) {
     *value = xl->GetHyperParam().num_folds;
   } else if (strcmp(key, "block_size") == 0) {
     *value = xl->GetHyperParam().block_size;
+  } else if (strcmp(key, "prefetch_depth") == 0) {
+    *value = xl->GetHyperParam().prefetch_depth;
   } else if (strcmp(key, "nthread") == 0) {
     *value = xl->GetHyperParam().thread_number;
   } else if (strcmp(key, "stop_window") == 0) {
     *value = xl->GetHyperParam().stop_window;
+  } else if (strcmp(key, "numa_sync") == 0) {
+    *value = xl->GetHyperParam().numa_sync;
+  } else if (strcmp(key, "sync_batch") == 0) {
+    *value = xl->GetHyperParam().sync_batch;
+  } else if (strcmp(key, "cv_parallel") == 0) {
+    *value = xl->GetHyperParam().cv_parallel;
+  } else if (strcmp(key, "hash_bits") == 0) {
+    *value = xl->GetHyperParam().hash_bits;
+  } else if (strcmp(key, "stream_batch") == 0) {
+    *value = xl->GetHyperParam().stream_batch;
+  } else if (strcmp(key, "stream_window") == 0) {
+    *value = xl->GetHyperParam().stream_window;
+  } else if (strcmp(key, "nfield") == 0) {
+    *value = xl->GetHyperParam().num_field;
+  } else if (strcmp(key, "checkpoint_rows") == 0) {
+    *value = xl->GetHyperParam().checkpoint_rows;
+  } else if (strcmp(key, "checkpoint_sec") == 0) {
+    *value = xl->GetHyperParam().checkpoint_sec;
   }
   API_END();
 }
@@ -293,6 +389,8 @@ XL_DLL int XLearnSetFloat(XL *out, const char *key, const float value) {
     xl->GetHyperParam().lambda_1 = value;
   } else if (strcmp(key, "lambda_2") == 0) {
     xl->GetHyperParam().lambda_2 = value;
+  } else if (strcmp(key, "prune") == 0) {
+    xl->GetHyperParam().prune_threshold = value;
   }
   API_END();
 }
@@ -315,6 +413,8 @@ XL_DLL int XLearnGetFloat(XL *out, const char *key, float *value) {
     *value = xl->GetHyperParam().lambda_1;
   } else if (strcmp(key, "lambda_2") == 0) {
     *value = xl->GetHyperParam().lambda_2;
+  } else if (strcmp(key, "prune") == 0) {
+    *value = xl->GetHyperParam().prune_threshold;
   }
   API_END();
 }
@@ -331,8 +431,20 @@ XL_DLL int XLearnSetBool(XL *out, const char *key, const bool value) {
   	xl->GetHyperParam().norm = value;
   } else if (strcmp(key, "lock_free") == 0) {
   	xl->GetHyperParam().lock_free = value;
+  } else if (strcmp(key, "numa") == 0) {
+    xl->GetHyperParam().numa = value;
+  } else if (strcmp(key, "sync") == 0) {
+    xl->GetHyperParam().sync = value;
+  } else if (strcmp(key, "sparse_feature") == 0) {
+    xl->GetHyperParam().sparse_feature = value;
+  } else if (strcmp(key, "exact_auc") == 0) {
+    xl->GetHyperParam().exact_auc = value;
   } else if (strcmp(key, "early_stop") == 0) {
   	xl->GetHyperParam().early_stop = value;
+  } else if (strcmp(key, "stream") == 0) {
+    xl->GetHyperParam().stream = value;
+  } else if (strcmp(key, "verify_binary") == 0) {
+    xl->GetHyperParam().verify_binary = value;
   } else if (strcmp(key, "sign") == 0) {
   	xl->GetHyperParam().sign = value;
   } else if (strcmp(key, "sigmoid") == 0) {
@@ -353,8 +465,20 @@ XL_DLL int XLearnGetBool(XL *out, const char *key, bool *value) {
     *value = xl->GetHyperParam().norm;
   } else if (strcmp(key, "lock_free") == 0) {
     *value = xl->GetHyperParam().lock_free;
+  } else if (strcmp(key, "numa") == 0) {
+    *value = xl->GetHyperParam().numa;
+  } else if (strcmp(key, "sync") == 0) {
+    *value = xl->GetHyperParam().sync;
+  } else if (strcmp(key, "sparse_feature") == 0) {
+    *value = xl->GetHyperParam().sparse_feature;
+  } else if (strcmp(key, "exact_auc") == 0) {
+    *value = xl->GetHyperParam().exact_auc;
   } else if (strcmp(key, "early_stop") == 0) {
     *value = xl->GetHyperParam().early_stop;
+  } else if (strcmp(key, "stream") == 0) {
+    *value = xl->GetHyperParam().stream;
+  } else if (strcmp(key, "verify_binary") == 0) {
+    *value = xl->GetHyperParam().verify_binary;
   } else if (strcmp(key, "sign") == 0) {
     *value = xl->GetHyperParam().sign = value;
   } else if (strcmp(key, "sigmoid") == 0) {
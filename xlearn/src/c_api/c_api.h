@@ -31,6 +31,7 @@ for interfacing to other languages.
 #ifdef __cplusplus
 #define XL_EXTERN_C extern "C"
 #include <cstdio>
+#include <cstdint>
 #else
 #define XL_EXTERN_C
 #include <stdio.h>
@@ -46,6 +47,9 @@ for interfacing to other languages.
 /* Handle to xlearn */
 typedef void* XL;
 
+/* Handle to a model loaded for the in-memory prediction */
+typedef void* XLModel;
+
 // Say hello to user
 XL_DLL int XLearnHello();
 
@@ -91,6 +95,27 @@ XL_DLL int XLearnCV(XL *out);
 // Start to predict
 XL_DLL int XLearnPredict(XL *out, const char *model_path, const char *out_path);
 
+// Load a model file once for the in-memory prediction,
+// using nthread threads (0 for the number of CPUs)
+XL_DLL int XLearnModelLoad(const char *model_path, int nthread, 
+                           bool norm, XLModel *out);
+
+// Free the loaded model
+XL_DLL int XLearnModelFree(XLModel *out);
+
+// Predict the num_row rows of a CSR matrix in memory, and write
+// the result to out[0, num_row), which is owned by the caller.
+// Row i has the nodes indptr[i], ..., indptr[i+1]-1. The fields
+// can be NULL except for ffm, and the values can be NULL if all 
+// of them are 1.0
+XL_DLL int XLearnPredictCSR(XLModel *model, uint64_t num_row,
+                            const uint64_t *indptr,
+                            const uint32_t *indices,
+                            const uint32_t *fields,
+                            const float *values,
+                            bool sign, bool sigmoid,
+                            float *out);
+
 // Set string param
 XL_DLL int XLearnSetStr(XL *out, const char *key, const char *value);
 
@@ -20,7 +20,14 @@ This file tests c_api.h file.
 
 #include "gtest/gtest.h"
 
+#include <math.h>
+
+#include <vector>
+
 #include "src/c_api/c_api.h"
+#include "src/data/model_parameters.h"
+#include "src/score/fm_score.h"
+#include "src/score/ffm_score.h"
 
 TEST(C_API_TEST, Initialize) {
   XL xlearn;
@@ -86,4 +93,68 @@ TEST(C_API_TEST, Initialize) {
   EXPECT_EQ(xl->GetHyperParam().sigmoid, true);
   EXPECT_EQ(xl->GetHyperParam().block_size, 256);
   EXPECT_EQ(XLearnHandleFree(&xlearn), 0);
-}
\ No newline at end of file
+}
+
+// The CSR matrix of the test. Feature 12 is unknown to
+// the model, which only has 10 features and 2 fields.
+const uint64_t kIndptr[] = { 0, 3, 3, 6, 8 };
+const uint32_t kIndices[] = { 1, 4, 9, 0, 12, 5, 2, 3 };
+const uint32_t kFields[] = { 0, 1, 1, 0, 1, 0, 1, 1 };
+const float kValues[] = { 0.5, 1.0, 2.0, 1.5, 1.0, 0.2, 3.0, 0.7 };
+const uint64_t kNumRow = 4;
+
+// Score the rows without the unknown features
+void csr_expected(const std::string& score_func,
+                  xLearn::Model& model,
+                  std::vector<float>* expected) {
+  xLearn::Score* score = nullptr;
+  if (score_func == "fm") {
+    score = new xLearn::FMScore;
+  } else {
+    score = new xLearn::FFMScore;
+  }
+  for (uint64_t i = 0; i < kNumRow; ++i) {
+    std::vector<xLearn::Node> node;
+    float sum = 0;
+    for (uint64_t j = kIndptr[i]; j < kIndptr[i+1]; ++j) {
+      sum += kValues[j] * kValues[j];
+      if (kIndices[j] < 10) {
+        node.push_back(xLearn::Node(kFields[j], kIndices[j], kValues[j]));
+      }
+    }
+    xLearn::SparseRow row(node.data(), node.size());
+    float norm = sum > 0 ? 1.0f / sum : 1.0f;
+    expected->push_back(score->CalcScore(&row, model, norm));
+  }
+  delete score;
+}
+
+TEST(C_API_TEST, Predict_CSR) {
+  const char* score_func[] = { "fm", "ffm" };
+  for (int s = 0; s < 2; ++s) {
+    xLearn::Model model;
+    model.Initialize(score_func[s], "cross-entropy", 10, 2, 4, 1);
+    std::string filename = std::string("./c_api_test.model.") + score_func[s];
+    model.Serialize(filename);
+    std::vector<float> expected;
+    csr_expected(score_func[s], model, &expected);
+    XLModel handle = nullptr;
+    EXPECT_EQ(XLearnModelLoad(filename.c_str(), 2, true, &handle), 0);
+    std::vector<float> out(kNumRow);
+    EXPECT_EQ(XLearnPredictCSR(&handle, kNumRow, kIndptr, kIndices,
+                               kFields, kValues, false, false,
+                               out.data()), 0);
+    for (uint64_t i = 0; i < kNumRow; ++i) {
+      EXPECT_FLOAT_EQ(out[i], expected[i]);
+    }
+    EXPECT_EQ(XLearnPredictCSR(&handle, kNumRow, kIndptr, kIndices,
+                               kFields, kValues, false, true,
+                               out.data()), 0);
+    for (uint64_t i = 0; i < kNumRow; ++i) {
+      EXPECT_FLOAT_EQ(out[i], 1.0 / (1.0 + exp(-expected[i])));
+    }
+    EXPECT_EQ(XLearnModelFree(&handle), 0);
+    EXPECT_TRUE(handle == nullptr);
+    remove(filename.c_str());
+  }
+}
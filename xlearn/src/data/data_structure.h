@@ -25,6 +25,7 @@ This file defines the basic data structures.
 #include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
+#include <limits>
 
 #include "src/base/common.h"
 #include "src/base/file_util.h"
@@ -50,8 +51,10 @@ typedef uint32 index_t;
 typedef std::unordered_map<index_t, index_t> feature_map;
 
 //------------------------------------------------------------------------------
-// We use SSE to accelerate our training, so some 
-// parameters will be aligned.
+// We use SIMD to accelerate our training, so some parameters will
+// be aligned. kAlign and kAlignByte are the SSE (128-bit) values, which
+// are also the layout of the model checkpoint file. At run time the model
+// can use a wider alignment (see Model::GetAlign()) for AVX2 and AVX-512.
 //------------------------------------------------------------------------------
 const int kAlign = 4;
 const int kAlignByte = 16;
@@ -63,6 +66,8 @@ const int kAlignByte = 16;
 struct MetricInfo {
   real_t loss_val;    /* Loss value */
   real_t metric_val;  /* Metric value */
+  /* All the metric values, where metric_list[0] = metric_val */
+  std::vector<real_t> metric_list;
 };
 
 //------------------------------------------------------------------------------
@@ -86,10 +91,79 @@ struct Node {
 };
 
 //------------------------------------------------------------------------------
-// SparseRow is used to store one line of the data, which
-// is represented as a vector of the Node data structure.
+// SparseRow is used to store one line of the data. It is a non-owning
+// view of a contiguous array of the Node data structure, which is owned
+// by DMatrix (or by the caller). Copying a SparseRow is as cheap as
+// copying a pointer, and we can use it just like a std::vector<Node>:
+//
+//    std::vector<Node> nodes(3);
+//    SparseRow row(nodes.data(), nodes.size());
+//    for (SparseRow::iterator iter = row.begin();
+//         iter != row.end(); ++iter) {
+//      ... iter->feat_id ...
+//    }
 //------------------------------------------------------------------------------
-typedef std::vector<Node> SparseRow;
+class SparseRow {
+ public:
+  typedef Node* iterator;
+  typedef const Node* const_iterator;
+
+  // Constructor
+  SparseRow() : data_(nullptr), size_(0) { }
+  SparseRow(Node* data, size_t size)
+   : data_(data), size_(size) { }
+
+  // Access the nodes of current row.
+  inline Node* begin() const { return data_; }
+  inline Node* end() const { return data_ + size_; }
+  inline Node* data() const { return data_; }
+  inline size_t size() const { return size_; }
+  inline bool empty() const { return size_ == 0; }
+  inline Node& operator[](size_t i) const { return data_[i]; }
+
+ private:
+  // DMatrix needs to re-point and extend its own rows.
+  friend struct DMatrix;
+
+  Node* data_;
+  index_t size_;
+};
+
+//------------------------------------------------------------------------------
+// The binary file of DMatrix, which can be mapped into memory and
+// used as the training data directly, without any copy. All the
+// sections are aligned to kBinaryAlign bytes:
+//
+//   [ BinaryHeader                          ]
+//   [ Y      : row_length * real_t          ]
+//   [ norm   : row_length * real_t          ]
+//   [ offset : (row_length + 1) * uint64    ]  /* CSR row offsets */
+//   [ nodes  : node_num * Node              ]
+//
+// The two hash values of the txt file are the first 16 bytes of
+// the binary file, which are checked by InmemReader before using it:
+// hash_value_1 is the fingerprint (see FingerprintFile()), and
+// hash_value_2 is the hash of all the content (HashFileContent()).
+//------------------------------------------------------------------------------
+const uint32 kBinaryMagic = 0x4d444c58;  // "XLDM"
+const uint32 kBinaryVersion = 4;
+const uint64 kBinaryAlign = 64;
+
+struct BinaryHeader {
+  uint64 hash_value_1;
+  uint64 hash_value_2;
+  uint32 magic;
+  uint32 version;
+  uint64 row_length;
+  uint64 node_num;
+  uint32 has_label;
+  /* sizeof(Node), used to check the platform */
+  uint32 node_size;
+  char padding[16];
+};
+
+static_assert(sizeof(BinaryHeader) == kBinaryAlign,
+              "BinaryHeader must be aligned");
 
 //------------------------------------------------------------------------------
 // DMatrix (data matrix) is used to store a batch of the dataset.
@@ -98,6 +172,12 @@ typedef std::vector<Node> SparseRow;
 // large-scale machine learning problems, we cannot load all the data into 
 // memory at once, and hence we have to load a small batch of dataset in 
 // DMatrix at each samplling for training or prediction.  
+// All the nodes are stored in one contiguous array (CSR format) instead
+// of one heap block for each row, and each row is a SparseRow view of
+// this array. Rows must be filled one by one in order by AddNode().
+// A DMatrix can also hold views of the rows owned by another DMatrix,
+// e.g., the mini-batch and the shuffled samples, and hence no data is
+// copied during the training.
 // We can use the DMatrix like this:
 //
 //    DMatrix matrix;
@@ -115,10 +195,16 @@ typedef std::vector<Node> SparseRow;
 //    /* The new matrix is the same with old matrix */
 //    new_matrix.Deserialize("/tmp/test.bin");
 //
+//    /* Or use the mapped binary file without copy */
+//    MmapFile mmap_file;
+//    mmap_file.Open("/tmp/test.bin");
+//    new_matrix.DeserializeFromBuffer(mmap_file.data(),
+//                                     mmap_file.size());
+//
 //    /* We can access the matrix */
 //    for (int i = 0; i < matrix.row_length; ++i) {
 //      ... matrix.Y[i] ..   /* access y */
-//      SparseRow *row = matrix.row[i];
+//      SparseRow *row = &matrix.row[i];
 //      for (SparseRow::iterator iter = row->begin();
 //           iter != row->end(); ++iter) {
 //        ... iter->field_id ...   /* access field_id */
@@ -138,32 +224,31 @@ struct DMatrix {
      hash_value_2(0),
      row_length(0),
      row(0),
+     nodes(0),
      Y(0),
      norm(0),
      has_label(false),
      pos(0) { }
 
-  // Destructor
-  ~DMatrix() { }
-
   // Reset data for the DMatrix.
-  // This function will first release the original
-  // memory allocated for the DMatrix, and then re-allocate 
-  // memory for this matrix. For some dataset, it will not
+  // This function will reset all the rows of this matrix
+  // to empty, and re-allocate memory for the label and norm.
+  // The memory of the node storage is kept for reuse, and we
+  // can use Release() to free it. For some dataset, it will not
   // contains the label y, and hence we need to set the 
   // has_label variable to false. On deafult, this value will
   // be set to true.
   void ResetMatrix(size_t length, bool label = true) {
     CHECK_GE(length, 0);
-    this->Release();
     hash_value_1 = 0;
     hash_value_2 = 0;
     row_length = length;
-    row.resize(length, nullptr);
-    Y.resize(length, 0);
+    row.assign(length, SparseRow());
+    nodes.clear();
+    Y.assign(length, 0);
     // we set norm to 1.0 by default, which means
     // that we don't use instance-wise nomarlization
-    norm.resize(length, 1.0);
+    norm.assign(length, 1.0);
     // Indicate that if current dataset has the label y
     has_label = label;
     pos = 0;
@@ -177,14 +262,10 @@ struct DMatrix {
     hash_value_2 = 0;
     // Delete Y
     std::vector<real_t>().swap(Y);
-    // Delete Node
-    for (int i = 0; i < row_length; ++i) {
-      if (row[i] != nullptr) {
-        STLDeleteElementsAndClear(&row);
-      }
-    }
     // Delete SparseRow
-    std::vector<SparseRow*>().swap(row);
+    std::vector<SparseRow>().swap(row);
+    // Delete Node
+    std::vector<Node>().swap(nodes);
     // Delete norm
     std::vector<real_t>().swap(norm);
     has_label = false;
@@ -194,22 +275,32 @@ struct DMatrix {
 
   // Add node to current data matrix.
   // We don't use the 'field' by default because it
-  // will only be used in the ffm tasks.
+  // will only be used in the ffm tasks. The node is appended
+  // to the node storage, so we can only add node to the last
+  // non-empty row or to a new row after it.
   void AddNode(index_t row_id,  
                index_t feat_id,
                real_t feat_val, 
                index_t field_id = 0) {
     CHECK_GT(row_length, row_id);
-    // Allocate memory for the first adding
-    if (row[row_id] == nullptr) {
-      row[row_id] = new SparseRow;
+    size_t offset = nodes.size();
+    Node* old_data = nodes.data();
+    nodes.push_back(Node(field_id, feat_id, feat_val));
+    // The node storage has been re-allocated
+    if (nodes.data() != old_data) {
+      rebase_rows(old_data, offset, row_id+1);
     }
-    Node node(field_id, feat_id, feat_val);
-    row[row_id]->push_back(node);
+    SparseRow& r = row[row_id];
+    if (r.empty()) {
+      r.data_ = nodes.data() + offset;
+    } else {
+      CHECK(r.end() == nodes.data() + offset);
+    }
+    r.size_++;
   }
 
   // The hash value is used to identify the difference
-  // between two data matrix, and it can be generated by HashFile() 
+  // between two data matrix, and it can be generated by FingerprintFile()
   // method (in file_util.h) and this value will be used when reading 
   // txt data from disk file. We can cache the binary data in disk file 
   // to accelerate the reading of disk file.
@@ -219,8 +310,8 @@ struct DMatrix {
   }
 
   // Copy another data matrix to this matrix.
-  // Note that here we do the deep copy and we will
-  // allocate memory if current matrix is empty.
+  // Note that here we do the deep copy and all the rows
+  // of the matrix are copied to the contiguous node storage.
   void CopyFrom(const DMatrix* matrix) {
     CHECK_NOTNULL(matrix);
     this->Release();
@@ -229,17 +320,17 @@ struct DMatrix {
     this->hash_value_2 = matrix->hash_value_2;
     // Copy row length
     this->row_length = matrix->row_length;
-    this->row.resize(row_length, nullptr);
+    this->row.resize(row_length);
     // Copy row
+    size_t node_num = 0;
     for (index_t i = 0; i < row_length; ++i) {
-      SparseRow* rowc = matrix->row[i];
-      for (SparseRow::iterator iter = rowc->begin();
-           iter != rowc->end(); ++iter) {
-        this->AddNode(i, 
-                iter->feat_id, 
-                iter->feat_val, 
-                iter->field_id);
-      }
+      node_num += matrix->row[i].size();
+    }
+    this->nodes.reserve(node_num);
+    for (index_t i = 0; i < row_length; ++i) {
+      const SparseRow& rowc = matrix->row[i];
+      this->row[i] = SparseRow(nodes.data() + nodes.size(), rowc.size());
+      this->nodes.insert(nodes.end(), rowc.begin(), rowc.end());
     }
     // Copy y
     this->Y = matrix->Y;
@@ -274,15 +365,15 @@ struct DMatrix {
   void Compress(std::vector<index_t>& feature_list) {
     // Using a map to store the mapping relations
     size_t node_num {0};
-    for (auto row : this->row) {
-      node_num += row->size();
+    for (index_t i = 0; i < this->row_length; ++i) {
+      node_num += this->row[i].size();
     }
     std::unordered_set<index_t> feat_set;
     feat_set.reserve(node_num);
     for (index_t i = 0; i < this->row_length; ++i) {
-      SparseRow* row = this->row[i];
-      for (SparseRow::iterator iter = row->begin();
-           iter != row->end(); ++iter) {
+      const SparseRow& row = this->row[i];
+      for (SparseRow::iterator iter = row.begin();
+           iter != row.end(); ++iter) {
         if (feat_set.count(iter->feat_id) == 0) {
           feat_set.insert(iter->feat_id);
         }
@@ -298,7 +389,7 @@ struct DMatrix {
       mp[feature_list[i]] = i + 1;
     }
     for (index_t i = 0; i < this->row_length; ++ i) {
-      for (auto &iter: *this->row[i]) {
+      for (auto &iter: this->row[i]) {
         // using map is better than lower_bound
         iter.feat_id = mp[iter.feat_id];
       }
@@ -324,58 +415,70 @@ struct DMatrix {
   }
 
   // Serialize current DMatrix to disk file.
+  // The rows are written to a contiguous node array, even
+  // if they are the views of another matrix.
   void Serialize(const std::string& filename) {
     CHECK_NE(filename.empty(), true);
     CHECK_EQ(row_length, row.size());
     CHECK_EQ(row_length, Y.size());
     CHECK_EQ(row_length, norm.size());
     FILE* file = OpenFileOrDie(filename.c_str(), "w");
-    // Write hash_value
-    WriteDataToDisk(file, (char*)&hash_value_1, sizeof(hash_value_1));
-    WriteDataToDisk(file, (char*)&hash_value_2, sizeof(hash_value_2));
-    // Write row_length
-    WriteDataToDisk(file, (char*)&row_length, sizeof(row_length));
-    // Write row
+    // Get the CSR row offsets
+    std::vector<uint64> offset(row_length+1, 0);
     for (size_t i = 0; i < row_length; ++i) {
-      WriteVectorToFile(file, *(row[i]));
+      offset[i+1] = offset[i] + row[i].size();
     }
+    // Write header
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.hash_value_1 = hash_value_1;
+    header.hash_value_2 = hash_value_2;
+    header.magic = kBinaryMagic;
+    header.version = kBinaryVersion;
+    header.row_length = row_length;
+    header.node_num = offset[row_length];
+    header.has_label = has_label;
+    header.node_size = sizeof(Node);
+    WriteDataToDisk(file, (char*)&header, sizeof(header));
     // Write Y
-    WriteVectorToFile(file, Y);
+    write_aligned(file, (char*)Y.data(), sizeof(real_t)*row_length);
     // Write norm
-    WriteVectorToFile(file, norm);
-    // Write has_label
-    WriteDataToDisk(file, (char*)&has_label, sizeof(has_label));
-    // Write pos
-    WriteDataToDisk(file, (char*)&pos, sizeof(pos));
+    write_aligned(file, (char*)norm.data(), sizeof(real_t)*row_length);
+    // Write row offset
+    write_aligned(file, (char*)offset.data(),
+                  sizeof(uint64)*(row_length+1));
+    // Write nodes
+    for (size_t i = 0; i < row_length; ++i) {
+      if (!row[i].empty()) {
+        WriteDataToDisk(file, (char*)row[i].data(),
+                        sizeof(Node)*row[i].size());
+      }
+    }
     Close(file);
   }
 
   // Deserialize the DMatrix from disk file.
+  // All the nodes are copied to the node storage of this matrix.
   void Deserialize(const std::string& filename) {
     CHECK(!filename.empty());
-    this->Release();
-    FILE* file = OpenFileOrDie(filename.c_str(), "r");
-    // Read hash_value
-    ReadDataFromDisk(file, (char*)&hash_value_1, sizeof(hash_value_1));
-    ReadDataFromDisk(file, (char*)&hash_value_2, sizeof(hash_value_2));
-    // Read row_length
-    ReadDataFromDisk(file, (char*)&row_length, sizeof(row_length));
-    CHECK_GE(row_length, 0);
-    // Read row
-    row.resize(row_length, nullptr);
-    for (size_t i = 0; i < row_length; ++i) {
-      row[i] = new SparseRow;
-      ReadVectorFromFile(file, *(row[i]));
-    }
-    // Read Y
-    ReadVectorFromFile(file, Y);
-    // Read norm
-    ReadVectorFromFile(file, norm);
-    // Read has label
-    ReadDataFromDisk(file, (char*)&has_label, sizeof(has_label));
-    // Read pos
-    ReadDataFromDisk(file, (char*)&pos, sizeof(pos));
-    Close(file);
+    MmapFile mmap_file;
+    mmap_file.Open(filename);
+    uint64 node_num = 0;
+    Node* buf_nodes = this->parse_binary(mmap_file.data(),
+                                         mmap_file.size(),
+                                         &node_num);
+    nodes.assign(buf_nodes, buf_nodes + node_num);
+    rebase_rows(buf_nodes, node_num, row_length);
+  }
+
+  // Deserialize the DMatrix from a memory buffer of the
+  // binary file, e.g., the mapped file. The rows will point
+  // to the buffer directly without any copy, and hence the
+  // caller must keep the buffer alive (and writable if we
+  // need to Compress() this matrix) while using this matrix.
+  void DeserializeFromBuffer(char* buf, uint64 size) {
+    uint64 node_num = 0;
+    this->parse_binary(buf, size, &node_num);
   }
 
   // We get find the max index of feature or field in current
@@ -385,9 +488,9 @@ struct DMatrix {
   inline index_t max_feat_or_field(bool is_feat) const {
     index_t max = 0;
     for (size_t i = 0; i < row_length; ++i) {
-      SparseRow* sr = this->row[i];
-      for (SparseRow::const_iterator iter = sr->begin();
-           iter != sr->end(); ++iter) {
+      const SparseRow& sr = this->row[i];
+      for (SparseRow::const_iterator iter = sr.begin();
+           iter != sr.end(); ++iter) {
         if (is_feat) {  // feature
           if (iter->feat_id > max) {
             max = iter->feat_id;
@@ -409,8 +512,11 @@ struct DMatrix {
   uint64 hash_value_2;
   /* Row length of current matrix */
   index_t row_length;
-  /* Using pointer for zero-copy */
-  std::vector<SparseRow*> row;
+  /* Row views for zero-copy, which point to the
+  nodes of this matrix or of another matrix */
+  std::vector<SparseRow> row;
+  /* Contiguous storage of the nodes added by AddNode() */
+  std::vector<Node> nodes;
   /* 0 or -1 for negative and +1 for positive
   example, and others for regression */
   std::vector<real_t> Y;
@@ -420,6 +526,109 @@ struct DMatrix {
   bool has_label;
   /* Current position for GetMiniBatch() */
   index_t pos;
+
+ private:
+  // Re-point the rows [0, row_end) from the old node storage to
+  // the new node storage. When it is used after re-allocation, the
+  // amortized cost is O(1) for each node because the storage grows
+  // geometrically.
+  void rebase_rows(const Node* old_data,
+                   size_t old_size,
+                   index_t row_end) {
+    for (index_t i = 0; i < row_end; ++i) {
+      Node* data = row[i].data_;
+      if (data >= old_data && data <= old_data + old_size) {
+        row[i].data_ = nodes.data() + (data - old_data);
+      }
+    }
+  }
+
+  // Round up the size to kBinaryAlign.
+  static inline uint64 binary_align(uint64 size) {
+    return (size + kBinaryAlign - 1) / kBinaryAlign * kBinaryAlign;
+  }
+
+  // Write a section of the binary file with padding.
+  static void write_aligned(FILE* file, const char* buf, uint64 len) {
+    static const char zero[kBinaryAlign] = { 0 };
+    if (len > 0) {
+      WriteDataToDisk(file, buf, len);
+    }
+    uint64 pad = binary_align(len) - len;
+    if (pad > 0) {
+      WriteDataToDisk(file, zero, pad);
+    }
+  }
+
+  // A binary file that passes the format check but cannot be
+  // parsed is corrupted or edited.
+  static void broken_binary(const char* reason) {
+    LOG(FATAL) << "Broken binary file: " << reason << ". "
+               << "Please remove it and convert the txt file again.";
+  }
+
+  // Parse the binary file in buffer. The rows of this matrix
+  // will point to the node array of the buffer, which is returned.
+  Node* parse_binary(char* buf, uint64 size, uint64* node_num) {
+    CHECK_NOTNULL(buf);
+    this->Release();
+    CHECK_GE(size, sizeof(BinaryHeader));
+    BinaryHeader* header = reinterpret_cast<BinaryHeader*>(buf);
+    if (header->magic != kBinaryMagic ||
+        header->version != kBinaryVersion ||
+        header->node_size != sizeof(Node)) {
+      LOG(FATAL) << "Unknow format of binary file. "
+                 << "Please remove it and convert the txt file again.";
+    }
+    // The sizes come from the file, so they are bounded by the
+    // file size before computing the sections.
+    uint64 body = size - sizeof(BinaryHeader);
+    if (header->row_length > body / (sizeof(real_t)*2 + sizeof(uint64)) ||
+        header->row_length >= (uint64)std::numeric_limits<index_t>::max() ||
+        header->node_num > body / sizeof(Node)) {
+      broken_binary("the header does not match the file size");
+    }
+    hash_value_1 = header->hash_value_1;
+    hash_value_2 = header->hash_value_2;
+    row_length = header->row_length;
+    has_label = header->has_label;
+    *node_num = header->node_num;
+    // Get all the sections
+    uint64 len_y = binary_align(sizeof(real_t)*row_length);
+    uint64 len_offset = binary_align(sizeof(uint64)*(row_length+1));
+    if (body < len_y*2 + len_offset + sizeof(Node)*(*node_num)) {
+      broken_binary("the file is truncated");
+    }
+    char* ptr = buf + sizeof(BinaryHeader);
+    real_t* buf_y = reinterpret_cast<real_t*>(ptr);
+    real_t* buf_norm = reinterpret_cast<real_t*>(ptr + len_y);
+    uint64* offset = reinterpret_cast<uint64*>(ptr + len_y*2);
+    Node* buf_nodes = reinterpret_cast<Node*>(ptr + len_y*2 + len_offset);
+    // Each row must be a range of the node array
+    if (offset[0] != 0 || offset[row_length] != *node_num) {
+      broken_binary("the row offsets do not match the nodes");
+    }
+    for (size_t i = 0; i < row_length; ++i) {
+      if (offset[i] > offset[i+1]) {
+        broken_binary("the row offsets are not sorted");
+      }
+    }
+    // Y and norm are small, and we copy them
+    Y.assign(buf_y, buf_y + row_length);
+    norm.assign(buf_norm, buf_norm + row_length);
+    // Rows are the views of the node array in buffer
+    row.resize(row_length);
+    for (size_t i = 0; i < row_length; ++i) {
+      row[i] = SparseRow(buf_nodes + offset[i], offset[i+1] - offset[i]);
+    }
+    pos = 0;
+    return buf_nodes;
+  }
+
+  // The rows are the views of the node storage of this matrix
+  // or of a buffer, so a copy would point to the storage of the
+  // source. Use CopyFrom() for a deep copy.
+  DISALLOW_COPY_AND_ASSIGN(DMatrix);
 };
 
 }  // namespace xLearn
@@ -31,7 +31,7 @@ TEST(DMATRIX_TEST, Resize_and_Release) {
   EXPECT_EQ(matrix.hash_value_2, 0);
   EXPECT_EQ(matrix.row_length, 10);
   for (size_t i = 0; i < 10; ++i) {
-    EXPECT_EQ(matrix.row[i], nullptr);
+    EXPECT_EQ(matrix.row[i].empty(), true);
     EXPECT_FLOAT_EQ(matrix.Y[i], 0);
     EXPECT_FLOAT_EQ(matrix.norm[i], 1.0);
     EXPECT_EQ(matrix.has_label, true);
@@ -46,6 +46,40 @@ TEST(DMATRIX_TEST, Resize_and_Release) {
   EXPECT_EQ(matrix.norm.empty(), true);
 }
 
+TEST(DMATRIX_TEST, Contiguous_storage) {
+  DMatrix matrix;
+  matrix.ResetMatrix(1000);
+  // The node storage will be re-allocated many times
+  for (index_t i = 0; i < 1000; ++i) {
+    if (i % 7 == 0) { continue; }  // empty row
+    for (index_t j = 0; j < 3; ++j) {
+      matrix.AddNode(i, i+j, 0.5, j);
+    }
+  }
+  const Node* node = matrix.nodes.data();
+  for (index_t i = 0; i < 1000; ++i) {
+    SparseRow *row = &matrix.row[i];
+    if (i % 7 == 0) {
+      EXPECT_EQ(row->empty(), true);
+      continue;
+    }
+    EXPECT_EQ(row->size(), 3);
+    EXPECT_EQ(row->data(), node);
+    for (index_t j = 0; j < 3; ++j) {
+      EXPECT_EQ((*row)[j].feat_id, i+j);
+      EXPECT_EQ((*row)[j].field_id, j);
+      EXPECT_FLOAT_EQ((*row)[j].feat_val, 0.5);
+    }
+    node += 3;
+  }
+  EXPECT_EQ(node, matrix.nodes.data() + matrix.nodes.size());
+  // Reset keeps the memory of node storage
+  size_t capacity = matrix.nodes.capacity();
+  matrix.ResetMatrix(10);
+  EXPECT_EQ(matrix.nodes.empty(), true);
+  EXPECT_EQ(matrix.nodes.capacity(), capacity);
+}
+
 TEST(DMATRIX_TEST, Serialize_and_Deserialize) {
   DMatrix matrix;
   // Init
@@ -76,7 +110,7 @@ TEST(DMATRIX_TEST, Serialize_and_Deserialize) {
   for (int i = 0; i < 10; ++i) {
     EXPECT_EQ(matrix.Y[i], i);
     EXPECT_EQ(matrix.norm[i], 0.25);
-    SparseRow *row = matrix.row[i];
+    SparseRow *row = &matrix.row[i];
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
       EXPECT_EQ(iter->field_id, i);
@@ -87,6 +121,56 @@ TEST(DMATRIX_TEST, Serialize_and_Deserialize) {
   RemoveFile("/tmp/test.bin");
 }
 
+TEST(DMATRIX_TEST, Deserialize_from_buffer) {
+  DMatrix matrix;
+  // Init
+  matrix.ResetMatrix(10);
+  for (size_t i = 0; i < 10; ++i) {
+    if (i == 3) { continue; }  // empty row
+    matrix.AddNode(i, i, 2.5, i);
+    matrix.AddNode(i, i+1, 2.5, i);
+    matrix.Y[i] = i;
+    matrix.norm[i] = 0.25;
+  }
+  matrix.SetHash(1234, 5678);
+  matrix.Serialize("/tmp/test.bin");
+  // The hash values are the first 16 bytes
+  FILE* file = OpenFileOrDie("/tmp/test.bin", "r");
+  uint64 hash[2];
+  ReadDataFromDisk(file, (char*)hash, sizeof(hash));
+  Close(file);
+  EXPECT_EQ(hash[0], 1234);
+  EXPECT_EQ(hash[1], 5678);
+  // Map the binary file
+  MmapFile mmap_file;
+  mmap_file.Open("/tmp/test.bin");
+  DMatrix new_matrix;
+  new_matrix.DeserializeFromBuffer(mmap_file.data(), mmap_file.size());
+  EXPECT_EQ(new_matrix.row_length, 10);
+  EXPECT_EQ(new_matrix.hash_value_1, 1234);
+  EXPECT_EQ(new_matrix.hash_value_2, 5678);
+  EXPECT_EQ(new_matrix.has_label, true);
+  EXPECT_EQ(new_matrix.nodes.empty(), true);
+  for (size_t i = 0; i < 10; ++i) {
+    SparseRow *row = &new_matrix.row[i];
+    if (i == 3) {
+      EXPECT_EQ(row->empty(), true);
+      continue;
+    }
+    // Zero-copy and aligned
+    EXPECT_GE((char*)row->data(), mmap_file.data());
+    EXPECT_LT((char*)row->data(), mmap_file.data() + mmap_file.size());
+    EXPECT_EQ(row->size(), 2);
+    EXPECT_EQ((*row)[0].feat_id, i);
+    EXPECT_EQ((*row)[1].feat_id, i+1);
+    EXPECT_EQ((*row)[1].field_id, i);
+    EXPECT_EQ(new_matrix.Y[i], i);
+    EXPECT_EQ(new_matrix.norm[i], 0.25);
+  }
+  EXPECT_EQ(((uint64)new_matrix.row[0].data()) % kBinaryAlign, 0);
+  RemoveFile("/tmp/test.bin");
+}
+
 TEST(DMATRIX_TEST, Find_max_feat_and_field) {
   DMatrix matrix;
   matrix.ResetMatrix(10);
@@ -124,7 +208,7 @@ TEST(DMATRIX_TEST, CopyFrom) {
   for (int i = 0; i < 10; ++i) {
     EXPECT_EQ(new_matrix.Y[i], i);
     EXPECT_EQ(new_matrix.norm[i], 0.25);
-    SparseRow *row =new_matrix.row[i];
+    SparseRow *row = &new_matrix.row[i];
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
       EXPECT_EQ(iter->field_id, i);
@@ -159,23 +243,23 @@ TEST(DMATRIX_TEST, Compress) {
   std::vector<index_t> feature_list;
   matrix.Compress(feature_list);
   // row_0
-  SparseRow* row = matrix.row[0];
+  SparseRow* row = &matrix.row[0];
   EXPECT_EQ((*row)[0].feat_id, 1);
   EXPECT_EQ((*row)[1].feat_id, 5);
   EXPECT_EQ((*row)[2].feat_id, 7);
   EXPECT_EQ((*row)[3].feat_id, 8);
   // row_1
-  row = matrix.row[1];
+  row = &matrix.row[1];
   EXPECT_EQ((*row)[0].feat_id, 3);
   EXPECT_EQ((*row)[1].feat_id, 10);
   EXPECT_EQ((*row)[2].feat_id, 11);
   // row_2
-  row = matrix.row[2];
+  row = &matrix.row[2];
   EXPECT_EQ((*row)[0].feat_id, 5);
   EXPECT_EQ((*row)[1].feat_id, 7);
   EXPECT_EQ((*row)[2].feat_id, 9);
   // row_3
-  row = matrix.row[3];
+  row = &matrix.row[3];
   EXPECT_EQ((*row)[0].feat_id, 2);
   EXPECT_EQ((*row)[1].feat_id, 4);
   EXPECT_EQ((*row)[2].feat_id, 6);
@@ -211,7 +295,7 @@ TEST(DMATRIX_TEST, GetMiniBatch) {
   for (int i = 0; i < 4; ++i) {
     EXPECT_EQ(mini_batch.Y[i], i);
     EXPECT_EQ(mini_batch.norm[i], 0.25);
-    SparseRow *row =mini_batch.row[i];
+    SparseRow *row = &mini_batch.row[i];
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
       EXPECT_EQ(iter->field_id, i);
@@ -225,7 +309,7 @@ TEST(DMATRIX_TEST, GetMiniBatch) {
   for (int i = 4; i < 8; ++i) {
     EXPECT_EQ(mini_batch.Y[i-4], i);
     EXPECT_EQ(mini_batch.norm[i-4], 0.25);
-    SparseRow *row =mini_batch.row[i-4];
+    SparseRow *row = &mini_batch.row[i-4];
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
       EXPECT_EQ(iter->field_id, i);
@@ -239,7 +323,7 @@ TEST(DMATRIX_TEST, GetMiniBatch) {
   for (int i = 8; i < 10; ++i) {
     EXPECT_EQ(mini_batch.Y[i-8], i);
     EXPECT_EQ(mini_batch.norm[i-8], 0.25);
-    SparseRow *row =mini_batch.row[i-8];
+    SparseRow *row = &mini_batch.row[i-8];
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
       EXPECT_EQ(iter->field_id, i);
@@ -0,0 +1,97 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the FeatureMap class.
+*/
+
+#include "src/data/feature_map.h"
+
+#include <algorithm>
+
+#include "src/base/file_util.h"
+#include "src/base/logging.h"
+
+namespace xLearn {
+
+const index_t FeatureMap::kNotFound;
+
+/* The table has at least this number of slots */
+static const size_t kMinCapacity = 1024;
+
+// Add the key if it is new. The table is kept at most half
+// full, so the probing sequence is short.
+index_t FeatureMap::Insert(uint64 key) {
+  if ((keys_.size() + 1) * 2 > slots_.size()) {
+    rehash(std::max(kMinCapacity, slots_.size() * 2));
+  }
+  size_t s = MurmurMix64(key) & mask_;
+  for (;;) {
+    index_t id = slots_[s];
+    if (id == kNotFound) { break; }
+    if (keys_[id] == key) { return id; }
+    s = (s + 1) & mask_;
+  }
+  index_t id = keys_.size();
+  CHECK_NE(id, kNotFound);
+  slots_[s] = id;
+  keys_.push_back(key);
+  return id;
+}
+
+void FeatureMap::rehash(size_t capacity) {
+  slots_.assign(capacity, kNotFound);
+  mask_ = capacity - 1;
+  for (index_t id = 0; id < keys_.size(); ++id) {
+    size_t s = MurmurMix64(keys_[id]) & mask_;
+    while (slots_[s] != kNotFound) {
+      s = (s + 1) & mask_;
+    }
+    slots_[s] = id;
+  }
+}
+
+void FeatureMap::Clear() {
+  std::vector<uint64>().swap(keys_);
+  std::vector<index_t>().swap(slots_);
+  mask_ = 0;
+}
+
+// The keys are stored in the order of id, and
+// the hash table is re-built in Deserialize().
+void FeatureMap::Serialize(FILE* file) {
+  uint64 size = keys_.size();
+  WriteDataToDisk(file, (char*)&size, sizeof(size));
+  if (size > 0) {
+    WriteDataToDisk(file, (char*)keys_.data(), sizeof(uint64) * size);
+  }
+}
+
+void FeatureMap::Deserialize(FILE* file) {
+  uint64 size = 0;
+  ReadDataFromDisk(file, (char*)&size, sizeof(size));
+  keys_.resize(size);
+  if (size > 0) {
+    size_t len = ReadDataFromDisk(file, (char*)keys_.data(),
+                                  sizeof(uint64) * size);
+    CHECK_EQ(len, sizeof(uint64) * size);
+  }
+  size_t capacity = kMinCapacity;
+  while (capacity < size * 2) { capacity *= 2; }
+  rehash(capacity);
+}
+
+}  // namespace xLearn
@@ -0,0 +1,108 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the FeatureMap class, which maps the sparse
+64-bit feature keys to the compact feature ids of the model.
+*/
+
+#ifndef XLEARN_DATA_FEATURE_MAP_H_
+#define XLEARN_DATA_FEATURE_MAP_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/murmur_hash.h"
+#include "src/data/data_structure.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// The dense model has one row of parameters for each feature id from 0
+// to the max id, which is infeasible for the 64-bit hashed ids of CTR
+// logs. FeatureMap gives the compact ids 0, 1, 2, ... to the keys in
+// the order they are first seen, so the model only has the rows of the
+// features that appear in the training data, and the Score kernels
+// still index the model by the (compact) feature id:
+//
+//   FeatureMap map;
+//   index_t id = map.Insert(key);   /* new id, or the id of old key */
+//   id = map.Find(key);             /* FeatureMap::kNotFound if new */
+//   index_t num_feat = map.Size();  /* number of distinct keys */
+//
+// The keys are stored in an open-addressing hash table with linear
+// probing, which is much smaller and faster than std::unordered_map:
+// each key uses 8 bytes for the key and at most 16 bytes for the slots.
+// Insert() must not run at the same time as the other methods, but
+// Find() can be invoked by multiple threads.
+//------------------------------------------------------------------------------
+class FeatureMap {
+ public:
+  // Constructor and Destructor
+  FeatureMap() : mask_(0) { }
+  ~FeatureMap() { }
+
+  /* Find() returns this value for a new key */
+  static const index_t kNotFound = (index_t)(-1);
+
+  // Return the id of key, and add the key if it is new.
+  index_t Insert(uint64 key);
+
+  // Return the id of key, or kNotFound.
+  inline index_t Find(uint64 key) const {
+    if (slots_.empty()) { return kNotFound; }
+    for (size_t s = MurmurMix64(key) & mask_; ; s = (s + 1) & mask_) {
+      index_t id = slots_[s];
+      if (id == kNotFound || keys_[id] == key) { return id; }
+    }
+  }
+
+  // Number of keys.
+  inline index_t Size() const { return keys_.size(); }
+
+  // The key of the given id.
+  inline uint64 Key(index_t id) const { return keys_[id]; }
+
+  // Remove all the keys.
+  void Clear();
+
+  // Serialize the keys to a disk file.
+  void Serialize(FILE* file);
+
+  // Deserialize the keys from a disk file.
+  void Deserialize(FILE* file);
+
+ protected:
+  /* Key of each id */
+  std::vector<uint64> keys_;
+  /* Id of each slot of hash table, kNotFound for empty slot.
+  The size is a power of 2 */
+  std::vector<index_t> slots_;
+  /* Size of slots_ - 1 */
+  uint64 mask_;
+
+  // Re-build the hash table with the given number of slots.
+  void rehash(size_t capacity);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FeatureMap);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_DATA_FEATURE_MAP_H_
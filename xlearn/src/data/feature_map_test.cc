@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the FeatureMap class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "src/base/file_util.h"
+#include "src/data/feature_map.h"
+
+namespace xLearn {
+
+const index_t kNumKey = 100000;
+
+// Keys that are far from each other
+uint64 key_of(index_t i) {
+  return i * 0x9e3779b97f4a7c15ULL + 1;
+}
+
+TEST(FEATURE_MAP_TEST, Insert_and_Find) {
+  FeatureMap map;
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_EQ(map.Find(1), FeatureMap::kNotFound);
+  for (index_t i = 0; i < kNumKey; ++i) {
+    EXPECT_EQ(map.Insert(key_of(i)), i);
+  }
+  EXPECT_EQ(map.Size(), kNumKey);
+  // Insert the old keys
+  for (index_t i = 0; i < kNumKey; i += 7) {
+    EXPECT_EQ(map.Insert(key_of(i)), i);
+  }
+  EXPECT_EQ(map.Size(), kNumKey);
+  for (index_t i = 0; i < kNumKey; ++i) {
+    EXPECT_EQ(map.Find(key_of(i)), i);
+    EXPECT_EQ(map.Key(i), key_of(i));
+  }
+  EXPECT_EQ(map.Find(key_of(kNumKey)), FeatureMap::kNotFound);
+  // Small keys, such as the hashed ids with few bits
+  FeatureMap small;
+  for (index_t i = 0; i < 5000; ++i) {
+    EXPECT_EQ(small.Insert(4999 - i), i);
+  }
+  EXPECT_EQ(small.Find(0), 4999);
+  map.Clear();
+  EXPECT_EQ(map.Size(), 0);
+  EXPECT_EQ(map.Find(key_of(1)), FeatureMap::kNotFound);
+}
+
+TEST(FEATURE_MAP_TEST, Serialize_and_Deserialize) {
+  const std::string filename = "./test_feature_map.bin";
+  FeatureMap map;
+  for (index_t i = 0; i < kNumKey; ++i) {
+    map.Insert(key_of(i));
+  }
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  map.Serialize(file);
+  Close(file);
+  FeatureMap new_map;
+  file = OpenFileOrDie(filename.c_str(), "r");
+  new_map.Deserialize(file);
+  Close(file);
+  ASSERT_EQ(new_map.Size(), kNumKey);
+  for (index_t i = 0; i < kNumKey; ++i) {
+    EXPECT_EQ(new_map.Find(key_of(i)), i);
+  }
+  // New key after deserialize
+  EXPECT_EQ(new_map.Insert(key_of(kNumKey)), kNumKey);
+  RemoveFile(filename.c_str());
+}
+
+}  // namespace xLearn
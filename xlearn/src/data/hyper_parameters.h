@@ -41,6 +41,9 @@ struct HyperParam {
   /* On-disk training for limited memory.
   True for on-disk training, and false for in-memory training. */
   bool on_disk = false;
+  /* How the rows are shuffled in in-memory training.
+  It can be 'random', 'block', or 'permute' */
+  std::string shuffle_mode = "random";
   /* Don't print any evaluation information 
   during the training, and just train the model.
   Setting this option to true will accerlate the training. */
@@ -52,9 +55,13 @@ struct HyperParam {
   For now, it can be 'cross-entropy' and 'squared' */
   std::string loss_func = "cross-entropy";
   /* Metric function. 
-  For now, it can be 'acc', 'prec', 'recall', 
-  'f1', 'mae', 'rmsd', 'mape', or 'none' */
+  For now, it can be 'acc', 'prec', 'recall', 'f1',
+  'auc', 'logloss', 'mae', 'rmsd', 'mape', or 'none'.
+  A list such as 'auc,logloss,acc' is computed in one pass */
   std::string metric = "none";
+  /* Compute the exact AUC by sorting all the scores,
+  instead of counting them in buckets */
+  bool exact_auc = false;
   /* Number of thread existing in the thread pool */
   int thread_number = 0;
 //------------------------------------------------------------------------------
@@ -83,6 +90,17 @@ struct HyperParam {
   bool norm = true;
   /* Using lock-free AdaGard to accelerate training */
   bool lock_free = true;
+  /* Using the NUMA-aware lock-free training, which keeps
+  a model replica on each NUMA node */
+  bool numa = false;
+  /* Number of rows between two averaging of the replicas
+  in NUMA-aware training. 0 means 4096 rows per node */
+  index_t numa_sync = 0;
+  /* Using the deterministic synchronous mini-batch
+  training, which is reproducible for any threads */
+  bool sync = false;
+  /* Number of rows of a mini-batch in the sync training */
+  index_t sync_batch = 1000;
 //------------------------------------------------------------------------------
 // Parameters for dataset
 //------------------------------------------------------------------------------
@@ -94,6 +112,20 @@ struct HyperParam {
   index_t num_K = 4;
   /* Number of field, used by ffm tasks */
   index_t num_field = 0;
+  /* Hash the feature ids into 2^hash_bits buckets.
+  0 for no hashing */
+  int hash_bits = 0;
+  /* Map the (hashed) feature ids to the compact ids, so
+  the model size depends on the number of distinct features */
+  bool sparse_feature = false;
+  /* Save the trained model as an inference model, whose
+  latent factor is stored in 'fp16' or 'int8'. 'none' for
+  the float checkpoint */
+  std::string quantize = "none";
+  /* Save the trained ffm model as a pruned inference model,
+  which drops the latent vectors that are never updated or
+  within this threshold. Negative for no pruning */
+  real_t prune_threshold = -1;
   /* Filename of training dataset
   We must set this value in training task. */
   std::string train_set_file;
@@ -111,13 +143,24 @@ struct HyperParam {
   /* Filename of the txt model checkpoint 
   On default, txt_model_file = none */
   std::string txt_model_file = "none";
+  /* Filename of the best model saved in background during
+  early-stopping. Empty for not saving it */
+  std::string best_model_file;
   /* Filename of output result for prediction
   output_file = test_set_file + ".out" */
   std::string output_file;
   /* Filename of log file */
   std::string log_file = "/tmp/xlearn_log";
+  /* Check the hash of the whole txt file before using
+  its binary cache, instead of the fingerprint only */
+  bool verify_binary = false;
+  /* Write the time of the phases of each epoch to this file
+  (JSON Lines, or CSV for *.csv). Empty for no profiling */
+  std::string profile_file;
   /* Block size for on-disk training */
   int block_size = 500;  // 500 MB
+  // Number of blocks read ahead by on-disk training
+  int prefetch_depth = 2;
 //------------------------------------------------------------------------------
 // Parameters for validation
 //------------------------------------------------------------------------------
@@ -126,6 +169,24 @@ struct HyperParam {
   bool cross_validation = false;
   /* Number of folds in cross-validation */
   int num_folds = 5;
+  /* Number of folds trained at the same time in the
+  in-memory cross-validation. 0 means all the folds */
+  int cv_parallel = 0;
+  /* Train in one pass over the stream of train_set_file
+  ("-" for stdin), such as a FIFO, instead of the epochs */
+  bool stream = false;
+  /* Number of rows of each mini-batch of the stream */
+  int stream_batch = 1000;
+  /* Number of latest rows of the progressive validation,
+  which is also the interval of the reports */
+  int stream_window = 100000;
+  /* Save a checkpoint of the stream training every
+  checkpoint_rows rows or checkpoint_sec seconds. 0 for never */
+  int checkpoint_rows = 0;
+  int checkpoint_sec = 0;
+  /* Filename of the checkpoint of the stream training.
+  checkpoint_file = model_file + ".ckpt" on default */
+  std::string checkpoint_file;
   /* True for using early-stop and
   False for not */
   bool early_stop = true;
@@ -144,6 +205,11 @@ struct HyperParam {
   int num_worker = 0;
   /* Number of parameter server for store model parameters */
   int num_server = 0;
+  /* Maximal number of clocks that a worker can be ahead of the
+  slowest worker. -1 means the asynchronous training */
+  int staleness = -1;
+  /* Id of current worker, which is set by the Solver */
+  int worker_id = 0;
 };
 
 }  // namespace XLEARN
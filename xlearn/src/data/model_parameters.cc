@@ -21,13 +21,17 @@ This file is the implementation of the Model class.
 #include "src/data/model_parameters.h"
 
 #include <string.h>
+#include <vector>
 #include <pmmintrin.h>  // for SSE
 
+#include "src/base/cpu_feature.h"
+#include "src/base/float16.h"
 #include "src/base/file_util.h"
 #include "src/base/format_print.h"
 #include "src/base/math.h"
 #include "src/base/logging.h"
 #include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
 
 namespace xLearn {
 
@@ -35,6 +39,13 @@ namespace xLearn {
 // The Model class
 //------------------------------------------------------------------------------
 
+/* Magic number of the inference model file: "XLQM" */
+static const uint32 kQuantMagic = 0x4d514c58;
+/* Magic number of the pruned model file: "XLSM" */
+static const uint32 kSparseMagic = 0x4d534c58;
+/* Magic number of the feature hashing section: "XLFH" */
+static const uint32 kFeatureHashMagic = 0x48464c58;
+
 // Basic contributor.
 void Model::Initialize(const std::string& score_func,
                   const std::string& loss_func,
@@ -42,7 +53,8 @@ void Model::Initialize(const std::string& score_func,
                   index_t num_field,
                   index_t num_K,
                   index_t aux_size,
-                  real_t scale) {
+                  real_t scale,
+                  ThreadPool* pool) {
   CHECK(!score_func.empty());
   CHECK(!loss_func.empty());
   CHECK_GT(num_feature, 0);
@@ -59,6 +71,7 @@ void Model::Initialize(const std::string& score_func,
   num_K_ = num_K;
   aux_size_ = aux_size;
   scale_ = scale;
+  this->choose_align();
   // Calculate the number of model parameters
   param_num_w_ = num_feature * aux_size_;
   if (score_func == "linear") {
@@ -72,13 +85,75 @@ void Model::Initialize(const std::string& score_func,
   } else {
     LOG(FATAL) << "Unknow score function: " << score_func;
   }
-  this->initial(true);
+  this->initial(true, pool);
+}
+
+// Copy the shape and value of the other model.
+void Model::CopyFrom(const Model& other, ThreadPool* pool) {
+  CHECK_EQ(other.quant_, kQuantNone);
+  CHECK(!other.sparse_);
+  bool same_shape = param_w_ != nullptr &&
+                    score_func_ == other.score_func_ &&
+                    param_num_w_ == other.param_num_w_ &&
+                    param_num_v_ == other.param_num_v_ &&
+                    aux_size_ == other.aux_size_ &&
+                    align_ == other.align_;
+  score_func_ = other.score_func_;
+  loss_func_ = other.loss_func_;
+  num_feat_ = other.num_feat_;
+  num_field_ = other.num_field_;
+  num_K_ = other.num_K_;
+  scale_ = other.scale_;
+  if (!same_shape) {
+    free_model();
+    param_num_w_ = other.param_num_w_;
+    param_num_v_ = other.param_num_v_;
+    aux_size_ = other.aux_size_;
+    align_ = other.align_;
+    this->initial(false);
+  } else {
+    // The record does not match the copied parameters
+    free_best();
+  }
+  // The copy is also the first touch of new memory
+  copy_range(param_w_, other.param_w_, param_num_w_, pool);
+  copy_range(param_v_, other.param_v_, param_num_v_, pool);
+  memcpy(param_b_, other.param_b_, aux_size_ * sizeof(real_t));
+}
+
+// Copy src to dst in parallel.
+void Model::copy_range(real_t* dst, const real_t* src,
+                       index_t len, ThreadPool* pool) {
+  if (len == 0) { return; }
+  if (pool == nullptr) {
+    memcpy(dst, src, len * sizeof(real_t));
+    return;
+  }
+  pool->ParallelFor(0, len, kTouchGrain, [&](size_t start, size_t end) {
+    memcpy(dst + start, src + start, (end - start) * sizeof(real_t));
+  });
+}
+
+// Choose the SIMD width for the latent factor. We use the widest
+// width supported by current CPU, as long as the aligned K is
+// still a multiple of it. In this way, the model size is the same
+// for all of the SSE, AVX2 and AVX-512 kernels, e.g., K = 8 uses
+// AVX2 and K = 16 (32, 48, ...) uses AVX-512 if current CPU has it.
+void Model::choose_align() {
+  index_t max_align = SIMDWidth(GetSIMDLevel());
+  index_t aligned_k = get_aligned_k();
+  align_ = kAlign;
+  while (align_ * 2 <= max_align &&
+         aligned_k % (align_ * 2) == 0) {
+    align_ *= 2;
+  }
 }
 
-// To get the best performance for SSE, we need to
+// To get the best performance for SIMD, we need to
 // allocate memory for the model parameters in aligned way.
-// For SSE, the align number should be 16 byte.
-void Model::initial(bool set_val) {
+// For SSE, the align number should be 16 byte, and it is
+// 32 byte for AVX2 and 64 byte for AVX-512.
+void Model::initial(bool set_val, ThreadPool* pool) {
   try {
     // Conventional malloc for linear term and bias
     param_w_ = (real_t*)malloc(param_num_w_ * sizeof(real_t));
@@ -89,11 +164,11 @@ void Model::initial(bool set_val) {
 #ifdef _WIN32
       param_v_ = _aligned_malloc(
                  param_num_v_ * sizeof(real_t),
-                 kAlignByte);
+                 get_align_byte());
 #else
       int ret = posix_memalign(
                 (void**)&param_v_,
-                kAlignByte,
+                get_align_byte(),
                 param_num_v_ * sizeof(real_t));
       CHECK_EQ(ret, 0);
 #endif
@@ -105,6 +180,20 @@ void Model::initial(bool set_val) {
                    model parameters. Parameter size: "
                << GetNumParameter();
   }
+  // Zero the memory by the threads of pool, so that the pages
+  // are placed on the NUMA nodes of these threads.
+  if (pool != nullptr) {
+    real_t* buf[2] = { param_w_, param_v_ };
+    index_t len[2] = { param_num_w_, param_num_v_ };
+    for (int i = 0; i < 2; ++i) {
+      if (buf[i] == nullptr || len[i] == 0) { continue; }
+      real_t* p = buf[i];
+      pool->ParallelFor(0, len[i], kTouchGrain,
+        [&](size_t start, size_t end) {
+          memset(p + start, 0, (end - start) * sizeof(real_t));
+      });
+    }
+  }
   // Set value for model
   if (set_val) {
     set_value();
@@ -156,13 +245,13 @@ void Model::set_value() {
     for (index_t j = 0; j < num_feat_; ++j) {
       for (index_t f = 0; f < num_field_; ++f) {
         for (index_t d = 0; d < k_aligned; ) {
-          for (index_t s = 0; s < kAlign; s++, w++, d++) {
+          for (index_t s = 0; s < align_; s++, w++, d++) {
             w[0] = (d < num_K_) ? coef * dis(generator) : 0.0;
             for (index_t j = 1; j < aux_size_; ++j) {
-              w[kAlign * j] = 1.0;
+              w[align_ * j] = 1.0;
             }
           }
-          w += (aux_size_-1) * kAlign;
+          w += (aux_size_-1) * align_;
         }
       }
     }
@@ -174,15 +263,25 @@ void Model::free_model() {
   free(param_w_);
   free(param_v_);
   free(param_b_);
-  if (param_best_w_ != nullptr) {
-    free(param_best_w_);
-  }
-  if (param_best_v_ != nullptr) {
-    free(param_best_v_);
-  }
-  if (param_best_b_ != nullptr) {
-    free(param_best_b_);
-  }
+  free(param_v16_);
+  free(param_v8_);
+  free(param_v_scale_);
+  free(param_v_bitmap_);
+  free(param_v_offset_);
+  free_best();
+}
+
+// Free the record of best model
+void Model::free_best() {
+  WaitBestModel();
+  free(param_best_w_);
+  free(param_best_v_);
+  free(param_best_b_);
+  param_best_w_ = nullptr;
+  param_best_v_ = nullptr;
+  param_best_b_ = nullptr;
+  std::vector<uint8>().swap(touched_);
+  std::vector<index_t>().swap(touched_list_);
 }
 
 // Initialize model from a checkpoint file
@@ -201,6 +300,18 @@ Model::Model(const std::string& filename) {
 void Model::Serialize(const std::string& filename) {
   CHECK_NE(filename.empty(), true);
   FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  if (quant_ != kQuantNone) {
+    this->serialize_quant(file);
+    this->serialize_feature_hash(file);
+    Close(file);
+    return;
+  }
+  if (sparse_) {
+    this->serialize_sparse(file);
+    this->serialize_feature_hash(file);
+    Close(file);
+    return;
+  }
   // Write score function
   WriteStringToFile(file, score_func_);
   // Write loss function
@@ -215,6 +326,8 @@ void Model::Serialize(const std::string& filename) {
   WriteDataToDisk(file, (char*)&aux_size_, sizeof(aux_size_));
   // Write w
   this->serialize_w_v_b(file);
+  // Write feature hashing
+  this->serialize_feature_hash(file);
   Close(file);
 }
 
@@ -222,6 +335,28 @@ void Model::Serialize(const std::string& filename) {
 void Model::SerializeToTxt(const std::string& filename) {
   CHECK_NE(filename.empty(), true);
   std::ofstream o_file(filename);
+  if (quant_ != kQuantNone || sparse_) {
+    // The values of an inference model are dequantized, and
+    // the dropped vectors of a pruned model are zero
+    o_file << (*param_b_) << "\n";
+    for (index_t n = 0; n < num_feat_; ++n) {
+      o_file << param_w_[n] << "\n";
+    }
+    index_t num_vec = get_num_vector();
+    index_t vec_per_line = score_func_.compare("ffm") == 0 ? num_field_ : 1;
+    for (index_t i = 0; i < num_vec; ++i) {
+      for (index_t d = 0; d < num_K_; ++d) {
+        o_file << get_quant_value(i, d);
+        if (d != num_K_-1) {
+          o_file << " ";
+        }
+      }
+      if ((i + 1) % vec_per_line == 0) {
+        o_file << "\n";
+      }
+    }
+    return;
+  }
   // For now, only LR model can dump to txt file.
   /* bias */
   o_file << (*param_b_) << "\n";
@@ -253,7 +388,7 @@ void Model::SerializeToTxt(const std::string& filename) {
     for (index_t j = 0; j < num_feat_; ++j) {
       for (index_t f = 0; f < num_field_; ++f) {
         for (index_t d = 0; d < k_aligned; ) {
-          for (index_t s = 0; s < kAlign; s++, w++, d++) {
+          for (index_t s = 0; s < align_; s++, w++, d++) {
             if (d < num_K_) {
               o_file << *w;
               if (d != num_K_-1) {
@@ -264,7 +399,7 @@ void Model::SerializeToTxt(const std::string& filename) {
               // do nothing
             }
           }
-          w += (aux_size_-1) * kAlign;
+          w += (aux_size_-1) * align_;
         }
       }
       o_file << "\n";
@@ -277,6 +412,22 @@ bool Model::Deserialize(const std::string& filename) {
   CHECK_NE(filename.empty(), true);
   FILE* file = OpenFileOrDie(filename.c_str(), "r");
   if (file == NULL) { return false; }
+  // The file of an inference model starts with a magic number,
+  // which cannot be the length of score function in a checkpoint.
+  uint32 magic = 0;
+  ReadDataFromDisk(file, (char*)&magic, sizeof(magic));
+  if (magic == kQuantMagic) {
+    this->deserialize_quant(file);
+    this->deserialize_feature_hash(file);
+    Close(file);
+    return true;
+  } else if (magic == kSparseMagic) {
+    this->deserialize_sparse(file);
+    this->deserialize_feature_hash(file);
+    Close(file);
+    return true;
+  }
+  fseek(file, 0, SEEK_SET);
   // Read score function
   ReadStringFromFile(file, score_func_);
   // Read loss function
@@ -289,60 +440,631 @@ bool Model::Deserialize(const std::string& filename) {
   ReadDataFromDisk(file, (char*)&num_K_, sizeof(num_K_));
   // Read aux_size
   ReadDataFromDisk(file, (char*)&aux_size_, sizeof(aux_size_));
+  // Choose SIMD width for current CPU
+  this->choose_align();
   // Read w
   this->deserialize_w_v_b(file);
+  // Read feature hashing
+  this->deserialize_feature_hash(file);
   Close(file);
   return true;
 }
 
-// Take a record of the best model during training
+// Read a model file with fread(), so that a truncated
+// or foreign file is reported instead of aborted.
+struct ModelFileReader {
+  FILE* file;
+  uint64 left;
+
+  bool Read(void* buf, uint64 len) {
+    if (len > left || fread(buf, 1, len, file) != len) { return false; }
+    left -= len;
+    return true;
+  }
+
+  bool ReadString(std::string* str) {
+    size_t len = 0;
+    if (!Read(&len, sizeof(len)) || len == 0 || len > left) {
+      return false;
+    }
+    str->resize(len);
+    return Read(&(*str)[0], len);
+  }
+
+  bool Skip(uint64 len) {
+    if (len > left || fseek(file, len, SEEK_CUR) != 0) { return false; }
+    left -= len;
+    return true;
+  }
+};
+
+// The sizes follow the Deserialize() functions of the three formats.
+static bool check_model_file(ModelFileReader& reader, std::string* error) {
+  uint64 file_size = reader.left;
+  uint32 magic = 0;
+  if (!reader.Read(&magic, sizeof(magic))) {
+    *error = "the file is too short";
+    return false;
+  }
+  uint32 type = kQuantNone;
+  if (magic == kQuantMagic) {
+    if (!reader.Read(&type, sizeof(type)) ||
+        (type != kQuantFP16 && type != kQuantInt8)) {
+      *error = "unknown quantization type";
+      return false;
+    }
+  } else if (magic != kSparseMagic) {
+    // A checkpoint starts with the score function
+    rewind(reader.file);
+    reader.left = file_size;
+  }
+  std::string score_func, loss_func;
+  index_t num_feat = 0, num_field = 0, num_K = 0;
+  if (!reader.ReadString(&score_func) ||
+      (score_func != "linear" && score_func != "fm" &&
+       score_func != "ffm")) {
+    *error = "unknown score function";
+    return false;
+  }
+  if (!reader.ReadString(&loss_func) ||
+      !reader.Read(&num_feat, sizeof(num_feat)) ||
+      !reader.Read(&num_field, sizeof(num_field)) ||
+      !reader.Read(&num_K, sizeof(num_K))) {
+    *error = "the header is truncated";
+    return false;
+  }
+  uint64 aligned_k = (num_K + kAlign - 1) / kAlign * kAlign;
+  uint64 num_vec = 0;
+  if (score_func == "fm") {
+    num_vec = num_feat;
+  } else if (score_func == "ffm") {
+    num_vec = (uint64)num_feat * num_field;
+  }
+  uint64 size = 0;
+  if (magic == kQuantMagic) {
+    // w, b, and v in fp16 or int8 with the scales
+    size = (num_feat + 1ULL) * sizeof(real_t);
+    if (type == kQuantFP16) {
+      size += num_vec * aligned_k * sizeof(uint16);
+    } else {
+      size += num_vec * (sizeof(real_t) + aligned_k * sizeof(int8));
+    }
+  } else if (magic == kSparseMagic) {
+    // w, b, the field bitmap and the kept vectors
+    index_t num_kept = 0;
+    if (!reader.Read(&num_kept, sizeof(num_kept))) {
+      *error = "the header is truncated";
+      return false;
+    }
+    if (num_kept > num_vec) {
+      *error = "the number of vectors does not match the model";
+      return false;
+    }
+    size = (num_feat + 1ULL) * sizeof(real_t) +
+           (uint64)num_feat * ((num_field + 63) / 64) * sizeof(uint64) +
+           num_kept * aligned_k * sizeof(real_t);
+  } else {
+    // The sizes of w and v are stored in the checkpoint,
+    // and are computed in the same way as Initialize().
+    index_t aux_size = 0, num_w = 0, num_v = 0;
+    if (!reader.Read(&aux_size, sizeof(aux_size)) ||
+        !reader.Read(&num_w, sizeof(num_w)) ||
+        (score_func != "linear" && !reader.Read(&num_v, sizeof(num_v)))) {
+      *error = "the header is truncated";
+      return false;
+    }
+    if (aux_size < 1 || aux_size > 3 ||
+        num_w != num_feat * aux_size ||
+        num_v != (index_t)(num_vec * aligned_k) * aux_size) {
+      *error = "the number of parameters does not match the model";
+      return false;
+    }
+    size = ((uint64)num_w + aux_size + num_v) * sizeof(real_t);
+  }
+  if (!reader.Skip(size)) {
+    *error = "the parameters are truncated";
+    return false;
+  }
+  // The optional section of feature hashing
+  if (reader.left > 0) {
+    uint32 bits = 0, has_map = 0;
+    uint64 num_key = 0;
+    if (!reader.Read(&magic, sizeof(magic)) || magic != kFeatureHashMagic ||
+        !reader.Read(&bits, sizeof(bits)) || bits > 31 ||
+        !reader.Read(&has_map, sizeof(has_map)) ||
+        (has_map && (!reader.Read(&num_key, sizeof(num_key)) ||
+                     num_key > reader.left / sizeof(uint64) ||
+                     !reader.Skip(num_key * sizeof(uint64))))) {
+      *error = "the feature hashing section is broken";
+      return false;
+    }
+  }
+  if (reader.left > 0) {
+    *error = "unexpected data at the end of the file";
+    return false;
+  }
+  return true;
+}
+
+bool Model::CheckFile(const std::string& filename, std::string* error) {
+  CHECK_NOTNULL(error);
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    *error = StringPrintf("Cannot open the model file: %s",
+                          filename.c_str());
+    return false;
+  }
+  ModelFileReader reader;
+  reader.file = file;
+  reader.left = 0;
+  if (fseek(file, 0L, SEEK_END) == 0) {
+    long len = ftell(file);
+    reader.left = len > 0 ? len : 0;
+  }
+  rewind(file);
+  std::string reason;
+  bool ok = check_model_file(reader, &reason);
+  fclose(file);
+  if (!ok) {
+    *error = StringPrintf("Invalid model file: %s (%s)",
+                          filename.c_str(), reason.c_str());
+  }
+  return ok;
+}
+
+// Set the feature hashing of the model
+void Model::SetFeatureHash(int hash_bits, FeatureMap* map) {
+  CHECK_GE(hash_bits, 0);
+  CHECK_LE(hash_bits, 31);
+  hash_bits_ = hash_bits;
+  if (feat_map_ != map) {
+    delete feat_map_;
+    feat_map_ = map;
+  }
+}
+
+// Number of latent vectors
+index_t Model::get_num_vector() {
+  if (score_func_.compare("fm") == 0) {
+    return num_feat_;
+  } else if (score_func_.compare("ffm") == 0) {
+    return num_feat_ * num_field_;
+  }
+  return 0;
+}
+
+// The i-th vector of ffm is the vector of feature i / num_field
+// on field i % num_field, which is the i-th block of param_v_.
+void Model::get_vector(index_t i, real_t* out) {
+  const real_t* base = param_v_ + (size_t)i * get_aligned_k() * aux_size_;
+  if (score_func_.compare("fm") == 0) {
+    memcpy(out, base, num_K_ * sizeof(real_t));
+    return;
+  }
+  for (index_t d = 0; d < num_K_; ++d) {
+    out[d] = base[(d/align_)*align_*aux_size_ + d%align_];
+  }
+}
+
+real_t Model::get_quant_value(index_t i, index_t d) {
+  if (sparse_) {
+    const real_t* v = find_sparse_vector(i / num_field_, i % num_field_);
+    return v != nullptr ? v[d] : 0;
+  }
+  size_t idx = (size_t)i * get_aligned_k() + d;
+  if (quant_ == kQuantFP16) {
+    return HalfToFloat(param_v16_[idx]);
+  }
+  return param_v_scale_[i] * param_v8_[idx];
+}
+
+// Convert current model to an inference model
+void Model::Quantize(QuantType type) {
+  CHECK_NE(type, kQuantNone);
+  CHECK_EQ(quant_, kQuantNone);
+  CHECK(!sparse_);
+  // Linear term and bias without the gradient cache
+  real_t* w = (real_t*)malloc(num_feat_ * sizeof(real_t));
+  for (index_t i = 0; i < num_feat_; ++i) {
+    w[i] = param_w_[i * aux_size_];
+  }
+  real_t b = param_b_[0];
+  // Latent factor
+  index_t num_vec = get_num_vector();
+  index_t aligned_k = get_aligned_k();
+  size_t num_v = (size_t)num_vec * aligned_k;
+  uint16* v16 = nullptr;
+  int8* v8 = nullptr;
+  real_t* scale = nullptr;
+  if (type == kQuantFP16) {
+    v16 = (uint16*)malloc(num_v * sizeof(uint16));
+  } else {
+    v8 = (int8*)malloc(num_v * sizeof(int8));
+    scale = (real_t*)malloc(num_vec * sizeof(real_t));
+  }
+  // The padding values are zero
+  std::vector<real_t> vec(aligned_k, 0);
+  for (index_t i = 0; i < num_vec; ++i) {
+    get_vector(i, vec.data());
+    size_t base = (size_t)i * aligned_k;
+    if (type == kQuantFP16) {
+      for (index_t d = 0; d < aligned_k; ++d) {
+        v16[base + d] = FloatToHalf(vec[d]);
+      }
+      continue;
+    }
+    // Symmetric quantization: the max absolute value is 127
+    real_t max_abs = 0;
+    for (index_t d = 0; d < num_K_; ++d) {
+      max_abs = std::max(max_abs, (real_t)fabs(vec[d]));
+    }
+    real_t s = max_abs / 127.0f;
+    real_t inv = s > 0 ? 1.0f / s : 0;
+    for (index_t d = 0; d < aligned_k; ++d) {
+      v8[base + d] = (int8)lrintf(vec[d] * inv);
+    }
+    scale[i] = s;
+  }
+  // Replace the float model
+  free_model();
+  param_w_ = w;
+  param_b_ = (real_t*)malloc(sizeof(real_t));
+  param_b_[0] = b;
+  param_v_ = nullptr;
+  param_v16_ = v16;
+  param_v8_ = v8;
+  param_v_scale_ = scale;
+  param_num_w_ = num_feat_;
+  param_num_v_ = num_v;
+  aux_size_ = 1;
+  quant_ = type;
+}
+
+// Allocate the buffers of an inference model
+void Model::initial_quant() {
+  index_t num_vec = get_num_vector();
+  param_num_w_ = num_feat_;
+  param_num_v_ = num_vec * get_aligned_k();
+  aux_size_ = 1;
+  param_w_ = (real_t*)malloc(param_num_w_ * sizeof(real_t));
+  param_b_ = (real_t*)malloc(sizeof(real_t));
+  param_v_ = nullptr;
+  if (quant_ == kQuantFP16) {
+    param_v16_ = (uint16*)malloc(param_num_v_ * sizeof(uint16));
+  } else {
+    param_v8_ = (int8*)malloc(param_num_v_ * sizeof(int8));
+    param_v_scale_ = (real_t*)malloc(num_vec * sizeof(real_t));
+  }
+}
+
+// The format of an inference model is:
+//  [magic][quant type][score func][loss func][num_feat][num_field][K]
+//  [w: num_feat float][b: 1 float][v: fp16, or scale and int8]
+void Model::serialize_quant(FILE* file) {
+  uint32 magic = kQuantMagic;
+  WriteDataToDisk(file, (char*)&magic, sizeof(magic));
+  uint32 type = quant_;
+  WriteDataToDisk(file, (char*)&type, sizeof(type));
+  WriteStringToFile(file, score_func_);
+  WriteStringToFile(file, loss_func_);
+  WriteDataToDisk(file, (char*)&num_feat_, sizeof(num_feat_));
+  WriteDataToDisk(file, (char*)&num_field_, sizeof(num_field_));
+  WriteDataToDisk(file, (char*)&num_K_, sizeof(num_K_));
+  WriteDataToDisk(file, (char*)param_w_, sizeof(real_t)*param_num_w_);
+  WriteDataToDisk(file, (char*)param_b_, sizeof(real_t));
+  if (quant_ == kQuantFP16) {
+    WriteDataToDisk(file, (char*)param_v16_, sizeof(uint16)*param_num_v_);
+  } else {
+    WriteDataToDisk(file, (char*)param_v_scale_,
+                    sizeof(real_t)*get_num_vector());
+    WriteDataToDisk(file, (char*)param_v8_, sizeof(int8)*param_num_v_);
+  }
+}
+
+void Model::deserialize_quant(FILE* file) {
+  uint32 type = 0;
+  ReadDataFromDisk(file, (char*)&type, sizeof(type));
+  CHECK(type == kQuantFP16 || type == kQuantInt8);
+  quant_ = (QuantType)type;
+  ReadStringFromFile(file, score_func_);
+  ReadStringFromFile(file, loss_func_);
+  ReadDataFromDisk(file, (char*)&num_feat_, sizeof(num_feat_));
+  ReadDataFromDisk(file, (char*)&num_field_, sizeof(num_field_));
+  ReadDataFromDisk(file, (char*)&num_K_, sizeof(num_K_));
+  this->choose_align();
+  this->initial_quant();
+  ReadDataFromDisk(file, (char*)param_w_, sizeof(real_t)*param_num_w_);
+  ReadDataFromDisk(file, (char*)param_b_, sizeof(real_t));
+  if (quant_ == kQuantFP16) {
+    ReadDataFromDisk(file, (char*)param_v16_, sizeof(uint16)*param_num_v_);
+  } else {
+    ReadDataFromDisk(file, (char*)param_v_scale_,
+                     sizeof(real_t)*get_num_vector());
+    ReadDataFromDisk(file, (char*)param_v8_, sizeof(int8)*param_num_v_);
+  }
+}
+
+// A latent vector is never updated if its gradient cache still has
+// the initial value 1.0. The gradient cache of sgd (aux_size is 1) is
+// not stored, so only the threshold is checked.
+bool Model::keep_vector(index_t i, real_t threshold) {
+  const real_t* base = param_v_ + (size_t)i * get_aligned_k() * aux_size_;
+  bool updated = aux_size_ == 1;
+  real_t max_abs = 0;
+  for (index_t d = 0; d < num_K_; ++d) {
+    index_t idx = (d/align_)*align_*aux_size_ + d%align_;
+    max_abs = std::max(max_abs, (real_t)fabs(base[idx]));
+    for (index_t j = 1; j < aux_size_; ++j) {
+      if (base[idx + j*align_] != 1.0) { updated = true; }
+    }
+  }
+  return updated && max_abs > threshold;
+}
+
+// Bit f of the bitmap of feature j is set if the vector is kept,
+// and its index is the offset of j plus the bits set before f.
+const real_t* Model::find_sparse_vector(index_t j, index_t f) {
+  index_t words = GetNumFieldWord();
+  const uint64* bitmap = param_v_bitmap_ + (size_t)j * words;
+  index_t n = f / 64;
+  uint64 mask = (uint64)1 << (f % 64);
+  if ((bitmap[n] & mask) == 0) { return nullptr; }
+  size_t idx = param_v_offset_[j] + PopCount64(bitmap[n] & (mask - 1));
+  for (index_t w = 0; w < n; ++w) {
+    idx += PopCount64(bitmap[w]);
+  }
+  return param_v_ + idx * get_aligned_k();
+}
+
+// Convert current ffm model to a pruned inference model
+index_t Model::Prune(real_t threshold) {
+  CHECK_EQ(score_func_.compare("ffm"), 0);
+  CHECK_EQ(quant_, kQuantNone);
+  CHECK(!sparse_);
+  CHECK_GE(threshold, 0);
+  // Linear term and bias without the gradient cache
+  real_t* w = (real_t*)malloc(num_feat_ * sizeof(real_t));
+  for (index_t i = 0; i < num_feat_; ++i) {
+    real_t x = param_w_[i * aux_size_];
+    w[i] = fabs(x) > threshold ? x : 0;
+  }
+  real_t b = param_b_[0];
+  // Choose the vectors to keep
+  index_t words = GetNumFieldWord();
+  uint64* bitmap = (uint64*)calloc((size_t)num_feat_ * words,
+                                   sizeof(uint64));
+  index_t num_vec = 0;
+  for (index_t j = 0; j < num_feat_; ++j) {
+    for (index_t f = 0; f < num_field_; ++f) {
+      if (keep_vector(j * num_field_ + f, threshold)) {
+        bitmap[(size_t)j * words + f / 64] |= (uint64)1 << (f % 64);
+        num_vec++;
+      }
+    }
+  }
+  // Pack the kept vectors, whose padding values are zero
+  index_t aligned_k = get_aligned_k();
+  std::vector<real_t> v(std::max(num_vec, (index_t)1) * aligned_k, 0);
+  real_t* out = v.data();
+  for (index_t j = 0; j < num_feat_; ++j) {
+    for (index_t f = 0; f < num_field_; ++f) {
+      if (bitmap[(size_t)j * words + f / 64] & ((uint64)1 << (f % 64))) {
+        get_vector(j * num_field_ + f, out);
+        out += aligned_k;
+      }
+    }
+  }
+  // Replace the float model
+  free_model();
+  param_w_ = w;
+  param_b_ = (real_t*)malloc(sizeof(real_t));
+  param_b_[0] = b;
+  param_v_bitmap_ = bitmap;
+  param_v16_ = nullptr;
+  param_v8_ = nullptr;
+  param_v_scale_ = nullptr;
+  param_num_w_ = num_feat_;
+  aux_size_ = 1;
+  sparse_ = true;
+  this->initial_sparse(num_vec);
+  memcpy(param_v_, v.data(), param_num_v_ * sizeof(real_t));
+  return num_vec;
+}
+
+// The field bitmap has been set. The latent factor is aligned
+// for the SIMD kernel, and each vector has aligned_k values.
+void Model::initial_sparse(index_t num_vec) {
+  param_num_v_ = num_vec * get_aligned_k();
+  size_t size = std::max(param_num_v_, (index_t)1) * sizeof(real_t);
+#ifdef _WIN32
+  param_v_ = (real_t*)_aligned_malloc(size, get_align_byte());
+#else
+  int ret = posix_memalign((void**)&param_v_, get_align_byte(), size);
+  CHECK_EQ(ret, 0);
+#endif
+  param_v_offset_ = (index_t*)malloc((num_feat_ + 1) * sizeof(index_t));
+  index_t words = GetNumFieldWord();
+  index_t offset = 0;
+  for (index_t j = 0; j < num_feat_; ++j) {
+    param_v_offset_[j] = offset;
+    for (index_t n = 0; n < words; ++n) {
+      offset += PopCount64(param_v_bitmap_[(size_t)j * words + n]);
+    }
+  }
+  param_v_offset_[num_feat_] = offset;
+  CHECK_EQ(offset, num_vec);
+}
+
+// The format of a pruned model is:
+//  [magic][score func][loss func][num_feat][num_field][K][num_vec]
+//  [w: num_feat float][b: 1 float][bitmap: num_feat * words uint64]
+//  [v: num_vec * aligned_k float]
+// The offsets are built from the bitmap when it is loaded.
+void Model::serialize_sparse(FILE* file) {
+  uint32 magic = kSparseMagic;
+  WriteDataToDisk(file, (char*)&magic, sizeof(magic));
+  WriteStringToFile(file, score_func_);
+  WriteStringToFile(file, loss_func_);
+  WriteDataToDisk(file, (char*)&num_feat_, sizeof(num_feat_));
+  WriteDataToDisk(file, (char*)&num_field_, sizeof(num_field_));
+  WriteDataToDisk(file, (char*)&num_K_, sizeof(num_K_));
+  index_t num_vec = param_v_offset_[num_feat_];
+  WriteDataToDisk(file, (char*)&num_vec, sizeof(num_vec));
+  WriteDataToDisk(file, (char*)param_w_, sizeof(real_t)*param_num_w_);
+  WriteDataToDisk(file, (char*)param_b_, sizeof(real_t));
+  WriteDataToDisk(file, (char*)param_v_bitmap_,
+                  sizeof(uint64)*num_feat_*GetNumFieldWord());
+  WriteDataToDisk(file, (char*)param_v_, sizeof(real_t)*param_num_v_);
+}
+
+void Model::deserialize_sparse(FILE* file) {
+  ReadStringFromFile(file, score_func_);
+  ReadStringFromFile(file, loss_func_);
+  ReadDataFromDisk(file, (char*)&num_feat_, sizeof(num_feat_));
+  ReadDataFromDisk(file, (char*)&num_field_, sizeof(num_field_));
+  ReadDataFromDisk(file, (char*)&num_K_, sizeof(num_K_));
+  index_t num_vec = 0;
+  ReadDataFromDisk(file, (char*)&num_vec, sizeof(num_vec));
+  this->choose_align();
+  sparse_ = true;
+  aux_size_ = 1;
+  param_num_w_ = num_feat_;
+  param_w_ = (real_t*)malloc(param_num_w_ * sizeof(real_t));
+  param_b_ = (real_t*)malloc(sizeof(real_t));
+  ReadDataFromDisk(file, (char*)param_w_, sizeof(real_t)*param_num_w_);
+  ReadDataFromDisk(file, (char*)param_b_, sizeof(real_t));
+  size_t num_word = (size_t)num_feat_ * GetNumFieldWord();
+  param_v_bitmap_ = (uint64*)malloc(num_word * sizeof(uint64));
+  ReadDataFromDisk(file, (char*)param_v_bitmap_, sizeof(uint64)*num_word);
+  this->initial_sparse(num_vec);
+  ReadDataFromDisk(file, (char*)param_v_, sizeof(real_t)*param_num_v_);
+}
+
+// Copy the parameters of feature j between the model and the
+// record. The record of a latent vector is its aligned K values,
+// and for ffm the K values are in blocks of align_ in the model.
+void Model::copy_best(index_t j, bool restore) {
+  real_t* w = param_w_ + (size_t)j * aux_size_;
+  if (restore) {
+    *w = param_best_w_[j];
+  } else {
+    param_best_w_[j] = *w;
+  }
+  if (param_best_v_ == nullptr) { return; }
+  index_t aligned_k = get_aligned_k();
+  index_t num_vec = score_func_.compare("ffm") == 0 ? num_field_ : 1;
+  index_t block = score_func_.compare("ffm") == 0 ? align_ : aligned_k;
+  for (index_t f = 0; f < num_vec; ++f) {
+    size_t i = (size_t)j * num_vec + f;
+    real_t* v = param_v_ + i * aligned_k * aux_size_;
+    real_t* best = param_best_v_ + i * aligned_k;
+    for (index_t d = 0; d < aligned_k; d += block) {
+      real_t* m = v + d * aux_size_;
+      if (restore) {
+        memcpy(m, best + d, block * sizeof(real_t));
+      } else {
+        memcpy(best + d, m, block * sizeof(real_t));
+      }
+    }
+  }
+}
+
+// Take a record of the best model during training. The first
+// record copies all the features, and the next records copy the
+// features touched after the previous one.
 void Model::SetBestModel() {
-  try {
-    if (param_best_w_ == nullptr) {
-        param_best_w_ = (real_t*)malloc(
-        param_num_w_*sizeof(real_t));
-    }
-    if (param_best_v_ == nullptr &&
-        score_func_.compare("linear") != 0) {
-  #ifdef _WIN32
-        param_best_v_ = _aligned_malloc(
-        param_num_v_ * sizeof(real_t),
-        kAlignByte);
-  #else
-      int ret = posix_memalign(
-                (void**)&param_best_v_,
-                kAlignByte,
-                param_num_v_ * sizeof(real_t));
-      CHECK_EQ(ret, 0);
-  #endif
+  CHECK_EQ(quant_, kQuantNone);
+  CHECK(!sparse_);
+  // The writer is still reading the previous record
+  WaitBestModel();
+  bool first = param_best_w_ == nullptr;
+  if (first) {
+    param_best_w_ = (real_t*)malloc(num_feat_ * sizeof(real_t));
+    param_best_b_ = (real_t*)malloc(sizeof(real_t));
+    index_t num_vec = get_num_vector();
+    if (num_vec > 0) {
+      param_best_v_ = (real_t*)malloc(
+          (size_t)num_vec * get_aligned_k() * sizeof(real_t));
     }
-    if (param_best_b_ == nullptr) {
-        param_best_b_ = (real_t*)malloc(
-         aux_size_ * sizeof(real_t)
-        );
+    if (param_best_w_ == nullptr || param_best_b_ == nullptr ||
+        (num_vec > 0 && param_best_v_ == nullptr)) {
+      LOG(FATAL) << "Cannot allocate enough memory for current  \
+                     model parameters. Parameter size: "
+                 << GetNumParameter();
+    }
+    touched_.assign(num_feat_, 0);
+    for (index_t j = 0; j < num_feat_; ++j) {
+      copy_best(j, false);
+    }
+  } else {
+    for (size_t n = 0; n < touched_list_.size(); ++n) {
+      index_t j = touched_list_[n];
+      copy_best(j, false);
+      touched_[j] = 0;
+    }
+  }
+  touched_list_.clear();
+  param_best_b_[0] = param_b_[0];
+  if (!best_file_.empty()) {
+    best_writer_ = std::thread(&Model::serialize_best, this, best_file_);
+  }
+}
+
+// Record the features updated by a mini-batch. Nothing needs
+// to be recorded before the first SetBestModel().
+void Model::Touch(const DMatrix* matrix) {
+  if (param_best_w_ == nullptr || matrix == nullptr) { return; }
+  for (index_t i = 0; i < matrix->row_length; ++i) {
+    const SparseRow& row = matrix->row[i];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      index_t j = it->feat_id;
+      if (j < num_feat_ && touched_[j] == 0) {
+        touched_[j] = 1;
+        touched_list_.push_back(j);
+      }
     }
-  } catch (std::bad_alloc&) {
-    LOG(FATAL) << "Cannot allocate enough memory for current  \
-                   model parameters. Parameter size: "
-               << GetNumParameter();
   }
-  // Copy current model parameters
-  memcpy(param_best_w_, param_w_, param_num_w_*sizeof(real_t));
-  memcpy(param_best_v_, param_v_, param_num_v_*sizeof(real_t));
-  memcpy(param_best_b_, param_b_, aux_size_*sizeof(real_t));
 }
 
 // Shrink back for getting the best model
 void Model::Shrink() {
-  // Copy best model parameters
-  if (param_best_w_ != nullptr) {
-    memcpy(param_w_, param_best_w_, param_num_w_*sizeof(real_t));
+  if (param_best_w_ == nullptr) { return; }
+  WaitBestModel();
+  for (index_t j = 0; j < num_feat_; ++j) {
+    copy_best(j, true);
   }
-  if (param_best_v_ != nullptr) {
-    memcpy(param_v_, param_best_v_, param_num_v_*sizeof(real_t));
+  param_b_[0] = param_best_b_[0];
+}
+
+// The record is saved as a checkpoint whose aux_size is 1, where
+// the ffm layout is the same for all SIMD widths. It is written to
+// a temporary file first, so the file is always a complete model.
+void Model::serialize_best(const std::string& filename) {
+  std::string tmp = filename + ".tmp";
+  FILE* file = OpenFileOrDie(tmp.c_str(), "w");
+  index_t aux_size = 1;
+  index_t num_w = num_feat_;
+  index_t num_v = get_num_vector() * get_aligned_k();
+  WriteStringToFile(file, score_func_);
+  WriteStringToFile(file, loss_func_);
+  WriteDataToDisk(file, (char*)&num_feat_, sizeof(num_feat_));
+  WriteDataToDisk(file, (char*)&num_field_, sizeof(num_field_));
+  WriteDataToDisk(file, (char*)&num_K_, sizeof(num_K_));
+  WriteDataToDisk(file, (char*)&aux_size, sizeof(aux_size));
+  WriteDataToDisk(file, (char*)&num_w, sizeof(num_w));
+  if (score_func_.compare("linear") != 0) {
+    WriteDataToDisk(file, (char*)&num_v, sizeof(num_v));
   }
-  if (param_best_b_ != nullptr) {
-    memcpy(param_b_, param_best_b_, aux_size_*sizeof(real_t));
+  WriteDataToDisk(file, (char*)param_best_w_, sizeof(real_t)*num_w);
+  WriteDataToDisk(file, (char*)param_best_b_, sizeof(real_t));
+  if (score_func_.compare("linear") != 0) {
+    WriteDataToDisk(file, (char*)param_best_v_, sizeof(real_t)*num_v);
+  }
+  this->serialize_feature_hash(file);
+  Close(file);
+  if (rename(tmp.c_str(), filename.c_str()) != 0) {
+    LOG(ERR) << "Cannot save the best model to " << filename;
   }
 }
 
@@ -360,10 +1082,43 @@ void Model::serialize_w_v_b(FILE* file) {
   WriteDataToDisk(file, (char*)param_b_, sizeof(real_t)*aux_size_);
   // Write v
   if (score_func_.compare("linear") != 0) {
-    WriteDataToDisk(file, (char*)param_v_, sizeof(real_t)*param_num_v_);
+    this->serialize_v(file);
+  }
+}
+
+// The old checkpoint files don't have this section, so
+// it is written only if the features are hashed.
+void Model::serialize_feature_hash(FILE* file) {
+  if (hash_bits_ == 0 && feat_map_ == nullptr) { return; }
+  uint32 magic = kFeatureHashMagic;
+  WriteDataToDisk(file, (char*)&magic, sizeof(magic));
+  uint32 bits = hash_bits_;
+  WriteDataToDisk(file, (char*)&bits, sizeof(bits));
+  uint32 has_map = feat_map_ != nullptr ? 1 : 0;
+  WriteDataToDisk(file, (char*)&has_map, sizeof(has_map));
+  if (has_map) {
+    feat_map_->Serialize(file);
   }
 }
 
+void Model::deserialize_feature_hash(FILE* file) {
+  uint32 magic = 0;
+  size_t len = ReadDataFromDisk(file, (char*)&magic, sizeof(magic));
+  if (len != sizeof(magic) || magic != kFeatureHashMagic) {
+    SetFeatureHash(0, nullptr);
+    return;
+  }
+  uint32 bits = 0, has_map = 0;
+  ReadDataFromDisk(file, (char*)&bits, sizeof(bits));
+  ReadDataFromDisk(file, (char*)&has_map, sizeof(has_map));
+  FeatureMap* map = nullptr;
+  if (has_map) {
+    map = new FeatureMap();
+    map->Deserialize(file);
+  }
+  SetFeatureHash(bits, map);
+}
+
 // Deserialize w,v,b from disk file
 void Model::deserialize_w_v_b(FILE* file) {
   // Read size of w
@@ -380,7 +1135,79 @@ void Model::deserialize_w_v_b(FILE* file) {
   ReadDataFromDisk(file, (char*)param_b_, sizeof(real_t)*aux_size_);
   // Read v
   if (score_func_.compare("linear") != 0) {
+    this->deserialize_v(file);
+  }
+}
+
+// Convert a block of ffm latent factor, i.e., all the
+// K (and the gradient cache) of one feature on one field,
+// between two different SIMD layouts:
+//  [w_0 .. w_a-1 | g_0 .. g_a-1 | w_a .. w_2a-1 | g_a .. g_2a-1 | ...]
+static void convert_ffm_block(const real_t* src,
+                              index_t src_align,
+                              real_t* dst,
+                              index_t dst_align,
+                              index_t aligned_k,
+                              index_t aux_size) {
+  for (index_t d = 0; d < aligned_k; ++d) {
+    index_t src_idx = (d/src_align)*src_align*aux_size + d%src_align;
+    index_t dst_idx = (d/dst_align)*dst_align*aux_size + d%dst_align;
+    for (index_t j = 0; j < aux_size; ++j) {
+      dst[dst_idx + j*dst_align] = src[src_idx + j*src_align];
+    }
+  }
+}
+
+// The checkpoint file always stores the latent factor in the
+// kAlign layout, so that a model trained by the AVX-512 kernel
+// can be loaded on the machine that only supports SSE.
+// Note that only ffm interleaves the gradient cache with the
+// model parameters, and the fm layout does not depend on align_.
+void Model::serialize_v(FILE* file) {
+  if (score_func_.compare("ffm") != 0 || align_ == kAlign) {
+    WriteDataToDisk(file, (char*)param_v_, sizeof(real_t)*param_num_v_);
+    return;
+  }
+  index_t block_size = get_aligned_k() * aux_size_;
+  index_t num_block = param_num_v_ / block_size;
+  // Convert 1 MB of data at each time
+  index_t batch = (MB / sizeof(real_t)) / block_size;
+  if (batch == 0) { batch = 1; }
+  std::vector<real_t> buffer(batch * block_size);
+  for (index_t i = 0; i < num_block; i += batch) {
+    index_t n = std::min(batch, num_block - i);
+    for (index_t b = 0; b < n; ++b) {
+      convert_ffm_block(param_v_ + (i+b)*block_size, align_,
+                        buffer.data() + b*block_size, kAlign,
+                        get_aligned_k(), aux_size_);
+    }
+    WriteDataToDisk(file, (char*)buffer.data(),
+                    sizeof(real_t)*n*block_size);
+  }
+}
+
+// Read the kAlign layout from checkpoint file and convert
+// it to the layout used by current SIMD kernel.
+void Model::deserialize_v(FILE* file) {
+  if (score_func_.compare("ffm") != 0 || align_ == kAlign) {
     ReadDataFromDisk(file, (char*)param_v_, sizeof(real_t)*param_num_v_);
+    return;
+  }
+  index_t block_size = get_aligned_k() * aux_size_;
+  index_t num_block = param_num_v_ / block_size;
+  // Convert 1 MB of data at each time
+  index_t batch = (MB / sizeof(real_t)) / block_size;
+  if (batch == 0) { batch = 1; }
+  std::vector<real_t> buffer(batch * block_size);
+  for (index_t i = 0; i < num_block; i += batch) {
+    index_t n = std::min(batch, num_block - i);
+    ReadDataFromDisk(file, (char*)buffer.data(),
+                     sizeof(real_t)*n*block_size);
+    for (index_t b = 0; b < n; ++b) {
+      convert_ffm_block(buffer.data() + b*block_size, kAlign,
+                        param_v_ + (i+b)*block_size, align_,
+                        get_aligned_k(), aux_size_);
+    }
   }
 }
 
@@ -22,15 +22,29 @@ This file defines the class of model parameters.
 #define XLEARN_DATA_MODEL_PARAMETERS_H_
 
 #include <string>
+#include <vector>
+#include <thread>
 
 #include <math.h>
 
 #include "src/base/common.h"
 #include "src/data/data_structure.h"
+#include "src/data/feature_map.h"
 #include "src/base/logging.h"
 
+class ThreadPool;
+
 namespace xLearn {
 
+// Storage type of the latent factor. A model trained by xLearn uses
+// float, and an inference model made by Model::Quantize() can use
+// fp16 or int8 to save the memory.
+enum QuantType {
+  kQuantNone = 0,  /* float, with the gradient cache */
+  kQuantFP16 = 1,  /* half-precision float */
+  kQuantInt8 = 2   /* int8, with one float scale for each vector */
+};
+
 //------------------------------------------------------------------------------
 // The Model class is responsible for storing the global
 // model prameters. We can dump a checkpoint for current model
@@ -80,12 +94,62 @@ namespace xLearn {
 // The Model class can support early-stopping technique. We can set
 // a record for the best model parameter by using SetBestModel() and
 // we can shrink back to find the best model by using Shrink() method.
+// The record only keeps the model parameters without the gradient
+// cache, and it is updated incrementally: after the first record,
+// only the features given to Touch() are copied:
+//
+//    model.SetBestModel();
+//    for (each mini-batch) {
+//      /* update model by matrix ... */
+//      model.Touch(matrix);
+//    }
+//    model.SetBestModel();  /* copy the touched features only */
+//
+// If SetBestModelFile() is set, each record is also saved to the
+// file by a background thread.
+//
+// Memory pages are placed on the NUMA node of the thread that first
+// writes them. If a ThreadPool is given to Initialize() or CopyFrom(),
+// the threads of the pool write the model buffers first, so the pages
+// are spread over the nodes of these threads instead of all on the
+// node of the main thread.
+//
+// If the features are hashed (see Parser::setFeatureHash()), the model
+// keeps the number of hash bits and the FeatureMap, and saves them in
+// the checkpoint file, so that the prediction task can map the feature
+// keys to the same ids.
+//
+// After training, we can make an inference-only model, which drops the
+// gradient cache and stores the latent factor in fp16 or int8:
+//
+//    model.Quantize(kQuantInt8);
+//    model.Serialize("/tmp/model.bin");  /* saved in the compact format */
+//
+// The quantized latent factor is read by GetParameter_v_fp16() or
+// GetParameter_v_int8(), in which each latent vector is stored in
+// aligned K values, padded by zero. An inference model can only be
+// used for prediction, so GetParameter_v() returns nullptr.
+//
+// An ffm model can also be pruned into a compact inference model,
+// which keeps only the latent vectors that are used:
+//
+//    model.Prune(1e-6);  /* drop the vectors within 1e-6 */
+//    model.Serialize("/tmp/model.bin");  /* saved in the compact format */
+//
+// The kept vectors are packed in GetParameter_v(), and feature j has
+// GetNumFieldWord() words of field bitmap at GetFieldBitmap() + j * words.
+// If bit f is set, the vector of feature j on field f is the n-th one
+// from GetVectorOffset()[j], where n is the number of bits set before f.
 //------------------------------------------------------------------------------
 class Model {
  public:
   // Default Constructor and Destructor
   Model() { }
-  ~Model() { free_model(); }
+  ~Model() {
+    WaitBestModel();
+    free_model();
+    delete feat_map_;
+  }
 
   // Initialize model from a checkpoint file.
   explicit Model(const std::string& filename);
@@ -98,7 +162,12 @@ class Model {
               index_t num_field,
               index_t num_K,
               index_t aux_size,
-              real_t scale = 1.0);
+              real_t scale = 1.0,
+              ThreadPool* pool = nullptr);
+
+  // Make current model a copy of the other model. The memory
+  // is allocated only if the shape of the two models is different.
+  void CopyFrom(const Model& other, ThreadPool* pool = nullptr);
 
   // Serialize model to a checkpoint file.
   void Serialize(const std::string& filename);
@@ -109,12 +178,84 @@ class Model {
   // Deserialize model from a checkpoint file.
   bool Deserialize(const std::string& filename);
 
+  // Check the header and the size of a model file (a checkpoint,
+  // an inference model or a pruned model) without loading it.
+  // Return false and set error if Deserialize() cannot load it.
+  static bool CheckFile(const std::string& filename, std::string* error);
+
+  // Convert current model to an inference model, which only has the
+  // model parameters, and stores the latent factor in the given type.
+  // Serialize() saves an inference model in a compact format.
+  void Quantize(QuantType type);
+
+  // Storage type of the latent factor.
+  inline QuantType GetQuantType() { return quant_; }
+
+  // Get the fp16 latent factor of an inference model.
+  inline const uint16* GetParameter_v_fp16() { return param_v16_; }
+
+  // Get the int8 latent factor of an inference model.
+  inline const int8* GetParameter_v_int8() { return param_v8_; }
+
+  // Get the scale of each int8 latent vector.
+  inline const real_t* GetScale_v() { return param_v_scale_; }
+
+  // Convert a trained ffm model to an inference model, which drops
+  // the latent vectors that are never updated (the gradient cache is
+  // not changed) or whose values are all within threshold, and sets
+  // the linear term within threshold to zero. The kept vectors are
+  // packed and indexed by a field bitmap of each feature. Serialize()
+  // saves a pruned model in a compact format. Return the number of
+  // latent vectors kept.
+  index_t Prune(real_t threshold);
+
+  // Whether current model is a pruned inference model.
+  inline bool IsSparse() { return sparse_; }
+
+  // Get the field bitmap of each feature of a pruned model.
+  inline const uint64* GetFieldBitmap() { return param_v_bitmap_; }
+
+  // Get the index of the first kept vector of each feature.
+  inline const index_t* GetVectorOffset() { return param_v_offset_; }
+
+  // Number of uint64 in the field bitmap of one feature.
+  inline index_t GetNumFieldWord() { return (num_field_ + 63) / 64; }
+
+  // Set the feature hashing used by the training data. The model
+  // takes the ownership of map, which can be nullptr.
+  void SetFeatureHash(int hash_bits, FeatureMap* map);
+
+  // Number of hash bits, 0 for no hashing.
+  inline int GetHashBits() { return hash_bits_; }
+
+  // The map from feature key to feature id, or nullptr.
+  inline FeatureMap* GetFeatureMap() { return feat_map_; }
+
   // Take a record of the best model during training.
   void SetBestModel();
 
-  // Shrink back for getting the best model.
+  // Shrink back for getting the best model. The gradient
+  // cache is not in the record, so it is not changed.
   void Shrink();
 
+  // The features of matrix are updated after the last
+  // SetBestModel(), so they are copied by the next one.
+  void Touch(const DMatrix* matrix);
+
+  // Save the best model to filename in a background thread
+  // after each SetBestModel(). The file is a checkpoint without
+  // gradient cache (aux_size is 1), which can be used for
+  // prediction. An empty filename disables the writer.
+  void SetBestModelFile(const std::string& filename) {
+    WaitBestModel();
+    best_file_ = filename;
+  }
+
+  // Wait until the background writer has saved the best model.
+  void WaitBestModel() {
+    if (best_writer_.joinable()) { best_writer_.join(); }
+  }
+
   // Get the size of auxiliary cache size
   inline real_t GetAuxiliarySize() { return aux_size_; }
 
@@ -135,7 +276,10 @@ class Model {
   inline index_t GetNumParameter_v() { return param_num_v_; }
 
   // Reset current model parameters.
-  inline void Reset() { set_value(); }
+  inline void Reset() {
+    free_best();
+    set_value();
+  }
 
   // Get score function type.
   inline std::string& GetScoreFunction() { return score_func_; }
@@ -152,11 +296,20 @@ class Model {
   // Get the number of k.
   inline index_t GetNumK() { return num_K_; }
 
+  // Get the number of float in one SIMD block of the
+  // latent factor. It can be 4 (SSE), 8 (AVX2) or 16 (AVX-512).
+  inline index_t GetAlign() { return align_; }
+
   // Get the aligned size of K.
   inline index_t get_aligned_k() {
     return (index_t)ceil((real_t)num_K_/kAlign)*kAlign;
   }
 
+  // Get the aligned byte for the latent factor.
+  inline index_t get_align_byte() {
+    return align_ * sizeof(real_t);
+  }
+
   // Get the total size of model parameters.
   inline index_t GetNumParameter() {
     return param_num_w_ + param_num_v_ + 2;
@@ -194,35 +347,130 @@ class Model {
   /* Auxiliary memory size for different optimization method
   For 'adagrad' it equals 2 and 'ftrl' it equals 3 */
   index_t aux_size_;
+  /* Width of the SIMD kernel used by current model, which
+  is chosen by choose_align() when model is created */
+  index_t align_ = kAlign;
   /* Storing the parameter of linear term */
   real_t*  param_w_ = nullptr;
   /* Storing the parameter of latent factor */
   real_t*  param_v_ = nullptr;
   /* Storing the bias term */
   real_t*  param_b_ = nullptr;
-  /* The following varibles are used for early-stopping */
+  /* The following varibles are used for early-stopping.
+  The record has the parameters without the gradient cache:
+  w of each feature, the aligned K of each vector, and b */
   real_t* param_best_w_ = nullptr;
   real_t* param_best_v_ = nullptr;
   real_t* param_best_b_ = nullptr;
+  /* Features touched after the last record */
+  std::vector<uint8> touched_;
+  std::vector<index_t> touched_list_;
+  /* Background writer of the best model */
+  std::string best_file_;
+  std::thread best_writer_;
   /* Used for init model parameters */
   real_t scale_;
+  /* Number of hash bits of the feature ids */
+  int hash_bits_ = 0;
+  /* Map from feature key to feature id */
+  FeatureMap* feat_map_ = nullptr;
+  /* Storage type of the latent factor */
+  QuantType quant_ = kQuantNone;
+  /* Latent factor of an inference model in fp16 or int8.
+  For fm, the vector of feature j is at j * aligned_k, and for ffm,
+  the vector of feature j on field f is at (j * num_field + f) * aligned_k */
+  uint16* param_v16_ = nullptr;
+  int8* param_v8_ = nullptr;
+  /* Scale of each int8 vector: v = scale * int8 */
+  real_t* param_v_scale_ = nullptr;
+  /* A pruned model packs the kept vectors in param_v_, and
+  indexes them by the field bitmap and offset of each feature */
+  bool sparse_ = false;
+  uint64* param_v_bitmap_ = nullptr;
+  index_t* param_v_offset_ = nullptr;
+  /* Number of float written by one task of the
+  thread pool when we touch the model memory */
+  static const index_t kTouchGrain = 16384;
 
   // Initialize the value of model parameters.
-  // and gradient cache
-  void initial(bool set_value = false);
+  // and gradient cache. The memory is first touched
+  // by the threads of pool if it is not nullptr.
+  void initial(bool set_value = false, ThreadPool* pool = nullptr);
 
   // Reset the value of current model parameters.
   void set_value();
 
+  // Copy src to dst by the threads of pool.
+  static void copy_range(real_t* dst, const real_t* src,
+                         index_t len, ThreadPool* pool);
+
+  // Choose the widest SIMD width supported by current CPU
+  // that does not change the size of aligned K.
+  void choose_align();
+
+  // Serialize or deserialize the latent factor in the
+  // kAlign (SSE) layout, which is used by the checkpoint file.
+  void serialize_v(FILE* file);
+  void deserialize_v(FILE* file);
+
   // Serialize w, v, b to disk file.
   void serialize_w_v_b(FILE* file);
 
   // Deserialize w, v, b from disk file.
   void deserialize_w_v_b(FILE* file);
 
+  // Number of latent vectors, i.e., num_feat for fm
+  // and num_feat * num_field for ffm.
+  index_t get_num_vector();
+
+  // Copy the K values of the i-th latent vector of a float model.
+  void get_vector(index_t i, real_t* out);
+
+  // Get the d-th value of the i-th latent vector of an inference model.
+  real_t get_quant_value(index_t i, index_t d);
+
+  // Allocate the buffers of an inference model.
+  void initial_quant();
+
+  // Whether the i-th latent vector of a float model is kept by Prune().
+  bool keep_vector(index_t i, real_t threshold);
+
+  // Get the kept vector of feature j on field f of a
+  // pruned model, or nullptr if it has been dropped.
+  const real_t* find_sparse_vector(index_t j, index_t f);
+
+  // Allocate the packed latent factor of a pruned model, and build
+  // the offsets from the field bitmap.
+  void initial_sparse(index_t num_vec);
+
+  // Serialize or deserialize a pruned model. The
+  // header has been read when deserialize_sparse() is called.
+  void serialize_sparse(FILE* file);
+  void deserialize_sparse(FILE* file);
+
+  // Serialize or deserialize an inference model. The
+  // header has been read when deserialize_quant() is called.
+  void serialize_quant(FILE* file);
+  void deserialize_quant(FILE* file);
+
+  // Serialize or deserialize the feature hashing, which is
+  // an optional section at the end of the checkpoint file.
+  void serialize_feature_hash(FILE* file);
+  void deserialize_feature_hash(FILE* file);
+
   // Free the allocated memory.
   void free_model();
 
+  // Free the record of the best model.
+  void free_best();
+
+  // Copy the parameters of feature j to the record of the
+  // best model, or copy them back if restore is true.
+  void copy_best(index_t j, bool restore);
+
+  // Save the record of the best model to a checkpoint file.
+  void serialize_best(const std::string& filename);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Model);
 };
@@ -23,6 +23,8 @@ This file tests model_parameters.h file.
 #include <string>
 #include <vector>
 
+#include "src/base/float16.h"
+#include "src/base/thread_pool.h"
 #include "src/data/model_parameters.h"
 #include "src/data/hyper_parameters.h"
 
@@ -72,9 +74,10 @@ TEST(MODEL_TEST, Init_ffm) {
 
   }
   len = model_ffm.GetNumParameter_v();
-  for (index_t i = 0; i < len; i+=(kAlign*aux_size)) {
+  index_t align = model_ffm.GetAlign();
+  for (index_t i = 0; i < len; i+=(align*aux_size)) {
     for (index_t j = 1; j < aux_size; ++j) {
-      EXPECT_FLOAT_EQ(v[i+kAlign*j], 1.0);
+      EXPECT_FLOAT_EQ(v[i+align*j], 1.0);
     }
   }
 }
@@ -167,6 +170,8 @@ TEST(MODEL_TEST, Save_and_Load) {
     v[i] = 3.5;
   }
   model_ffm.Serialize(hyper_param.model_file);
+  std::string error;
+  EXPECT_TRUE(Model::CheckFile(hyper_param.model_file, &error));
   Model new_model(hyper_param.model_file);
   real_t* b = new_model.GetParameter_b();
   w = new_model.GetParameter_w();
@@ -197,6 +202,199 @@ TEST(MODEL_TEST, Save_and_Load) {
   RemoveFile(hyper_param.model_file.c_str());
 }
 
+TEST(MODEL_TEST, Save_and_Load_feature_hash) {
+  HyperParam hyper_param = Init();
+  Model model_lr;
+  model_lr.Initialize("linear", "squared", 3, 0, 0, 2);
+  FeatureMap* map = new FeatureMap();
+  map->Insert(123456789012345ULL);
+  map->Insert(42);
+  map->Insert(7);
+  model_lr.SetFeatureHash(24, map);
+  model_lr.Serialize(hyper_param.model_file);
+  std::string error;
+  EXPECT_TRUE(Model::CheckFile(hyper_param.model_file, &error));
+  Model new_model(hyper_param.model_file);
+  EXPECT_EQ(new_model.GetHashBits(), 24);
+  ASSERT_TRUE(new_model.GetFeatureMap() != nullptr);
+  EXPECT_EQ(new_model.GetFeatureMap()->Size(), 3);
+  EXPECT_EQ(new_model.GetFeatureMap()->Find(123456789012345ULL), 0);
+  EXPECT_EQ(new_model.GetFeatureMap()->Find(7), 2);
+  // The model without hashing
+  Model model_plain;
+  model_plain.Initialize("linear", "squared", 3, 0, 0, 2);
+  model_plain.Serialize(hyper_param.model_file);
+  Model plain(hyper_param.model_file);
+  EXPECT_EQ(plain.GetHashBits(), 0);
+  EXPECT_TRUE(plain.GetFeatureMap() == nullptr);
+  RemoveFile(hyper_param.model_file.c_str());
+}
+
+TEST(MODEL_TEST, Quantize_and_Save) {
+  HyperParam hyper_param = Init();
+  QuantType types[2] = { kQuantFP16, kQuantInt8 };
+  for (int t = 0; t < 2; ++t) {
+    Model model_ffm;
+    model_ffm.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K,
+                    hyper_param.auxiliary_size);
+    model_ffm.GetParameter_w()[2] = 0.25;
+    index_t k_aligned = model_ffm.get_aligned_k();
+    index_t align = model_ffm.GetAlign();
+    // The first value of feature 1 on field 2
+    real_t v_1_2 = model_ffm.GetParameter_v()[
+      (1 * hyper_param.num_field + 2) * k_aligned * 2];
+    // The last value of feature 3 on field 0
+    index_t d = hyper_param.num_K - 1;
+    real_t v_3_0 = model_ffm.GetParameter_v()[
+      (3 * hyper_param.num_field) * k_aligned * 2 +
+      (d/align)*align*2 + d%align];
+    model_ffm.Quantize(types[t]);
+    EXPECT_EQ(model_ffm.GetNumParameter_w(), hyper_param.num_feature);
+    EXPECT_EQ(model_ffm.GetNumParameter_v(),
+              hyper_param.num_feature * hyper_param.num_field *
+              k_aligned);
+    EXPECT_FLOAT_EQ(model_ffm.GetParameter_w()[1], 0.25);
+    model_ffm.Serialize(hyper_param.model_file);
+    std::string error;
+    EXPECT_TRUE(Model::CheckFile(hyper_param.model_file, &error));
+    Model new_model(hyper_param.model_file);
+    EXPECT_EQ(new_model.GetQuantType(), types[t]);
+    EXPECT_EQ(new_model.GetScoreFunction(), "ffm");
+    EXPECT_EQ(new_model.GetNumK(), hyper_param.num_K);
+    EXPECT_EQ(new_model.GetAuxiliarySize(), 1);
+    EXPECT_FLOAT_EQ(new_model.GetParameter_w()[1], 0.25);
+    index_t i1 = (1 * hyper_param.num_field + 2) * k_aligned;
+    index_t i2 = 3 * hyper_param.num_field * k_aligned + d;
+    if (types[t] == kQuantFP16) {
+      const uint16* v = new_model.GetParameter_v_fp16();
+      EXPECT_NEAR(HalfToFloat(v[i1]), v_1_2, 1e-3);
+      EXPECT_NEAR(HalfToFloat(v[i2]), v_3_0, 1e-3);
+    } else {
+      const int8* v = new_model.GetParameter_v_int8();
+      const real_t* scale = new_model.GetScale_v();
+      EXPECT_NEAR(v[i1] * scale[i1 / k_aligned], v_1_2, 1e-2);
+      EXPECT_NEAR(v[i2] * scale[i2 / k_aligned], v_3_0, 1e-2);
+    }
+  }
+  RemoveFile(hyper_param.model_file.c_str());
+}
+
+TEST(MODEL_TEST, Prune_and_Save) {
+  HyperParam hyper_param = Init();
+  hyper_param.num_field = 70;  // two words of field bitmap
+  Model model_ffm;
+  model_ffm.Initialize(hyper_param.score_func,
+                  hyper_param.loss_func,
+                  hyper_param.num_feature,
+                  hyper_param.num_field,
+                  hyper_param.num_K,
+                  hyper_param.auxiliary_size);
+  index_t k_aligned = model_ffm.get_aligned_k();
+  index_t align = model_ffm.GetAlign();
+  real_t* v = model_ffm.GetParameter_v();
+  // Update the vectors of feature 1 on field 2 and 65, and
+  // feature 3 on field 0, by changing their gradient cache.
+  index_t num_field = hyper_param.num_field;
+  index_t updated[3] = { 1 * num_field + 2,
+                         1 * num_field + 65,
+                         3 * num_field + 0 };
+  for (int n = 0; n < 3; ++n) {
+    v[updated[n] * k_aligned * 2 + align] = 2.0;
+  }
+  // Feature 1 on field 65 is updated to zero
+  for (index_t d = 0; d < hyper_param.num_K; ++d) {
+    v[updated[1] * k_aligned * 2 + (d/align)*align*2 + d%align] = 0;
+  }
+  real_t v_1_2 = v[updated[0] * k_aligned * 2];
+  index_t d = hyper_param.num_K - 1;
+  real_t v_3_0 = v[updated[2] * k_aligned * 2 + (d/align)*align*2 + d%align];
+  model_ffm.GetParameter_w()[2] = 0.25;
+  model_ffm.GetParameter_w()[4] = 1e-4;
+  EXPECT_EQ(model_ffm.Prune(1e-3), 2);
+  EXPECT_TRUE(model_ffm.IsSparse());
+  EXPECT_EQ(model_ffm.GetNumParameter_v(), 2 * k_aligned);
+  EXPECT_EQ(model_ffm.GetNumFieldWord(), 2);
+  EXPECT_FLOAT_EQ(model_ffm.GetParameter_w()[1], 0.25);
+  EXPECT_FLOAT_EQ(model_ffm.GetParameter_w()[2], 0);
+  model_ffm.Serialize(hyper_param.model_file);
+  std::string error;
+  EXPECT_TRUE(Model::CheckFile(hyper_param.model_file, &error));
+  Model new_model(hyper_param.model_file);
+  EXPECT_TRUE(new_model.IsSparse());
+  EXPECT_EQ(new_model.GetScoreFunction(), "ffm");
+  EXPECT_EQ(new_model.GetNumField(), num_field);
+  EXPECT_EQ(new_model.GetNumK(), hyper_param.num_K);
+  EXPECT_EQ(new_model.GetAuxiliarySize(), 1);
+  EXPECT_FLOAT_EQ(new_model.GetParameter_w()[1], 0.25);
+  const uint64* bitmap = new_model.GetFieldBitmap();
+  const index_t* offset = new_model.GetVectorOffset();
+  EXPECT_EQ(bitmap[1 * 2], (uint64)1 << 2);
+  EXPECT_EQ(bitmap[1 * 2 + 1], 0);
+  EXPECT_EQ(bitmap[3 * 2], 1);
+  EXPECT_EQ(offset[1], 0);
+  EXPECT_EQ(offset[3], 1);
+  EXPECT_EQ(offset[hyper_param.num_feature], 2);
+  const real_t* new_v = new_model.GetParameter_v();
+  EXPECT_FLOAT_EQ(new_v[0], v_1_2);
+  EXPECT_FLOAT_EQ(new_v[k_aligned + d], v_3_0);
+  for (index_t d = hyper_param.num_K; d < k_aligned; ++d) {
+    EXPECT_FLOAT_EQ(new_v[d], 0);
+  }
+  RemoveFile(hyper_param.model_file.c_str());
+}
+
+// Write the first len bytes of the data, and the extra bytes
+void write_file(const std::string& filename, const std::string& data,
+                size_t len, const std::string& extra) {
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  WriteDataToDisk(file, (char*)data.data(), len);
+  if (!extra.empty()) {
+    WriteDataToDisk(file, (char*)extra.data(), extra.size());
+  }
+  Close(file);
+}
+
+TEST(MODEL_TEST, CheckFile) {
+  HyperParam hyper_param = Init();
+  std::string error;
+  EXPECT_FALSE(Model::CheckFile("./no_such_model", &error));
+  EXPECT_EQ(error.find("Cannot open"), 0);
+  Model model_ffm;
+  model_ffm.Initialize(hyper_param.score_func,
+                  hyper_param.loss_func,
+                  hyper_param.num_feature,
+                  hyper_param.num_field,
+                  hyper_param.num_K,
+                  hyper_param.auxiliary_size);
+  model_ffm.Serialize(hyper_param.model_file);
+  char* buffer = nullptr;
+  uint64 size = ReadFileToMemory(hyper_param.model_file, &buffer);
+  std::string data(buffer, size);
+  delete [] buffer;
+  // Truncated parameters and header
+  write_file(hyper_param.model_file, data, size - 4, "");
+  EXPECT_FALSE(Model::CheckFile(hyper_param.model_file, &error));
+  EXPECT_NE(error.find("truncated"), std::string::npos);
+  write_file(hyper_param.model_file, data, 20, "");
+  EXPECT_FALSE(Model::CheckFile(hyper_param.model_file, &error));
+  // Extra data at the end
+  write_file(hyper_param.model_file, data, size, "abcdefgh");
+  EXPECT_FALSE(Model::CheckFile(hyper_param.model_file, &error));
+  // Not a model file
+  write_file(hyper_param.model_file, "", 0, "1 0:0:1.0 1:1:2.0\n");
+  EXPECT_FALSE(Model::CheckFile(hyper_param.model_file, &error));
+  write_file(hyper_param.model_file, "", 0, "");
+  EXPECT_FALSE(Model::CheckFile(hyper_param.model_file, &error));
+  // The file itself
+  write_file(hyper_param.model_file, data, size, "");
+  EXPECT_TRUE(Model::CheckFile(hyper_param.model_file, &error));
+  RemoveFile(hyper_param.model_file.c_str());
+}
+
 TEST(MODEL_TEST, SerializeToTxt) {
   HyperParam hyper_param = Init();
   hyper_param.score_func = "linear";
@@ -219,6 +417,13 @@ TEST(MODEL_TEST, SerializeToTxt) {
   RemoveFile(hyper_param.model_file.c_str());
 }
 
+// Whether v[i] of ffm is a model parameter, not the gradient cache
+bool is_param_v(Model& model, index_t i) {
+  index_t align = model.GetAlign();
+  index_t aux_size = model.GetAuxiliarySize();
+  return (i / align) % aux_size == 0;
+}
+
 TEST(MODEL_TEST, BestModel) {
   // Init model
   HyperParam hyper_param = Init();
@@ -251,15 +456,147 @@ TEST(MODEL_TEST, BestModel) {
   b[0] = 0;
   b[1] = 0;
   model_ffm.Shrink();
-  // Test
+  // Test. The gradient cache is not in the record.
   for (index_t i = 0; i < model_ffm.GetNumParameter_w(); ++i) {
-    EXPECT_FLOAT_EQ(w[i], 1);
+    EXPECT_FLOAT_EQ(w[i], i % 2 == 0 ? 1 : 0);
   }
   for (index_t i = 0; i < model_ffm.GetNumParameter_v(); ++i) {
-    EXPECT_FLOAT_EQ(v[i], 2);
+    EXPECT_FLOAT_EQ(v[i], is_param_v(model_ffm, i) ? 2 : 0);
   }
   EXPECT_FLOAT_EQ(b[0], 3);
-  EXPECT_FLOAT_EQ(b[1], 3);
+  EXPECT_FLOAT_EQ(b[1], 0);
+}
+
+// Only the touched features are copied to the record
+TEST(MODEL_TEST, BestModel_Touch) {
+  HyperParam hyper_param = Init();
+  Model model_ffm;
+  model_ffm.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K, 2);
+  real_t* w = model_ffm.GetParameter_w();
+  real_t* v = model_ffm.GetParameter_v();
+  index_t vec_size = model_ffm.GetNumParameter_v() /
+                     hyper_param.num_feature;
+  model_ffm.SetBestModel();
+  // Feature 3 is touched and feature 5 is not
+  DMatrix matrix;
+  matrix.ResetMatrix(1);
+  matrix.AddNode(0, 3, 1.0, 0);
+  w[3*2] = 7;
+  w[5*2] = 9;
+  v[3*vec_size] = 7;
+  model_ffm.Touch(&matrix);
+  model_ffm.SetBestModel();
+  w[3*2] = 0;
+  v[3*vec_size] = 0;
+  model_ffm.Shrink();
+  EXPECT_FLOAT_EQ(w[3*2], 7);
+  EXPECT_FLOAT_EQ(v[3*vec_size], 7);
+  EXPECT_FLOAT_EQ(w[5*2], 0);
+}
+
+// The record is saved in background as a model without gradient cache
+TEST(MODEL_TEST, BestModel_File) {
+  HyperParam hyper_param = Init();
+  Model model_ffm;
+  model_ffm.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K, 2);
+  std::string filename = "./test_best_model.bin";
+  model_ffm.SetBestModelFile(filename);
+  model_ffm.GetParameter_w()[4*2] = 5;
+  model_ffm.SetBestModel();
+  model_ffm.WaitBestModel();
+  Model best(filename);
+  EXPECT_EQ(best.GetAuxiliarySize(), 1);
+  EXPECT_EQ(best.GetNumParameter_w(), hyper_param.num_feature);
+  EXPECT_EQ(best.GetNumParameter_v() * 2, model_ffm.GetNumParameter_v());
+  EXPECT_FLOAT_EQ(best.GetParameter_w()[4], 5);
+  // The parameters of v are in the same order
+  real_t* v = model_ffm.GetParameter_v();
+  real_t* best_v = best.GetParameter_v();
+  for (index_t i = 0, j = 0; i < model_ffm.GetNumParameter_v(); ++i) {
+    if (is_param_v(model_ffm, i)) {
+      EXPECT_FLOAT_EQ(v[i], best_v[j++]);
+    }
+  }
+  RemoveFile(filename.c_str());
+}
+
+TEST(MODEL_TEST, Init_with_pool) {
+  HyperParam hyper_param = Init();
+  Model model_ffm, model_pool;
+  model_ffm.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K,
+                    hyper_param.auxiliary_size);
+  ThreadPool pool(3);
+  model_pool.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K,
+                    hyper_param.auxiliary_size,
+                    1.0, &pool);
+  // The first touch does not change the value
+  for (index_t i = 0; i < model_ffm.GetNumParameter_w(); ++i) {
+    EXPECT_FLOAT_EQ(model_ffm.GetParameter_w()[i],
+                    model_pool.GetParameter_w()[i]);
+  }
+  for (index_t i = 0; i < model_ffm.GetNumParameter_v(); ++i) {
+    EXPECT_FLOAT_EQ(model_ffm.GetParameter_v()[i],
+                    model_pool.GetParameter_v()[i]);
+  }
+}
+
+TEST(MODEL_TEST, CopyFrom) {
+  HyperParam hyper_param = Init();
+  Model model_ffm;
+  model_ffm.Initialize(hyper_param.score_func,
+                    hyper_param.loss_func,
+                    hyper_param.num_feature,
+                    hyper_param.num_field,
+                    hyper_param.num_K,
+                    hyper_param.auxiliary_size);
+  real_t* v = model_ffm.GetParameter_v();
+  for (index_t i = 0; i < model_ffm.GetNumParameter_v(); ++i) {
+    v[i] = i;
+  }
+  model_ffm.GetParameter_w()[3] = 5;
+  model_ffm.GetParameter_b()[0] = 7;
+  ThreadPool pool(2);
+  Model copy;
+  for (int n = 0; n < 2; ++n) {
+    // The second copy reuses the memory
+    real_t* old_v = copy.GetParameter_v();
+    copy.CopyFrom(model_ffm, &pool);
+    if (n == 1) {
+      EXPECT_EQ(old_v, copy.GetParameter_v());
+    }
+    EXPECT_EQ(copy.GetScoreFunction(), hyper_param.score_func);
+    EXPECT_EQ(copy.GetNumParameter(), model_ffm.GetNumParameter());
+    EXPECT_EQ(copy.GetAlign(), model_ffm.GetAlign());
+    for (index_t i = 0; i < copy.GetNumParameter_v(); ++i) {
+      EXPECT_FLOAT_EQ(copy.GetParameter_v()[i], i);
+    }
+    EXPECT_FLOAT_EQ(copy.GetParameter_w()[3], 5);
+    EXPECT_FLOAT_EQ(copy.GetParameter_b()[0], 7);
+    EXPECT_FLOAT_EQ(copy.GetParameter_b()[1], 1.0);
+  }
+  // Copy a model of other shape
+  Model model_lr;
+  model_lr.Initialize("linear", "squared", 20, 0, 0, 3);
+  copy.CopyFrom(model_lr);
+  EXPECT_EQ(copy.GetNumParameter_w(), 60);
+  EXPECT_EQ(copy.GetNumParameter_v(), 0);
+  EXPECT_TRUE(copy.GetParameter_v() == nullptr);
 }
 
 }   // namespace xLearn
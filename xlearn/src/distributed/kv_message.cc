@@ -0,0 +1,102 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of kv_message.h.
+*/
+
+#include "src/distributed/kv_message.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+
+namespace xLearn {
+
+/* Header of the message on the wire */
+struct MessageHeader {
+  uint32 type;
+  uint32 table;
+  int32 worker_id;
+  int32 clock;
+  int32 staleness;
+  uint32 length;
+  uint64 num_key;
+  uint64 num_value;
+};
+
+// Write all the bytes, retry on the partial write
+static bool write_all(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t ret = send(fd, buf, len, MSG_NOSIGNAL);
+    if (ret < 0 && errno == EINTR) { continue; }
+    if (ret <= 0) { return false; }
+    buf += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+// Read all the bytes, retry on the partial read
+static bool read_all(int fd, char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t ret = recv(fd, buf, len, 0);
+    if (ret < 0 && errno == EINTR) { continue; }
+    if (ret <= 0) { return false; }
+    buf += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+bool WriteMessage(int fd, const KVMessage& msg) {
+  MessageHeader header;
+  header.type = msg.type;
+  header.table = msg.table;
+  header.worker_id = msg.worker_id;
+  header.clock = msg.clock;
+  header.staleness = msg.staleness;
+  header.length = msg.length;
+  header.num_key = msg.keys.size();
+  header.num_value = msg.values.size();
+  return write_all(fd, (const char*)&header, sizeof(header)) &&
+         write_all(fd, (const char*)msg.keys.data(),
+                   msg.keys.size() * sizeof(index_t)) &&
+         write_all(fd, (const char*)msg.values.data(),
+                   msg.values.size() * sizeof(real_t));
+}
+
+bool ReadMessage(int fd, KVMessage* msg) {
+  CHECK_NOTNULL(msg);
+  MessageHeader header;
+  if (!read_all(fd, (char*)&header, sizeof(header))) {
+    return false;
+  }
+  msg->type = header.type;
+  msg->table = header.table;
+  msg->worker_id = header.worker_id;
+  msg->clock = header.clock;
+  msg->staleness = header.staleness;
+  msg->length = header.length;
+  msg->keys.resize(header.num_key);
+  msg->values.resize(header.num_value);
+  return read_all(fd, (char*)msg->keys.data(),
+                  header.num_key * sizeof(index_t)) &&
+         read_all(fd, (char*)msg->values.data(),
+                  header.num_value * sizeof(real_t));
+}
+
+}  // namespace xLearn
@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the KVMessage, which is sent between the
+workers and the servers of the parameter server.
+*/
+
+#ifndef XLEARN_DISTRIBUTED_KV_MESSAGE_H_
+#define XLEARN_DISTRIBUTED_KV_MESSAGE_H_
+
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+
+namespace xLearn {
+
+/* Type of the request and the reply */
+enum KVMessageType {
+  kPushRequest = 0,   /* add the values to the store */
+  kPullRequest = 1,   /* get the values from the store */
+  kClockRequest = 2,  /* the worker finishes one mini-batch */
+  kDoneRequest = 3,   /* the worker will not push any more */
+  kBarrierRequest = 4,  /* wait for all the workers */
+  kFinishRequest = 5,   /* the worker disconnects */
+  kReply = 6
+};
+
+/* The store has a table for the scalar value (linear term
+and bias) and a table for the value list (latent factor) */
+enum KVTable {
+  kScalarTable = 0,
+  kListTable = 1
+};
+
+//------------------------------------------------------------------------------
+// KVMessage is a request from a worker to one server, or the reply of
+// the server. The keys are the local ids on that server (see
+// KVStore::FeatMap()), and each key has 'length' values:
+//
+//    key:    | k0 | k1 | k2 |
+//    value:  | v0[0..length) | v1[0..length) | v2[0..length) |
+//
+// The message is written to a socket as a fixed-size header followed
+// by the keys and the values.
+//------------------------------------------------------------------------------
+struct KVMessage {
+  /* KVMessageType */
+  uint32 type;
+  /* KVTable */
+  uint32 table;
+  /* Id of the worker */
+  int32 worker_id;
+  /* Clock of the worker, i.e., finished mini-batches */
+  int32 clock;
+  /* Max clock difference of the pull, -1 for no limit */
+  int32 staleness;
+  /* Number of values of each key */
+  uint32 length;
+  /* Local ids of the keys */
+  std::vector<index_t> keys;
+  /* Values of all the keys */
+  std::vector<real_t> values;
+
+  KVMessage()
+   : type(kReply), table(kScalarTable), worker_id(0),
+     clock(0), staleness(-1), length(1) { }
+
+  // Reset the message to a request of the given type,
+  // and keep the memory of keys and values.
+  void Reset(KVMessageType msg_type, uint32 msg_table = kScalarTable,
+             uint32 msg_length = 1) {
+    type = msg_type;
+    table = msg_table;
+    length = msg_length;
+    keys.clear();
+    values.clear();
+  }
+};
+
+// Write the message to a socket.
+// Return false if the connection is closed.
+bool WriteMessage(int fd, const KVMessage& msg);
+
+// Read a message from a socket.
+// Return false if the connection is closed.
+bool ReadMessage(int fd, KVMessage* msg);
+
+}  // namespace xLearn
+
+#endif  // XLEARN_DISTRIBUTED_KV_MESSAGE_H_
@@ -0,0 +1,163 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the KVServer class.
+*/
+
+#include "src/distributed/kv_server.h"
+
+#include <limits>
+#include <algorithm>
+
+namespace xLearn {
+
+/* Clock of the workers that will not push */
+static const int32 kInfiniteClock = std::numeric_limits<int32>::max();
+
+void KVServer::Initialize(int worker_num) {
+  CHECK_GT(worker_num, 0);
+  worker_num_ = worker_num;
+  clock_.assign(worker_num, 0);
+  length_[kScalarTable] = 1;
+  length_[kListTable] = 0;
+  table_[kScalarTable].clear();
+  table_[kListTable].clear();
+  finish_num_ = 0;
+  barrier_num_ = 0;
+  barrier_gen_ = 0;
+}
+
+void KVServer::Handle(const KVMessage& request, KVMessage* reply) {
+  CHECK_NOTNULL(reply);
+  CHECK_GE(request.worker_id, 0);
+  CHECK_LT(request.worker_id, worker_num_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  reply->Reset(kReply, request.table, request.length);
+  reply->worker_id = request.worker_id;
+  switch (request.type) {
+    case kPushRequest:
+      push(request);
+      break;
+    case kPullRequest:
+      pull(request, reply, lock);
+      break;
+    case kClockRequest:
+      if (clock_[request.worker_id] != kInfiniteClock) {
+        clock_[request.worker_id]++;
+      }
+      cond_.notify_all();
+      break;
+    case kDoneRequest:
+      clock_[request.worker_id] = kInfiniteClock;
+      cond_.notify_all();
+      break;
+    case kBarrierRequest:
+      barrier(lock);
+      break;
+    case kFinishRequest:
+      finish_num_++;
+      clock_[request.worker_id] = kInfiniteClock;
+      cond_.notify_all();
+      break;
+    default:
+      LOG(FATAL) << "Unknown request type: " << request.type;
+  }
+  reply->clock = min_clock();
+}
+
+bool KVServer::Finished() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return finish_num_ >= worker_num_;
+}
+
+size_t KVServer::TableSize(KVTable table) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return table_[table].size();
+}
+
+// The length of the list table is given by the first request
+void KVServer::check_table(const KVMessage& request) {
+  CHECK_LE(request.table, kListTable);
+  CHECK_GT(request.length, 0);
+  if (length_[request.table] == 0) {
+    length_[request.table] = request.length;
+  }
+  CHECK_EQ(length_[request.table], request.length);
+}
+
+// Add the values to the table, which grows to the max key
+void KVServer::push(const KVMessage& request) {
+  check_table(request);
+  size_t len = request.length;
+  CHECK_EQ(request.keys.size() * len, request.values.size());
+  std::vector<real_t>& table = table_[request.table];
+  for (size_t i = 0; i < request.keys.size(); ++i) {
+    size_t offset = (size_t)request.keys[i] * len;
+    if (offset + len > table.size()) {
+      table.resize(offset + len, 0);
+    }
+    const real_t* value = request.values.data() + i * len;
+    for (size_t j = 0; j < len; ++j) {
+      table[offset + j] += value[j];
+    }
+  }
+}
+
+// Wait for the slow workers, and copy the values to the reply
+void KVServer::pull(const KVMessage& request, KVMessage* reply,
+                    std::unique_lock<std::mutex>& lock) {
+  check_table(request);
+  if (request.staleness >= 0) {
+    int32 target = request.clock - request.staleness;
+    cond_.wait(lock, [this, target]() {
+      return min_clock() >= target;
+    });
+  }
+  size_t len = request.length;
+  const std::vector<real_t>& table = table_[request.table];
+  reply->values.resize(request.keys.size() * len);
+  for (size_t i = 0; i < request.keys.size(); ++i) {
+    size_t offset = (size_t)request.keys[i] * len;
+    real_t* value = reply->values.data() + i * len;
+    for (size_t j = 0; j < len; ++j) {
+      value[j] = offset + j < table.size() ? table[offset + j] : 0;
+    }
+  }
+}
+
+// Wait until all the workers arrive at the barrier
+void KVServer::barrier(std::unique_lock<std::mutex>& lock) {
+  int gen = barrier_gen_;
+  if (++barrier_num_ == worker_num_) {
+    barrier_num_ = 0;
+    barrier_gen_++;
+    cond_.notify_all();
+    return;
+  }
+  cond_.wait(lock, [this, gen]() { return barrier_gen_ != gen; });
+}
+
+int32 KVServer::min_clock() const {
+  int32 clock = kInfiniteClock;
+  for (size_t i = 0; i < clock_.size(); ++i) {
+    clock = std::min(clock, clock_[i]);
+  }
+  return clock;
+}
+
+}  // namespace xLearn
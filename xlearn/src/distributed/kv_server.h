@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the KVServer class, which stores one shard
+of the model parameters for the parameter server.
+*/
+
+#ifndef XLEARN_DISTRIBUTED_KV_SERVER_H_
+#define XLEARN_DISTRIBUTED_KV_SERVER_H_
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+#include "src/distributed/kv_message.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// KVServer is one shard of the KVStore. It keeps the values of the
+// keys that are mapped to this server, in a dense array indexed by the
+// local id of the key. The values of the keys that are never pushed
+// are zero. The server handles the requests of all the workers:
+//
+//   Push:     values[key] += pushed value
+//   Pull:     return values[key], after all the workers have reached
+//             (clock - staleness) if staleness >= 0
+//   Clock:    the worker finishes one mini-batch
+//   Done:     the worker will not push, so its clock is infinite
+//   Barrier:  wait until all the workers arrive
+//   Finish:   the worker disconnects
+//
+// The pushed values are the changes of the parameters made by the
+// workers, so the store keeps the sum of all the updates. The Pull
+// of a fast worker waits for the slow workers (bounded staleness),
+// and there is no wait if the staleness is -1 (asynchronous).
+//
+//   KVServer server;
+//   server.Initialize(2);  /* 2 workers */
+//   KVMessage request, reply;
+//   server.Handle(request, &reply);
+//
+// Handle() can be called by many threads at the same time, one for
+// each connection of the workers.
+//------------------------------------------------------------------------------
+class KVServer {
+ public:
+  // Constructor and Destructor
+  KVServer() : worker_num_(0), finish_num_(0),
+               barrier_num_(0), barrier_gen_(0) { }
+  ~KVServer() { }
+
+  // Invoke this function before we use this class.
+  void Initialize(int worker_num);
+
+  // Handle a request and fill the reply.
+  void Handle(const KVMessage& request, KVMessage* reply);
+
+  // Have all the workers disconnected ?
+  bool Finished();
+
+  // Number of values in the table
+  size_t TableSize(KVTable table);
+
+ protected:
+  /* Number of workers */
+  int worker_num_;
+  /* Values of the scalar table and the list table */
+  std::vector<real_t> table_[2];
+  /* Number of values of each key */
+  uint32 length_[2];
+  /* Clock of each worker */
+  std::vector<int32> clock_;
+  /* Number of the finished workers */
+  int finish_num_;
+  /* Workers in current barrier */
+  int barrier_num_;
+  /* Generation of the barrier */
+  int barrier_gen_;
+  /* Lock of all the states */
+  std::mutex mutex_;
+  std::condition_variable cond_;
+
+  void push(const KVMessage& request);
+  void pull(const KVMessage& request, KVMessage* reply,
+            std::unique_lock<std::mutex>& lock);
+  void barrier(std::unique_lock<std::mutex>& lock);
+
+  // Min clock of all the workers
+  int32 min_clock() const;
+
+  // Check the table and the length of a request
+  void check_table(const KVMessage& request);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(KVServer);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_DISTRIBUTED_KV_SERVER_H_
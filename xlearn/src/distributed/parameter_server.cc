@@ -14,6 +14,7 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
+
 /*
 This file is the implementation of KVStore.
 */
@@ -22,60 +23,152 @@ This file is the implementation of KVStore.
 
 namespace xLearn {
 
+// Initial KVStore
+void KVStore::Initialize(size_t server_num,
+                         Transport* transport,
+                         int worker_id,
+                         int staleness) {
+  CHECK_GT(server_num, 0);
+  CHECK_GE(worker_id, 0);
+  CHECK_GE(staleness, -1);
+  if (transport != nullptr) {
+    CHECK_EQ(transport->ServerNumber(), server_num);
+  }
+  server_num_ = server_num;
+  transport_ = transport;
+  worker_id_ = worker_id;
+  staleness_ = staleness;
+  clock_ = 0;
+  request_.resize(server_num);
+  reply_.resize(server_num);
+  position_.resize(server_num);
+}
+
+// Split the keys to the requests of their servers. The
+// position of each key is kept to merge the pulled values.
+void KVStore::split(const std::vector<index_t>& key,
+                    const std::vector<real_t>* value,
+                    size_t length,
+                    KVMessageType type,
+                    KVTable table) {
+  CHECK_NOTNULL(transport_);
+  CHECK_GT(length, 0);
+  for (size_t s = 0; s < server_num_; ++s) {
+    request_[s].Reset(type, table, length);
+    request_[s].worker_id = worker_id_;
+    request_[s].clock = clock_;
+    request_[s].staleness = staleness_;
+    position_[s].clear();
+  }
+  for (size_t i = 0; i < key.size(); ++i) {
+    size_t s = GetServerId(key[i]);
+    request_[s].keys.push_back(FeatMap(key[i]));
+    position_[s].push_back(i);
+    if (value != nullptr) {
+      const real_t* v = value->data() + i * length;
+      request_[s].values.insert(request_[s].values.end(),
+                                v, v + length);
+    }
+  }
+}
+
 // Push a list of (key, value) into store.
-// For example:
-//  ------------------------------------------------------
-// |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-// | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-//  ------------------------------------------------------
 void KVStore::Push(const std::vector<index_t>& key,
-   	               const std::vector<real_t>& value) {
- // TODO(chao)
+                   const std::vector<real_t>& value) {
+  push(key, value, 1, kScalarTable);
 }
 
 // Push a list of (key, value_list) into store.
-// For example:
-//  ------------------------------------------------------
-// |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-// | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-// |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
-// |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
-// |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
-// |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
-//  ------------------------------------------------------
-// This method is useful for the FM and FFM task.
 void KVStore::Push(const std::vector<index_t>& key,
-   	               const std::vector<real_t>& value_list,
-   	               const size_t length) {
- // TODO(chao)
+                   const std::vector<real_t>& value_list,
+                   const size_t length) {
+  push(key, value_list, length, kListTable);
 }
 
 // Pull the values for a list of keys from store.
-// For example:
-//  ------------------------------------------------------
-// |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-// | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-//  ------------------------------------------------------
 void KVStore::Pull(const std::vector<index_t>& key,
-   	               std::vector<real_t>* value) {
-  // TODO(chao)
+                   std::vector<real_t>* value) {
+  pull(key, value, 1, kScalarTable);
 }
 
 // Pull the value list for a list of keys from store.
-// For example:
-//  ------------------------------------------------------
-// |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-// | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-// |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
-// |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
-// |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
-// |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
-//  ------------------------------------------------------
-// This method is useful for the FM and FFM task.
 void KVStore::Pull(const std::vector<index_t>& key,
-   	               std::vector<real_t>* value_list,
-   	               const size_t length) {
- // TODO(Chao)
+                   std::vector<real_t>* value_list,
+                   const size_t length) {
+  pull(key, value_list, length, kListTable);
+}
+
+void KVStore::push(const std::vector<index_t>& key,
+                   const std::vector<real_t>& value,
+                   size_t length,
+                   KVTable table) {
+  CHECK_EQ(key.size() * length, value.size());
+  split(key, &value, length, kPushRequest, table);
+  for (size_t s = 0; s < server_num_; ++s) {
+    if (request_[s].keys.empty()) { continue; }
+    transport_->Request(s, request_[s], &reply_[s]);
+  }
+}
+
+// The values of each server are copied to the
+// positions of their keys in the key list.
+void KVStore::pull(const std::vector<index_t>& key,
+                   std::vector<real_t>* value,
+                   size_t length,
+                   KVTable table) {
+  CHECK_NOTNULL(value);
+  split(key, nullptr, length, kPullRequest, table);
+  value->resize(key.size() * length);
+  for (size_t s = 0; s < server_num_; ++s) {
+    if (request_[s].keys.empty()) { continue; }
+    transport_->Request(s, request_[s], &reply_[s]);
+    const std::vector<real_t>& values = reply_[s].values;
+    const std::vector<size_t>& position = position_[s];
+    CHECK_EQ(values.size(), position.size() * length);
+    for (size_t j = 0; j < position.size(); ++j) {
+      real_t* dst = value->data() + position[j] * length;
+      const real_t* src = values.data() + j * length;
+      for (size_t d = 0; d < length; ++d) {
+        dst[d] = src[d];
+      }
+    }
+  }
+}
+
+// Send the same request to all the servers
+void KVStore::broadcast(KVMessageType type) {
+  CHECK_NOTNULL(transport_);
+  for (size_t s = 0; s < server_num_; ++s) {
+    request_[s].Reset(type);
+    request_[s].worker_id = worker_id_;
+    request_[s].clock = clock_;
+    transport_->Request(s, request_[s], &reply_[s]);
+  }
+}
+
+// Current worker finishes one mini-batch
+void KVStore::Clock() {
+  broadcast(kClockRequest);
+  clock_++;
+}
+
+// Current worker will not push any more
+void KVStore::Done() {
+  broadcast(kDoneRequest);
+}
+
+// All the servers see the same workers, so
+// the barrier of the first server is enough.
+void KVStore::Barrier() {
+  CHECK_NOTNULL(transport_);
+  request_[0].Reset(kBarrierRequest);
+  request_[0].worker_id = worker_id_;
+  transport_->Request(0, request_[0], &reply_[0]);
+}
+
+// Disconnect from the servers
+void KVStore::Finish() {
+  broadcast(kFinishRequest);
 }
 
 //------------------------------------------------------------------------------
@@ -111,4 +204,4 @@ index_t KVStore::FeatMap(const index_t feat_id) const {
   return feat_id / server_num_;
 }
 
-}  // namespace xLearn
\ No newline at end of file
+}  // namespace xLearn
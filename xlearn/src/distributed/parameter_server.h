@@ -14,6 +14,7 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
+
 /*
 This file defines the KVStore class, which allows workers 
 to get and set the model parameters.
@@ -26,108 +27,183 @@ to get and set the model parameters.
 
 #include "src/base/common.h"
 #include "src/data/data_structure.h"
+#include "src/distributed/kv_message.h"
+#include "src/distributed/transport.h"
 
 namespace xLearn {
 
 //------------------------------------------------------------------------------
 // KVStore are used for distributed training and it allows workers to get
-// and set the model parameters by using pull() and push() API.
+// and set the model parameters by using pull() and push() API. The keys
+// are sharded on the servers (see GetServerId()), and each Push() or
+// Pull() sends one batched request to each server by the Transport.
+// The scalar values (linear term) and the value lists (latent factor)
+// are stored in two different tables:
+//
+//   SocketTransport transport;
+//   transport.Connect("/tmp/xlearn_ps", server_num);
+//   KVStore store;
+//   store.Initialize(server_num, &transport, worker_id, staleness);
+//
+//   store.Pull(key, &value);        /* get the current values */
+//   ... train on the values ...
+//   store.Push(key, delta);         /* add the changes to the store */
+//   store.Clock();                  /* finish one mini-batch */
+//
+// The pushed values are added to the values in store. If staleness
+// is not -1, the Pull() of a worker at clock c waits until all the
+// workers have finished (c - staleness) mini-batches (bounded
+// staleness). Otherwise, the workers never wait (asynchronous).
 //------------------------------------------------------------------------------
 class KVStore {
  public:
-   // Constructor and Destructor
-   KVStore() { }
-   ~KVStore() { }
-
-   // Initial KVStore. 
-   // Invoke this function before we use it.
-   virtual void Initialize(size_t server_num) {
-   	 CHECK_GT(server_num, 0);
-     server_num_ = server_num;
-   }
-
-   // Push a list of (key, value) into store.
-   // For example:
-   //  ------------------------------------------------------
-   // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-   // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-   //  ------------------------------------------------------
-   virtual void Push(const std::vector<index_t>& key, 
-   	               const std::vector<real_t>& value);
-
-   // Push a list of (key, value_list) into store.
-   // For example:
-   //  ------------------------------------------------------
-   // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-   // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-   // |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
-   // |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
-   // |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
-   // |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
-   //  ------------------------------------------------------
-   // This method is useful for the FM and FFM task.
-   virtual void Push(const std::vector<index_t>& key, 
-   	               const std::vector<real_t>& value_list, 
-   	               const size_t length);
-
-   // Pull the values for a list of keys from store.
-   // For example:
-   //  ------------------------------------------------------
-   // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-   // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-   //  ------------------------------------------------------
-   virtual void Pull(const std::vector<index_t>& key, 
-   	               std::vector<real_t>* value);
-
-   // Pull the value list for a list of keys from store.
-   // For example:
-   //  ------------------------------------------------------
-   // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
-   // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
-   // |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
-   // |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
-   // |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
-   // |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
-   //  ------------------------------------------------------
-   // This method is useful for the FM and FFM task.
-   virtual void Pull(const std::vector<index_t>& key, 
-   	               std::vector<real_t>* value_list, 
-   	               const size_t length);
-
-   //---------------------------------------------------------------------------
-   // In xLearn, we use a simple range strategy for model partiton
-   // on parameter server. For example, we have 10 features and 3 
-   // server nodes.
-   //
-   //  ---------------------------------------
-   // | 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9 |
-   //  ---------------------------------------
-   //   |   |   |   |   |   |   |   |   |   |
-   //  s1  s2  s3  s1  s2  s3  s1  s2  s3  s1
-   //
-   // On each local server:
-   //
-   //        s0                  s1               s2
-   //  ---------------      -----------      -----------
-   // | 0 | 1 | 2 | 3 |    | 0 | 1 | 2 |    | 0 | 1 | 2 |
-   //  ---------------      -----------      -----------
-   //   |   |   |   |        |   |   |        |   |   |
-   //   0   3   6   9        1   4   7        2   5   8
-   //---------------------------------------------------------------------------
-
-   // Given a feature id, return the server id
-   virtual size_t GetServerId(const index_t feat_id) const;
-
-   // Mapping the global feature id to a local feature id
-   virtual index_t FeatMap(const index_t feat_id) const;
+  // Constructor and Destructor
+  KVStore() : server_num_(0), transport_(nullptr), worker_id_(0),
+              staleness_(-1), clock_(0) { }
+  ~KVStore() { }
+
+  // Initial KVStore. 
+  // Invoke this function before we use it.
+  // The transport can be nullptr if we only use the key mapping.
+  void Initialize(size_t server_num,
+                  Transport* transport = nullptr,
+                  int worker_id = 0,
+                  int staleness = -1);
+
+  // Push a list of (key, value) into store.
+  // For example:
+  //  ------------------------------------------------------
+  // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
+  // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
+  //  ------------------------------------------------------
+  void Push(const std::vector<index_t>& key, 
+            const std::vector<real_t>& value);
+
+  // Push a list of (key, value_list) into store.
+  // For example:
+  //  ------------------------------------------------------
+  // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
+  // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
+  // |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
+  // |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
+  // |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
+  // |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
+  //  ------------------------------------------------------
+  // This method is useful for the FM and FFM task. The value
+  // list of key[i] is value_list[i*length, (i+1)*length).
+  void Push(const std::vector<index_t>& key, 
+            const std::vector<real_t>& value_list, 
+            const size_t length);
+
+  // Pull the values for a list of keys from store.
+  // For example:
+  //  ------------------------------------------------------
+  // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
+  // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
+  //  ------------------------------------------------------
+  void Pull(const std::vector<index_t>& key, 
+            std::vector<real_t>* value);
+
+  // Pull the value list for a list of keys from store.
+  // For example:
+  //  ------------------------------------------------------
+  // |  key:   |  0  |  2  |  4  |  5  |  6   |  7   |  9   |
+  // | value:  | 0.2 | 1.0 | 0.5 | 1.0 | 0.33 |  0.7 |  0.8 |
+  // |         | 0.1 | 1.2 | 0.1 | 0.8 | 0.9  |  1.0 |  0.5 |
+  // |         | 0.5 | 1.4 | 1.7 | 1.5 | 0.8  |  0.7 |  0.6 |
+  // |         | 0.2 | 1.2 | 1.4 | 1.8 | 0.5  |  1.1 |  1.8 |
+  // |         | ..  | ..  | ..  | ..  | ..   |  ..  |  ..  |
+  //  ------------------------------------------------------
+  // This method is useful for the FM and FFM task.
+  void Pull(const std::vector<index_t>& key, 
+            std::vector<real_t>* value_list, 
+            const size_t length);
+
+  // Current worker finishes one mini-batch.
+  void Clock();
+
+  // Current worker will not push any more, so the
+  // other workers don't wait for it.
+  void Done();
+
+  // Wait until all the workers call Barrier().
+  void Barrier();
+
+  // Disconnect from the servers. The servers exit after
+  // all the workers call Finish().
+  void Finish();
+
+  // Number of finished mini-batches of current worker
+  int GetClock() const { return clock_; }
+
+  //---------------------------------------------------------------------------
+  // In xLearn, we use a simple range strategy for model partiton
+  // on parameter server. For example, we have 10 features and 3 
+  // server nodes.
+  //
+  //  ---------------------------------------
+  // | 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9 |
+  //  ---------------------------------------
+  //   |   |   |   |   |   |   |   |   |   |
+  //  s0  s1  s2  s0  s1  s2  s0  s1  s2  s0
+  //
+  // On each local server:
+  //
+  //        s0                  s1               s2
+  //  ---------------      -----------      -----------
+  // | 0 | 1 | 2 | 3 |    | 0 | 1 | 2 |    | 0 | 1 | 2 |
+  //  ---------------      -----------      -----------
+  //   |   |   |   |        |   |   |        |   |   |
+  //   0   3   6   9        1   4   7        2   5   8
+  //---------------------------------------------------------------------------
+
+  // Given a feature id, return the server id
+  size_t GetServerId(const index_t feat_id) const;
+
+  // Mapping the global feature id to a local feature id
+  index_t FeatMap(const index_t feat_id) const;
 
  private:
   /* The number of server */
   size_t server_num_;  
+  /* Connection to the servers */
+  Transport* transport_;
+  /* Id of current worker */
+  int worker_id_;
+  /* Max clock difference, -1 for asynchronous */
+  int staleness_;
+  /* Number of finished mini-batches */
+  int clock_;
+  /* Request and reply of each server, which
+  are reused to avoid the memory allocation */
+  std::vector<KVMessage> request_;
+  std::vector<KVMessage> reply_;
+  /* Position of the keys of each server in the key list */
+  std::vector<std::vector<size_t> > position_;
+
+  // Split the keys (and values) into the requests of servers
+  void split(const std::vector<index_t>& key,
+             const std::vector<real_t>* value,
+             size_t length,
+             KVMessageType type,
+             KVTable table);
+
+  // Push and pull the values of the table
+  void push(const std::vector<index_t>& key,
+            const std::vector<real_t>& value,
+            size_t length,
+            KVTable table);
+  void pull(const std::vector<index_t>& key,
+            std::vector<real_t>* value,
+            size_t length,
+            KVTable table);
+
+  // Send the same request to all the servers
+  void broadcast(KVMessageType type);
 
   DISALLOW_COPY_AND_ASSIGN(KVStore);
 };
 
 }  // namespace xLearn
 
-#endif  // XLEARN_DISTRIBUTED_KVSTORE_H_
\ No newline at end of file
+#endif  // XLEARN_DISTRIBUTED_KVSTORE_H_
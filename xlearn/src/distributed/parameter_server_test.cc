@@ -20,7 +20,14 @@ This file tests the KVStore class file
 
 #include "gtest/gtest.h"
 
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
 #include "src/distributed/parameter_server.h"
+#include "src/distributed/kv_server.h"
+#include "src/distributed/transport.h"
 
 namespace xLearn {
 
@@ -54,4 +61,147 @@ TEST(KVStoreTest, FeatMap) {
   EXPECT_EQ(store.FeatMap((index_t)9), (index_t)3);
 }
 
-}  // namespace xLearn
\ No newline at end of file
+// Create server_num servers for worker_num workers
+std::vector<KVServer*> create_servers(size_t server_num, int worker_num) {
+  std::vector<KVServer*> servers;
+  for (size_t i = 0; i < server_num; ++i) {
+    servers.push_back(new KVServer());
+    servers.back()->Initialize(worker_num);
+  }
+  return servers;
+}
+
+void delete_servers(std::vector<KVServer*>& servers) {
+  for (size_t i = 0; i < servers.size(); ++i) {
+    delete servers[i];
+  }
+  servers.clear();
+}
+
+TEST(KVStoreTest, Push_Pull) {
+  std::vector<KVServer*> servers = create_servers(3, 1);
+  LocalTransport transport(servers);
+  KVStore store;
+  store.Initialize(3, &transport);
+  std::vector<index_t> key = { 0, 2, 4, 5, 6, 7, 9 };
+  std::vector<real_t> value = { 0.2, 1.0, 0.5, 1.0, 0.33, 0.7, 0.8 };
+  store.Push(key, value);
+  // The pushed values are added, and the
+  // values of the new keys are zero
+  store.Push(key, value);
+  std::vector<index_t> pull_key = { 9, 1, 0, 7 };
+  std::vector<real_t> result;
+  store.Pull(pull_key, &result);
+  ASSERT_EQ(result.size(), pull_key.size());
+  EXPECT_FLOAT_EQ(result[0], 1.6);
+  EXPECT_FLOAT_EQ(result[1], 0);
+  EXPECT_FLOAT_EQ(result[2], 0.4);
+  EXPECT_FLOAT_EQ(result[3], 1.4);
+  // Key 9 is the local key 3 of server 0
+  EXPECT_EQ(servers[0]->TableSize(kScalarTable), 4);
+  delete_servers(servers);
+}
+
+TEST(KVStoreTest, Push_Pull_List) {
+  std::vector<KVServer*> servers = create_servers(2, 1);
+  LocalTransport transport(servers);
+  KVStore store;
+  store.Initialize(2, &transport);
+  const size_t length = 4;
+  std::vector<index_t> key = { 3, 0, 8, 5 };
+  std::vector<real_t> value_list(key.size() * length);
+  for (size_t i = 0; i < value_list.size(); ++i) {
+    value_list[i] = i * 0.5;
+  }
+  store.Push(key, value_list, length);
+  // The list table is not the scalar table
+  std::vector<real_t> scalar(key.size(), 1.0);
+  store.Push(key, scalar);
+  std::vector<real_t> result;
+  store.Pull(key, &result, length);
+  ASSERT_EQ(result.size(), value_list.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_FLOAT_EQ(result[i], value_list[i]);
+  }
+  store.Pull(key, &result);
+  ASSERT_EQ(result.size(), key.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_FLOAT_EQ(result[i], 1.0);
+  }
+  delete_servers(servers);
+}
+
+// Worker 0 cannot be more than one clock ahead of
+// worker 1 with staleness 1.
+TEST(KVStoreTest, Bounded_Staleness) {
+  std::vector<KVServer*> servers = create_servers(2, 2);
+  LocalTransport transport(servers);
+  std::atomic<int> slow_clock(0);
+  std::atomic<int> max_gap(0);
+  const int kClock = 20;
+  std::vector<index_t> key = { 1, 2 };
+  std::thread fast([&]() {
+    KVStore store;
+    store.Initialize(2, &transport, 0, 1);
+    std::vector<real_t> value;
+    for (int c = 0; c < kClock; ++c) {
+      store.Pull(key, &value);
+      int gap = store.GetClock() - slow_clock.load();
+      if (gap > max_gap.load()) { max_gap = gap; }
+      store.Push(key, std::vector<real_t>(2, 1.0));
+      store.Clock();
+    }
+    store.Done();
+  });
+  std::thread slow([&]() {
+    KVStore store;
+    store.Initialize(2, &transport, 1, 1);
+    std::vector<real_t> value;
+    for (int c = 0; c < kClock; ++c) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      store.Pull(key, &value);
+      store.Push(key, std::vector<real_t>(2, 1.0));
+      slow_clock++;
+      store.Clock();
+    }
+    store.Done();
+  });
+  fast.join();
+  slow.join();
+  EXPECT_LE(max_gap.load(), 1);
+  // All the pushes are in the store
+  KVStore store;
+  store.Initialize(2, &transport);
+  std::vector<real_t> value;
+  store.Pull(key, &value);
+  EXPECT_FLOAT_EQ(value[0], kClock * 2);
+  EXPECT_FLOAT_EQ(value[1], kClock * 2);
+  delete_servers(servers);
+}
+
+TEST(KVStoreTest, Barrier_Finish) {
+  std::vector<KVServer*> servers = create_servers(2, 3);
+  LocalTransport transport(servers);
+  std::atomic<int> arrived(0);
+  std::atomic<bool> passed_early(false);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < 3; ++w) {
+    threads.push_back(std::thread([&, w]() {
+      KVStore store;
+      store.Initialize(2, &transport, w);
+      arrived++;
+      store.Barrier();
+      if (arrived.load() != 3) { passed_early = true; }
+      store.Finish();
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  EXPECT_FALSE(passed_early.load());
+  EXPECT_TRUE(servers[0]->Finished());
+  EXPECT_TRUE(servers[1]->Finished());
+  delete_servers(servers);
+}
+
+}  // namespace xLearn
@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the PSWorker class.
+*/
+
+#include "src/distributed/ps_worker.h"
+
+#include <algorithm>
+
+namespace xLearn {
+
+/* Number of features of each request of the whole model */
+static const index_t kModelChunk = 65536;
+
+void PSWorker::Initialize(KVStore* store,
+                          int worker_id,
+                          int worker_num,
+                          index_t batch_size) {
+  CHECK_NOTNULL(store);
+  CHECK_GT(worker_num, 0);
+  CHECK_GE(worker_id, 0);
+  CHECK_LT(worker_id, worker_num);
+  CHECK_GT(batch_size, 0);
+  store_ = store;
+  worker_id_ = worker_id;
+  worker_num_ = worker_num;
+  batch_size_ = batch_size;
+  batch_count_ = 0;
+}
+
+// The latent factor of a feature is one vector for fm,
+// and one vector for each field for ffm.
+size_t PSWorker::latent_length(Model& model) {
+  const std::string& score = model.GetScoreFunction();
+  if (score.compare("fm") == 0) {
+    return model.GetNumK();
+  } else if (score.compare("ffm") == 0) {
+    return model.GetNumField() * model.GetNumK();
+  }
+  return 0;
+}
+
+// The bias is the last value of w_value_
+template <typename Func>
+void PSWorker::for_each_param(Model& model, Func func) {
+  real_t* w = model.GetParameter_w();
+  index_t aux_size = (index_t)model.GetAuxiliarySize();
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    func(w_value_[i], w[keys_[i] * aux_size]);
+  }
+  func(w_value_[keys_.size()], model.GetParameter_b()[0]);
+  size_t length = latent_length(model);
+  if (length == 0) { return; }
+  // Each feature has num_block vectors of K values,
+  // which are align0 floats apart in the model.
+  index_t num_K = model.GetNumK();
+  index_t num_block = length / num_K;
+  index_t align0 = model.get_aligned_k() * aux_size;
+  // The ffm vectors interleave the values and the gradient
+  // cache in the chunks of align values, while the fm
+  // vectors keep the K values in front of the cache.
+  bool is_ffm = model.GetScoreFunction().compare("ffm") == 0;
+  index_t align = model.GetAlign();
+  real_t* v = model.GetParameter_v();
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    real_t* value = v_value_.data() + i * length;
+    for (index_t b = 0; b < num_block; ++b) {
+      real_t* param = v + ((size_t)keys_[i] * num_block + b) * align0;
+      for (index_t d = 0; d < num_K; ++d) {
+        index_t pos = is_ffm ?
+          d / align * align * aux_size + d % align : d;
+        func(*value++, param[pos]);
+      }
+    }
+  }
+}
+
+// The features are sorted, so the model is accessed in order
+void PSWorker::collect_keys(const DMatrix& batch, Model& model) {
+  index_t num_feat = model.GetNumFeature();
+  if (mark_.size() < num_feat) { mark_.resize(num_feat, 0); }
+  keys_.clear();
+  for (index_t i = 0; i < batch.row_length; ++i) {
+    const SparseRow& row = batch.row[i];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      index_t feat = it->feat_id;
+      if (feat < num_feat && !mark_[feat]) {
+        mark_[feat] = 1;
+        keys_.push_back(feat);
+      }
+    }
+  }
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    mark_[keys_[i]] = 0;
+  }
+  std::sort(keys_.begin(), keys_.end());
+}
+
+void PSWorker::pull(Model& model) {
+  w_keys_.assign(keys_.begin(), keys_.end());
+  w_keys_.push_back(model.GetNumFeature());
+  store_->Pull(w_keys_, &w_value_);
+  size_t length = latent_length(model);
+  if (length > 0) {
+    store_->Pull(keys_, &v_value_, length);
+  }
+  for_each_param(model, [](real_t& value, real_t& param) {
+    param = value;
+  });
+}
+
+void PSWorker::push(Model& model) {
+  for_each_param(model, [](real_t& value, real_t& param) {
+    value = param - value;
+  });
+  store_->Push(w_keys_, w_value_);
+  size_t length = latent_length(model);
+  if (length > 0) {
+    store_->Push(keys_, v_value_, length);
+  }
+}
+
+// Worker 0 pushes the model by chunks of features
+void PSWorker::InitModel(Model& model) {
+  CHECK_NOTNULL(store_);
+  if (worker_id_ == 0) {
+    index_t num_feat = model.GetNumFeature();
+    size_t length = latent_length(model);
+    for (index_t begin = 0; begin < num_feat; begin += kModelChunk) {
+      index_t end = std::min(num_feat, begin + kModelChunk);
+      keys_.clear();
+      for (index_t j = begin; j < end; ++j) {
+        keys_.push_back(j);
+      }
+      w_keys_.assign(keys_.begin(), keys_.end());
+      w_keys_.push_back(num_feat);
+      w_value_.resize(w_keys_.size());
+      v_value_.resize(keys_.size() * length);
+      for_each_param(model, [](real_t& value, real_t& param) {
+        value = param;
+      });
+      // The bias is pushed only once
+      if (begin != 0) { w_value_.back() = 0; }
+      store_->Push(w_keys_, w_value_);
+      if (length > 0) {
+        store_->Push(keys_, v_value_, length);
+      }
+    }
+  }
+  store_->Barrier();
+}
+
+// Each worker trains every worker_num-th mini-batch
+void PSWorker::CalcGrad(DMatrix* matrix, Model& model, Loss* loss) {
+  CHECK_NOTNULL(store_);
+  CHECK_NOTNULL(matrix);
+  CHECK_NOTNULL(loss);
+  index_t batch_size = std::min(batch_size_, matrix->row_length);
+  matrix->pos = 0;
+  for (;;) {
+    batch_.ResetMatrix(batch_size);
+    index_t len = matrix->GetMiniBatch(batch_size, batch_);
+    if (len == 0) { break; }
+    size_t count = batch_count_++;
+    if (count % worker_num_ != (size_t)worker_id_) { continue; }
+    batch_.row_length = len;
+    collect_keys(batch_, model);
+    pull(model);
+    loss->CalcGrad(&batch_, model);
+    push(model);
+    store_->Clock();
+  }
+}
+
+// Pull the model by chunks of features
+void PSWorker::PullModel(Model& model) {
+  CHECK_NOTNULL(store_);
+  index_t num_feat = model.GetNumFeature();
+  for (index_t begin = 0; begin < num_feat; begin += kModelChunk) {
+    index_t end = std::min(num_feat, begin + kModelChunk);
+    keys_.clear();
+    for (index_t j = begin; j < end; ++j) {
+      keys_.push_back(j);
+    }
+    pull(model);
+  }
+}
+
+// After Done(), the workers don't wait for each other in Pull(),
+// so the barrier cannot be blocked by a bounded-staleness Pull().
+void PSWorker::Finish(Model& model) {
+  CHECK_NOTNULL(store_);
+  store_->Done();
+  store_->Barrier();
+  if (worker_id_ == 0) {
+    PullModel(model);
+  }
+  store_->Finish();
+}
+
+}  // namespace xLearn
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the PSWorker class, which trains a model
+with the parameters stored in the KVStore.
+*/
+
+#ifndef XLEARN_DISTRIBUTED_PS_WORKER_H_
+#define XLEARN_DISTRIBUTED_PS_WORKER_H_
+
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/distributed/parameter_server.h"
+#include "src/loss/loss.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// PSWorker is one of the workers of a distributed training. Every
+// worker has a full local Model, but the shared parameters are in the
+// KVStore. The data is split into mini-batches, and each worker trains
+// every worker_num-th mini-batch:
+//
+//   (1) Pull the linear weights, the bias and the latent factors of
+//       the features in the mini-batch into the local model.
+//   (2) Train the mini-batch on the local model by Loss::CalcGrad().
+//   (3) Push the changes of these parameters to the KVStore, and
+//       finish one clock.
+//
+// The optimizer states (e.g., the sum of squared gradients of adagrad)
+// are not shared, so each worker keeps its own states.
+//
+//   PSWorker worker;
+//   worker.Initialize(&store, worker_id, worker_num, batch_size);
+//   worker.InitModel(model);   /* the model of worker 0 is shared */
+//   for (int n = 0; n < epoch; ++n) {
+//     worker.CalcGrad(matrix, model, loss);
+//     worker.PullModel(model);  /* for the evaluation */
+//   }
+//   worker.Finish(model);      /* worker 0 gets the final model */
+//------------------------------------------------------------------------------
+class PSWorker {
+ public:
+  // Constructor and Destructor
+  PSWorker() : store_(nullptr), worker_id_(0), worker_num_(1),
+               batch_size_(0), batch_count_(0) { }
+  ~PSWorker() { }
+
+  // Invoke this function before we use this class.
+  void Initialize(KVStore* store,
+                  int worker_id,
+                  int worker_num,
+                  index_t batch_size);
+
+  // Worker 0 pushes its model as the initial model,
+  // and the other workers wait for it.
+  void InitModel(Model& model);
+
+  // Train the mini-batches of current worker in matrix.
+  void CalcGrad(DMatrix* matrix, Model& model, Loss* loss);
+
+  // Pull all the shared parameters into the model.
+  void PullModel(Model& model);
+
+  // Wait for all the workers to finish training. Then worker 0
+  // pulls the final model, and all workers disconnect.
+  void Finish(Model& model);
+
+  // Id of current worker
+  int WorkerId() const { return worker_id_; }
+
+ protected:
+  /* The shared parameters */
+  KVStore* store_;
+  /* Id of current worker */
+  int worker_id_;
+  /* Number of workers */
+  int worker_num_;
+  /* Number of rows of a mini-batch */
+  index_t batch_size_;
+  /* Number of mini-batches of all the workers */
+  size_t batch_count_;
+  /* Current mini-batch */
+  DMatrix batch_;
+  /* Features of current mini-batch */
+  std::vector<index_t> keys_;
+  std::vector<char> mark_;
+  /* Keys of the linear term, with the bias at the end */
+  std::vector<index_t> w_keys_;
+  /* Pulled values, and then the changes to push */
+  std::vector<real_t> w_value_;
+  std::vector<real_t> v_value_;
+
+  // Collect the features of the mini-batch
+  void collect_keys(const DMatrix& batch, Model& model);
+
+  // Call func(value, param) for each value of w_value_ and v_value_,
+  // and its parameter in the model.
+  template <typename Func>
+  void for_each_param(Model& model, Func func);
+
+  // Pull the parameters of keys_ into the model,
+  // and keep the pulled values.
+  void pull(Model& model);
+
+  // Push the changes of the parameters of keys_.
+  void push(Model& model);
+
+  // Number of latent values of each feature
+  size_t latent_length(Model& model);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PSWorker);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_DISTRIBUTED_PS_WORKER_H_
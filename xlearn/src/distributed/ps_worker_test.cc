@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the PSWorker class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+
+#include <vector>
+#include <thread>
+
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/distributed/kv_server.h"
+#include "src/distributed/parameter_server.h"
+#include "src/distributed/ps_worker.h"
+#include "src/distributed/transport.h"
+#include "src/loss/cross_entropy_loss.h"
+#include "src/score/ffm_score.h"
+#include "src/score/fm_score.h"
+
+namespace xLearn {
+
+const index_t kNumRow = 400;
+const index_t kNumFeat = 40;
+const index_t kNumNode = 5;
+const index_t kNumK = 4;
+const index_t kNumField = 3;
+
+// The label is given by the sign of a linear function,
+// so the data can be learned by the model.
+void make_data(DMatrix& matrix) {
+  srand(0);
+  std::vector<real_t> weight(kNumFeat);
+  for (index_t j = 0; j < kNumFeat; ++j) {
+    weight[j] = (rand() % 200 - 100) / 100.0;
+  }
+  matrix.ResetMatrix(kNumRow);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    real_t sum = 0;
+    for (index_t n = 0; n < kNumNode; ++n) {
+      index_t feat = rand() % kNumFeat;
+      matrix.AddNode(i, feat, 1.0, feat % kNumField);
+      sum += weight[feat];
+    }
+    matrix.Y[i] = sum > 0 ? 1 : 0;
+    matrix.norm[i] = 1.0 / kNumNode;
+  }
+}
+
+void init_model(Model& model) {
+  model.Initialize("fm", "cross-entropy", kNumFeat, 0, kNumK, 2);
+}
+
+void init_loss(Loss& loss, Score& score, ThreadPool* pool) {
+  std::string opt = "adagrad";
+  score.Initialize(0.1, 0.0, 0.3, 1.0, 0.0001, 0.002, opt);
+  loss.Initialize(&score, pool, true, false);
+}
+
+std::vector<KVServer*> create_servers(size_t num, int worker_num) {
+  std::vector<KVServer*> servers(num);
+  for (size_t i = 0; i < num; ++i) {
+    servers[i] = new KVServer;
+    servers[i]->Initialize(worker_num);
+  }
+  return servers;
+}
+
+void delete_servers(std::vector<KVServer*>& servers) {
+  for (size_t i = 0; i < servers.size(); ++i) {
+    delete servers[i];
+  }
+}
+
+// With one worker and one mini-batch, the worker pulls the whole
+// model, trains it and pushes the changes back, which is the
+// same as the local training.
+void check_same_as_local(Model& model, Score& score) {
+  DMatrix matrix;
+  make_data(matrix);
+  ThreadPool pool(1);
+  Model model_local;
+  model_local.CopyFrom(model);
+  CrossEntropyLoss loss;
+  init_loss(loss, score, &pool);
+  std::vector<KVServer*> servers = create_servers(2, 1);
+  LocalTransport transport(servers);
+  KVStore store;
+  store.Initialize(2, &transport);
+  PSWorker worker;
+  worker.Initialize(&store, 0, 1, kNumRow);
+  worker.InitModel(model);
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    worker.CalcGrad(&matrix, model, &loss);
+    loss.CalcGrad(&matrix, model_local);
+  }
+  // Overwrite the local model by the store, and the gradient
+  // cache of the local model must stay where it is.
+  Model model_ps;
+  model_ps.CopyFrom(model_local);
+  worker.Finish(model_ps);
+  real_t* w[2] = { model_ps.GetParameter_w(), model_local.GetParameter_w() };
+  for (index_t j = 0; j < model_ps.GetNumParameter_w(); ++j) {
+    EXPECT_NEAR(w[0][j], w[1][j], 1e-5);
+  }
+  EXPECT_NEAR(model_ps.GetParameter_b()[0],
+              model_local.GetParameter_b()[0], 1e-5);
+  real_t* v[2] = { model_ps.GetParameter_v(), model_local.GetParameter_v() };
+  for (index_t j = 0; j < model_ps.GetNumParameter_v(); ++j) {
+    EXPECT_NEAR(v[0][j], v[1][j], 1e-5);
+  }
+  // The store keeps the K values of each latent vector, and
+  // the ffm vectors are in the chunks of align values.
+  bool is_ffm = model.GetScoreFunction().compare("ffm") == 0;
+  index_t num_K = model.GetNumK();
+  index_t num_block = is_ffm ? model.GetNumField() : 1;
+  index_t align = model.GetAlign();
+  index_t align0 = model.get_aligned_k() * 2;
+  std::vector<index_t> key;
+  for (index_t j = 0; j < kNumFeat; ++j) {
+    key.push_back(j);
+  }
+  std::vector<real_t> v_value;
+  store.Pull(key, &v_value, num_block * num_K);
+  for (index_t j = 0; j < kNumFeat; ++j) {
+    for (index_t b = 0; b < num_block; ++b) {
+      real_t* param = v[1] + (j * num_block + b) * align0;
+      for (index_t d = 0; d < num_K; ++d) {
+        index_t pos = is_ffm ? d / align * align * 2 + d % align : d;
+        EXPECT_NEAR(param[pos],
+                    v_value[(j * num_block + b) * num_K + d], 1e-5);
+      }
+    }
+  }
+  delete_servers(servers);
+}
+
+TEST(PSWorkerTest, Same_As_Local) {
+  Model model;
+  init_model(model);
+  FMScore score;
+  check_same_as_local(model, score);
+}
+
+// K = 12 is more than one chunk of the ffm layout, which
+// interleaves the values and the adagrad cache.
+TEST(PSWorkerTest, Same_As_Local_FFM) {
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, kNumField, 12, 2);
+  ASSERT_LT(model.GetAlign(), model.GetNumK());
+  FFMScore score;
+  check_same_as_local(model, score);
+}
+
+// Two workers train the same data, and the loss of the
+// model in the store goes down.
+void check_training(int staleness) {
+  const int kWorker = 2;
+  DMatrix matrix;
+  make_data(matrix);
+  std::vector<KVServer*> servers = create_servers(2, kWorker);
+  LocalTransport transport(servers);
+  std::vector<real_t> first_loss(kWorker), last_loss(kWorker);
+  Model final_model;
+  init_model(final_model);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < kWorker; ++w) {
+    threads.push_back(std::thread([&, w]() {
+      ThreadPool pool(1);
+      Model model;
+      init_model(model);
+      FMScore score;
+      CrossEntropyLoss loss;
+      init_loss(loss, score, &pool);
+      KVStore store;
+      store.Initialize(2, &transport, w, staleness);
+      PSWorker worker;
+      worker.Initialize(&store, w, kWorker, 20);
+      worker.InitModel(model);
+      for (int epoch = 0; epoch < 10; ++epoch) {
+        loss.Reset();
+        worker.CalcGrad(&matrix, model, &loss);
+        if (epoch == 0) { first_loss[w] = loss.GetLoss(); }
+        last_loss[w] = loss.GetLoss();
+      }
+      worker.Finish(w == 0 ? final_model : model);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (int w = 0; w < kWorker; ++w) {
+    EXPECT_LT(last_loss[w], first_loss[w]);
+  }
+  // The final model of worker 0 is the same as the store
+  KVStore store;
+  store.Initialize(2, &transport);
+  std::vector<index_t> key;
+  for (index_t j = 0; j < kNumFeat; ++j) {
+    key.push_back(j);
+  }
+  std::vector<real_t> w_value, v_value;
+  store.Pull(key, &w_value);
+  store.Pull(key, &v_value, kNumK);
+  real_t* w = final_model.GetParameter_w();
+  real_t* v = final_model.GetParameter_v();
+  index_t align0 = final_model.get_aligned_k() * 2;
+  for (index_t j = 0; j < kNumFeat; ++j) {
+    EXPECT_FLOAT_EQ(w[j * 2], w_value[j]);
+    for (index_t d = 0; d < kNumK; ++d) {
+      EXPECT_FLOAT_EQ(v[j * align0 + d], v_value[j * kNumK + d]);
+    }
+  }
+  delete_servers(servers);
+}
+
+TEST(PSWorkerTest, Async) {
+  check_training(-1);
+}
+
+TEST(PSWorkerTest, Bounded_Staleness) {
+  check_training(1);
+}
+
+}  // namespace xLearn
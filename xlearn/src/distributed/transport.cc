@@ -0,0 +1,215 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the Transport classes.
+*/
+
+#include "src/distributed/transport.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <memory>
+
+#include "src/base/stringprintf.h"
+
+namespace xLearn {
+
+std::string SocketPath(const std::string& prefix, size_t server_id) {
+  return StringPrintf("%s.%d.sock", prefix.c_str(), (int)server_id);
+}
+
+// Fill the socket address of the path
+static void socket_address(const std::string& path,
+                           struct sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  CHECK_LT(path.size(), sizeof(addr->sun_path));
+  strncpy(addr->sun_path, path.c_str(), sizeof(addr->sun_path) - 1);
+}
+
+//------------------------------------------------------------------------------
+// SocketTransport
+//------------------------------------------------------------------------------
+
+SocketTransport::~SocketTransport() {
+  Close();
+}
+
+void SocketTransport::Connect(const std::string& prefix,
+                              size_t server_num,
+                              int timeout) {
+  CHECK_GT(server_num, 0);
+  CHECK(fd_.empty());
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(timeout);
+  for (size_t i = 0; i < server_num; ++i) {
+    std::string path = SocketPath(prefix, i);
+    struct sockaddr_un addr;
+    socket_address(path, &addr);
+    // The server may not listen yet
+    for (;;) {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      CHECK_GE(fd, 0);
+      if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        fd_.push_back(fd);
+        break;
+      }
+      close(fd);
+      if (std::chrono::steady_clock::now() > deadline) {
+        LOG(FATAL) << "Cannot connect to the server: " << path
+                   << " (" << strerror(errno) << ")";
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+}
+
+void SocketTransport::Close() {
+  for (size_t i = 0; i < fd_.size(); ++i) {
+    close(fd_[i]);
+  }
+  fd_.clear();
+}
+
+void SocketTransport::Request(size_t server_id,
+                              const KVMessage& request,
+                              KVMessage* reply) {
+  CHECK_LT(server_id, fd_.size());
+  if (!WriteMessage(fd_[server_id], request) ||
+      !ReadMessage(fd_[server_id], reply)) {
+    LOG(FATAL) << "The connection to server " << server_id
+               << " is closed.";
+  }
+}
+
+//------------------------------------------------------------------------------
+// ServeSocket
+//------------------------------------------------------------------------------
+
+// A connection of a worker. It is shared by the connection
+// thread and ServeSocket(), which can detach the thread.
+struct Connection {
+  explicit Connection(int f) : fd(f), finishing(false) { }
+  int fd;
+  /* The finish request has been received */
+  std::atomic<bool> finishing;
+};
+
+// Handle the requests of one connection until it is closed.
+// A worker sends nothing after the finish request, so the
+// connection is closed without waiting for the worker. If the
+// connection is closed before that, the worker has crashed or
+// been killed, and it will never finish.
+static void serve_connection(KVServer* server,
+                             std::shared_ptr<Connection> conn,
+                             std::shared_ptr<std::atomic<bool>> failed) {
+  KVMessage request, reply;
+  while (ReadMessage(conn->fd, &request)) {
+    // It is set before the reply, after which the worker
+    // can close the connection.
+    if (request.type == kFinishRequest) { conn->finishing = true; }
+    server->Handle(request, &reply);
+    if (!WriteMessage(conn->fd, reply)) { break; }
+    if (request.type == kFinishRequest) { return; }
+  }
+  *failed = true;
+}
+
+bool ServeSocket(KVServer* server, const std::string& path) {
+  CHECK_NOTNULL(server);
+  struct sockaddr_un addr;
+  socket_address(path, &addr);
+  unlink(path.c_str());
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd, 0);
+  if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 128) != 0) {
+    LOG(FATAL) << "Cannot listen on the socket: " << path
+               << " (" << strerror(errno) << ")";
+  }
+  std::vector<std::thread> threads;
+  std::vector<std::shared_ptr<Connection>> conns;
+  std::shared_ptr<std::atomic<bool>> failed(new std::atomic<bool>(false));
+  std::vector<struct pollfd> pfd;
+  // Check the finish of the workers every 100 ms. A connection
+  // thread can be blocked in a barrier of the server, and then it
+  // does not read the end of its connection, so the connections
+  // are also polled for the hang-up here.
+  while (!server->Finished() && !*failed) {
+    pfd.resize(1);
+    pfd[0].fd = listen_fd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    std::vector<Connection*> polled;
+    for (size_t i = 0; i < conns.size(); ++i) {
+      if (conns[i]->finishing) { continue; }
+      struct pollfd p;
+      p.fd = conns[i]->fd;
+      p.events = POLLRDHUP;
+      p.revents = 0;
+      pfd.push_back(p);
+      polled.push_back(conns[i].get());
+    }
+    if (poll(pfd.data(), pfd.size(), 100) <= 0) { continue; }
+    for (size_t i = 0; i < polled.size(); ++i) {
+      if ((pfd[i+1].revents & (POLLRDHUP | POLLHUP | POLLERR)) &&
+          !polled[i]->finishing) {
+        *failed = true;
+      }
+    }
+    if (!(pfd[0].revents & POLLIN)) { continue; }
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) { continue; }
+    conns.push_back(std::make_shared<Connection>(fd));
+    threads.push_back(std::thread(serve_connection, server,
+                                  conns.back(), failed));
+  }
+  close(listen_fd);
+  unlink(path.c_str());
+  if (*failed) {
+    // The other connections may be blocked in a barrier for the
+    // failed worker, so they are shut down and not joined. Each
+    // worker finds its connection closed and exits.
+    LOG(ERR) << "A worker closed the connection before it finished.";
+    for (size_t i = 0; i < conns.size(); ++i) {
+      shutdown(conns[i]->fd, SHUT_RDWR);
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].detach();
+    }
+    return false;
+  }
+  // The connections are closed after the finish request
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (size_t i = 0; i < conns.size(); ++i) {
+    close(conns[i]->fd);
+  }
+  return true;
+}
+
+}  // namespace xLearn
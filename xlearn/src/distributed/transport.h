@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the Transport, which sends the requests of a
+worker to the servers of the parameter server.
+*/
+
+#ifndef XLEARN_DISTRIBUTED_TRANSPORT_H_
+#define XLEARN_DISTRIBUTED_TRANSPORT_H_
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/distributed/kv_message.h"
+#include "src/distributed/kv_server.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// Transport is the connection of one worker to all the servers. The
+// KVStore only uses Request(), so the servers can be in the same
+// process (LocalTransport), in the other processes of the same machine
+// (SocketTransport), or on the other machines by a new Transport.
+//
+// A Transport is used by one thread at a time.
+//------------------------------------------------------------------------------
+class Transport {
+ public:
+  Transport() { }
+  virtual ~Transport() { }
+
+  // Number of servers
+  virtual size_t ServerNumber() const = 0;
+
+  // Send the request to the server and wait for the reply.
+  virtual void Request(size_t server_id,
+                       const KVMessage& request,
+                       KVMessage* reply) = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Transport);
+};
+
+//------------------------------------------------------------------------------
+// LocalTransport calls the servers in current process directly,
+// which is used by the tests and the single-process training:
+//
+//   std::vector<KVServer*> servers = ...;
+//   LocalTransport transport(servers);
+//------------------------------------------------------------------------------
+class LocalTransport : public Transport {
+ public:
+  explicit LocalTransport(const std::vector<KVServer*>& servers)
+   : servers_(servers) { CHECK(!servers.empty()); }
+  ~LocalTransport() { }
+
+  size_t ServerNumber() const { return servers_.size(); }
+
+  void Request(size_t server_id,
+               const KVMessage& request,
+               KVMessage* reply) {
+    CHECK_LT(server_id, servers_.size());
+    servers_[server_id]->Handle(request, reply);
+  }
+
+ protected:
+  std::vector<KVServer*> servers_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LocalTransport);
+};
+
+//------------------------------------------------------------------------------
+// SocketTransport connects to the servers of other processes by Unix
+// domain sockets. Server i listens on SocketPath(prefix, i):
+//
+//   /* In the server process */
+//   KVServer server;
+//   server.Initialize(worker_num);
+//   bool ok = ServeSocket(&server, SocketPath("/tmp/xlearn_ps", 0));
+//
+//   /* In the worker process */
+//   SocketTransport transport;
+//   transport.Connect("/tmp/xlearn_ps", server_num);
+//
+// Connect() waits for the servers that have not started yet.
+//------------------------------------------------------------------------------
+class SocketTransport : public Transport {
+ public:
+  SocketTransport() { }
+  ~SocketTransport();
+
+  // Connect to all the servers. Exit if a server cannot
+  // be connected in timeout seconds.
+  void Connect(const std::string& prefix,
+               size_t server_num,
+               int timeout = 60);
+
+  // Close all the connections.
+  void Close();
+
+  size_t ServerNumber() const { return fd_.size(); }
+
+  void Request(size_t server_id,
+               const KVMessage& request,
+               KVMessage* reply);
+
+ protected:
+  /* Socket of each server */
+  std::vector<int> fd_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SocketTransport);
+};
+
+// Path of the socket of the server_id server.
+std::string SocketPath(const std::string& prefix, size_t server_id);
+
+// Serve the requests on the Unix domain socket of the path, with
+// one thread for each connection. Return true after all the workers
+// of the server have sent the finish request, or false as soon as
+// a connection is closed before its finish request, i.e., a worker
+// fails. The server process should exit then, because the blocked
+// connection threads are left running.
+bool ServeSocket(KVServer* server, const std::string& path);
+
+}  // namespace xLearn
+
+#endif  // XLEARN_DISTRIBUTED_TRANSPORT_H_
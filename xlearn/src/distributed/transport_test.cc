@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the Transport classes.
+*/
+
+#include "gtest/gtest.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "src/base/stringprintf.h"
+#include "src/distributed/kv_message.h"
+#include "src/distributed/kv_server.h"
+#include "src/distributed/parameter_server.h"
+#include "src/distributed/transport.h"
+
+namespace xLearn {
+
+std::string socket_prefix() {
+  return StringPrintf("/tmp/xlearn_transport_test_%d", (int)getpid());
+}
+
+TEST(TransportTest, Message) {
+  int fd[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fd), 0);
+  KVMessage msg;
+  msg.Reset(kPushRequest, kListTable, 2);
+  msg.worker_id = 3;
+  msg.clock = 7;
+  msg.staleness = 1;
+  msg.keys = { 5, 1 };
+  msg.values = { 0.5, 1.5, 2.5, 3.5 };
+  ASSERT_TRUE(WriteMessage(fd[0], msg));
+  KVMessage result;
+  ASSERT_TRUE(ReadMessage(fd[1], &result));
+  EXPECT_EQ(result.type, kPushRequest);
+  EXPECT_EQ(result.table, kListTable);
+  EXPECT_EQ(result.length, 2);
+  EXPECT_EQ(result.worker_id, 3);
+  EXPECT_EQ(result.clock, 7);
+  EXPECT_EQ(result.staleness, 1);
+  EXPECT_EQ(result.keys, msg.keys);
+  EXPECT_EQ(result.values, msg.values);
+  // The closed connection
+  close(fd[0]);
+  EXPECT_FALSE(ReadMessage(fd[1], &result));
+  close(fd[1]);
+}
+
+// The servers are two processes, and the
+// workers are two threads of this process.
+TEST(TransportTest, Socket) {
+  const size_t kServer = 2;
+  const int kWorker = 2;
+  std::string prefix = socket_prefix();
+  std::vector<pid_t> pid;
+  for (size_t s = 0; s < kServer; ++s) {
+    pid_t p = fork();
+    ASSERT_GE(p, 0);
+    if (p == 0) {
+      KVServer server;
+      server.Initialize(kWorker);
+      bool ok = ServeSocket(&server, SocketPath(prefix, s));
+      _exit(ok ? 0 : 1);
+    }
+    pid.push_back(p);
+  }
+  std::vector<index_t> key = { 0, 1, 2, 3, 4, 5, 6 };
+  std::vector<std::thread> threads;
+  for (int w = 0; w < kWorker; ++w) {
+    threads.push_back(std::thread([&, w]() {
+      SocketTransport transport;
+      transport.Connect(prefix, kServer);
+      KVStore store;
+      store.Initialize(kServer, &transport, w);
+      std::vector<real_t> value(key.size() * 3);
+      for (size_t i = 0; i < value.size(); ++i) {
+        value[i] = i + w;
+      }
+      store.Push(key, value, 3);
+      store.Barrier();
+      std::vector<real_t> result;
+      store.Pull(key, &result, 3);
+      ASSERT_EQ(result.size(), value.size());
+      for (size_t i = 0; i < result.size(); ++i) {
+        EXPECT_FLOAT_EQ(result[i], 2 * i + 1);
+      }
+      store.Finish();
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // The servers exit after all the workers finish
+  for (size_t s = 0; s < kServer; ++s) {
+    int status = -1;
+    ASSERT_EQ(waitpid(pid[s], &status, 0), pid[s]);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_NE(access(SocketPath(prefix, s).c_str(), F_OK), 0);
+  }
+}
+
+// A worker that closes its connection without the finish request
+// has failed, and the server exits with an error instead of
+// waiting for it forever. The second worker is killed while the
+// server is blocked in the barrier of its request.
+TEST(TransportTest, Worker_Failure) {
+  std::string prefix = socket_prefix() + "_failure";
+  pid_t server_pid = fork();
+  ASSERT_GE(server_pid, 0);
+  if (server_pid == 0) {
+    KVServer server;
+    server.Initialize(3);
+    bool ok = ServeSocket(&server, SocketPath(prefix, 0));
+    _exit(ok ? 0 : 1);
+  }
+  pid_t worker_pid = fork();
+  ASSERT_GE(worker_pid, 0);
+  if (worker_pid == 0) {
+    SocketTransport transport;
+    transport.Connect(prefix, 1);
+    KVStore store;
+    store.Initialize(1, &transport, 1);
+    store.Barrier();
+    _exit(0);
+  }
+  SocketTransport transport;
+  transport.Connect(prefix, 1);
+  KVStore store;
+  store.Initialize(1, &transport, 0);
+  std::vector<index_t> key = { 0, 1 };
+  std::vector<real_t> value = { 1.0, 2.0 };
+  store.Push(key, value);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  kill(worker_pid, SIGKILL);
+  int status = -1;
+  ASSERT_EQ(waitpid(server_pid, &status, 0), server_pid);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 1);
+  EXPECT_NE(access(SocketPath(prefix, 0).c_str(), F_OK), 0);
+  waitpid(worker_pid, &status, 0);
+  transport.Close();
+}
+
+}  // namespace xLearn
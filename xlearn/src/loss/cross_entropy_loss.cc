@@ -19,6 +19,8 @@ This file is the implementation of CrossEntropyLoss class.
 */
 
 #include "src/loss/cross_entropy_loss.h"
+#include "src/loss/numa_hogwild.h"
+#include "src/loss/sync_batch.h"
 
 #include <thread>
 #include<atomic>
@@ -58,23 +60,12 @@ void CrossEntropyLoss::Evalute(const std::vector<real_t>& pred,
   CHECK_NE(label.empty(), true);
   total_example_ += pred.size();
   // multi-thread training
-  std::vector<real_t> sum(threadNumber_, 0);
-  for (int i = 0; i < threadNumber_; ++i) {
-    size_t start_idx = getStart(pred.size(), threadNumber_, i);
-    size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-    pool_->enqueue(std::bind(ce_evalute_thread,
-                             &pred,
-                             &label,
-                             &(sum[i]),
-                             start_idx,
-                             end_idx));
-  }
-  // Wait all of the threads finish their job
-  pool_->Sync(threadNumber_);
-  // Accumulate loss
-  for (size_t i = 0; i < sum.size(); ++i) {
-    loss_sum_ += sum[i];
-  }
+  loss_sum_ = pool_->ParallelReduce(0, pred.size(), kExampleGrain,
+    loss_sum_, [&](size_t start_idx, size_t end_idx) {
+      real_t sum = 0;
+      ce_evalute_thread(&pred, &label, &sum, start_idx, end_idx);
+      return sum;
+  });
 }
 
 
@@ -84,12 +75,14 @@ static void ce_gradient_thread(const DMatrix* matrix,
                                Score* score_func,
                                bool is_norm,
                                real_t* sum,
+                               const index_t* order,
                                size_t start_idx,
                                size_t end_idx) {
   CHECK_GE(end_idx, start_idx);
   *sum = 0;
-  for (size_t i = start_idx; i < end_idx; ++i) {
-    SparseRow* row = matrix->row[i];
+  for (size_t k = start_idx; k < end_idx; ++k) {
+    size_t i = order == nullptr ? k : order[k];
+    const SparseRow* row = &matrix->row[i];
     real_t norm = is_norm ? matrix->norm[i] : 1.0;
     real_t pred = score_func->CalcScore(row, *model, norm);
     // partial gradient
@@ -121,25 +114,34 @@ void CrossEntropyLoss::CalcGrad(const DMatrix* matrix,
   size_t row_len = matrix->row_length;
   total_example_ += row_len;
   // multi-thread training
-  int count = lock_free_ ? threadNumber_ : 1;
-  std::vector<real_t> sum(count, 0);
-  for (int i = 0; i < count; ++i) {
-    index_t start_idx = getStart(row_len, count, i);
-    index_t end_idx = getEnd(row_len, count, i);
-    pool_->enqueue(std::bind(ce_gradient_thread,
-                             matrix,
-                             &model,
-                             score_func_,
-                             norm_,
-                             &(sum[i]),
-                             start_idx,
-                             end_idx));
-  }
-  // Wait all of the threads finish their job
-  pool_->Sync(count);
-  // Accumulate loss
-  for (int i = 0; i < sum.size(); ++i) {
-    loss_sum_ += sum[i];
+  TrainFunc train = use_train_kernel_ ? train_func_ : nullptr;
+  OptParam opt = score_func_->GetOptParam();
+  auto gradient = [&](Model* m, const index_t* order,
+                      size_t start_idx, size_t end_idx) -> real_t {
+    if (train != nullptr) {
+      return train(matrix, m, opt, norm_, order, start_idx, end_idx);
+    }
+    real_t sum = 0;
+    ce_gradient_thread(matrix, m, score_func_, norm_,
+                       &sum, order, start_idx, end_idx);
+    return sum;
+  };
+  if (sync_ != nullptr) {
+    loss_sum_ += sync_->Train(matrix, model, score_func_, norm_,
+      [](real_t pred, real_t label, real_t* pg) -> real_t {
+        real_t y = label > 0 ? 1.0 : -1.0;
+        *pg = -y/(1.0+(1.0/exp(-y*pred)));
+        return log1p(exp(-y*pred));
+    });
+  } else if (numa_ != nullptr) {
+    loss_sum_ += numa_->Train(matrix, model, gradient);
+  } else if (lock_free_) {
+    loss_sum_ = pool_->ParallelReduce(0, row_len, kRowGrain, loss_sum_,
+      [&](size_t start_idx, size_t end_idx) {
+        return gradient(&model, nullptr, start_idx, end_idx);
+    });
+  } else {
+    loss_sum_ += gradient(&model, nullptr, 0, row_len);
   }
 }
 
@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the scaling benchmark of the lock-free training. It
+reports the rows trained per second by the plain lock-free training
+and by the NUMA-aware training, from 1 thread to max_thread threads:
+
+  ./hogwild_benchmark [num_row] [max_thread] [numa_sync]
+
+The feature ids follow a power-law distribution like the CTR data,
+so a few hot features appear in most of the rows.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/numa.h"
+#include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/loss/cross_entropy_loss.h"
+#include "src/score/ffm_score.h"
+
+using namespace xLearn;
+
+const index_t kNumFeature = 100000;
+const index_t kNumField = 20;
+const index_t kNumK = 8;
+const int kEpoch = 2;
+
+// Generate the ffm data with power-law feature ids
+void random_data(index_t num_row, DMatrix& matrix) {
+  matrix.ResetMatrix(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    for (index_t f = 0; f < kNumField; ++f) {
+      real_t u = (rand() + 1.0) / (RAND_MAX + 2.0);
+      index_t feat = (index_t)(pow(u, 4.0) * kNumFeature);
+      matrix.AddNode(i, feat, 1.0, f);
+    }
+    matrix.Y[i] = rand() % 2;
+    matrix.norm[i] = 1.0 / kNumField;
+  }
+}
+
+// Train the data and return rows/sec
+real_t run(DMatrix& matrix, size_t thread_number,
+           bool numa, index_t numa_sync) {
+  // The caller thread is also used by the thread pool
+  ThreadPool pool(thread_number - 1);
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeature,
+                   kNumField, kNumK, 2, 1.0, &pool);
+  FFMScore score;
+  std::string opt = "adagrad";
+  score.Initialize(0.2, 0.00002, 0, 0, 0, 0, opt);
+  CrossEntropyLoss loss;
+  loss.Initialize(&score, &pool, true, true);
+  if (numa) {
+    loss.SetNumaMode(GetNumaNodes(), numa_sync);
+  }
+  Timer timer;
+  timer.tic();
+  for (int e = 0; e < kEpoch; ++e) {
+    loss.CalcGrad(&matrix, model);
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  return matrix.row_length * kEpoch / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_row = argc > 1 ? atoi(argv[1]) : 200000;
+  size_t max_thread = argc > 2 ? atoi(argv[2]) : 64;
+  index_t numa_sync = argc > 3 ? atoi(argv[3]) : 0;
+  if (max_thread == 0) { max_thread = 1; }
+  print_info(StringPrintf("Rows: %d, max thread: %d, CPUs: %d, "
+                          "NUMA nodes: %d",
+                          (int)num_row, (int)max_thread,
+                          (int)std::thread::hardware_concurrency(),
+                          (int)GetNumaNodes().size()));
+  DMatrix matrix;
+  random_data(num_row, matrix);
+  std::vector<std::string> column;
+  std::vector<int> width(5, 16);
+  column.push_back("Threads");
+  column.push_back("Hogwild rows/s");
+  column.push_back("NUMA rows/s");
+  column.push_back("Hogwild scale");
+  column.push_back("NUMA scale");
+  print_row(column, width);
+  real_t base = 0;
+  for (size_t t = 1; t <= max_thread; t *= 2) {
+    real_t plain = run(matrix, t, false, numa_sync);
+    real_t numa = run(matrix, t, true, numa_sync);
+    if (t == 1) { base = plain; }
+    column.clear();
+    column.push_back(StringPrintf("%d", (int)t));
+    column.push_back(StringPrintf("%.0f", plain));
+    column.push_back(StringPrintf("%.0f", numa));
+    column.push_back(StringPrintf("%.2fx", plain / base));
+    column.push_back(StringPrintf("%.2fx", numa / base));
+    print_row(column, width);
+  }
+  return 0;
+}
@@ -21,6 +21,8 @@ This file is the implementation of the basic Loss class.
 #include "src/loss/loss.h"
 #include "src/loss/squared_loss.h"
 #include "src/loss/cross_entropy_loss.h"
+#include "src/loss/numa_hogwild.h"
+#include "src/loss/sync_batch.h"
 
 namespace xLearn {
 
@@ -31,6 +33,29 @@ CLASS_REGISTER_IMPLEMENT_REGISTRY(xLearn_loss_registry, Loss);
 REGISTER_LOSS("squared", SquaredLoss);
 REGISTER_LOSS("cross-entropy", CrossEntropyLoss);
 
+Loss::~Loss() {
+  delete numa_;
+  delete sync_;
+}
+
+// The threads of the thread pool are divided among the
+// nodes, so the NUMA-aware mode does not add any thread.
+void Loss::SetNumaMode(const std::vector<NumaNode>& nodes,
+                       index_t sync_rows) {
+  CHECK_NOTNULL(pool_);
+  delete numa_;
+  numa_ = new NumaHogwild();
+  numa_->Initialize(nodes, pool_, sync_rows);
+}
+
+// The shards of the mini-batches are trained by the thread pool.
+void Loss::SetSyncMode(index_t batch_size) {
+  CHECK_NOTNULL(pool_);
+  delete sync_;
+  sync_ = new SyncBatch();
+  sync_->Initialize(pool_, batch_size);
+}
+
 // Predict in one thread
 void pred_thread(const DMatrix* matrix,
                  Model* model,
@@ -41,7 +66,7 @@ void pred_thread(const DMatrix* matrix,
                  size_t end_idx) {
   CHECK_GE(end_idx, start_idx);
   for (size_t i = start_idx; i < end_idx; ++i) {
-    SparseRow* row = matrix->row[i];
+    const SparseRow* row = &matrix->row[i];
     real_t norm = is_norm ? matrix->norm[i] : 1.0;
     (*pred)[i] = score_func_->CalcScore(row, *model, norm);
   }
@@ -56,20 +81,11 @@ void Loss::Predict(const DMatrix* matrix,
   CHECK_EQ(pred.size(), matrix->row_length);
   index_t row_len = matrix->row_length;
   // Predict in multi-thread
-  for (int i = 0; i < threadNumber_; ++i) {
-    size_t start_idx = getStart(row_len, threadNumber_, i);
-    size_t end_idx = getEnd(row_len, threadNumber_, i);
-    pool_->enqueue(std::bind(pred_thread,
-                             matrix,
-                             &model,
-                             &pred,
-                             score_func_,
-                             norm_,
-                             start_idx,
-                             end_idx));
-  }
-  // Wait all of the threads finish their job
-  pool_->Sync(threadNumber_);
+  pool_->ParallelFor(0, row_len, kRowGrain,
+    [&](size_t start_idx, size_t end_idx) {
+      pred_thread(matrix, &model, &pred, score_func_,
+                  norm_, start_idx, end_idx);
+  });
 }
 
 // Given data sample and current model, calculate gradient.
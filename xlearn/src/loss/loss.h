@@ -28,12 +28,22 @@ function or objective function.
 #include "src/base/common.h"
 #include "src/base/class_register.h"
 #include "src/base/math.h"
+#include "src/base/numa.h"
 #include "src/base/thread_pool.h"
 #include "src/data/model_parameters.h"
 #include "src/score/score_function.h"
+#include "src/loss/train_kernel.h"
 
 namespace xLearn {
 
+class NumaHogwild;
+class SyncBatch;
+
+/* Minimal number of rows of each task in CalcGrad() and Predict() */
+const size_t kRowGrain = 32;
+/* Minimal number of examples of each task in Evalute() */
+const size_t kExampleGrain = 4096;
+
 //------------------------------------------------------------------------------
 // The Loss is an abstract class, which can be implemented by the real
 // loss functions such as cross-entropy loss (cross_entropy_loss.h),
@@ -66,12 +76,23 @@ namespace xLearn {
 //     sq_loss->Evalute(pred, matrix->Y);
 //   }
 //   loss_val = sq_loss->GetLoss()
+//
+// With lock-free training, we can also train in the NUMA-aware mode
+// (see numa_hogwild.h), which keeps a model replica on each NUMA node:
+//
+//   sq_loss->SetNumaMode(GetNumaNodes(), sync_rows);
 //------------------------------------------------------------------------------
 class Loss {
  public:
   // Constructor and Desstructor
-  Loss() : loss_sum_(0), total_example_ (0) { };
-  virtual ~Loss() { }
+  Loss() 
+   : loss_sum_(0), 
+     total_example_ (0), 
+     numa_(nullptr),
+     sync_(nullptr),
+     train_func_(nullptr),
+     use_train_kernel_(true) { };
+  virtual ~Loss();
 
   // This function needs to be invoked before using this class
   void Initialize(Score* score, 
@@ -88,8 +109,29 @@ class Loss {
     threadNumber_ = pool_->ThreadNumber();
     lock_free_ = lock_free;
     batch_size_ = batch_size;
+    train_func_ = GetTrainFunc(score->score_type(),
+                               score->opt_type(),
+                               this->loss_type());
   }
 
+  // CalcGrad() uses the training kernel of current score function,
+  // optimization method and loss (see train_kernel.h) by default.
+  // Setting this to false uses the virtual methods of Score.
+  void UseTrainKernel(bool use) { use_train_kernel_ = use; }
+
+  // Train CalcGrad() on a model replica of each of the given
+  // NUMA nodes, and average the replicas every sync_rows rows
+  // (0 means kSyncRowsPerNode rows for each node). The threads
+  // of the thread pool of Initialize() are used.
+  void SetNumaMode(const std::vector<NumaNode>& nodes,
+                   index_t sync_rows = 0);
+
+  // Train CalcGrad() in synchronous mini-batches of batch_size
+  // rows (see sync_batch.h), whose gradients are summed in a fixed
+  // order and applied once, so the model is bit-reproducible.
+  // It is used instead of the lock-free and NUMA-aware training.
+  void SetSyncMode(index_t batch_size);
+
   // Given predictions and labels, accumulate loss value.
   virtual void Evalute(const std::vector<real_t>& pred,
                        const std::vector<real_t>& label) = 0;
@@ -145,6 +187,14 @@ class Loss {
   index_t total_example_;
   /* Mini-batch size */
   index_t batch_size_;
+  /* NUMA-aware training, which is nullptr by default */
+  NumaHogwild* numa_;
+  /* Synchronous mini-batch training, which is nullptr by default */
+  SyncBatch* sync_;
+  /* The specialized training kernel */
+  TrainFunc train_func_;
+  /* Use train_func_ in CalcGrad() ? */
+  bool use_train_kernel_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(Loss);
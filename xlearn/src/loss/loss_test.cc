@@ -90,7 +90,6 @@ TEST_F(LossTest, Predict_Linear) {
   matrix.ResetMatrix(kLine);
   for (int i = 0; i < kLine; ++i) {
     matrix.Y[i] = 0;
-    matrix.row[i] = new SparseRow;
     for (int j = 0; j < param.num_feature; ++j) {
       matrix.AddNode(i, j, 1.0);
     }
@@ -134,7 +133,6 @@ TEST_F(LossTest, Predict_FM) {
   matrix.ResetMatrix(kLine);
   for (int i = 0; i < kLine; ++i) {
     matrix.Y[i] = 0;
-    matrix.row[i] = new SparseRow;
     for (int j = 0; j < param.num_feature; ++j) {
       matrix.AddNode(i, j, 1.0);
     }
@@ -179,7 +177,6 @@ TEST_F(LossTest, Predict_FFM) {
   matrix.ResetMatrix(kLine);
   for (int i = 0; i < kLine; ++i) {
     matrix.Y[i] = 0;
-    matrix.row[i] = new SparseRow;
     for (int j = 0; j < param.num_feature; ++j) {
       matrix.AddNode(i, j, 1.0, j);
     }
@@ -23,6 +23,10 @@ This file defines the Metric class.
 
 #include <math.h>
 
+#include <string>
+#include <vector>
+#include <algorithm>
+
 #include "src/base/common.h"
 #include "src/base/math.h"
 #include "src/base/class_register.h"
@@ -33,6 +37,22 @@ namespace xLearn {
 
 // Bucket size used by AUC
 const index_t kMaxBucketSize = 1e6;
+// Minimal number of examples of each task in Accumulate()
+const size_t kMetricGrain = 4096;
+
+//------------------------------------------------------------------------------
+// Two counters that are accumulated by ParallelReduce().
+//------------------------------------------------------------------------------
+struct CounterPair {
+  CounterPair() : first(0), second(0) { }
+  CounterPair& operator+=(const CounterPair& other) {
+    first += other.first;
+    second += other.second;
+    return *this;
+  }
+  index_t first;
+  index_t second;
+};
 
 //------------------------------------------------------------------------------
 // A metric is a function that is used to judge the performance of 
@@ -78,6 +98,16 @@ class Metric {
   // Return the metric type.
   virtual std::string metric_type() = 0;
 
+  // A Metric can give more than one value, such as MultiMetric.
+  // Return all the metric values and their types. GetMetric() and
+  // metric_type() return the first of them.
+  virtual void GetMetricList(std::vector<real_t>* value) {
+    value->assign(1, GetMetric());
+  }
+  virtual void MetricTypeList(std::vector<std::string>* type) {
+    type->assign(1, metric_type());
+  }
+
  protected:
   /* Pointer of thread pool */
   ThreadPool* pool_;
@@ -129,22 +159,12 @@ class AccMetric : public Metric {
     CHECK_EQ(Y.size(), pred.size());
     total_example_ += Y.size();
     // multi-thread training
-    std::vector<index_t> sum(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(acc_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum.size(); ++i) {
-      true_pred_ += sum[i];
-    }
+    true_pred_ = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      true_pred_, [&](size_t start_idx, size_t end_idx) {
+        index_t sum = 0;
+        acc_accum_thread(&Y, &pred, &sum, start_idx, end_idx);
+        return sum;
+    });
   }
 
   // Reset counters
@@ -211,27 +231,15 @@ class PrecMetric : public Metric {
                   const std::vector<real_t>& pred) {
     CHECK_EQ(Y.size(), pred.size());
     // multi-thread training
-    std::vector<index_t> sum_1(threadNumber_, 0);
-    std::vector<index_t> sum_2(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(prec_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum_1[i]),
-                               &(sum_2[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum_1.size(); ++i) {
-      true_positive_ += sum_1[i];
-    }
-    for (size_t i = 0; i < sum_2.size(); ++i) {
-      false_positive_ += sum_2[i];
-    }
+    CounterPair sum = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      CounterPair(), [&](size_t start_idx, size_t end_idx) {
+        CounterPair count;
+        prec_accum_thread(&Y, &pred, &count.first, &count.second,
+                          start_idx, end_idx);
+        return count;
+    });
+    true_positive_ += sum.first;
+    false_positive_ += sum.second;
   }
 
   // Reset counters
@@ -299,27 +307,15 @@ class RecallMetric : public Metric {
                   const std::vector<real_t>& pred) {
     CHECK_EQ(Y.size(), pred.size());
     // multi-thread training
-    std::vector<index_t> sum_1(threadNumber_, 0);
-    std::vector<index_t> sum_2(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(recall_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum_1[i]),
-                               &(sum_2[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum_1.size(); ++i) {
-      true_positive_ += sum_1[i];
-    }
-    for (size_t i = 0; i < sum_2.size(); ++i) {
-      false_negative_ += sum_2[i];
-    }
+    CounterPair sum = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      CounterPair(), [&](size_t start_idx, size_t end_idx) {
+        CounterPair count;
+        recall_accum_thread(&Y, &pred, &count.first, &count.second,
+                            start_idx, end_idx);
+        return count;
+    });
+    true_positive_ += sum.first;
+    false_negative_ += sum.second;
   }
 
   // Reset counters
@@ -390,27 +386,15 @@ class F1Metric : public Metric {
     CHECK_EQ(Y.size(), pred.size());
     total_example_ += Y.size();
     // multi-thread training
-    std::vector<index_t> sum_1(threadNumber_, 0);
-    std::vector<index_t> sum_2(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(f1_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum_1[i]),
-                               &(sum_2[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum_1.size(); ++i) {
-      true_positive_ += sum_1[i];
-    }
-    for (size_t i = 0; i < sum_2.size(); ++i) {
-      true_negative_ += sum_2[i];
-    }
+    CounterPair sum = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      CounterPair(), [&](size_t start_idx, size_t end_idx) {
+        CounterPair count;
+        f1_accum_thread(&Y, &pred, &count.first, &count.second,
+                        start_idx, end_idx);
+        return count;
+    });
+    true_positive_ += sum.first;
+    true_negative_ += sum.second;
   }
 
   // Reset counters
@@ -440,93 +424,98 @@ class F1Metric : public Metric {
   DISALLOW_COPY_AND_ASSIGN(F1Metric);
 };
 
+//------------------------------------------------------------------------------
+// Calculate the AUC from the histograms of the positive and
+// negative examples, where a larger bucket id means a larger score.
+//------------------------------------------------------------------------------
+inline real_t CalcBucketAUC(const std::vector<index_t>& positive_vec,
+                            const std::vector<index_t>& negative_vec) {
+  CHECK_EQ(positive_vec.size(), negative_vec.size());
+  long long positive_sum = 0;
+  long long negative_sum = 0;
+  long long pre_positive_sum = 0;
+  double auc = 0.0;
+  for (size_t i = 0; i < positive_vec.size(); ++i) {
+    pre_positive_sum = positive_sum;
+    positive_sum += positive_vec[i];
+    negative_sum += negative_vec[i];
+    auc += (pre_positive_sum + positive_sum) *
+           (double)(negative_vec[i]) * 1.0 / 2;
+  }
+  double auc_res = auc / ((double)positive_sum * negative_sum);
+  return 1.0 - auc_res;
+}
+
+// The bucket of a score in the AUC histograms
+inline index_t AUCBucket(real_t score) {
+  real_t sigmoid_score = fastsigmoid(score);
+  return index_t(sigmoid_score * kMaxBucketSize) % kMaxBucketSize;
+}
+
 //------------------------------------------------------------------------------
 // The area under the curve (often referred to as simply the AUC) is 
 // equal to the probability that a classifier will rank a randomly chosen 
 // positive instance higher than a randomly chosen negative one 
 // (assuming 'positive' ranks higher than 'negative').
+// AUCMetric counts the scores in kMaxBucketSize buckets, so the
+// result is an approximation. MultiMetric can give the exact AUC.
 //------------------------------------------------------------------------------
 class AUCMetric : public Metric {
- public:
-  struct Info {
-    Info() {
-      positive_vec_.resize(kMaxBucketSize, 0);
-      negative_vec_.resize(kMaxBucketSize, 0);
-    }
-    std::vector<index_t> positive_vec_;
-    std::vector<index_t> negative_vec_;
-  };
-
  public:
   // Constrcutor and Destructor
-  AUCMetric() {
-    all_positive_number_.clear();
-    all_negative_number_.clear();
-    all_positive_number_.resize(kMaxBucketSize, 0);
-    all_negative_number_.resize(kMaxBucketSize, 0);
-  }
+  AUCMetric() 
+   : all_positive_number_(kMaxBucketSize, 0),
+     all_negative_number_(kMaxBucketSize, 0) { }
   ~AUCMetric() { }
 
-  // Calculate AUC in one thread
-  static void auc_accum_thread(const std::vector<real_t>* Y,
-                               const std::vector<real_t>* pred,
-                               Info* info,
-                               size_t start_idx,
-                               size_t end_idx) {
+  // Calculate the bucket of each example in one thread
+  static void auc_bucket_thread(const std::vector<real_t>* pred,
+                                std::vector<index_t>* bucket,
+                                size_t start_idx,
+                                size_t end_idx) {
     CHECK_GE(end_idx, start_idx);
     for (size_t i = start_idx; i < end_idx; ++i) {
-      real_t r_label = (*Y)[i] > 0 ? 1 : -1;
-      real_t sigmoid_score = fastsigmoid((*pred)[i]);
-      index_t bkt_id = index_t(sigmoid_score * kMaxBucketSize) 
-                       % kMaxBucketSize;
-      CHECK_LT(bkt_id, kMaxBucketSize);
-      if (r_label > 0) {
-        info->positive_vec_[bkt_id] += 1;
-      } else {
-        info->negative_vec_[bkt_id] += 1;
-      }
+      (*bucket)[i] = AUCBucket((*pred)[i]);
     }
   }
 
   // Accumulate counters during the training.
+  // The buckets are calculated in multi-thread, and then 
+  // counted in one thread, so we don't need a copy of 
+  // all the buckets for each thread. The bucket buffer
+  // is reused by the following mini-batches.
   void Accumulate(const std::vector<real_t>& Y,
                   const std::vector<real_t>& pred) {
     CHECK_EQ(Y.size(), pred.size());
-    // multi-thread
-    Info single_info;
-    std::vector<Info> info(threadNumber_, single_info);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(auc_accum_thread,
-                               &Y,
-                               &pred,
-                               &(info[i]),
-                               start_idx,
-                               end_idx));
+    if (bucket_.size() < pred.size()) {
+      bucket_.resize(pred.size());
     }
-    // Wait all thread finish their job
-    pool_->Sync(threadNumber_);
-    for (index_t i = 0; i < info.size(); ++i) {
-      for (index_t j = 0; j < kMaxBucketSize; ++j) {
-        all_positive_number_[j] += info[i].positive_vec_[j];
-        all_negative_number_[j] += info[i].negative_vec_[j];
+    // multi-thread
+    pool_->ParallelFor(0, pred.size(), kMetricGrain,
+      [&](size_t start_idx, size_t end_idx) {
+        auc_bucket_thread(&pred, &bucket_, start_idx, end_idx);
+    });
+    for (size_t i = 0; i < pred.size(); ++i) {
+      if (Y[i] > 0) {
+        all_positive_number_[bucket_[i]] += 1;
+      } else {
+        all_negative_number_[bucket_[i]] += 1;
       }
-    } 
+    }
   }
   
   // Reset counters
   void Reset() {
-    all_positive_number_.clear();
-    all_negative_number_.clear();
-    all_positive_number_.resize(kMaxBucketSize, 0);
-    all_negative_number_.resize(kMaxBucketSize, 0);
+    std::fill(all_positive_number_.begin(), 
+              all_positive_number_.end(), 0);
+    std::fill(all_negative_number_.begin(), 
+              all_negative_number_.end(), 0);
   }
 
   // Return AUC
   real_t GetMetric() {
-    return CalcAUC(all_positive_number_, 
-                   all_negative_number_);
+    return CalcBucketAUC(all_positive_number_, 
+                         all_negative_number_);
   }
 
   // Metric type
@@ -537,27 +526,8 @@ class AUCMetric : public Metric {
  protected:
   std::vector<index_t> all_positive_number_;
   std::vector<index_t> all_negative_number_;
-
-  real_t CalcAUC(std::vector<index_t> positive_vec,
-                 std::vector<index_t> negative_vec) {
-    CHECK_EQ(positive_vec.size(), negative_vec.size());
-    long long positive_sum = 0;
-    long long negative_sum= 0;
-    long long pre_positive_sum = 0.0;
-    long long positivesum_dot_negativesum = 0;
-    double auc = 0.0;
-    double auc_res = 0.0;
-    for (index_t i = 0; i < kMaxBucketSize; ++i) {
-      pre_positive_sum = positive_sum;
-      positive_sum += all_positive_number_[i];
-      negative_sum += all_negative_number_[i];
-      auc += (pre_positive_sum + positive_sum) * 
-             (double)(all_negative_number_[i]) * 1.0 / 2;
-    }
-    positivesum_dot_negativesum = positive_sum * negative_sum;
-    auc_res = auc / (positivesum_dot_negativesum);
-    return 1.0 - auc_res;
-  }
+  /* Bucket of each example in current mini-batch */
+  std::vector<index_t> bucket_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(AUCMetric);
@@ -601,22 +571,12 @@ class MAEMetric : public Metric {
     CHECK_EQ(Y.size(), pred.size());
     total_example_ += Y.size();
     // multi-thread training
-    std::vector<real_t> sum(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(mae_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum.size(); ++i) {
-      error_ += sum[i];
-    }
+    error_ = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      error_, [&](size_t start_idx, size_t end_idx) {
+        real_t sum = 0;
+        mae_accum_thread(&Y, &pred, &sum, start_idx, end_idx);
+        return sum;
+    });
   }
 
   // Reset counters
@@ -675,22 +635,12 @@ class MAPEMetric : public Metric {
     CHECK_EQ(Y.size(), pred.size());
     total_example_ += Y.size();
     // multi-thread training
-    std::vector<real_t> sum(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(mae_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum.size(); ++i) {
-      error_ += sum[i];
-    }
+    error_ = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      error_, [&](size_t start_idx, size_t end_idx) {
+        real_t sum = 0;
+        mae_accum_thread(&Y, &pred, &sum, start_idx, end_idx);
+        return sum;
+    });
   }
 
   // Reset counters
@@ -751,22 +701,12 @@ class RMSDMetric : public Metric {
     CHECK_EQ(Y.size(), pred.size());
     total_example_ += Y.size();
     // multi-thread training
-    std::vector<real_t> sum(threadNumber_, 0);
-    for (int i = 0; i < threadNumber_; ++i) {
-      size_t start_idx = getStart(pred.size(), threadNumber_, i);
-      size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-      pool_->enqueue(std::bind(rmsd_accum_thread,
-                               &Y,
-                               &pred,
-                               &(sum[i]),
-                               start_idx,
-                               end_idx));
-    }
-    // Wait all of the threads finish their job
-    pool_->Sync(threadNumber_);
-    for (size_t i = 0; i < sum.size(); ++i) {
-      error_ += sum[i];
-    }
+    error_ = pool_->ParallelReduce(0, pred.size(), kMetricGrain,
+      error_, [&](size_t start_idx, size_t end_idx) {
+        real_t sum = 0;
+        rmsd_accum_thread(&Y, &pred, &sum, start_idx, end_idx);
+        return sum;
+    });
   }
 
   // Reset counters
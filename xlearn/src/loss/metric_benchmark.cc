@@ -0,0 +1,158 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the benchmark of the evaluation metrics. It reports the
+time of computing 'acc', 'prec', 'recall', 'f1', 'auc' and 'logloss'
+by one Metric for each of them, and by the MultiMetric in one pass:
+
+  ./metric_benchmark [num_example_M] [thread_number]
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
+#include "src/base/timer.h"
+#include "src/loss/metric.h"
+#include "src/loss/multi_metric.h"
+
+using namespace xLearn;
+
+const size_t kBatchSize = 100000;
+const int kRepeat = 3;
+
+const char* kNames[] = { "acc", "prec", "recall", "f1", "auc", "logloss" };
+const size_t kNumMetric = 6;
+
+// Run the evaluation of all the batches and return the seconds.
+template <typename Func>
+real_t run(Func func) {
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    func();
+  }
+  return timer.toc() / kRepeat;
+}
+
+void print_result(const std::string& method,
+                  real_t sec,
+                  real_t base,
+                  const std::vector<real_t>& value) {
+  std::vector<std::string> column;
+  std::vector<int> width = { 20, 14, 10, 44 };
+  column.push_back(method);
+  column.push_back(StringPrintf("%.3f", sec));
+  column.push_back(StringPrintf("%.2fx", base / sec));
+  std::string str;
+  for (size_t i = 0; i < value.size(); ++i) {
+    str += StringPrintf("%.4f ", value[i]);
+  }
+  column.push_back(str);
+  print_row(column, width);
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_example = (argc > 1 ? atoi(argv[1]) : 10) * 1000000;
+  size_t thread_number = argc > 2 ? atoi(argv[2]) :
+                         std::thread::hardware_concurrency();
+  if (thread_number == 0) { thread_number = 1; }
+  print_info(StringPrintf("Examples: %d, threads: %d",
+                          (int)num_example, (int)thread_number));
+  ThreadPool pool(thread_number);
+  // Scores that are related to the labels
+  size_t num_batch = (num_example + kBatchSize - 1) / kBatchSize;
+  std::vector<std::vector<real_t> > Y(num_batch), pred(num_batch);
+  for (size_t b = 0; b < num_batch; ++b) {
+    size_t len = std::min(kBatchSize, num_example - b * kBatchSize);
+    Y[b].resize(len);
+    pred[b].resize(len);
+    for (size_t i = 0; i < len; ++i) {
+      Y[b][i] = (rand() % 4 == 0) ? 1.0 : -1.0;
+      pred[b][i] = (rand() % 10000) / 2000.0 - 3.0 + Y[b][i] * 0.5;
+    }
+  }
+  std::vector<std::string> column;
+  std::vector<int> width = { 20, 14, 10, 44 };
+  column.push_back("Method");
+  column.push_back("Time (sec)");
+  column.push_back("Speedup");
+  column.push_back("acc prec recall f1 auc logloss");
+  print_row(column, width);
+
+  // One Metric for each of them. There is no Metric
+  // class of logloss, so it is given by the Loss.
+  std::vector<Metric*> metric;
+  for (size_t m = 0; m < kNumMetric - 1; ++m) {
+    metric.push_back(CREATE_METRIC(kNames[m]));
+    metric.back()->Initialize(&pool);
+  }
+  std::vector<real_t> value(kNumMetric);
+  real_t base = run([&]() {
+    for (size_t m = 0; m < metric.size(); ++m) {
+      metric[m]->Reset();
+    }
+    double logloss = 0;
+    for (size_t b = 0; b < num_batch; ++b) {
+      for (size_t m = 0; m < metric.size(); ++m) {
+        metric[m]->Accumulate(Y[b], pred[b]);
+      }
+      logloss = pool.ParallelReduce(0, pred[b].size(), kMetricGrain,
+        logloss, [&](size_t start, size_t end) {
+          double sum = 0;
+          for (size_t i = start; i < end; ++i) {
+            sum += log1p(exp(-Y[b][i] * pred[b][i]));
+          }
+          return sum;
+      });
+    }
+    for (size_t m = 0; m < metric.size(); ++m) {
+      value[m] = metric[m]->GetMetric();
+    }
+    value[kNumMetric-1] = logloss / num_example;
+  });
+  print_result("separate", base, base, value);
+  for (size_t m = 0; m < metric.size(); ++m) {
+    delete metric[m];
+  }
+
+  // All of them in one pass
+  std::vector<std::string> list(kNames, kNames + kNumMetric);
+  for (int exact = 0; exact < 2; ++exact) {
+    MultiMetric multi;
+    multi.Initialize(&pool);
+    multi.SetMetricList(list, exact == 1);
+    real_t sec = run([&]() {
+      multi.Reset();
+      for (size_t b = 0; b < num_batch; ++b) {
+        multi.Accumulate(Y[b], pred[b]);
+      }
+      multi.GetMetricList(&value);
+    });
+    print_result(exact ? "fused (exact AUC)" : "fused", sec, base, value);
+  }
+
+  return 0;
+}
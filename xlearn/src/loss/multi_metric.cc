@@ -0,0 +1,334 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the MultiMetric class.
+*/
+
+#include "src/loss/multi_metric.h"
+
+#include <math.h>
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "src/base/split_string.h"
+
+namespace xLearn {
+
+/* Number of slots of each thread in Accumulate() */
+static const size_t kSlotPerThread = 4;
+/* Minimal number of scores sorted by one task */
+static const size_t kSortGrain = 65536;
+
+static const char* kMetricName[] = {
+  "acc", "prec", "recall", "f1", "auc", "logloss", "mae", "mape", "rmsd"
+};
+
+bool SplitMetricList(const std::string& str,
+                     std::vector<std::string>* list) {
+  CHECK_NOTNULL(list);
+  list->clear();
+  std::vector<std::string> name;
+  SplitStringUsing(str, ",", &name);
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (name[i] == "none") { continue; }
+    if (name[i] == "rmse") { name[i] = "rmsd"; }
+    bool found = false;
+    for (size_t j = 0; j < sizeof(kMetricName) / sizeof(char*); ++j) {
+      if (name[i] == kMetricName[j]) { found = true; }
+    }
+    if (!found) { return false; }
+    // Each metric is shown only once
+    if (std::find(list->begin(), list->end(), name[i]) == list->end()) {
+      list->push_back(name[i]);
+    }
+  }
+  return true;
+}
+
+std::string JoinMetricList(const std::vector<std::string>& list) {
+  if (list.empty()) { return "none"; }
+  std::string str = list[0];
+  for (size_t i = 1; i < list.size(); ++i) {
+    str += "," + list[i];
+  }
+  return str;
+}
+
+bool IsClassificationMetric(const std::string& name) {
+  return name == "acc" || name == "prec" || name == "recall" ||
+         name == "f1" || name == "logloss";
+}
+
+bool IsRegressionMetric(const std::string& name) {
+  return name == "mae" || name == "mape" ||
+         name == "rmsd" || name == "rmse";
+}
+
+void MultiMetric::SetMetricList(const std::vector<std::string>& list,
+                                bool exact_auc) {
+  CHECK(!list.empty());
+  name_ = list;
+  exact_auc_ = exact_auc;
+  has_auc_ = false;
+  has_logloss_ = false;
+  has_error_ = false;
+  for (size_t i = 0; i < name_.size(); ++i) {
+    if (name_[i] == "auc") {
+      has_auc_ = true;
+    } else if (name_[i] == "logloss") {
+      has_logloss_ = true;
+    } else if (IsRegressionMetric(name_[i])) {
+      has_error_ = true;
+    }
+  }
+  if (has_auc_ && !exact_auc_) {
+    positive_bucket_.assign(kMaxBucketSize, 0);
+    negative_bucket_.assign(kMaxBucketSize, 0);
+  }
+  Reset();
+}
+
+// All the counters are accumulated in local variables,
+// and written to the slot once.
+void MultiMetric::accum_slot(const std::vector<real_t>& Y,
+                             const std::vector<real_t>& pred,
+                             size_t score_offset,
+                             MetricCounter* counter,
+                             size_t start_idx,
+                             size_t end_idx) {
+  CHECK_GE(end_idx, start_idx);
+  MetricCounter count;
+  count.total = end_idx - start_idx;
+  for (size_t i = start_idx; i < end_idx; ++i) {
+    real_t y = Y[i];
+    real_t p = pred[i];
+    bool positive = y > 0;
+    if (p > 0) {
+      if (positive) { count.true_pos++; } else { count.false_pos++; }
+    } else {
+      if (positive) { count.false_neg++; } else { count.true_neg++; }
+    }
+    if (has_logloss_) {
+      // log(1 + exp(-z)) without overflow
+      real_t z = positive ? p : -p;
+      count.logloss += z > 0 ? log1p(exp(-z)) : log1p(exp(z)) - z;
+    }
+    if (has_error_) {
+      real_t error = y - p;
+      real_t abs_error = error > 0 ? error : -error;
+      count.abs_error += abs_error;
+      count.ape += abs_error / y;
+      count.sq_error += error * error;
+    }
+    if (has_auc_) {
+      if (exact_auc_) {
+        ScoreLabel& s = score_[score_offset + i];
+        s.score = p;
+        s.positive = positive;
+      } else {
+        bucket_[i] = AUCBucket(p);
+      }
+    }
+  }
+  *counter = count;
+}
+
+void MultiMetric::Accumulate(const std::vector<real_t>& Y,
+                             const std::vector<real_t>& pred) {
+  CHECK_EQ(Y.size(), pred.size());
+  CHECK(!name_.empty());
+  size_t len = pred.size();
+  if (len == 0) { return; }
+  if (slot_.empty()) {
+    slot_.resize(threadNumber_ * kSlotPerThread);
+  }
+  size_t num = (len + kMetricGrain - 1) / kMetricGrain;
+  num = std::min(num, slot_.size());
+  // The buffers only grow, so they are not
+  // reallocated in the following epochs.
+  size_t offset = score_.size();
+  if (has_auc_ && exact_auc_) {
+    score_.resize(offset + len);
+    sorted_ = false;
+  } else if (has_auc_ && bucket_.size() < len) {
+    bucket_.resize(len);
+  }
+  pool_->ParallelFor(0, num, 1, [&](size_t start, size_t end) {
+    for (size_t s = start; s < end; ++s) {
+      accum_slot(Y, pred, offset, &slot_[s],
+                 getStart(len, num, s),
+                 getEnd(len, num, s));
+    }
+  });
+  for (size_t s = 0; s < num; ++s) {
+    total_ += slot_[s];
+  }
+  // The histogram is too large to have a copy for each slot
+  if (has_auc_ && !exact_auc_) {
+    for (size_t i = 0; i < len; ++i) {
+      if (Y[i] > 0) {
+        positive_bucket_[bucket_[i]]++;
+      } else {
+        negative_bucket_[bucket_[i]]++;
+      }
+    }
+  }
+}
+
+void MultiMetric::Reset() {
+  total_.Reset();
+  score_.clear();
+  sorted_ = true;
+  std::fill(positive_bucket_.begin(), positive_bucket_.end(), 0);
+  std::fill(negative_bucket_.begin(), negative_bucket_.end(), 0);
+}
+
+// Each task sorts a run of score_, and then the runs
+// are merged in pairs until there is only one run.
+real_t MultiMetric::exact_auc() {
+  size_t len = score_.size();
+  if (!sorted_) {
+    size_t num = (len + kSortGrain - 1) / kSortGrain;
+    num = std::max((size_t)1,
+                   std::min(num, threadNumber_ * kSlotPerThread));
+    auto bound = [&](size_t id) {
+      return id >= num ? len : getStart(len, num, id);
+    };
+    ScoreLabel* data = score_.data();
+    pool_->ParallelFor(0, num, 1, [&](size_t start, size_t end) {
+      for (size_t r = start; r < end; ++r) {
+        std::sort(data + bound(r), data + bound(r+1));
+      }
+    });
+    if (num > 1) {
+      merge_buf_.resize(len);
+      ScoreLabel* src = data;
+      ScoreLabel* dst = merge_buf_.data();
+      for (size_t width = 1; width < num; width *= 2) {
+        size_t pairs = (num + 2 * width - 1) / (2 * width);
+        pool_->ParallelFor(0, pairs, 1, [&](size_t start, size_t end) {
+          for (size_t p = start; p < end; ++p) {
+            size_t lo = bound(p * 2 * width);
+            size_t mid = bound(p * 2 * width + width);
+            size_t hi = bound(p * 2 * width + 2 * width);
+            std::merge(src + lo, src + mid, src + mid,
+                       src + hi, dst + lo);
+          }
+        });
+        std::swap(src, dst);
+      }
+      if (src != data) { score_.swap(merge_buf_); }
+    }
+    sorted_ = true;
+  }
+  // Count the pairs of positive and negative examples in which the
+  // positive one has a larger score. A tie is counted as half a pair.
+  double auc = 0;
+  double positive_sum = 0;
+  double negative_sum = 0;
+  for (size_t i = 0; i < len;) {
+    double positive = 0;
+    double negative = 0;
+    size_t j = i;
+    for (; j < len && score_[j].score == score_[i].score; ++j) {
+      if (score_[j].positive) { positive++; } else { negative++; }
+    }
+    auc += positive * (negative_sum + 0.5 * negative);
+    positive_sum += positive;
+    negative_sum += negative;
+    i = j;
+  }
+  // The AUC is undefined if there is only one class
+  if (positive_sum == 0 || negative_sum == 0) { return 0.5; }
+  return auc / (positive_sum * negative_sum);
+}
+
+real_t MultiMetric::get_value(const std::string& name) {
+  double total = total_.total;
+  double tp = total_.true_pos;
+  if (name == "acc") {
+    return (tp + total_.true_neg) / total;
+  } else if (name == "prec") {
+    return tp / (tp + total_.false_pos);
+  } else if (name == "recall") {
+    return tp / (tp + total_.false_neg);
+  } else if (name == "f1") {
+    return tp * 2.0 / (tp * 2.0 + total_.false_pos + total_.false_neg);
+  } else if (name == "auc") {
+    return exact_auc_ ? exact_auc() :
+           CalcBucketAUC(positive_bucket_, negative_bucket_);
+  } else if (name == "logloss") {
+    return total_.logloss / total;
+  } else if (name == "mae") {
+    return total_.abs_error / total;
+  } else if (name == "mape") {
+    return total_.ape / total;
+  } else if (name == "rmsd") {
+    return sqrt(total_.sq_error / total);
+  }
+  LOG(FATAL) << "Unknow metric: " << name;
+  return 0;
+}
+
+void MultiMetric::GetMetricList(std::vector<real_t>* value) {
+  CHECK_NOTNULL(value);
+  value->resize(name_.size());
+  for (size_t i = 0; i < name_.size(); ++i) {
+    (*value)[i] = get_value(name_[i]);
+  }
+}
+
+void MultiMetric::MetricTypeList(std::vector<std::string>* type) {
+  CHECK_NOTNULL(type);
+  type->resize(name_.size());
+  for (size_t i = 0; i < name_.size(); ++i) {
+    const std::string& name = name_[i];
+    if (name == "acc") {
+      (*type)[i] = "Accuarcy";
+    } else if (name == "prec") {
+      (*type)[i] = "Precision";
+    } else if (name == "recall") {
+      (*type)[i] = "Recall";
+    } else if (name == "f1") {
+      (*type)[i] = "F1";
+    } else if (name == "auc") {
+      (*type)[i] = exact_auc_ ? "AUC (exact)" : "AUC";
+    } else if (name == "logloss") {
+      (*type)[i] = "Logloss";
+    } else {
+      // MAE, MAPE, and RMSD
+      (*type)[i] = name;
+      std::transform(name.begin(), name.end(),
+                     (*type)[i].begin(), ::toupper);
+    }
+  }
+}
+
+real_t MultiMetric::GetMetric() {
+  CHECK(!name_.empty());
+  return get_value(name_[0]);
+}
+
+std::string MultiMetric::metric_type() {
+  std::vector<std::string> type;
+  MetricTypeList(&type);
+  return type[0];
+}
+
+}  // namespace xLearn
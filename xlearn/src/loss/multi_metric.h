@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the MultiMetric class, which computes several
+evaluation metrics in one pass over the predictions.
+*/
+
+#ifndef XLEARN_LOSS_MULTI_METRIC_H_
+#define XLEARN_LOSS_MULTI_METRIC_H_
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/loss/metric.h"
+
+namespace xLearn {
+
+// Split the metric option, such as "auc,logloss,acc", into the metric
+// names, where "rmse" is renamed to "rmsd". Return false if any name is
+// unknown. "none" gives an empty list.
+bool SplitMetricList(const std::string& str,
+                     std::vector<std::string>* list);
+
+// Join the metric names by ','. An empty list gives "none".
+std::string JoinMetricList(const std::vector<std::string>& list);
+
+// Return true if the metric can only be used in classification
+bool IsClassificationMetric(const std::string& name);
+
+// Return true if the metric can only be used in regression
+bool IsRegressionMetric(const std::string& name);
+
+//------------------------------------------------------------------------------
+// The counters of all the metrics of MultiMetric, which are accumulated
+// for a part of the examples and then merged by +=.
+//------------------------------------------------------------------------------
+struct MetricCounter {
+  MetricCounter() { Reset(); }
+  void Reset() {
+    total = 0;
+    true_pos = false_pos = true_neg = false_neg = 0;
+    logloss = abs_error = ape = sq_error = 0;
+  }
+  MetricCounter& operator+=(const MetricCounter& other) {
+    total += other.total;
+    true_pos += other.true_pos;
+    false_pos += other.false_pos;
+    true_neg += other.true_neg;
+    false_neg += other.false_neg;
+    logloss += other.logloss;
+    abs_error += other.abs_error;
+    ape += other.ape;
+    sq_error += other.sq_error;
+    return *this;
+  }
+  uint64 total;
+  uint64 true_pos;
+  uint64 false_pos;
+  uint64 true_neg;
+  uint64 false_neg;
+  double logloss;
+  double abs_error;
+  double ape;
+  double sq_error;
+};
+
+// A score and its label, used by the exact AUC
+struct ScoreLabel {
+  real_t score;
+  index_t positive;
+  bool operator<(const ScoreLabel& other) const {
+    return score < other.score;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Each of the Metric classes in metric.h needs a pass over the predictions,
+// and AUCMetric gives an approximate result. MultiMetric computes the
+// metrics 'acc', 'prec', 'recall', 'f1', 'auc', 'logloss', 'mae', 'mape'
+// and 'rmsd' together:
+//
+//   (1) Each mini-batch is divided into slots, and all the counters of a
+//       slot are accumulated in one pass by one task. The slots are
+//       allocated once and merged after each mini-batch, so Accumulate()
+//       does not allocate memory in the steady state.
+//   (2) The AUC is computed from the histogram of kMaxBucketSize buckets
+//       like AUCMetric, or exactly if exact_auc is true. The exact AUC
+//       keeps all the (score, label) pairs, sorts them in parallel in
+//       GetMetricList(), and handles the tied scores by their mid-rank.
+//       It needs 8 bytes for each example.
+//
+// We can use the MultiMetric class like this:
+//
+//   std::vector<std::string> list;
+//   SplitMetricList("auc,logloss,acc", &list);
+//   MultiMetric metric;
+//   metric.Initialize(pool);
+//   metric.SetMetricList(list, true);
+//   metric.Accumulate(Y, pred);  /* for each mini-batch */
+//   std::vector<real_t> value;
+//   metric.GetMetricList(&value);  /* AUC, logloss, and accuracy */
+//------------------------------------------------------------------------------
+class MultiMetric : public Metric {
+ public:
+  // Constructor and Destructor
+  MultiMetric()
+   : exact_auc_(false),
+     has_auc_(false),
+     has_logloss_(false),
+     has_error_(false),
+     sorted_(true) { }
+  ~MultiMetric() { }
+
+  // Set the metrics to compute. The list cannot be empty.
+  void SetMetricList(const std::vector<std::string>& list,
+                     bool exact_auc = false);
+
+  // Accumulate counters during the training.
+  void Accumulate(const std::vector<real_t>& Y,
+                  const std::vector<real_t>& pred);
+
+  // Reset counters
+  void Reset();
+
+  // Return the first metric value.
+  real_t GetMetric();
+
+  // Return the first metric type.
+  std::string metric_type();
+
+  // Return all the metric values and their types.
+  void GetMetricList(std::vector<real_t>* value);
+  void MetricTypeList(std::vector<std::string>* type);
+
+ protected:
+  /* Name of each metric */
+  std::vector<std::string> name_;
+  /* Compute the exact AUC ? */
+  bool exact_auc_;
+  /* Is the AUC in the list ? */
+  bool has_auc_;
+  /* Is the logloss in the list ? */
+  bool has_logloss_;
+  /* Are the regression metrics in the list ? */
+  bool has_error_;
+  /* Is score_ sorted ? */
+  bool sorted_;
+  /* Counters of all the examples */
+  MetricCounter total_;
+  /* Counters of each slot of current mini-batch */
+  std::vector<MetricCounter> slot_;
+  /* Histograms of the approximate AUC */
+  std::vector<index_t> positive_bucket_;
+  std::vector<index_t> negative_bucket_;
+  /* Bucket of each example in current mini-batch */
+  std::vector<index_t> bucket_;
+  /* (score, label) of all the examples for the exact AUC */
+  std::vector<ScoreLabel> score_;
+  /* Buffer used to merge the sorted runs of score_ */
+  std::vector<ScoreLabel> merge_buf_;
+
+  // Accumulate the counters of [start_idx, end_idx).
+  void accum_slot(const std::vector<real_t>& Y,
+                  const std::vector<real_t>& pred,
+                  size_t score_offset,
+                  MetricCounter* counter,
+                  size_t start_idx,
+                  size_t end_idx);
+
+  // Sort score_ in parallel and return the exact AUC.
+  real_t exact_auc();
+
+  // Return the value of the given metric.
+  real_t get_value(const std::string& name);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MultiMetric);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_LOSS_MULTI_METRIC_H_
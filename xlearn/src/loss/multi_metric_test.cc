@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the MultiMetric class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "src/base/common.h"
+#include "src/base/thread_pool.h"
+#include "src/loss/metric.h"
+#include "src/loss/multi_metric.h"
+
+namespace xLearn {
+
+// Generate the labels and the scores that are related to the labels
+void random_pred(size_t len, int level,
+                 std::vector<real_t>* Y,
+                 std::vector<real_t>* pred) {
+  Y->resize(len);
+  pred->resize(len);
+  for (size_t i = 0; i < len; ++i) {
+    (*Y)[i] = (rand() % 2) ? 1.0 : -1.0;
+    // Only a few levels of score, so there are many ties
+    (*pred)[i] = (rand() % level) * 0.1 - level * 0.05 + (*Y)[i] * 0.2;
+  }
+}
+
+// The AUC by comparing all the pairs
+real_t naive_auc(const std::vector<real_t>& Y,
+                 const std::vector<real_t>& pred) {
+  double count = 0;
+  double pairs = 0;
+  for (size_t i = 0; i < Y.size(); ++i) {
+    if (Y[i] <= 0) { continue; }
+    for (size_t j = 0; j < Y.size(); ++j) {
+      if (Y[j] > 0) { continue; }
+      pairs++;
+      if (pred[i] > pred[j]) {
+        count += 1;
+      } else if (pred[i] == pred[j]) {
+        count += 0.5;
+      }
+    }
+  }
+  return count / pairs;
+}
+
+TEST(MultiMetricTest, Split_Metric_List) {
+  std::vector<std::string> list;
+  EXPECT_TRUE(SplitMetricList("auc,logloss,acc", &list));
+  ASSERT_EQ(list.size(), 3);
+  EXPECT_EQ(list[0], "auc");
+  EXPECT_EQ(list[1], "logloss");
+  EXPECT_EQ(list[2], "acc");
+  EXPECT_TRUE(SplitMetricList("rmse,mae,rmsd", &list));
+  ASSERT_EQ(list.size(), 2);
+  EXPECT_EQ(list[0], "rmsd");
+  EXPECT_EQ(JoinMetricList(list), "rmsd,mae");
+  EXPECT_TRUE(SplitMetricList("none", &list));
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(JoinMetricList(list), "none");
+  EXPECT_FALSE(SplitMetricList("auc,unknow", &list));
+}
+
+// Compare MultiMetric with one Metric for each of the names
+void check_same_as_metric(const std::vector<std::string>& list,
+                          real_t label_shift) {
+  ThreadPool pool(4);
+  size_t num = list.size();
+  std::vector<Metric*> metric(num);
+  for (size_t i = 0; i < num; ++i) {
+    metric[i] = CREATE_METRIC(list[i].c_str());
+    metric[i]->Initialize(&pool);
+  }
+  MultiMetric multi;
+  multi.Initialize(&pool);
+  multi.SetMetricList(list);
+  std::vector<real_t> Y, pred;
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    for (size_t i = 0; i < num; ++i) {
+      metric[i]->Reset();
+    }
+    multi.Reset();
+    // Mini-batches of different size
+    for (size_t len = 1; len < 100000; len *= 7) {
+      random_pred(len, 20, &Y, &pred);
+      for (size_t i = 0; i < len; ++i) { Y[i] += label_shift; }
+      for (size_t i = 0; i < num; ++i) {
+        metric[i]->Accumulate(Y, pred);
+      }
+      multi.Accumulate(Y, pred);
+    }
+    std::vector<real_t> value;
+    multi.GetMetricList(&value);
+    std::vector<std::string> type;
+    multi.MetricTypeList(&type);
+    ASSERT_EQ(value.size(), num);
+    for (size_t i = 0; i < num; ++i) {
+      real_t expect = metric[i]->GetMetric();
+      EXPECT_NEAR(value[i], expect, 1e-4 * std::max(1.0f, expect));
+      EXPECT_EQ(type[i], metric[i]->metric_type());
+    }
+    EXPECT_FLOAT_EQ(multi.GetMetric(), value[0]);
+    EXPECT_EQ(multi.metric_type(), type[0]);
+  }
+  for (size_t i = 0; i < num; ++i) {
+    delete metric[i];
+  }
+}
+
+TEST(MultiMetricTest, Same_As_Metric) {
+  std::vector<std::string> list;
+  SplitMetricList("acc,prec,recall,f1,auc", &list);
+  check_same_as_metric(list, 0);
+  // Labels for MAPE should not be zero
+  SplitMetricList("mae,mape,rmsd", &list);
+  check_same_as_metric(list, 3.0);
+}
+
+TEST(MultiMetricTest, Logloss) {
+  ThreadPool pool(2);
+  std::vector<real_t> Y = {1.0, -1.0, 1.0, 0.0};
+  std::vector<real_t> pred = {2.0, 0.5, -100.0, -1.0};
+  MultiMetric metric;
+  metric.Initialize(&pool);
+  metric.SetMetricList(std::vector<std::string>(1, "logloss"));
+  metric.Accumulate(Y, pred);
+  real_t expect = (log1p(exp(-2.0)) + log1p(exp(0.5)) +
+                   100.0 + log1p(exp(-1.0))) / 4;
+  EXPECT_NEAR(metric.GetMetric(), expect, 1e-4);
+  EXPECT_EQ(metric.metric_type(), "Logloss");
+}
+
+TEST(MultiMetricTest, Exact_AUC) {
+  ThreadPool pool(4);
+  MultiMetric metric;
+  metric.Initialize(&pool);
+  metric.SetMetricList(std::vector<std::string>(1, "auc"), true);
+  EXPECT_EQ(metric.metric_type(), "AUC (exact)");
+  std::vector<real_t> Y = {-1.0, -1.0, 1.0, 1.0};
+  std::vector<real_t> pred = {0.1, 0.4, 0.35, 0.8};
+  metric.Accumulate(Y, pred);
+  EXPECT_FLOAT_EQ(metric.GetMetric(), 0.75);
+  // Many ties, and enough scores to merge the sorted runs
+  std::vector<real_t> all_Y, all_pred;
+  for (int level = 3; level <= 1000; level *= 10) {
+    metric.Reset();
+    all_Y.clear();
+    all_pred.clear();
+    for (size_t b = 0; b < 4; ++b) {
+      random_pred(1000 + b * 700, level, &Y, &pred);
+      metric.Accumulate(Y, pred);
+      all_Y.insert(all_Y.end(), Y.begin(), Y.end());
+      all_pred.insert(all_pred.end(), pred.begin(), pred.end());
+    }
+    EXPECT_NEAR(metric.GetMetric(), naive_auc(all_Y, all_pred), 1e-5);
+    // The sorted scores give the same result
+    EXPECT_NEAR(metric.GetMetric(), naive_auc(all_Y, all_pred), 1e-5);
+  }
+  metric.Reset();
+  random_pred(1000000, 100, &Y, &pred);
+  metric.Accumulate(Y, pred);
+  real_t exact = metric.GetMetric();
+  AUCMetric bucket;
+  bucket.Initialize(&pool);
+  bucket.Accumulate(Y, pred);
+  EXPECT_NEAR(exact, bucket.GetMetric(), 1e-3);
+}
+
+}  // namespace xLearn
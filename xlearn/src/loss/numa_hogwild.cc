@@ -0,0 +1,319 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the NumaHogwild class.
+*/
+
+#include "src/loss/numa_hogwild.h"
+
+#include <string.h>
+
+#include <atomic>
+
+namespace xLearn {
+
+/* Number of float copied or averaged by one task */
+static const size_t kAverageGrain = 16384;
+
+// The position of the next chunk of a node in run_nodes().
+// Each cursor is in its own cache line, so the nodes do
+// not share the cache line.
+struct NodeCursor {
+  std::atomic<size_t> next;
+  char pad[64 - sizeof(std::atomic<size_t>)];
+};
+
+// Bind current thread to the CPUs of node, which is
+// skipped if the thread is already bound to it.
+static void bind_node(const NumaNode& node) {
+  static thread_local int bound_id = -1;
+  if (bound_id == node.id) { return; }
+  BindToCPUs(node.cpus);
+  bound_id = node.id;
+}
+
+NumaHogwild::~NumaHogwild() {
+  for (size_t i = 0; i < replicas_.size(); ++i) {
+    delete replicas_[i];
+  }
+}
+
+void NumaHogwild::Initialize(const std::vector<NumaNode>& nodes,
+                             ThreadPool* pool,
+                             index_t sync_rows,
+                             bool group_rows) {
+  CHECK(!nodes.empty());
+  CHECK_NOTNULL(pool);
+  CHECK(nodes_.empty());
+  pool_ = pool;
+  sync_rows_ = sync_rows;
+  group_rows_ = group_rows;
+  size_t thread_number = pool->ThreadNumber();
+  size_t node_num = std::min(nodes.size(), thread_number);
+  // The caller thread trains the model if the pool has no thread
+  if (node_num == 0) { node_num = 1; }
+  if (thread_number < node_num) { thread_number = node_num; }
+  nodes_.assign(nodes.begin(), nodes.begin() + node_num);
+  size_t total_cpu = 0;
+  for (size_t n = 0; n < node_num; ++n) {
+    total_cpu += nodes_[n].cpus.size();
+  }
+  size_t assigned = 0;
+  for (size_t n = 0; n < node_num; ++n) {
+    size_t num = 0;
+    if (n == node_num - 1) {
+      num = thread_number - assigned;
+    } else if (total_cpu > 0) {
+      num = thread_number * nodes_[n].cpus.size() / total_cpu;
+    }
+    // Keep at least one thread for each of the remaining nodes
+    size_t remain = node_num - n - 1;
+    num = std::min(num, thread_number - assigned - remain);
+    if (num == 0) { num = 1; }
+    assigned += num;
+    node_thread_.push_back(num);
+    // The memory of replica is allocated in the first broadcast()
+    // by a thread of this node.
+    replicas_.push_back(node_num > 1 ? new Model() : nullptr);
+  }
+}
+
+// The key of a row is its feature that appears in the most rows of
+// current mini-batch. The rows are sorted by the key in a stable way,
+// so the rows with the same key are still in the shuffled order.
+const index_t* NumaHogwild::group_rows(const DMatrix* matrix,
+                                       Model& model) {
+  order_.clear();
+  if (!group_rows_) { return nullptr; }
+  size_t row_len = matrix->row_length;
+  index_t num_feat = model.GetNumFeature();
+  if (feat_count_.size() < num_feat) {
+    feat_count_.resize(num_feat, 0);
+  }
+  for (size_t i = 0; i < row_len; ++i) {
+    const SparseRow& row = matrix->row[i];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      if (it->feat_id < num_feat) { feat_count_[it->feat_id]++; }
+    }
+  }
+  key_.resize(row_len);
+  for (size_t i = 0; i < row_len; ++i) {
+    const SparseRow& row = matrix->row[i];
+    index_t key = 0;
+    index_t max_count = 0;
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      if (it->feat_id >= num_feat) { continue; }
+      index_t count = feat_count_[it->feat_id];
+      if (count > max_count ||
+         (count == max_count && it->feat_id < key)) {
+        max_count = count;
+        key = it->feat_id;
+      }
+    }
+    key_[i] = key;
+  }
+  // Clear the counters for next mini-batch
+  for (size_t i = 0; i < row_len; ++i) {
+    const SparseRow& row = matrix->row[i];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      if (it->feat_id < num_feat) { feat_count_[it->feat_id] = 0; }
+    }
+  }
+  order_.resize(row_len);
+  for (size_t i = 0; i < row_len; ++i) {
+    order_[i] = i;
+  }
+  const std::vector<index_t>& key = key_;
+  std::stable_sort(order_.begin(), order_.end(),
+    [&key](index_t a, index_t b) { return key[a] < key[b]; });
+  return order_.data();
+}
+
+real_t NumaHogwild::run_nodes(
+    const std::vector<size_t>& range, size_t grain,
+    const std::function<real_t(size_t, size_t, size_t)>& task) {
+  size_t node_num = nodes_.size();
+  CHECK_EQ(range.size(), node_num + 1);
+  // The result of each chunk, which is summed in order
+  std::vector<size_t> first(node_num + 1, 0);
+  for (size_t n = 0; n < node_num; ++n) {
+    first[n+1] = first[n] + (range[n+1] - range[n] + grain - 1) / grain;
+  }
+  std::vector<real_t> result(first[node_num], 0);
+  std::vector<NodeCursor> cursor(node_num);
+  for (size_t n = 0; n < node_num; ++n) {
+    cursor[n].next.store(range[n]);
+  }
+  // The caller thread only waits, so the training
+  // uses the same number of threads as the pool.
+  std::vector<std::future<void> > done;
+  for (size_t n = 0; n < node_num; ++n) {
+    for (size_t t = 0; t < node_thread_[n]; ++t) {
+      done.push_back(pool_->enqueue([&, n]() {
+        bind_node(nodes_[n]);
+        for (;;) {
+          size_t start = cursor[n].next.fetch_add(grain);
+          if (start >= range[n+1]) { break; }
+          size_t end = std::min(range[n+1], start + grain);
+          result[first[n] + (start - range[n]) / grain] =
+            task(n, start, end);
+        }
+      }));
+    }
+  }
+  for (size_t i = 0; i < done.size(); ++i) {
+    done[i].get();
+  }
+  real_t sum = 0;
+  for (size_t i = 0; i < result.size(); ++i) {
+    sum += result[i];
+  }
+  return sum;
+}
+
+// Each replica is copied by the threads of its own node,
+// so the first copy also places the replica on that node.
+void NumaHogwild::broadcast(Model& model) {
+  size_t node_num = nodes_.size();
+  size_t w_len = model.GetNumParameter_w();
+  size_t v_len = model.GetNumParameter_v();
+  bool same_shape = true;
+  for (size_t n = 0; n < node_num; ++n) {
+    Model* replica = replicas_[n];
+    same_shape = same_shape &&
+                 replica->GetParameter_w() != nullptr &&
+                 replica->GetNumParameter_w() == w_len &&
+                 replica->GetNumParameter_v() == v_len &&
+                 replica->GetAuxiliarySize() == model.GetAuxiliarySize();
+  }
+  std::vector<size_t> range(node_num + 1);
+  if (!same_shape) {
+    // One task of each node allocates and copies its replica
+    for (size_t n = 0; n <= node_num; ++n) {
+      range[n] = n;
+    }
+    run_nodes(range, 1, [&](size_t n, size_t start, size_t end) {
+      replicas_[n]->CopyFrom(model);
+      return (real_t)0;
+    });
+    return;
+  }
+  // The range of node n is the w and v of its replica
+  size_t total = w_len + v_len;
+  for (size_t n = 0; n <= node_num; ++n) {
+    range[n] = n * total;
+  }
+  const real_t* w = model.GetParameter_w();
+  const real_t* v = model.GetParameter_v();
+  run_nodes(range, kAverageGrain, [&](size_t n, size_t start, size_t end) {
+    start -= n * total;
+    end -= n * total;
+    if (start < w_len) {
+      memcpy(replicas_[n]->GetParameter_w() + start, w + start,
+             (std::min(end, w_len) - start) * sizeof(real_t));
+    }
+    if (end > w_len) {
+      size_t s = std::max(start, w_len) - w_len;
+      memcpy(replicas_[n]->GetParameter_v() + s, v + s,
+             (end - w_len - s) * sizeof(real_t));
+    }
+    return (real_t)0;
+  });
+  size_t aux_size = (size_t)model.GetAuxiliarySize();
+  for (size_t n = 0; n < node_num; ++n) {
+    memcpy(replicas_[n]->GetParameter_b(), model.GetParameter_b(),
+           aux_size * sizeof(real_t));
+  }
+}
+
+// Average param[0], ..., param[num-1] in [start, start + len)
+// into param[num], and copy the average back to the others.
+static void average_range(const std::vector<real_t*>& param,
+                          size_t start, size_t len, real_t inv) {
+  size_t num = param.size() - 1;
+  real_t* dst = param[num];
+  for (size_t i = start; i < start + len; ++i) {
+    real_t sum = 0;
+    for (size_t r = 0; r < num; ++r) {
+      sum += param[r][i];
+    }
+    dst[i] = sum * inv;
+    for (size_t r = 0; r < num; ++r) {
+      param[r][i] = dst[i];
+    }
+  }
+}
+
+// The replicas are the same as the master model for the features
+// that are not in the rows, so only the touched features are
+// averaged. Each node averages one part of these features.
+void NumaHogwild::average(const DMatrix* matrix, Model& model,
+                          const index_t* order,
+                          size_t begin, size_t end) {
+  index_t num_feat = model.GetNumFeature();
+  if (is_touched_.size() < num_feat) {
+    is_touched_.resize(num_feat, false);
+  }
+  touched_.clear();
+  for (size_t k = begin; k < end; ++k) {
+    const SparseRow& row = matrix->row[order == nullptr ? k : order[k]];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      index_t j = it->feat_id;
+      if (j < num_feat && !is_touched_[j]) {
+        is_touched_[j] = true;
+        touched_.push_back(j);
+      }
+    }
+  }
+  size_t node_num = nodes_.size();
+  real_t inv = 1.0f / node_num;
+  // The replicas and then the master model
+  std::vector<real_t*> w(node_num + 1), v(node_num + 1), b(node_num + 1);
+  for (size_t n = 0; n <= node_num; ++n) {
+    Model* m = n < node_num ? replicas_[n] : &model;
+    w[n] = m->GetParameter_w();
+    v[n] = m->GetParameter_v();
+    b[n] = m->GetParameter_b();
+  }
+  size_t w_size = model.GetNumParameter_w() / num_feat;
+  size_t v_size = model.GetNumParameter_v() / num_feat;
+  std::vector<size_t> range(node_num + 1);
+  for (size_t n = 0; n < node_num; ++n) {
+    range[n] = getStart(touched_.size(), node_num, n);
+  }
+  range[node_num] = touched_.size();
+  size_t grain = std::max((size_t)1, kAverageGrain / (w_size + v_size));
+  run_nodes(range, grain, [&](size_t n, size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      index_t j = touched_[i];
+      average_range(w, j * w_size, w_size, inv);
+      average_range(v, j * v_size, v_size, inv);
+    }
+    return (real_t)0;
+  });
+  // The bias is small
+  average_range(b, 0, (size_t)model.GetAuxiliarySize(), inv);
+  for (size_t i = 0; i < touched_.size(); ++i) {
+    is_touched_[touched_[i]] = false;
+  }
+}
+
+}  // namespace xLearn
@@ -0,0 +1,197 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the NumaHogwild class, which is the NUMA-aware
+version of the lock-free (Hogwild) training.
+*/
+
+#ifndef XLEARN_LOSS_NUMA_HOGWILD_H_
+#define XLEARN_LOSS_NUMA_HOGWILD_H_
+
+#include <vector>
+#include <future>
+#include <functional>
+#include <algorithm>
+
+#include "src/base/common.h"
+#include "src/base/numa.h"
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/loss/loss.h"
+
+namespace xLearn {
+
+/* Rows trained by each node between two averaging,
+if the sync_rows of NumaHogwild is 0 */
+const index_t kSyncRowsPerNode = 4096;
+
+//------------------------------------------------------------------------------
+// In the plain lock-free training, all the threads update the same
+// Model, whose memory is on one NUMA node. On a multi-socket machine
+// most of the updates go to the remote memory, and the cache lines of
+// the hot features bounce between the sockets. NumaHogwild avoids this:
+//
+//   (1) The threads of the given thread pool are divided among the
+//       nodes, and each node has a replica of the model. A thread
+//       binds itself to the CPUs of its node when it runs a task of
+//       that node, and the replica is first touched by these tasks,
+//       so the replica is in the local memory of the node.
+//   (2) The rows of a mini-batch are grouped by their hottest feature,
+//       and each node trains a contiguous part of the grouped rows on
+//       its own replica. Hence the rows that update the same hot
+//       features are trained by the same threads.
+//   (3) Every sync_rows rows (kSyncRowsPerNode rows for each node if
+//       sync_rows is 0), the replicas are averaged into the master
+//       model, and the average is copied back to the replicas.
+//
+// The master model is copied to all the replicas once in each Train(),
+// which costs a full pass over the model for each mini-batch. After
+// that, only the features that appear in the rows of a round can be
+// different between the replicas, so the averaging of a round only
+// costs the parameters of these features, and not the whole model.
+//
+// We can use the NumaHogwild class like this:
+//
+//   NumaHogwild numa;
+//   numa.Initialize(GetNumaNodes(), pool, sync_rows);
+//
+//   /* grad(model, order, start, end) trains the rows order[start],
+//   ..., order[end-1] of matrix on model and returns the loss sum.
+//   order is nullptr if the rows are not reordered. */
+//   real_t loss = numa.Train(matrix, model, grad);
+//
+// If there is only one node (or the pool has less than two threads),
+// the master model is trained directly and only the row grouping is
+// used.
+//------------------------------------------------------------------------------
+class NumaHogwild {
+ public:
+  // Constructor and Destructor
+  NumaHogwild() : pool_(nullptr), sync_rows_(0), group_rows_(true) { }
+  ~NumaHogwild();
+
+  // Divide the threads of pool among the given nodes by their
+  // number of CPUs. Each node has at least one thread, so only
+  // the first ThreadNumber() nodes of the pool are used if the
+  // pool has less threads than nodes.
+  void Initialize(const std::vector<NumaNode>& nodes,
+                  ThreadPool* pool,
+                  index_t sync_rows = 0,
+                  bool group_rows = true);
+
+  // Train all the rows of matrix and update the master model.
+  // Return the sum of loss given by grad.
+  template <typename Func>
+  real_t Train(const DMatrix* matrix, Model& model, Func grad);
+
+  // Number of nodes
+  size_t NodeNumber() const { return nodes_.size(); }
+
+  // Number of threads of the given node
+  size_t ThreadNumber(size_t node) const {
+    return node_thread_[node];
+  }
+
+  // The training order of the rows in last Train(),
+  // which is empty if the rows are not grouped.
+  const std::vector<index_t>& Order() const { return order_; }
+
+ protected:
+  /* The threads of all the nodes */
+  ThreadPool* pool_;
+  /* The nodes that are used */
+  std::vector<NumaNode> nodes_;
+  /* Number of threads of each node */
+  std::vector<size_t> node_thread_;
+  /* Model replica of each node */
+  std::vector<Model*> replicas_;
+  /* Number of rows between two averaging */
+  index_t sync_rows_;
+  /* Group the rows by their hottest feature ? */
+  bool group_rows_;
+  /* Training order of the rows */
+  std::vector<index_t> order_;
+  /* Group key of each row */
+  std::vector<index_t> key_;
+  /* Number of rows of each feature in current mini-batch */
+  std::vector<index_t> feat_count_;
+  /* The features of the rows in current round */
+  std::vector<index_t> touched_;
+  /* Is the feature in touched_ ? */
+  std::vector<bool> is_touched_;
+
+  // Group the rows that have the same hottest feature,
+  // and return the new order of rows.
+  const index_t* group_rows(const DMatrix* matrix, Model& model);
+
+  // Run task(node, start, end) on the range of each node in
+  // the threads of that node, and return the sum of results
+  // in the order of ranges. The range of node n is split into
+  // chunks of grain elements, and the threads of the node take
+  // the chunks one by one.
+  real_t run_nodes(const std::vector<size_t>& range, size_t grain,
+                   const std::function<real_t(size_t, size_t, size_t)>& task);
+
+  // Copy the master model to all the replicas.
+  void broadcast(Model& model);
+
+  // Average the parameters of the features of the rows
+  // order[begin], ..., order[end-1] into the master model,
+  // and copy them back to the replicas.
+  void average(const DMatrix* matrix, Model& model,
+               const index_t* order, size_t begin, size_t end);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NumaHogwild);
+};
+
+template <typename Func>
+real_t NumaHogwild::Train(const DMatrix* matrix, Model& model, Func grad) {
+  CHECK_NOTNULL(pool_);
+  size_t row_len = matrix->row_length;
+  const index_t* order = group_rows(matrix, model);
+  size_t node_num = nodes_.size();
+  if (node_num == 1) {
+    return pool_->ParallelReduce(0, row_len, kRowGrain, (real_t)0,
+      [&](size_t start, size_t end) {
+        return grad(&model, order, start, end);
+    });
+  }
+  broadcast(model);
+  size_t round = sync_rows_ > 0 ? sync_rows_ : kSyncRowsPerNode * node_num;
+  std::vector<size_t> range(node_num + 1);
+  real_t loss = 0;
+  for (size_t begin = 0; begin < row_len; begin += round) {
+    size_t end = std::min(row_len, begin + round);
+    // Each node trains a contiguous part of rows
+    for (size_t n = 0; n < node_num; ++n) {
+      range[n] = begin + getStart(end - begin, node_num, n);
+    }
+    range[node_num] = end;
+    loss += run_nodes(range, kRowGrain,
+      [&](size_t n, size_t start, size_t stop) {
+        return grad(replicas_[n], order, start, stop);
+    });
+    average(matrix, model, order, begin, end);
+  }
+  return loss;
+}
+
+}  // namespace xLearn
+
+#endif  // XLEARN_LOSS_NUMA_HOGWILD_H_
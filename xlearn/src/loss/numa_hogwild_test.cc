@@ -0,0 +1,244 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the NumaHogwild class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <vector>
+#include <string>
+
+#include "src/loss/numa_hogwild.h"
+#include "src/loss/cross_entropy_loss.h"
+#include "src/score/ffm_score.h"
+
+namespace xLearn {
+
+const index_t kNumRow = 1000;
+const index_t kNumFeat = 50;
+const index_t kNumField = 4;
+
+// Nodes that all use the cpus of the first real node, so
+// we can test the multi-node training on any machine.
+std::vector<NumaNode> fake_nodes(int num) {
+  std::vector<NumaNode> nodes(num);
+  for (int i = 0; i < num; ++i) {
+    nodes[i].id = i;
+    nodes[i].cpus = GetNumaNodes()[0].cpus;
+  }
+  return nodes;
+}
+
+// The label is 1 if the row has feature 0 or 1.
+void make_data(DMatrix& matrix) {
+  matrix.ResetMatrix(kNumRow);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    index_t hot = i % 7;
+    matrix.AddNode(i, hot, 1.0, 0);
+    for (index_t f = 1; f < kNumField; ++f) {
+      matrix.AddNode(i, 7 + (i * 13 + f * 5) % (kNumFeat - 7), 1.0, f);
+    }
+    matrix.Y[i] = hot < 2 ? 1 : 0;
+    matrix.norm[i] = 1.0 / kNumField;
+  }
+}
+
+TEST(NUMA_HOGWILD, Initialize) {
+  std::vector<NumaNode> nodes = fake_nodes(3);
+  nodes[2].cpus.push_back(nodes[2].cpus[0]);
+  ThreadPool pool(8);
+  NumaHogwild numa;
+  numa.Initialize(nodes, &pool);
+  EXPECT_EQ(numa.NodeNumber(), 3);
+  size_t total = 0;
+  for (size_t n = 0; n < numa.NodeNumber(); ++n) {
+    EXPECT_GE(numa.ThreadNumber(n), 1);
+    total += numa.ThreadNumber(n);
+  }
+  EXPECT_EQ(total, 8);
+  // Each node has at least one thread, so the
+  // pool of two threads uses the first two nodes
+  ThreadPool small_pool(2);
+  NumaHogwild numa_small;
+  numa_small.Initialize(nodes, &small_pool);
+  EXPECT_EQ(numa_small.NodeNumber(), 2);
+  for (size_t n = 0; n < numa_small.NodeNumber(); ++n) {
+    EXPECT_EQ(numa_small.ThreadNumber(n), 1);
+  }
+}
+
+TEST(NUMA_HOGWILD, Train_each_row_once) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, kNumField, 4, 2);
+  ThreadPool pool(4);
+  for (index_t sync_rows = 0; sync_rows <= 300; sync_rows += 300) {
+    NumaHogwild numa;
+    numa.Initialize(fake_nodes(2), &pool, sync_rows);
+    std::vector<int> visit(kNumRow, 0);
+    real_t loss = numa.Train(&matrix, model,
+      [&](Model* m, const index_t* order, size_t start, size_t end) {
+        EXPECT_NE(m, &model);
+        EXPECT_TRUE(order != nullptr);
+        for (size_t k = start; k < end; ++k) {
+          visit[order[k]]++;
+        }
+        return (real_t)(end - start);
+    });
+    EXPECT_FLOAT_EQ(loss, kNumRow);
+    for (index_t i = 0; i < kNumRow; ++i) {
+      EXPECT_EQ(visit[i], 1);
+    }
+    // The rows are grouped by the hottest feature
+    const std::vector<index_t>& order = numa.Order();
+    ASSERT_EQ(order.size(), kNumRow);
+    for (index_t k = 1; k < kNumRow; ++k) {
+      index_t prev = matrix.row[order[k-1]].data()->feat_id;
+      index_t cur = matrix.row[order[k]].data()->feat_id;
+      EXPECT_LE(prev, cur);
+      if (prev == cur) {
+        EXPECT_LT(order[k-1], order[k]);
+      }
+    }
+  }
+}
+
+TEST(NUMA_HOGWILD, Average_replicas) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, kNumField, 4, 2);
+  real_t v0 = model.GetParameter_v()[0];
+  ThreadPool pool(2);
+  NumaHogwild numa;
+  numa.Initialize(fake_nodes(2), &pool, 0, false);
+  // Each node has one thread, so the replica is
+  // updated by one thread.
+  numa.Train(&matrix, model,
+    [&](Model* m, const index_t* order, size_t start, size_t end) {
+      EXPECT_TRUE(order == nullptr);
+      m->GetParameter_w()[0] += (end - start);
+      m->GetParameter_v()[0] += 2 * (end - start);
+      m->GetParameter_b()[0] += 4 * (end - start);
+      return (real_t)0;
+  });
+  EXPECT_TRUE(numa.Order().empty());
+  EXPECT_FLOAT_EQ(model.GetParameter_w()[0], kNumRow / 2.0);
+  EXPECT_FLOAT_EQ(model.GetParameter_v()[0], v0 + kNumRow);
+  EXPECT_FLOAT_EQ(model.GetParameter_b()[0], kNumRow * 2.0);
+}
+
+TEST(NUMA_HOGWILD, Single_node) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, kNumField, 4, 2);
+  ThreadPool pool(2);
+  NumaHogwild numa;
+  numa.Initialize(fake_nodes(1), &pool);
+  real_t loss = numa.Train(&matrix, model,
+    [&](Model* m, const index_t* order, size_t start, size_t end) {
+      EXPECT_EQ(m, &model);
+      return (real_t)(end - start);
+  });
+  EXPECT_FLOAT_EQ(loss, kNumRow);
+}
+
+TEST(NUMA_HOGWILD, Average_touched_features) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  // The last feature is not in the rows
+  const index_t kOther = kNumFeat;
+  model.Initialize("ffm", "cross-entropy", kNumFeat + 1, kNumField, 4, 2);
+  std::vector<real_t> w0(kNumFeat + 1);
+  for (index_t j = 0; j <= kNumFeat; ++j) {
+    w0[j] = model.GetParameter_w()[j*2];
+  }
+  ThreadPool pool(2);
+  NumaHogwild numa;
+  numa.Initialize(fake_nodes(2), &pool, 100, false);
+  // Each row adds 1 to the w of its features, and also
+  // to a feature that is not in the row, which is not
+  // averaged. Each node has one thread.
+  numa.Train(&matrix, model,
+    [&](Model* m, const index_t* order, size_t start, size_t end) {
+      real_t* w = m->GetParameter_w();
+      for (size_t i = start; i < end; ++i) {
+        const SparseRow& row = matrix.row[i];
+        for (SparseRow::const_iterator it = row.begin();
+             it != row.end(); ++it) {
+          w[it->feat_id*2] += 1;
+        }
+      }
+      w[kOther*2] += 1;
+      return (real_t)0;
+  });
+  // The average of the two replicas is half of the sum
+  std::vector<real_t> count(kNumFeat + 1, 0);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    const SparseRow& row = matrix.row[i];
+    for (SparseRow::const_iterator it = row.begin();
+         it != row.end(); ++it) {
+      count[it->feat_id] += 1;
+    }
+  }
+  for (index_t j = 0; j <= kNumFeat; ++j) {
+    EXPECT_FLOAT_EQ(model.GetParameter_w()[j*2], w0[j] + count[j] / 2);
+  }
+}
+
+// Train cross-entropy loss and return the loss of last epoch
+real_t train_loss(int node_num, index_t sync_rows) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, kNumField, 4, 2);
+  FFMScore score;
+  std::string opt = "adagrad";
+  score.Initialize(0.2, 0, 0, 0, 0, 0, opt);
+  ThreadPool pool(3);
+  CrossEntropyLoss loss;
+  loss.Initialize(&score, &pool, true, true);
+  if (node_num > 0) {
+    loss.SetNumaMode(fake_nodes(node_num), sync_rows);
+  }
+  real_t first = 0;
+  for (int epoch = 0; epoch < 10; ++epoch) {
+    loss.Reset();
+    loss.CalcGrad(&matrix, model);
+    if (epoch == 0) { first = loss.GetLoss(); }
+  }
+  EXPECT_LT(loss.GetLoss(), first);
+  return loss.GetLoss();
+}
+
+TEST(NUMA_HOGWILD, CrossEntropy_numa_mode) {
+  real_t plain = train_loss(0, 0);
+  real_t numa = train_loss(2, 0);
+  real_t numa_sync = train_loss(2, 100);
+  real_t single = train_loss(1, 0);
+  // All the modes learn the data
+  EXPECT_LT(plain, 0.3);
+  EXPECT_LT(numa, 0.3);
+  EXPECT_LT(numa_sync, 0.3);
+  EXPECT_LT(single, 0.3);
+}
+
+}  // namespace xLearn
@@ -19,6 +19,8 @@ This file is the implementation of SquaredLoss class.
 */
 
 #include "src/loss/squared_loss.h"
+#include "src/loss/numa_hogwild.h"
+#include "src/loss/sync_batch.h"
 
 namespace xLearn {
 
@@ -56,23 +58,12 @@ void SquaredLoss::Evalute(const std::vector<real_t>& pred,
   CHECK_NE(label.empty(), true);
   total_example_ += pred.size();
   // multi-thread training
-  std::vector<real_t> sum(threadNumber_, 0);
-  for (int i = 0; i < threadNumber_; ++i) {
-    size_t start_idx = getStart(pred.size(), threadNumber_, i);
-    size_t end_idx = getEnd(pred.size(), threadNumber_, i);
-    pool_->enqueue(std::bind(sq_evalute_thread,
-                             &pred,
-                             &label,
-                             &(sum[i]),
-                             start_idx,
-                             end_idx));
-  }
-  // Wait all of the threads finish their job
-  pool_->Sync(threadNumber_);
-  // Accumulate loss
-  for (size_t i = 0; i < sum.size(); ++i) {
-    loss_sum_ += sum[i];
-  }
+  loss_sum_ = pool_->ParallelReduce(0, pred.size(), kExampleGrain,
+    loss_sum_, [&](size_t start_idx, size_t end_idx) {
+      real_t sum = 0;
+      sq_evalute_thread(&pred, &label, &sum, start_idx, end_idx);
+      return sum;
+  });
 }
 
 // Calculate gradient in one thread
@@ -81,12 +72,14 @@ void sq_gradient_thread(const DMatrix* matrix,
                         Score* score_func,
                         bool is_norm,
                         real_t* sum,
-                        index_t start,
-                        index_t end) {
+                        const index_t* order,
+                        size_t start,
+                        size_t end) {
   CHECK_GE(end, start);
   *sum = 0;
-  for (size_t i = start; i < end; ++i) {
-    SparseRow* row = matrix->row[i];
+  for (size_t k = start; k < end; ++k) {
+    size_t i = order == nullptr ? k : order[k];
+    const SparseRow* row = &matrix->row[i];
     real_t norm = is_norm ? matrix->norm[i] : 1.0;
     real_t pred = score_func->CalcScore(row, *model, norm);
     // loss
@@ -119,25 +112,35 @@ void SquaredLoss::CalcGrad(const DMatrix* matrix,
   CHECK_GT(matrix->row_length, 0);
   size_t row_len = matrix->row_length;
   total_example_ += row_len;
-  int count = lock_free_ ? threadNumber_ : 1;
-  std::vector<real_t> sum(count, 0);
-  for (int i = 0; i < count; ++i) {
-    size_t start = getStart(row_len, count, i);
-    size_t end = getEnd(row_len, count, i);
-    pool_->enqueue(std::bind(sq_gradient_thread,
-                             matrix,
-                             &model,
-                             score_func_,
-                             norm_,
-                             &(sum[i]),
-                             start,
-                             end));
-  }
-  // Wait all of the threads finish their job
-  pool_->Sync(count);
-  // Accumulate loss
-  for (int i = 0; i < sum.size(); ++i) {
-    loss_sum_ += sum[i];
+  // multi-thread training
+  TrainFunc train = use_train_kernel_ ? train_func_ : nullptr;
+  OptParam opt = score_func_->GetOptParam();
+  auto gradient = [&](Model* m, const index_t* order,
+                      size_t start, size_t end) -> real_t {
+    if (train != nullptr) {
+      return train(matrix, m, opt, norm_, order, start, end);
+    }
+    real_t sum = 0;
+    sq_gradient_thread(matrix, m, score_func_, norm_,
+                       &sum, order, start, end);
+    return sum;
+  };
+  if (sync_ != nullptr) {
+    loss_sum_ += sync_->Train(matrix, model, score_func_, norm_,
+      [](real_t pred, real_t label, real_t* pg) -> real_t {
+        real_t error = label - pred;
+        *pg = pred - label;
+        return 0.5 * error * error;
+    });
+  } else if (numa_ != nullptr) {
+    loss_sum_ += numa_->Train(matrix, model, gradient);
+  } else if (lock_free_) {
+    loss_sum_ = pool_->ParallelReduce(0, row_len, kRowGrain, loss_sum_,
+      [&](size_t start, size_t end) {
+        return gradient(&model, nullptr, start, end);
+    });
+  } else {
+    loss_sum_ += gradient(&model, nullptr, 0, row_len);
   }
 }
 
@@ -0,0 +1,305 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the SyncBatch class.
+*/
+
+#include "src/loss/sync_batch.h"
+
+#include <math.h>
+
+#include "src/base/logging.h"
+#include "src/base/math.h"
+
+namespace xLearn {
+
+/* Number of feature ranges of each thread */
+static const index_t kRangePerThread = 4;
+
+void SyncBatch::Initialize(ThreadPool* pool, index_t batch_size) {
+  CHECK_NOTNULL(pool);
+  CHECK_GT(batch_size, 0);
+  pool_ = pool;
+  batch_size_ = batch_size;
+  size_t num_worker = pool_->ThreadNumber();
+  shard_table_.resize(num_worker);
+  fm_sum_.resize(num_worker);
+  row_slot_.resize(num_worker);
+  num_range_ = num_worker * kRangePerThread;
+  sum_table_.resize(num_range_);
+  sum_feat_.resize(num_range_);
+  sum_first_.resize(num_range_);
+  sum_offset_.resize(num_range_);
+  sum_grad_.resize(num_range_);
+}
+
+// The layout of the model is checked for each Train(), since
+// the same loss can be used for different models.
+void SyncBatch::init_layout(Model& model, Score* score) {
+  if (model.IsSparse() || model.GetQuantType() != kQuantNone) {
+    LOG(FATAL) << "Cannot train an inference-only model.";
+  }
+  is_fm_ = score->score_type().compare("fm") == 0;
+  is_ffm_ = score->score_type().compare("ffm") == 0;
+  is_sgd_ = score->opt_type().compare("sgd") == 0;
+  is_adagrad_ = score->opt_type().compare("adagrad") == 0;
+  opt_ = score->GetOptParam();
+  num_field_ = model.GetNumField();
+  num_K_ = model.GetNumK();
+  aux_size_ = model.GetAuxiliarySize();
+  align_ = model.GetAlign();
+  aligned_k_ = model.get_aligned_k();
+  unit_ = 1;
+  if (is_fm_) {
+    unit_ += num_K_;
+  } else if (is_ffm_) {
+    unit_ += num_field_ * num_K_;
+  }
+  // The ffm latent vector is interleaved with its
+  // gradient cache in the chunks of align_ values.
+  latent_offset_.resize(num_K_);
+  for (index_t k = 0; k < num_K_; ++k) {
+    latent_offset_[k] = is_ffm_ ?
+      k / align_ * align_ * aux_size_ + k % align_ : k;
+  }
+  num_feat_ = model.GetNumFeature();
+  for (size_t w = 0; w < fm_sum_.size(); ++w) {
+    fm_sum_[w].resize(num_K_);
+  }
+}
+
+// The gradients are the same as Score::CalcGrad() of each score
+// function, which adds the regularization of each touched weight.
+void SyncBatch::add_row_grad(Shard* shard, size_t worker,
+                             const SparseRow* row, Model& model,
+                             real_t pg, real_t norm) {
+  SlotTable* table = &shard_table_[worker];
+  std::vector<index_t>& row_slot = row_slot_[worker];
+  real_t lambda = is_sgd_ || is_adagrad_ ?
+                  opt_.regu_lambda : opt_.lambda_2;
+  // The linear score normalizes the linear term only for ftrl
+  real_t sqrt_norm = is_fm_ || is_ffm_ || (!is_sgd_ && !is_adagrad_) ?
+                     sqrt(norm) : 1.0;
+  const real_t* w = model.GetParameter_w();
+  // Find the slot of each node once, and kNoSlot
+  // for the node that is not in the model.
+  row_slot.resize(row->size());
+  for (size_t n = 0; n < row->size(); ++n) {
+    const Node& node = (*row)[n];
+    // Check the feature before using it, as Score does not
+    if (node.feat_id >= num_feat_ ||
+        (is_ffm_ && node.field_id >= num_field_)) {
+      row_slot[n] = kNoSlot;
+      continue;
+    }
+    row_slot[n] = shard_slot(shard, table, node.feat_id);
+    shard->grad[(size_t)row_slot[n] * unit_] +=
+      pg * node.feat_val * sqrt_norm + lambda * w[node.feat_id * aux_size_];
+  }
+  shard->bias_grad += pg;
+  if (!is_fm_ && !is_ffm_) { return; }
+  // The gradients are not re-allocated below
+  real_t* grad = shard->grad.data();
+  const real_t* v = model.GetParameter_v();
+  index_t align0 = aux_size_ * aligned_k_;
+  if (is_fm_) {
+    // s = sum(V_j * x_j)
+    real_t* sum = fm_sum_[worker].data();
+    std::fill(sum, sum + num_K_, 0);
+    for (size_t n = 0; n < row->size(); ++n) {
+      if (row_slot[n] == kNoSlot) { continue; }
+      const Node& node = (*row)[n];
+      const real_t* vj = v + (size_t)node.feat_id * align0;
+      real_t x = node.feat_val * norm;
+      for (index_t k = 0; k < num_K_; ++k) {
+        sum[k] += vj[k] * x;
+      }
+    }
+    for (size_t n = 0; n < row->size(); ++n) {
+      if (row_slot[n] == kNoSlot) { continue; }
+      const Node& node = (*row)[n];
+      const real_t* vj = v + (size_t)node.feat_id * align0;
+      real_t x = node.feat_val * norm;
+      real_t* g = grad + (size_t)row_slot[n] * unit_ + 1;
+      for (index_t k = 0; k < num_K_; ++k) {
+        g[k] += pg * x * (sum[k] - vj[k] * x) + lambda * vj[k];
+      }
+    }
+    return;
+  }
+  // ffm
+  index_t align1 = num_field_ * align0;
+  const index_t* offset = latent_offset_.data();
+  for (size_t n1 = 0; n1 < row->size(); ++n1) {
+    if (row_slot[n1] == kNoSlot) { continue; }
+    const Node& node1 = (*row)[n1];
+    index_t j1 = node1.feat_id;
+    index_t f1 = node1.field_id;
+    const real_t* v_j1 = v + (size_t)j1 * align1;
+    real_t* g_j1 = grad + (size_t)row_slot[n1] * unit_ + 1;
+    for (size_t n2 = n1+1; n2 < row->size(); ++n2) {
+      if (row_slot[n2] == kNoSlot) { continue; }
+      const Node& node2 = (*row)[n2];
+      index_t j2 = node2.feat_id;
+      index_t f2 = node2.field_id;
+      const real_t* v1 = v_j1 + f2 * align0;
+      const real_t* v2 = v + (size_t)j2 * align1 + f1 * align0;
+      real_t* g1 = g_j1 + f2 * num_K_;
+      real_t* g2 = grad + (size_t)row_slot[n2] * unit_ + 1 + f1 * num_K_;
+      real_t pgv = pg * node1.feat_val * node2.feat_val * norm;
+      // The latent vector is in the chunks of align_ values
+      for (index_t k = 0; k < num_K_; k += align_) {
+        const real_t* c1 = v1 + offset[k];
+        const real_t* c2 = v2 + offset[k];
+        index_t n = std::min(align_, num_K_ - k);
+        for (index_t d = 0; d < n; ++d) {
+          g1[k+d] += pgv * c2[d] + lambda * c1[d];
+          g2[k+d] += pgv * c1[d] + lambda * c2[d];
+        }
+      }
+    }
+  }
+}
+
+// Counting sort of the features by range, which keeps
+// the order of first touch in each range.
+void SyncBatch::finish_shard(Shard* shard) {
+  size_t num_feat = shard->feat.size();
+  shard->range.resize(num_feat);
+  shard->range_start.assign(num_range_ + 1, 0);
+  for (size_t i = 0; i < num_feat; ++i) {
+    index_t r = (uint64)shard->feat[i] * num_range_ / num_feat_;
+    shard->range[i] = r;
+    shard->range_start[r+1]++;
+  }
+  for (index_t r = 0; r < num_range_; ++r) {
+    shard->range_start[r+1] += shard->range_start[r];
+  }
+  std::vector<index_t> pos(shard->range_start.begin(),
+                           shard->range_start.end() - 1);
+  shard->order.resize(num_feat);
+  for (size_t i = 0; i < num_feat; ++i) {
+    shard->order[pos[shard->range[i]]++] = i;
+  }
+}
+
+void SyncBatch::reduce_range(index_t range, size_t num_shard,
+                             Model& model) {
+  std::vector<index_t>& feat = sum_feat_[range];
+  std::vector<const real_t*>& first = sum_first_[range];
+  std::vector<index_t>& offset = sum_offset_[range];
+  std::vector<real_t>& sum_grad = sum_grad_[range];
+  SlotTable* table = &sum_table_[range];
+  size_t num_entry = 0;
+  for (size_t s = 0; s < num_shard; ++s) {
+    num_entry += shards_[s].range_start[range+1] -
+                 shards_[s].range_start[range];
+  }
+  table->Reset(num_entry);
+  feat.clear();
+  first.clear();
+  offset.clear();
+  sum_grad.clear();
+  for (size_t s = 0; s < num_shard; ++s) {
+    const Shard& shard = shards_[s];
+    for (index_t n = shard.range_start[range];
+         n < shard.range_start[range+1]; ++n) {
+      index_t i = shard.order[n];
+      index_t feat_id = shard.feat[i];
+      const real_t* g = shard.grad.data() + (size_t)i * unit_;
+      index_t slot = table->Find(feat_id, feat.size());
+      if (slot == feat.size()) {
+        feat.push_back(feat_id);
+        first.push_back(g);
+        offset.push_back(kNoSlot);
+        continue;
+      }
+      if (offset[slot] == kNoSlot) {
+        offset[slot] = sum_grad.size();
+        sum_grad.insert(sum_grad.end(), first[slot], first[slot] + unit_);
+      }
+      real_t* sum = sum_grad.data() + offset[slot];
+      for (index_t d = 0; d < unit_; ++d) {
+        sum[d] += g[d];
+      }
+    }
+  }
+  // Apply the summed gradients
+  real_t* w = model.GetParameter_w();
+  real_t* v = model.GetParameter_v();
+  index_t align0 = aux_size_ * aligned_k_;
+  // Step between a latent value and its gradient cache
+  index_t step = is_fm_ ? aligned_k_ : align_;
+  for (size_t n = 0; n < feat.size(); ++n) {
+    index_t feat_id = feat[n];
+    const real_t* g = offset[n] == kNoSlot ?
+                      first[n] : sum_grad.data() + offset[n];
+    update(w + (size_t)feat_id * aux_size_, 1, g, 1);
+    if (unit_ == 1) { continue; }
+    if (is_fm_) {
+      update(v + (size_t)feat_id * align0, step, g + 1, num_K_);
+    } else {
+      // The latent vector is in the chunks of align_ values
+      for (index_t f = 0; f < num_field_; ++f) {
+        real_t* vjf = v + ((size_t)feat_id * num_field_ + f) * align0;
+        const real_t* gf = g + 1 + f * num_K_;
+        for (index_t k = 0; k < num_K_; k += align_) {
+          update(vjf + latent_offset_[k], step, gf + k,
+                 std::min(align_, num_K_ - k));
+        }
+      }
+    }
+  }
+}
+
+// The zero gradient is of the latent vectors that are not used by
+// the mini-batch, and they are not changed. It does not change the
+// weight of sgd and adagrad, so their loops have no branch and can
+// be vectorized. (ftrl would reset an initial weight to its z.)
+void SyncBatch::update(real_t* w, index_t step,
+                       const real_t* g, index_t n) {
+  real_t* wg = w + step;
+  real_t lr = opt_.learning_rate;
+  if (is_sgd_) {
+    for (index_t d = 0; d < n; ++d) {
+      w[d] -= lr * g[d];
+    }
+  } else if (is_adagrad_) {
+    for (index_t d = 0; d < n; ++d) {
+      wg[d] += g[d] * g[d];
+      w[d] -= lr * g[d] * InvSqrt(wg[d]);
+    }
+  } else {  // ftrl
+    real_t* z = w + step * 2;
+    for (index_t d = 0; d < n; ++d) {
+      if (g[d] == 0) { continue; }
+      real_t old_wg = wg[d];
+      wg[d] += g[d] * g[d];
+      real_t sigma = (sqrt(wg[d]) - sqrt(old_wg)) / opt_.alpha;
+      z[d] += g[d] - sigma * w[d];
+      int sign = z[d] > 0 ? 1 : -1;
+      if (sign * z[d] <= opt_.lambda_1) {
+        w[d] = 0;
+      } else {
+        w[d] = (sign * opt_.lambda_1 - z[d]) /
+               ((opt_.beta + sqrt(wg[d])) / opt_.alpha + opt_.lambda_2);
+      }
+    }
+  }
+}
+
+}  // namespace xLearn
@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the SyncBatch class, which is the deterministic
+synchronous mini-batch version of the multi-thread training.
+*/
+
+#ifndef XLEARN_LOSS_SYNC_BATCH_H_
+#define XLEARN_LOSS_SYNC_BATCH_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "src/base/common.h"
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/score_function.h"
+
+namespace xLearn {
+
+/* Number of rows of a shard of the mini-batch */
+const index_t kSyncShardRows = 256;
+/* Default number of rows of a mini-batch */
+const index_t kDefaultSyncBatch = 1000;
+/* A feature without slot */
+const index_t kNoSlot = static_cast<index_t>(-1);
+
+//------------------------------------------------------------------------------
+// SlotTable maps the features of a shard (or of a range) to their slots.
+// It is an open-addressing hash table sized by the number of nodes, so
+// it stays in cache, unlike an array of the slots of all the features.
+//------------------------------------------------------------------------------
+class SlotTable {
+ public:
+  // Clear the table for at most max_size features.
+  void Reset(size_t max_size) {
+    size_t cap = 16;
+    while (cap < max_size * 2) { cap <<= 1; }
+    entry_.assign(cap, Entry{kNoSlot, kNoSlot});
+    mask_ = cap - 1;
+  }
+
+  // Return the slot of feat_id, which is set to
+  // new_slot if feat_id is not in the table.
+  inline index_t Find(index_t feat_id, index_t new_slot) {
+    size_t h = (feat_id * 0x9E3779B97F4A7C15ULL) >> 32 & mask_;
+    for (;;) {
+      Entry& e = entry_[h];
+      if (e.feat_id == feat_id) { return e.slot; }
+      if (e.feat_id == kNoSlot) {
+        e.feat_id = feat_id;
+        e.slot = new_slot;
+        return new_slot;
+      }
+      h = (h + 1) & mask_;
+    }
+  }
+
+ protected:
+  struct Entry {
+    index_t feat_id;
+    index_t slot;
+  };
+  std::vector<Entry> entry_;
+  size_t mask_ = 0;
+};
+
+//------------------------------------------------------------------------------
+// The lock-free (Hogwild) training updates the model by each row, and
+// the order of the updates of different threads changes from run to
+// run, so the model is not reproducible. SyncBatch trains a mini-batch
+// in three steps on a fixed model instead:
+//
+//   (1) The mini-batch is split into shards of kSyncShardRows rows.
+//       The shards are computed in parallel, and each shard sums the
+//       gradients of its rows into its own sparse buffer, in which
+//       each touched feature has the gradient of its linear weight
+//       and of all its latent factors.
+//   (2) The feature ids are split into ranges, and the buffers are
+//       reduced in parallel by range: the gradient of a feature is
+//       the sum of the shards in the shard order.
+//   (3) Each range applies the optimizer (sgd, adagrad or ftrl) once
+//       with the summed gradients of its features.
+//
+// The shards and the order of every sum do not depend on the number
+// of threads or on the scheduling, so the model is bit-reproducible
+// for the same data, even with a different number of threads. Each
+// row gets the same gradient as the plain training on the model of
+// the start of its mini-batch (including the regularization), and
+// these gradients are summed.
+//
+// We can use the SyncBatch class like this:
+//
+//   SyncBatch sync;
+//   sync.Initialize(pool, batch_size);
+//
+//   /* grad(pred, y, &pg) returns the loss of a row given its
+//   prediction and label, and sets the partial gradient pg. */
+//   real_t loss = sync.Train(matrix, model, score, norm, grad);
+//------------------------------------------------------------------------------
+class SyncBatch {
+ public:
+  // Constructor and Destructor
+  SyncBatch() : pool_(nullptr), batch_size_(kDefaultSyncBatch) { }
+  ~SyncBatch() { }
+
+  // The mini-batches have batch_size rows (the last one
+  // may be smaller), and they are trained by the pool.
+  void Initialize(ThreadPool* pool, index_t batch_size);
+
+  // Train all the rows of matrix in mini-batches.
+  // Return the sum of loss given by grad.
+  template <typename Func>
+  real_t Train(const DMatrix* matrix, Model& model,
+               Score* score, bool norm, Func grad);
+
+  // Number of rows of a mini-batch
+  index_t BatchSize() const { return batch_size_; }
+
+ protected:
+  /* The gradients of a shard */
+  struct Shard {
+    /* Touched features in the order of first touch */
+    std::vector<index_t> feat;
+    /* Gradient of each feature, unit_ values per feature */
+    std::vector<real_t> grad;
+    /* Range of each feature */
+    std::vector<index_t> range;
+    /* Index of feat ordered by range, and the
+    start of each range in this order */
+    std::vector<index_t> order;
+    std::vector<index_t> range_start;
+    /* Gradient of the bias */
+    real_t bias_grad;
+    /* Sum of loss */
+    real_t loss;
+  };
+
+  /* Thread pool for training */
+  ThreadPool* pool_;
+  /* Number of rows of a mini-batch */
+  index_t batch_size_;
+  /* Shards of current mini-batch */
+  std::vector<Shard> shards_;
+  /* Slots of the shard of each worker */
+  std::vector<SlotTable> shard_table_;
+  /* Slots of the sum of each range */
+  std::vector<SlotTable> sum_table_;
+  /* Features of each range and their first gradient. The feature
+  of more than one shard has the offset of its sum in sum_grad_,
+  and the others (kept in their shard) are not copied. */
+  std::vector<std::vector<index_t> > sum_feat_;
+  std::vector<std::vector<const real_t*> > sum_first_;
+  std::vector<std::vector<index_t> > sum_offset_;
+  std::vector<std::vector<real_t> > sum_grad_;
+  /* Scratch of the fm sum of each worker */
+  std::vector<std::vector<real_t> > fm_sum_;
+  /* Scratch of the slot of each node of a row of each worker */
+  std::vector<std::vector<index_t> > row_slot_;
+  /* Layout of current model */
+  bool is_fm_;
+  bool is_ffm_;
+  /* Optimizer: sgd, adagrad or ftrl */
+  bool is_sgd_;
+  bool is_adagrad_;
+  OptParam opt_;
+  index_t num_feat_;
+  index_t num_field_;
+  index_t num_K_;
+  index_t aux_size_;
+  index_t align_;
+  index_t aligned_k_;
+  /* Values of the gradient of a feature: 1 + latent values */
+  index_t unit_;
+  /* Offset of the k-th latent value in a latent vector */
+  std::vector<index_t> latent_offset_;
+  /* Number of feature ranges */
+  index_t num_range_;
+
+  // Set the layout of the model and the optimizer.
+  void init_layout(Model& model, Score* score);
+
+  // Slot of a feature in the shard, which is
+  // added with zero gradient if it is not there.
+  inline index_t shard_slot(Shard* shard, SlotTable* table,
+                            index_t feat_id) {
+    index_t s = table->Find(feat_id, shard->feat.size());
+    if (s == shard->feat.size()) {
+      shard->feat.push_back(feat_id);
+      shard->grad.resize(shard->grad.size() + unit_, 0);
+    }
+    return s;
+  }
+
+  // Add the gradient of a row to the shard.
+  void add_row_grad(Shard* shard, size_t worker,
+                    const SparseRow* row, Model& model,
+                    real_t pg, real_t norm);
+
+  // Order the features of the shard by range.
+  void finish_shard(Shard* shard);
+
+  // Sum the gradients of the features of a range in the
+  // shard order, and apply them to the model.
+  void reduce_range(index_t range, size_t num_shard, Model& model);
+
+  // Apply the gradients g[0, n) to the weights w[0, n), whose
+  // gradient caches are w[step, step+n) and w[step*2, step*2+n).
+  void update(real_t* w, index_t step, const real_t* g, index_t n);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SyncBatch);
+};
+
+template <typename Func>
+real_t SyncBatch::Train(const DMatrix* matrix, Model& model,
+                        Score* score, bool norm, Func grad) {
+  CHECK_NOTNULL(pool_);
+  init_layout(model, score);
+  size_t row_len = matrix->row_length;
+  size_t num_worker = shard_table_.size();
+  real_t loss = 0;
+  for (size_t begin = 0; begin < row_len; begin += batch_size_) {
+    size_t end = std::min(row_len, begin + batch_size_);
+    size_t num_shard = (end - begin + kSyncShardRows - 1) / kSyncShardRows;
+    if (shards_.size() < num_shard) { shards_.resize(num_shard); }
+    // (1) Each worker computes the shards w, w + num_worker, ...
+    pool_->ParallelFor(0, num_worker, 1, [&](size_t w_start, size_t w_end) {
+      for (size_t w = w_start; w < w_end; ++w) {
+        for (size_t s = w; s < num_shard; s += num_worker) {
+          Shard* shard = &shards_[s];
+          shard->feat.clear();
+          shard->grad.clear();
+          shard->bias_grad = 0;
+          shard->loss = 0;
+          size_t start = begin + s * kSyncShardRows;
+          size_t stop = std::min(end, start + kSyncShardRows);
+          size_t num_node = 0;
+          for (size_t i = start; i < stop; ++i) {
+            num_node += matrix->row[i].size();
+          }
+          shard_table_[w].Reset(num_node);
+          for (size_t i = start; i < stop; ++i) {
+            const SparseRow* row = &matrix->row[i];
+            real_t row_norm = norm ? matrix->norm[i] : 1.0;
+            real_t pred = score->CalcScore(row, model, row_norm);
+            real_t pg = 0;
+            shard->loss += grad(pred, matrix->Y[i], &pg);
+            add_row_grad(shard, w, row, model, pg, row_norm);
+          }
+          finish_shard(shard);
+        }
+      }
+    });
+    // (2) and (3) for each range of features
+    pool_->ParallelFor(0, num_range_, 1, [&](size_t r_start, size_t r_end) {
+      for (size_t r = r_start; r < r_end; ++r) {
+        reduce_range(r, num_shard, model);
+      }
+    });
+    // The bias is shared by all the rows
+    real_t bias_grad = 0;
+    for (size_t s = 0; s < num_shard; ++s) {
+      bias_grad += shards_[s].bias_grad;
+      loss += shards_[s].loss;
+    }
+    update(model.GetParameter_b(), 1, &bias_grad, 1);
+  }
+  return loss;
+}
+
+}  // namespace xLearn
+
+#endif  // XLEARN_LOSS_SYNC_BATCH_H_
@@ -0,0 +1,184 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the SyncBatch class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#include <vector>
+#include <string>
+
+#include "src/loss/sync_batch.h"
+#include "src/loss/cross_entropy_loss.h"
+#include "src/score/score_function.h"
+
+namespace xLearn {
+
+const index_t kNumRow = 1000;
+const index_t kNumFeat = 50;
+const index_t kNumField = 4;
+
+// The label is 1 if the row has feature 0 or 1.
+void make_data(DMatrix& matrix) {
+  matrix.ResetMatrix(kNumRow);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    index_t hot = i % 7;
+    matrix.AddNode(i, hot, 1.0, 0);
+    for (index_t f = 1; f < kNumField; ++f) {
+      matrix.AddNode(i, 7 + (i * 13 + f * 5) % (kNumFeat - 7), 0.5, f);
+    }
+    matrix.Y[i] = hot < 2 ? 1 : 0;
+    matrix.norm[i] = 1.0 / kNumField;
+  }
+}
+
+// Copy of all the parameters of a model
+std::vector<real_t> params(Model& model) {
+  std::vector<real_t> p(model.GetParameter_w(),
+                        model.GetParameter_w() + model.GetNumParameter_w());
+  if (model.GetParameter_v() != nullptr) {
+    p.insert(p.end(), model.GetParameter_v(),
+             model.GetParameter_v() + model.GetNumParameter_v());
+  }
+  p.push_back(model.GetParameter_b()[0]);
+  return p;
+}
+
+int aux_size(const std::string& opt) {
+  return opt == "sgd" ? 1 : (opt == "adagrad" ? 2 : 3);
+}
+
+// Train the data by the sync mode in some epochs
+std::vector<real_t> train_sync(const std::string& score_type,
+                               const std::string& opt,
+                               int thread_number,
+                               real_t* last_loss) {
+  DMatrix matrix;
+  make_data(matrix);
+  Model model;
+  model.Initialize(score_type, "cross-entropy", kNumFeat,
+                   kNumField, 4, aux_size(opt));
+  Score* score = CREATE_SCORE(score_type.c_str());
+  std::string opt_type = opt;
+  score->Initialize(0.1, 0.0001, 0.1, 1.0, 0.0001, 0.0001, opt_type);
+  ThreadPool pool(thread_number);
+  CrossEntropyLoss loss;
+  loss.Initialize(score, &pool, true, true);
+  loss.SetSyncMode(100);
+  real_t first = 0;
+  for (int epoch = 0; epoch < 10; ++epoch) {
+    loss.Reset();
+    loss.CalcGrad(&matrix, model);
+    if (epoch == 0) { first = loss.GetLoss(); }
+  }
+  EXPECT_LT(loss.GetLoss(), first);
+  *last_loss = loss.GetLoss();
+  delete score;
+  return params(model);
+}
+
+// The model does not depend on the number of threads
+TEST(SYNC_BATCH, Reproducible) {
+  const char* scores[] = { "linear", "fm", "ffm" };
+  const char* opts[] = { "sgd", "adagrad", "ftrl" };
+  for (int s = 0; s < 3; ++s) {
+    for (int o = 0; o < 3; ++o) {
+      real_t loss_1 = 0, loss_2 = 0, loss_3 = 0;
+      std::vector<real_t> p1 = train_sync(scores[s], opts[o], 1, &loss_1);
+      std::vector<real_t> p2 = train_sync(scores[s], opts[o], 4, &loss_2);
+      std::vector<real_t> p3 = train_sync(scores[s], opts[o], 4, &loss_3);
+      ASSERT_EQ(p1.size(), p2.size());
+      EXPECT_EQ(memcmp(p1.data(), p2.data(),
+                       p1.size() * sizeof(real_t)), 0)
+        << scores[s] << " " << opts[o];
+      EXPECT_EQ(memcmp(p2.data(), p3.data(),
+                       p2.size() * sizeof(real_t)), 0)
+        << scores[s] << " " << opts[o];
+      EXPECT_EQ(loss_1, loss_2);
+    }
+  }
+}
+
+// With one row in a mini-batch, the change of the model is the
+// same as Score::CalcGrad() by the optimizer. K = 12 has three
+// chunks of the ffm layout when align is 4.
+void check_same_update(const std::string& score_type,
+                       const std::string& opt,
+                       index_t num_K) {
+  DMatrix matrix;
+  make_data(matrix);
+  matrix.row_length = 1;
+  Score* score = CREATE_SCORE(score_type.c_str());
+  std::string opt_type = opt;
+  score->Initialize(0.001, 0.01, 0.1, 1.0, 0.0001, 0.01, opt_type);
+  Model model;
+  model.Initialize(score_type, "cross-entropy", kNumFeat,
+                   kNumField, num_K, aux_size(opt));
+  std::vector<real_t> init = params(model);
+  real_t norm = matrix.norm[0];
+  real_t pred = score->CalcScore(&matrix.row[0], model, norm);
+  real_t pg = -1.0/(1.0+(1.0/exp(-pred)));
+  score->CalcGrad(&matrix.row[0], model, pg, norm);
+  std::vector<real_t> plain = params(model);
+  Model sync_model;
+  sync_model.Initialize(score_type, "cross-entropy", kNumFeat,
+                        kNumField, num_K, aux_size(opt));
+  ThreadPool pool(2);
+  SyncBatch sync;
+  sync.Initialize(&pool, 1);
+  sync.Train(&matrix, sync_model, score, true,
+    [](real_t pred, real_t label, real_t* pg) -> real_t {
+      real_t y = label > 0 ? 1.0 : -1.0;
+      *pg = -y/(1.0+(1.0/exp(-y*pred)));
+      return log1p(exp(-y*pred));
+  });
+  std::vector<real_t> sync_param = params(sync_model);
+  ASSERT_EQ(sync_param.size(), init.size());
+  size_t changed = 0;
+  for (size_t i = 0; i < init.size(); ++i) {
+    real_t d_plain = plain[i] - init[i];
+    real_t d_sync = sync_param[i] - init[i];
+    // adagrad of Score uses the approximate InvSqrt()
+    EXPECT_NEAR(d_sync, d_plain, 5e-3 * fabs(d_plain) + 1e-6)
+      << score_type << " " << opt << " K=" << num_K << " " << i;
+    if (d_sync != 0) { changed++; }
+  }
+  EXPECT_GT(changed, 0);
+  delete score;
+}
+
+TEST(SYNC_BATCH, Same_gradient) {
+  const char* scores[] = { "linear", "fm", "ffm" };
+  const char* opts[] = { "sgd", "adagrad", "ftrl" };
+  for (int s = 0; s < 3; ++s) {
+    for (int o = 0; o < 3; ++o) {
+      check_same_update(scores[s], opts[o], 4);
+      check_same_update(scores[s], opts[o], 12);
+    }
+  }
+}
+
+TEST(SYNC_BATCH, Learn_data) {
+  real_t loss = 0;
+  train_sync("ffm", "adagrad", 3, &loss);
+  EXPECT_LT(loss, 0.3);
+}
+
+}  // namespace xLearn
@@ -0,0 +1,296 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the specialized training kernels.
+*/
+
+#include "src/loss/train_kernel.h"
+
+#include <math.h>
+
+#include "src/base/math.h"
+#include "src/base/scratch_arena.h"
+
+namespace xLearn {
+
+ /*********************************************************
+  *  Loss functions                                       *
+  *********************************************************/
+
+// Return the loss of one example, and set the partial gradient.
+struct CrossEntropyLoss_ {
+  static inline real_t loss(real_t label, real_t pred, real_t* pg) {
+    real_t y = label > 0 ? 1.0 : -1.0;
+    *pg = -y/(1.0+(1.0/exp(-y*pred)));
+    return log1p(exp(-y*pred));
+  }
+  static inline real_t finish(real_t sum) { return sum; }
+};
+
+struct SquaredLoss_ {
+  static inline real_t loss(real_t label, real_t pred, real_t* pg) {
+    real_t error = label - pred;
+    *pg = pred - label;
+    return error*error;
+  }
+  static inline real_t finish(real_t sum) { return sum * 0.5; }
+};
+
+ /*********************************************************
+  *  Optimization methods                                 *
+  *********************************************************/
+
+// Update the linear term (w) and the bias term (b), where
+// pgx is the partial gradient multiplied by the feature value.
+struct SGDOpt {
+  static const index_t kAux = 1;
+  /* The ftrl uses the normalized feature value for linear score */
+  static const bool kNormLinear = false;
+  static inline void update_w(real_t* w, real_t pgx,
+                              const OptParam& opt) {
+    real_t g = opt.regu_lambda*w[0]+pgx;
+    w[0] -= (opt.learning_rate * g);
+  }
+  static inline void update_b(real_t* b, real_t pg,
+                              const OptParam& opt) {
+    b[0] -= opt.learning_rate * pg;
+  }
+  static inline decltype(SIMDKernel::fm_sgd)
+  fm_update(const SIMDKernel* k) { return k->fm_sgd; }
+  static inline decltype(SIMDKernel::ffm_sgd)
+  ffm_update(const SIMDKernel* k) { return k->ffm_sgd; }
+};
+
+struct AdaGradOpt {
+  static const index_t kAux = 2;
+  static const bool kNormLinear = false;
+  static inline void update_w(real_t* w, real_t pgx,
+                              const OptParam& opt) {
+    real_t g = opt.regu_lambda*w[0]+pgx;
+    w[1] += g*g;
+    w[0] -= opt.learning_rate * g * InvSqrt(w[1]);
+  }
+  static inline void update_b(real_t* b, real_t pg,
+                              const OptParam& opt) {
+    b[1] += pg*pg;
+    b[0] -= opt.learning_rate * pg * InvSqrt(b[1]);
+  }
+  static inline decltype(SIMDKernel::fm_adagrad)
+  fm_update(const SIMDKernel* k) { return k->fm_adagrad; }
+  static inline decltype(SIMDKernel::ffm_adagrad)
+  ffm_update(const SIMDKernel* k) { return k->ffm_adagrad; }
+};
+
+struct FTRLOpt {
+  static const index_t kAux = 3;
+  static const bool kNormLinear = true;
+  static inline void ftrl(real_t* w, real_t g, const OptParam& opt) {
+    real_t &wl = w[0];
+    real_t &wlg = w[1];
+    real_t &wlz = w[2];
+    real_t old_wlg = wlg;
+    wlg += g*g;
+    real_t sigma = (sqrt(wlg)-sqrt(old_wlg)) / opt.alpha;
+    wlz += (g-sigma*wl);
+    int sign = wlz > 0 ? 1:-1;
+    if (sign*wlz <= opt.lambda_1) {
+      wl = 0;
+    } else {
+      wl = (sign*opt.lambda_1-wlz) /
+           ((opt.beta + sqrt(wlg)) /
+            opt.alpha + opt.lambda_2);
+    }
+  }
+  static inline void update_w(real_t* w, real_t pgx,
+                              const OptParam& opt) {
+    ftrl(w, opt.lambda_2*w[0]+pgx, opt);
+  }
+  static inline void update_b(real_t* b, real_t pg,
+                              const OptParam& opt) {
+    ftrl(b, pg, opt);
+  }
+  static inline decltype(SIMDKernel::fm_ftrl)
+  fm_update(const SIMDKernel* k) { return k->fm_ftrl; }
+  static inline decltype(SIMDKernel::ffm_ftrl)
+  ffm_update(const SIMDKernel* k) { return k->ffm_ftrl; }
+};
+
+ /*********************************************************
+  *  Score functions                                      *
+  *********************************************************/
+
+// The latent factor of a score function. kNormLinear means that the
+// linear score uses the normalized feature value.
+struct LinearScore_ {
+  static const bool kNormLinear = false;
+  template <class O>
+  struct Latent {
+    Latent(Model* model, const SIMDKernel* kernel) { }
+    real_t score(const Node* begin, const Node* end, real_t norm) {
+      return 0;
+    }
+    void update(const Node* begin, const Node* end,
+                real_t pg, real_t norm, const OptParam& opt) { }
+  };
+};
+
+struct FMScore_ {
+  static const bool kNormLinear = true;
+  template <class O>
+  struct Latent {
+    Latent(Model* model, const SIMDKernel* kernel)
+     : v(model->GetParameter_v()),
+       aligned_k(model->get_aligned_k()),
+       sv(ScratchArena<real_t>::ThreadLocal()->Get(aligned_k)),
+       score_func(kernel->fm_score),
+       update_func(O::fm_update(kernel)) { }
+    real_t score(const Node* begin, const Node* end, real_t norm) {
+      return score_func(begin, end, v, aligned_k,
+                        O::kAux, norm, sv);
+    }
+    void update(const Node* begin, const Node* end,
+                real_t pg, real_t norm, const OptParam& opt) {
+      update_func(begin, end, v, aligned_k, pg,
+                  norm, opt, sv);
+    }
+    real_t* v;
+    index_t aligned_k;
+    /* Scratch buffer of current thread */
+    real_t* sv;
+    decltype(SIMDKernel::fm_score) score_func;
+    decltype(O::fm_update(nullptr)) update_func;
+  };
+};
+
+struct FFMScore_ {
+  static const bool kNormLinear = true;
+  template <class O>
+  struct Latent {
+    Latent(Model* model, const SIMDKernel* kernel)
+     : v(model->GetParameter_v()),
+       align0(O::kAux * model->get_aligned_k()),
+       align1(model->GetNumField() * align0),
+       score_func(kernel->ffm_score),
+       update_func(O::ffm_update(kernel)) { }
+    real_t score(const Node* begin, const Node* end, real_t norm) {
+      return score_func(begin, end, v, align0, align1,
+                        O::kAux, norm);
+    }
+    void update(const Node* begin, const Node* end,
+                real_t pg, real_t norm, const OptParam& opt) {
+      update_func(begin, end, v, align0, align1, pg, norm, opt);
+    }
+    real_t* v;
+    index_t align0;
+    index_t align1;
+    decltype(SIMDKernel::ffm_score) score_func;
+    decltype(O::ffm_update(nullptr)) update_func;
+  };
+};
+
+ /*********************************************************
+  *  Training kernel                                      *
+  *********************************************************/
+
+// The same computation as Score::CalcScore() and Score::CalcGrad()
+// in the same order.
+template <class S, class O, class L>
+real_t train_rows(const DMatrix* matrix,
+                  Model* model,
+                  const OptParam& opt,
+                  bool is_norm,
+                  const index_t* order,
+                  size_t start,
+                  size_t end) {
+  CHECK_GE(end, start);
+  CHECK_EQ(model->GetAuxiliarySize(), O::kAux);
+  real_t* w = model->GetParameter_w();
+  real_t* b = model->GetParameter_b();
+  typename S::template Latent<O> latent(
+      model, GetSIMDKernel(model->GetAlign()));
+  const SparseRow* rows = matrix->row.data();
+  const real_t* Y = matrix->Y.data();
+  const real_t* norm_list = matrix->norm.data();
+  real_t sum = 0;
+  for (size_t k = start; k < end; ++k) {
+    size_t i = order == nullptr ? k : order[k];
+    const Node* begin = rows[i].data();
+    const Node* last = begin + rows[i].size();
+    real_t norm = is_norm ? norm_list[i] : 1.0;
+    real_t sqrt_norm = sqrt(norm);
+    // linear term and bias term
+    real_t score_scale = S::kNormLinear ? sqrt_norm : 1.0;
+    real_t t = 0;
+    for (const Node* iter = begin; iter != last; ++iter) {
+      t += (iter->feat_val * w[iter->feat_id*O::kAux] * score_scale);
+    }
+    t += b[0];
+    real_t pred = latent.score(begin, last, norm) + t;
+    // partial gradient
+    real_t pg = 0;
+    sum += L::loss(Y[i], pred, &pg);
+    // update
+    real_t grad_scale = S::kNormLinear || O::kNormLinear ?
+                        sqrt_norm : 1.0;
+    for (const Node* iter = begin; iter != last; ++iter) {
+      O::update_w(w + iter->feat_id*O::kAux,
+                  pg*iter->feat_val*grad_scale, opt);
+    }
+    O::update_b(b, pg, opt);
+    latent.update(begin, last, pg, norm, opt);
+  }
+  return L::finish(sum);
+}
+
+template <class S, class L>
+TrainFunc get_train_func(const std::string& opt_type) {
+  if (opt_type == "sgd") {
+    return train_rows<S, SGDOpt, L>;
+  } else if (opt_type == "adagrad") {
+    return train_rows<S, AdaGradOpt, L>;
+  } else if (opt_type == "ftrl") {
+    return train_rows<S, FTRLOpt, L>;
+  }
+  return nullptr;
+}
+
+template <class L>
+TrainFunc get_train_func(const std::string& score_type,
+                         const std::string& opt_type) {
+  if (score_type == "linear") {
+    return get_train_func<LinearScore_, L>(opt_type);
+  } else if (score_type == "fm") {
+    return get_train_func<FMScore_, L>(opt_type);
+  } else if (score_type == "ffm") {
+    return get_train_func<FFMScore_, L>(opt_type);
+  }
+  return nullptr;
+}
+
+TrainFunc GetTrainFunc(const std::string& score_type,
+                       const std::string& opt_type,
+                       const std::string& loss_type) {
+  if (loss_type == "log_loss") {
+    return get_train_func<CrossEntropyLoss_>(score_type, opt_type);
+  } else if (loss_type == "mse_loss") {
+    return get_train_func<SquaredLoss_>(score_type, opt_type);
+  }
+  return nullptr;
+}
+
+}  // namespace xLearn
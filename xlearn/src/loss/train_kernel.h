@@ -0,0 +1,71 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the specialized training kernels, which are
+instantiated for each combination of score function, optimization
+method, and loss function.
+*/
+
+#ifndef XLEARN_LOSS_TRAIN_KERNEL_H_
+#define XLEARN_LOSS_TRAIN_KERNEL_H_
+
+#include <string>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/simd_kernel.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// The generic training loop of Loss calls the virtual Score::CalcScore()
+// and Score::CalcGrad() for each row, and CalcGrad() chooses the
+// optimization method by comparing strings. A TrainFunc trains the rows
+// [start, end) of matrix (or order[start], ..., order[end-1] if order is
+// not nullptr) in one function, where the score function, the optimization
+// method, the loss function, and the auxiliary size of the model are
+// compile-time constants:
+//
+//   TrainFunc train = GetTrainFunc("ffm", "adagrad", "log_loss");
+//   real_t loss_sum = train(matrix, &model, score->GetOptParam(),
+//                           true, nullptr, 0, matrix->row_length);
+//
+// The latent factor is still updated by the SIMD kernel of current CPU,
+// which is chosen once for each call. The computation is the same as
+// the generic training loop, except for the rounding of the fused
+// multiply-add that the compiler may generate.
+//------------------------------------------------------------------------------
+typedef real_t (*TrainFunc)(const DMatrix* matrix,
+                            Model* model,
+                            const OptParam& opt,
+                            bool is_norm,
+                            const index_t* order,
+                            size_t start,
+                            size_t end);
+
+// Return the kernel of the given score type ('linear', 'fm' and 'ffm'),
+// optimization method ('sgd', 'adagrad' and 'ftrl') and loss type
+// ('log_loss' and 'mse_loss'). Return nullptr if it is not found.
+TrainFunc GetTrainFunc(const std::string& score_type,
+                       const std::string& opt_type,
+                       const std::string& loss_type);
+
+}  // namespace xLearn
+
+#endif  // XLEARN_LOSS_TRAIN_KERNEL_H_
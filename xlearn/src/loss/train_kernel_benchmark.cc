@@ -0,0 +1,126 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the benchmark of the specialized training kernels. It
+reports the rows trained per second by the generic training loop
+(virtual Score methods) and by the training kernel, for each score
+function, optimization method and loss function:
+
+  ./train_kernel_benchmark [num_row] [K]
+*/
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/loss/loss.h"
+#include "src/score/score_function.h"
+
+using namespace xLearn;
+
+const index_t kNumFeature = 100000;
+const index_t kNumField = 20;
+const int kEpoch = 3;
+
+// Generate the ffm data
+void random_data(index_t num_row, DMatrix& matrix) {
+  matrix.ResetMatrix(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    for (index_t f = 0; f < kNumField; ++f) {
+      matrix.AddNode(i, rand() % kNumFeature, 1.0, f);
+    }
+    matrix.Y[i] = rand() % 2;
+    matrix.norm[i] = 1.0 / kNumField;
+  }
+}
+
+// Train the data in one thread and return rows/sec
+real_t run(DMatrix& matrix, const std::string& score_type,
+           const std::string& opt_type, const std::string& loss_func,
+           index_t num_K, bool use_kernel) {
+  index_t aux_size = opt_type == "sgd" ? 1 :
+                     opt_type == "adagrad" ? 2 : 3;
+  ThreadPool pool(1);
+  Model model;
+  model.Initialize(score_type, loss_func, kNumFeature,
+                   kNumField, num_K, aux_size);
+  std::string opt = opt_type;
+  Score* score = CREATE_SCORE(score_type.c_str());
+  score->Initialize(0.2, 0.00002, 0.3, 1.0, 0.00001, 0.00002, opt);
+  Loss* loss = CREATE_LOSS(loss_func.c_str());
+  loss->Initialize(score, &pool, true, false);
+  loss->UseTrainKernel(use_kernel);
+  Timer timer;
+  timer.tic();
+  for (int e = 0; e < kEpoch; ++e) {
+    loss->CalcGrad(&matrix, model);
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  delete loss;
+  delete score;
+  return matrix.row_length * kEpoch / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_row = argc > 1 ? atoi(argv[1]) : 50000;
+  index_t num_K = argc > 2 ? atoi(argv[2]) : 4;
+  print_info(StringPrintf("Rows: %d, fields: %d, K: %d",
+                          (int)num_row, (int)kNumField, (int)num_K));
+  DMatrix matrix;
+  random_data(num_row, matrix);
+  std::vector<std::string> column;
+  std::vector<int> width(6, 16);
+  column.push_back("Score");
+  column.push_back("Opt");
+  column.push_back("Loss");
+  column.push_back("Generic rows/s");
+  column.push_back("Kernel rows/s");
+  column.push_back("Speedup");
+  print_row(column, width);
+  const char* score[] = { "linear", "fm", "ffm" };
+  const char* opt[] = { "sgd", "adagrad", "ftrl" };
+  const char* loss[] = { "cross-entropy", "squared" };
+  for (int s = 0; s < 3; ++s) {
+    for (int o = 0; o < 3; ++o) {
+      for (int l = 0; l < 2; ++l) {
+        real_t generic = run(matrix, score[s], opt[o], loss[l],
+                             num_K, false);
+        real_t kernel = run(matrix, score[s], opt[o], loss[l],
+                            num_K, true);
+        column.clear();
+        column.push_back(score[s]);
+        column.push_back(opt[o]);
+        column.push_back(loss[l]);
+        column.push_back(StringPrintf("%.0f", generic));
+        column.push_back(StringPrintf("%.0f", kernel));
+        column.push_back(StringPrintf("%.2fx", kernel / generic));
+        print_row(column, width);
+      }
+    }
+  }
+  return 0;
+}
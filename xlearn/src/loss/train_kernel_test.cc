@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the specialized training kernels.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/alloc_counter.h"
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/loss/loss.h"
+#include "src/loss/train_kernel.h"
+#include "src/score/score_function.h"
+
+namespace xLearn {
+
+const index_t kNumRow = 300;
+const index_t kNumFeat = 50;
+const index_t kNumField = 6;
+
+void make_data(DMatrix& matrix, bool regression) {
+  matrix.ResetMatrix(kNumRow);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    for (index_t f = 0; f < kNumField; ++f) {
+      real_t val = (rand() % 100 + 1) / 100.0;
+      matrix.AddNode(i, rand() % kNumFeat, val, f);
+    }
+    matrix.Y[i] = regression ? (rand() % 100) / 10.0 : rand() % 2;
+    matrix.norm[i] = 1.0 / kNumField;
+  }
+}
+
+// The compiler can fuse the multiply-add in different ways,
+// so the results are not exactly the same.
+bool near(real_t a, real_t b) {
+  real_t diff = a > b ? a - b : b - a;
+  real_t abs_a = a > 0 ? a : -a;
+  return diff <= 1e-4 * (abs_a > 1 ? abs_a : 1);
+}
+
+// Train the same data by the generic loop and the training
+// kernel, and compare the loss and the model.
+void check_train_kernel(const std::string& score_type,
+                        const std::string& opt_type,
+                        const std::string& loss_func) {
+  SCOPED_TRACE(score_type + " " + opt_type + " " + loss_func);
+  DMatrix matrix;
+  make_data(matrix, loss_func == "squared");
+  index_t aux_size = opt_type == "sgd" ? 1 :
+                     opt_type == "adagrad" ? 2 : 3;
+  ThreadPool pool(1);
+  Model model;
+  model.Initialize(score_type, loss_func, kNumFeat,
+                   kNumField, 4, aux_size);
+  Model model_kernel;
+  model_kernel.CopyFrom(model);
+  std::string opt = opt_type;
+  Score* score = CREATE_SCORE(score_type.c_str());
+  score->Initialize(0.1, 0.002, 0.3, 1.0, 0.0001, 0.002, opt);
+  Loss* loss = CREATE_LOSS(loss_func.c_str());
+  loss->Initialize(score, &pool, true, false);
+  EXPECT_TRUE(GetTrainFunc(score_type, opt_type,
+                           loss->loss_type()) != nullptr);
+  real_t loss_val[2];
+  Model* m[2] = { &model, &model_kernel };
+  for (int k = 0; k < 2; ++k) {
+    loss->UseTrainKernel(k == 1);
+    loss->Reset();
+    for (int epoch = 0; epoch < 3; ++epoch) {
+      loss->CalcGrad(&matrix, *m[k]);
+    }
+    loss_val[k] = loss->GetLoss();
+  }
+  EXPECT_TRUE(near(loss_val[0], loss_val[1]));
+  real_t* w[2] = { model.GetParameter_w(), model_kernel.GetParameter_w() };
+  for (index_t i = 0; i < model.GetNumParameter_w(); ++i) {
+    ASSERT_TRUE(near(w[0][i], w[1][i]));
+  }
+  real_t* b[2] = { model.GetParameter_b(), model_kernel.GetParameter_b() };
+  for (index_t i = 0; i < aux_size; ++i) {
+    ASSERT_TRUE(near(b[0][i], b[1][i]));
+  }
+  real_t* v[2] = { model.GetParameter_v(), model_kernel.GetParameter_v() };
+  for (index_t i = 0; i < model.GetNumParameter_v(); ++i) {
+    ASSERT_TRUE(near(v[0][i], v[1][i]));
+  }
+  delete loss;
+  delete score;
+}
+
+TEST(TrainKernelTest, Same_As_Generic_Loop) {
+  const char* score[] = { "linear", "fm", "ffm" };
+  const char* opt[] = { "sgd", "adagrad", "ftrl" };
+  const char* loss[] = { "cross-entropy", "squared" };
+  for (int s = 0; s < 3; ++s) {
+    for (int o = 0; o < 3; ++o) {
+      for (int l = 0; l < 2; ++l) {
+        check_train_kernel(score[s], opt[o], loss[l]);
+      }
+    }
+  }
+}
+
+// The training kernels don't allocate memory after the first call.
+TEST(TrainKernelTest, No_Allocation) {
+  const char* score[] = { "linear", "fm", "ffm" };
+  const char* opt[] = { "sgd", "adagrad", "ftrl" };
+  DMatrix matrix;
+  make_data(matrix, false);
+  for (int s = 0; s < 3; ++s) {
+    for (int o = 0; o < 3; ++o) {
+      SCOPED_TRACE(std::string(score[s]) + " " + opt[o]);
+      Model model;
+      model.Initialize(score[s], "cross-entropy", kNumFeat,
+                       kNumField, 4, o + 1);
+      OptParam param;
+      param.learning_rate = 0.1;
+      param.regu_lambda = 0.002;
+      param.alpha = 0.3;
+      param.beta = 1.0;
+      param.lambda_1 = 0.0001;
+      param.lambda_2 = 0.002;
+      TrainFunc train = GetTrainFunc(score[s], opt[o], "log_loss");
+      ASSERT_TRUE(train != nullptr);
+      train(&matrix, &model, param, true, nullptr, 0, kNumRow);
+      uint64 before = GetAllocCount();
+      train(&matrix, &model, param, true, nullptr, 0, kNumRow);
+      EXPECT_EQ(GetAllocCount() - before, 0);
+    }
+  }
+}
+
+TEST(TrainKernelTest, Unknown_Type) {
+  EXPECT_TRUE(GetTrainFunc("ffm", "adam", "log_loss") == nullptr);
+  EXPECT_TRUE(GetTrainFunc("gbdt", "sgd", "log_loss") == nullptr);
+  EXPECT_TRUE(GetTrainFunc("ffm", "sgd", "hinge") == nullptr);
+}
+
+}  // namespace xLearn
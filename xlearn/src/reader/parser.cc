@@ -20,9 +20,11 @@ This file is the implementation of Parser class.
 
 #include "src/reader/parser.h"
 
-#include "src/base/split_string.h"
+#include <string.h>
+#include <algorithm>
+#include <utility>
 
-#include <stdlib.h>
+#include "src/base/parse_number.h"
 
 namespace xLearn {
 
@@ -34,40 +36,196 @@ REGISTER_PARSER("libsvm", LibsvmParser);
 REGISTER_PARSER("libffm", FFMParser);
 REGISTER_PARSER("csv", CSVParser);
 
-// How many lines are there in current memory buffer
-index_t Parser::get_line_number(char* buf, uint64 buf_size) {
-  index_t num = 0;
-  for (uint64 i = 0; i < buf_size; ++i) {
-    if (buf[i] == '\n') num++;
+//------------------------------------------------------------------------------
+// ParseChunk
+//------------------------------------------------------------------------------
+
+/* Lines longer than this are sorted by std::stable_sort,
+and the shorter ones by the insertion sort */
+static const index_t kInsertionSortLength = 32;
+
+static bool node_field_less(const Node& a, const Node& b) {
+  return a.field_id < b.field_id;
+}
+
+static bool keyed_node_field_less(const std::pair<Node, uint64>& a,
+                                  const std::pair<Node, uint64>& b) {
+  return a.first.field_id < b.first.field_id;
+}
+
+void ParseChunk::GroupLastRowByField() {
+  index_t len = size.back();
+  Node* row = nodes.data() + (nodes.size() - len);
+  uint64* row_key = keys.size() == nodes.size() ?
+                    keys.data() + (keys.size() - len) : nullptr;
+  // Most of the datasets are already grouped
+  index_t i = 1;
+  while (i < len && row[i-1].field_id <= row[i].field_id) { ++i; }
+  if (i >= len) { return; }
+  if (len > kInsertionSortLength) {
+    if (row_key == nullptr) {
+      std::stable_sort(row, row + len, node_field_less);
+    } else {
+      std::vector<std::pair<Node, uint64>> tmp(len);
+      for (index_t k = 0; k < len; ++k) {
+        tmp[k] = std::make_pair(row[k], row_key[k]);
+      }
+      std::stable_sort(tmp.begin(), tmp.end(), keyed_node_field_less);
+      for (index_t k = 0; k < len; ++k) {
+        row[k] = tmp[k].first;
+        row_key[k] = tmp[k].second;
+      }
+    }
+    return;
+  }
+  for (; i < len; ++i) {
+    Node node = row[i];
+    uint64 key = row_key != nullptr ? row_key[i] : 0;
+    index_t j = i;
+    for (; j > 0 && row[j-1].field_id > node.field_id; --j) {
+      row[j] = row[j-1];
+      if (row_key != nullptr) { row_key[j] = row_key[j-1]; }
+    }
+    row[j] = node;
+    if (row_key != nullptr) { row_key[j] = key; }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Parser
+//------------------------------------------------------------------------------
+
+// Hash the feature ids
+void Parser::setFeatureHash(int hash_bits,
+                            FeatureMap* map,
+                            bool insert) {
+  CHECK_GE(hash_bits, 0);
+  // 2^hash_bits features must fit in index_t
+  CHECK_LE(hash_bits, 31);
+  hash_bits_ = hash_bits;
+  hash_mask_ = hash_bits == 0 ? ~(uint64)0 :
+               ((uint64)1 << hash_bits) - 1;
+  feat_map_ = map;
+  map_insert_ = insert;
+  // Without map, the hashed id must fit in index_t
+  if (map == nullptr) {
+    CHECK_GT(hash_bits, 0);
+  }
+  hash_feature_ = true;
+}
+
+// Parse the buffer to the DMatrix
+void Parser::Parse(char* buf, uint64 size, DMatrix& matrix) {
+  CHECK_NOTNULL(buf);
+  CHECK_GT(size, 0);
+  // Split the buffer into chunks at the line boundary
+  size_t chunk_num = 1;
+  if (pool_ != nullptr) {
+    chunk_num = std::min((uint64)pool_->ThreadNumber(),
+                         std::max(size / kMinParseChunkSize, (uint64)1));
+  }
+  const char* buf_end = buf + size;
+  std::vector<const char*>& bound = bound_;
+  bound.resize(chunk_num + 1);
+  bound[0] = buf;
+  bound[chunk_num] = buf_end;
+  for (size_t i = 1; i < chunk_num; ++i) {
+    const char* pos = buf + size / chunk_num * i;
+    if (pos < bound[i-1]) { pos = bound[i-1]; }
+    const char* eol = (const char*)memchr(pos, '\n', buf_end - pos);
+    bound[i] = eol == nullptr ? buf_end : eol + 1;
+  }
+  // Parse every chunk. The chunks of last Parse() are reused.
+  std::vector<ParseChunk>& chunks = chunks_;
+  if (chunks.size() < chunk_num) { chunks.resize(chunk_num); }
+  for (size_t i = 0; i < chunk_num; ++i) {
+    chunks[i].Clear();
   }
-  // The last line may doesn't contain the '\n'
-  // and we need +1 here
-  if (buf[buf_size-1] != '\n') {
-    num += 1;
+  if (chunk_num == 1) {
+    parse_chunk(bound[0], bound[1], &chunks[0]);
+  } else {
+    pool_->ParallelFor(0, chunk_num, 1, [&](size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        parse_chunk(bound[i], bound[i+1], &chunks[i]);
+      }
+    });
+  }
+  // Give the ids to the new keys in the order of lines
+  if (feat_map_ != nullptr && map_insert_) {
+    for (size_t i = 0; i < chunk_num; ++i) {
+      std::vector<Node>& nodes = chunks[i].nodes;
+      const std::vector<uint64>& keys = chunks[i].keys;
+      CHECK_EQ(nodes.size(), keys.size());
+      for (size_t j = 0; j < nodes.size(); ++j) {
+        nodes[j].feat_id = feat_map_->Insert(keys[j]);
+      }
+    }
+  }
+  // Merge the chunks to the matrix
+  std::vector<index_t>& row_offset = row_offset_;
+  std::vector<size_t>& node_offset = node_offset_;
+  row_offset.assign(chunk_num + 1, 0);
+  node_offset.assign(chunk_num + 1, 0);
+  for (size_t i = 0; i < chunk_num; ++i) {
+    row_offset[i+1] = row_offset[i] + chunks[i].Y.size();
+    node_offset[i+1] = node_offset[i] + chunks[i].nodes.size();
+  }
+  matrix.ResetMatrix(row_offset[chunk_num]);
+  if (chunk_num == 1) {
+    // We don't need to copy the nodes. The old nodes of the
+    // matrix become the node buffer of the next Parse().
+    matrix.nodes.swap(chunks[0].nodes);
+    merge_chunk(chunks[0], 0, 0, &matrix);
+  } else {
+    matrix.nodes.resize(node_offset[chunk_num]);
+    pool_->ParallelFor(0, chunk_num, 1, [&](size_t start, size_t end) {
+      for (size_t i = start; i < end; ++i) {
+        merge_chunk(chunks[i], row_offset[i], node_offset[i], &matrix);
+      }
+    });
   }
-  return num;
 }
 
-// Get one line from memory buffer
-uint64 Parser::get_line_from_buffer(char* line,
-                                    char* buf,
-                                    uint64 pos,
-                                    uint64 size) {
-  if (pos >= size) { return 0; }
-  uint64 end_pos = pos;
-  while (end_pos < size && buf[end_pos] != '\n') { end_pos++; }
-  uint64 read_size = end_pos - pos + 1;
-  if (read_size > kMaxLineSize) {
-    LOG(FATAL) << "Encountered a too-long line.    \
-                   Please check the data.";
-  }
-  memcpy(line, buf+pos, read_size);
-  line[read_size - 1] = '\0';
-  if (read_size > 1 && line[read_size - 2] == '\r') {
+// Parse all the lines in [begin, end) to the chunk
+void Parser::parse_chunk(const char* begin,
+                         const char* end,
+                         ParseChunk* chunk) {
+  const char* pos = begin;
+  while (pos < end) {
+    const char* eol = (const char*)memchr(pos, '\n', end - pos);
+    if (eol == nullptr) { eol = end; }
+    const char* line_end = eol;
     // Handle some txt format in windows or DOS.
-    line[read_size - 2] = '\0';
+    if (line_end > pos && *(line_end-1) == '\r') { line_end--; }
+    parse_line(pos, line_end, chunk);
+    pos = eol + 1;
   }
-  return read_size;
+}
+
+// Copy the chunk to the matrix. If the nodes have been
+// swapped to the matrix, we don't need to copy them.
+void Parser::merge_chunk(const ParseChunk& chunk,
+                         index_t row_offset,
+                         size_t node_offset,
+                         DMatrix* matrix) {
+  Node* node = matrix->nodes.data() + node_offset;
+  if (!chunk.nodes.empty()) {
+    memcpy(node, chunk.nodes.data(), chunk.nodes.size() * sizeof(Node));
+  }
+  for (size_t i = 0; i < chunk.Y.size(); ++i) {
+    index_t r = row_offset + i;
+    matrix->Y[r] = chunk.Y[i];
+    matrix->norm[r] = 1.0f / chunk.norm[i];
+    matrix->row[r] = SparseRow(node, chunk.size[i]);
+    node += chunk.size[i];
+  }
+}
+
+// Print the bad line and exit.
+static void parse_error(const char* begin, const char* end) {
+  LOG(FATAL) << "Cannot parse the line: "
+             << std::string(begin, std::min<size_t>(end - begin, 256))
+             << " Please check the data.";
 }
 
 //------------------------------------------------------------------------------
@@ -76,52 +234,37 @@ uint64 Parser::get_line_from_buffer(char* line,
 // [y2 idx:value idx:value ...]
 // idx can start from 0
 //------------------------------------------------------------------------------
-void LibsvmParser::Parse(char* buf, uint64 size, DMatrix& matrix) {
-  CHECK_NOTNULL(buf);
-  CHECK_GT(size, 0);
-  index_t line_num = get_line_number(buf, size);
-  matrix.ResetMatrix(line_num);
-  char* line_buf = new char[kMaxLineSize];
-  // Parse every line
-  uint64 pos = 0;
-  for (index_t i = 0; i < line_num; ++i) {
-    pos += get_line_from_buffer(line_buf, buf, pos, size);
-    // Add Y
-    if (has_label_) {  // for training task
-      char *y_char = strtok(line_buf, " \t");
-      matrix.Y[i] = atof(y_char);
-    } else {  // for predict task
-      matrix.Y[i] = -2;
-    }
-    // Add features
-    real_t norm = 0.0;
-    // The first element
-    if (!has_label_) {
-      char *idx_char = strtok(line_buf, ":");
-      char *value_char = strtok(nullptr, " \t");
-      if (idx_char != nullptr && *idx_char != '\n') {
-        index_t idx = atoi(idx_char);
-        real_t value = atof(value_char);
-        matrix.AddNode(i, idx, value);
-        norm += value*value;
-      }
+void LibsvmParser::parse_line(const char* begin,
+                              const char* end,
+                              ParseChunk* chunk) {
+  const char* pos = SkipBlank(begin, end);
+  // Skip the empty line
+  if (pos == end) { return; }
+  // Add Y
+  real_t y = -2;  // for predict task
+  if (has_label_) {  // for training task
+    pos = ParseReal(pos, end, &y);
+  }
+  chunk->AddRow(y);
+  // Add features
+  for (;;) {
+    pos = SkipBlank(pos, end);
+    if (pos == end) { break; }
+    index_t idx = 0;
+    uint64 key = 0;
+    real_t value = 0;
+    const char* next = hash_feature_ ? parse_key(pos, end, &key) :
+                                       ParseUInt(pos, end, &idx);
+    if (next == pos || next == end || *next != ':') {
+      parse_error(begin, end);
     }
-    // The remain elements
-    for (;;) {
-      char *idx_char = strtok(nullptr, ":");
-      char *value_char = strtok(nullptr, " \t");
-      if (idx_char == nullptr || *idx_char == '\n') {
-        break;
-      }
-      index_t idx = atoi(idx_char);
-      real_t value = atof(value_char);
-      matrix.AddNode(i, idx, value);
-      norm += value*value;
+    pos = ParseReal(next+1, end, &value);
+    if (hash_feature_) {
+      add_hashed_node(key, value, 0, chunk);
+    } else {
+      chunk->AddNode(idx, value);
     }
-    norm = 1.0f / norm;
-    matrix.norm[i] = norm;
   }
-  delete [] line_buf;
 }
 
 //------------------------------------------------------------------------------
@@ -130,56 +273,44 @@ void LibsvmParser::Parse(char* buf, uint64 size, DMatrix& matrix) {
 // [y2 field:idx:value field:idx:value ...]
 // idx can start from 0
 //------------------------------------------------------------------------------
-void FFMParser::Parse(char* buf, uint64 size, DMatrix& matrix) {
-  CHECK_NOTNULL(buf);
-  CHECK_GT(size, 0);
-  index_t line_num = get_line_number(buf, size);
-  matrix.ResetMatrix(line_num);
-  char* line_buf = new char[kMaxLineSize];
-  // Parse every line
-  uint64 pos = 0;
-  for (index_t i = 0; i < line_num; ++i) {
-    pos += get_line_from_buffer(line_buf, buf, pos, size);
-    // Add Y
-    if (has_label_) {  // for training task
-      char *y_char = strtok(line_buf, " \t");
-      matrix.Y[i] = atof(y_char);
-    } else {  // for predict task
-      matrix.Y[i] = -2;
+void FFMParser::parse_line(const char* begin,
+                           const char* end,
+                           ParseChunk* chunk) {
+  const char* pos = SkipBlank(begin, end);
+  // Skip the empty line
+  if (pos == end) { return; }
+  // Add Y
+  real_t y = -2;  // for predict task
+  if (has_label_) {  // for training task
+    pos = ParseReal(pos, end, &y);
+  }
+  chunk->AddRow(y);
+  // Add features
+  for (;;) {
+    pos = SkipBlank(pos, end);
+    if (pos == end) { break; }
+    index_t field_id = 0;
+    index_t idx = 0;
+    real_t value = 0;
+    const char* next = ParseUInt(pos, end, &field_id);
+    if (next == pos || next == end || *next != ':') {
+      parse_error(begin, end);
     }
-    // Add features
-    real_t norm = 0.0;
-    // The first element
-    if (!has_label_) {
-      char *field_char = strtok(line_buf, ":");
-      char *idx_char = strtok(nullptr, ":");
-      char *value_char = strtok(nullptr, " \t");
-      if (idx_char != nullptr && *idx_char != '\n') {
-        index_t idx = atoi(idx_char);
-        real_t value = atof(value_char);
-        index_t field_id = atoi(field_char);
-        matrix.AddNode(i, idx, value, field_id);
-        norm += value*value;
-      }
+    pos = next + 1;
+    uint64 key = 0;
+    next = hash_feature_ ? parse_key(pos, end, &key) :
+                           ParseUInt(pos, end, &idx);
+    if (next == pos || next == end || *next != ':') {
+      parse_error(begin, end);
     }
-    // The remain elements
-    for (;;) {
-      char *field_char = strtok(nullptr, ":");
-      char *idx_char = strtok(nullptr, ":");
-      char *value_char = strtok(nullptr, " \t");
-      if (field_char == nullptr || *field_char == '\n') {
-        break;
-      }
-      index_t idx = atoi(idx_char);
-      real_t value = atof(value_char);
-      index_t field_id = atoi(field_char);
-      matrix.AddNode(i, idx, value, field_id);
-      norm += value*value;
+    pos = ParseReal(next+1, end, &value);
+    if (hash_feature_) {
+      add_hashed_node(key, value, field_id, chunk);
+    } else {
+      chunk->AddNode(idx, value, field_id);
     }
-    norm = 1.0f / norm;
-    matrix.norm[i] = norm;
   }
-  delete [] line_buf;
+  chunk->GroupLastRowByField();
 }
 
 //------------------------------------------------------------------------------
@@ -191,36 +322,30 @@ void FFMParser::Parse(char* buf, uint64 size, DMatrix& matrix) {
 // by themselves (Also in test data). Otherwise, the parser 
 // will treat the first element as the label y.
 //------------------------------------------------------------------------------
-void CSVParser::Parse(char* buf, uint64 size, DMatrix& matrix) {
-  CHECK_NOTNULL(buf);
-  CHECK_GT(size, 0);
-  index_t line_num = get_line_number(buf, size);
-  matrix.ResetMatrix(line_num);
-  char* line_buf = new char[kMaxLineSize];
-  // Parse every line
-  uint64 pos = 0;
-  std::vector<std::string> str_vec;
-  for (index_t i = 0; i < line_num; ++i) {
-    pos += get_line_from_buffer(line_buf, buf, pos, size);
-    str_vec.clear();
-    SplitStringUsing(line_buf, " \t", &str_vec);
-    int size = str_vec.size();
-    // Add Y
-    matrix.Y[i] = atof(str_vec[0].c_str());
-    // Add features
-    real_t norm = 0.0;
-    for (int j = 1; j < size; ++j) {
-      index_t idx = j-1;
-      real_t value = atof(str_vec[j].c_str());
-      // skip zero
-      if (value < kVerySmallNumber) { continue; }
-      matrix.AddNode(i, idx, value);
-      norm += value*value;
+void CSVParser::parse_line(const char* begin,
+                           const char* end,
+                           ParseChunk* chunk) {
+  const char* pos = SkipBlank(begin, end);
+  // Skip the empty line
+  if (pos == end) { return; }
+  // Add Y
+  real_t y = 0;
+  pos = ParseReal(pos, end, &y);
+  chunk->AddRow(y);
+  // Add features
+  for (index_t idx = 0; ; ++idx) {
+    pos = SkipBlank(pos, end);
+    if (pos == end) { break; }
+    real_t value = 0;
+    const char* next = ParseReal(pos, end, &value);
+    if (next == pos) {
+      parse_error(begin, end);
     }
-    norm = 1.0f / norm;
-    matrix.norm[i] = norm;
+    pos = next;
+    // skip zero
+    if (value < kVerySmallNumber) { continue; }
+    chunk->AddNode(idx, value);
   }
-  delete [] line_buf;
 }
 
 } // namespace xLearn
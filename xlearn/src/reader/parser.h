@@ -27,10 +27,72 @@ to the DMatrix.
 
 #include "src/base/common.h"
 #include "src/base/class_register.h"
+#include "src/base/thread_pool.h"
 #include "src/data/data_structure.h"
+#include "src/data/feature_map.h"
 
 namespace xLearn {
 
+/* Each thread parses at least 1 MB of the buffer */
+const uint64 kMinParseChunkSize = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+// ParseChunk stores the result of parsing one chunk of the memory
+// buffer. The chunks are parsed by different threads and then merged
+// into the DMatrix in order.
+//------------------------------------------------------------------------------
+struct ParseChunk {
+  /* Label y of each line */
+  std::vector<real_t> Y;
+  /* Norm of each line */
+  std::vector<real_t> norm;
+  /* Number of nodes of each line */
+  std::vector<index_t> size;
+  /* Nodes of all lines */
+  std::vector<Node> nodes;
+  /* Feature key of each node, which is used
+  when the new keys are added to a FeatureMap */
+  std::vector<uint64> keys;
+
+  // Remove all the lines and keep the memory,
+  // so the chunk can be reused by the next Parse().
+  inline void Clear() {
+    Y.clear();
+    norm.clear();
+    size.clear();
+    nodes.clear();
+    keys.clear();
+  }
+
+  // Add a new line.
+  inline void AddRow(real_t y) {
+    Y.push_back(y);
+    norm.push_back(0);
+    size.push_back(0);
+  }
+
+  // Add a node to the last line.
+  inline void AddNode(index_t feat_id,
+                      real_t feat_val,
+                      index_t field_id = 0) {
+    nodes.push_back(Node(field_id, feat_id, feat_val));
+    norm.back() += feat_val*feat_val;
+    size.back()++;
+  }
+
+  // Add a feature that is not stored to the norm of the last line.
+  inline void AddNorm(real_t feat_val) {
+    norm.back() += feat_val*feat_val;
+  }
+
+  // Stable sort the nodes of the last line by field_id, and
+  // move the keys (if any) with their nodes. The FFM kernels
+  // reuse the latent block w[j1][f2] for the consecutive nodes
+  // of the same field, so a grouped line touches fewer lines
+  // of the model than a line with the fields interleaved.
+  void GroupLastRowByField();
+};
+
 //------------------------------------------------------------------------------
 // Given a memory buffer, parse it to the DMatrix format.
 // Parser is an abstract class, which can be implemented by real
@@ -48,14 +110,37 @@ namespace xLearn {
 //     parser = new CSVParser();
 //   }
 //   parser->setLabel(true);  // this dataset contains label y
+//   parser->setThreadPool(pool);  // parse in multiple threads
 //   char* buffer = nullptr;
-//   uint64 size = ReadFileToMemory(filename, buffer);
+//   uint64 size = ReadFileToMemory(filename, &buffer);
 //   DMatrix matrix;
 //   parser->Parse(buffer, size, matrix);
+//
+// The buffer is split into chunks at the line boundary, and each
+// thread of the pool parses one chunk. The lines are tokenized in
+// place (no copy of line and no strtok) by the parse_line() of
+// each Parser, and the chunks are merged into the DMatrix in order.
+// Without thread pool, the buffer is parsed in current thread.
+// The chunks are kept by the Parser and reused by the next Parse(),
+// so parsing the blocks of similar size into the same DMatrix does
+// not allocate memory after the first few blocks.
+//
+// For the libsvm and libffm format, the feature ids can be hashed:
+//
+//   /* The feature id becomes MurmurHash64(id) % 2^20. The id
+//   can be any string without ':' and blank, e.g., 'user_123' */
+//   parser->setFeatureHash(20);
+//
+//   /* The 64-bit hashed ids are mapped to compact ids by map.
+//   The new keys are added to map if insert is true, and the
+//   features of the new keys are dropped if insert is false */
+//   parser->setFeatureHash(0, &map, insert);
 //------------------------------------------------------------------------------
 class Parser {
  public:
-  Parser() { }
+  Parser() : has_label_(false), pool_(nullptr),
+             hash_feature_(false), hash_bits_(0), hash_mask_(0),
+             feat_map_(nullptr), map_insert_(false) { }
   virtual ~Parser() {  }
 
   // Wether this dataset contains label y ?
@@ -63,22 +148,95 @@ class Parser {
     has_label_ = label;
   }
 
+  // Parse the buffer using this thread pool.
+  inline void setThreadPool(ThreadPool* pool) {
+    pool_ = pool;
+  }
+
+  // Hash the feature ids into 2^hash_bits buckets (0 for
+  // the full 64 bits), and map them to compact ids by map
+  // if map is not nullptr.
+  void setFeatureHash(int hash_bits,
+                      FeatureMap* map = nullptr,
+                      bool insert = true);
+
   // The real parse function invoked by users.
-  virtual void Parse(char* buf, uint64 size, DMatrix& matrix) = 0;
+  void Parse(char* buf, uint64 size, DMatrix& matrix);
 
  protected:
-   // Get how many lines in current memory buffer.
-   index_t get_line_number(char* buf, uint64 size);
+   // Parse one line [begin, end) to the chunk.
+   // The '\n' and '\r' have been removed from the line.
+   virtual void parse_line(const char* begin,
+                           const char* end,
+                           ParseChunk* chunk) = 0;
 
-   // Get one line from memory buffer.
-   uint64 get_line_from_buffer(char* line,
-                         char* buf,
-                         uint64 pos,
-                         uint64 size);
+   // Parse all the lines in [begin, end) to the chunk.
+   void parse_chunk(const char* begin,
+                    const char* end,
+                    ParseChunk* chunk);
+
+   // Copy the chunk to the matrix, starting from
+   // the row_offset row and the node_offset node.
+   void merge_chunk(const ParseChunk& chunk,
+                    index_t row_offset,
+                    size_t node_offset,
+                    DMatrix* matrix);
 
    /* True for training task and
    False for prediction task */
    bool has_label_;
+   /* Thread pool for parsing */
+   ThreadPool* pool_;
+   /* Hash the feature ids ? */
+   bool hash_feature_;
+   /* Number of hash bits, 0 for 64 bits */
+   int hash_bits_;
+   uint64 hash_mask_;
+   /* Map the hashed ids to the compact ids */
+   FeatureMap* feat_map_;
+   /* Add the new keys to feat_map_ ? */
+   bool map_insert_;
+   /* Chunk of each thread, reused by every Parse() */
+   std::vector<ParseChunk> chunks_;
+   /* Boundary of the chunks in the buffer */
+   std::vector<const char*> bound_;
+   /* First row and first node of each chunk in the matrix */
+   std::vector<index_t> row_offset_;
+   std::vector<size_t> node_offset_;
+
+   // Hash the feature id in [begin, end) that ends with ':'.
+   // Return the position of ':', or begin if there is no id.
+   const char* parse_key(const char* begin,
+                         const char* end,
+                         uint64* key) {
+     const char* p = begin;
+     while (p < end && *p != ':' && *p != ' ' && *p != '\t') { ++p; }
+     if (p == begin) { return begin; }
+     *key = MurmurHash64(begin, p - begin) & hash_mask_;
+     return p;
+   }
+
+   // Add the node of a hashed feature to the chunk.
+   void add_hashed_node(uint64 key,
+                        real_t value,
+                        index_t field_id,
+                        ParseChunk* chunk) {
+     if (feat_map_ == nullptr) {
+       chunk->AddNode((index_t)key, value, field_id);
+     } else if (map_insert_) {
+       // The id is given after all the chunks are parsed,
+       // so the ids don't depend on the number of threads.
+       chunk->keys.push_back(key);
+       chunk->AddNode(0, value, field_id);
+     } else {
+       index_t id = feat_map_->Find(key);
+       if (id == FeatureMap::kNotFound) {
+         chunk->AddNorm(value);
+       } else {
+         chunk->AddNode(id, value, field_id);
+       }
+     }
+   }
 
  private:
   DISALLOW_COPY_AND_ASSIGN(Parser);
@@ -94,8 +252,11 @@ class LibsvmParser : public Parser {
   LibsvmParser() { }
   ~LibsvmParser() {  }
 
-  // Parse the libsvm file
-  void Parse(char* buf, uint64 size, DMatrix& matrix);
+ protected:
+  // Parse one line of the libsvm file
+  void parse_line(const char* begin,
+                  const char* end,
+                  ParseChunk* chunk);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(LibsvmParser);
@@ -111,8 +272,11 @@ class FFMParser : public Parser {
   FFMParser() { }
   ~FFMParser() {  }
 
-  // Parse the libffm file
-  void Parse(char* buf, uint64 size, DMatrix& matrix);
+ protected:
+  // Parse one line of the libffm file
+  void parse_line(const char* begin,
+                  const char* end,
+                  ParseChunk* chunk);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(FFMParser);
@@ -132,8 +296,11 @@ class CSVParser : public Parser {
   CSVParser() { }
   ~CSVParser() { }
 
-  // Parse the csv file
-  void Parse(char* buf, uint64 size, DMatrix& matrix);
+ protected:
+  // Parse one line of the csv file
+  void parse_line(const char* begin,
+                  const char* end,
+                  ParseChunk* chunk);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(CSVParser);
@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the throughput benchmark of the Parser. It reports the
+bytes parsed per second by the old line-by-line parser (strtok and atof)
+and by the chunked parser with different number of threads:
+
+  ./parser_benchmark [size_MB] [max_thread]
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/reader/parser.h"
+
+using namespace xLearn;
+
+const index_t kNumFeature = 1000000;
+const index_t kNumField = 40;
+const index_t kRowLength = 40;
+const int kRepeat = 3;
+
+// Generate the libsvm or libffm data of the given size
+std::string random_data(uint64 size, bool ffm) {
+  std::string data;
+  data.reserve(size + 1024);
+  char buf[64];
+  while (data.size() < size) {
+    data += (rand() % 2) ? "1" : "0";
+    for (index_t j = 0; j < kRowLength; ++j) {
+      index_t feat = rand() % kNumFeature;
+      real_t val = (rand() % 1000) / 1000.0;
+      if (ffm) {
+        snprintf(buf, sizeof(buf), " %d:%d:%.3f", j % kNumField, feat, val);
+      } else {
+        snprintf(buf, sizeof(buf), " %d:%.3f", feat, val);
+      }
+      data += buf;
+    }
+    data += "\n";
+  }
+  return data;
+}
+
+//------------------------------------------------------------------------------
+// The old parser, which copies every line to a buffer and
+// tokenizes it by strtok.
+//------------------------------------------------------------------------------
+void old_parse(char* buf, uint64 size, bool ffm, DMatrix& matrix) {
+  index_t line_num = 0;
+  for (uint64 i = 0; i < size; ++i) {
+    if (buf[i] == '\n') line_num++;
+  }
+  if (buf[size-1] != '\n') { line_num += 1; }
+  matrix.ResetMatrix(line_num);
+  char* line_buf = new char[kMaxLineSize];
+  uint64 pos = 0;
+  for (index_t i = 0; i < line_num; ++i) {
+    // Get one line
+    uint64 end_pos = pos;
+    while (end_pos < size && buf[end_pos] != '\n') { end_pos++; }
+    uint64 read_size = end_pos - pos + 1;
+    memcpy(line_buf, buf+pos, read_size);
+    line_buf[read_size - 1] = '\0';
+    pos += read_size;
+    // Add Y
+    char *y_char = strtok(line_buf, " \t");
+    matrix.Y[i] = atof(y_char);
+    // Add features
+    real_t norm = 0.0;
+    for (;;) {
+      char *field_char = ffm ? strtok(nullptr, ":") : nullptr;
+      char *idx_char = strtok(nullptr, ":");
+      char *value_char = strtok(nullptr, " \t");
+      if (idx_char == nullptr || *idx_char == '\n') {
+        break;
+      }
+      index_t idx = atoi(idx_char);
+      real_t value = atof(value_char);
+      index_t field_id = ffm ? atoi(field_char) : 0;
+      matrix.AddNode(i, idx, value, field_id);
+      norm += value*value;
+    }
+    matrix.norm[i] = 1.0f / norm;
+  }
+  delete [] line_buf;
+}
+
+// Run the parser and return MB/sec
+template <typename Func>
+real_t run(uint64 size, Func func) {
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    func();
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  return size * kRepeat / sec / (1024.0 * 1024.0);
+}
+
+int main(int argc, char* argv[]) {
+  uint64 size_mb = argc > 1 ? atoi(argv[1]) : 64;
+  size_t max_thread = argc > 2 ? atoi(argv[2]) :
+                      std::thread::hardware_concurrency();
+  if (max_thread == 0) { max_thread = 1; }
+  print_info(StringPrintf("Data size: %d MB, max thread: %d",
+                          (int)size_mb, (int)max_thread));
+  std::vector<std::string> column;
+  std::vector<int> width(4, 16);
+  column.push_back("Format");
+  column.push_back("Parser");
+  column.push_back("MB/s");
+  column.push_back("Speedup");
+  print_row(column, width);
+
+  for (int f = 0; f < 2; ++f) {
+    bool ffm = (f == 1);
+    std::string data = random_data(size_mb * 1024 * 1024, ffm);
+    uint64 size = data.size();
+    // strtok modifies the buffer, so we use a copy of data.
+    std::vector<char> buf(data.begin(), data.end());
+    DMatrix matrix;
+    real_t old_rate = run(size, [&]() {
+      memcpy(buf.data(), data.data(), size);
+      old_parse(buf.data(), size, ffm, matrix);
+    });
+    column.clear();
+    column.push_back(ffm ? "libffm" : "libsvm");
+    column.push_back("old");
+    column.push_back(StringPrintf("%.1f", old_rate));
+    column.push_back("1.00x");
+    print_row(column, width);
+    Parser* parser = ffm ? (Parser*)new FFMParser() :
+                           (Parser*)new LibsvmParser();
+    parser->setLabel(true);
+    for (size_t t = 1; t <= max_thread; t *= 2) {
+      ThreadPool pool(t);
+      parser->setThreadPool(t == 1 ? nullptr : &pool);
+      real_t rate = run(size, [&]() {
+        parser->Parse(&data[0], size, matrix);
+      });
+      column.clear();
+      column.push_back(ffm ? "libffm" : "libsvm");
+      column.push_back(StringPrintf("chunked-%d", (int)t));
+      column.push_back(StringPrintf("%.1f", rate));
+      column.push_back(StringPrintf("%.2fx", rate / old_rate));
+      print_row(column, width);
+    }
+    delete parser;
+  }
+
+  return 0;
+}
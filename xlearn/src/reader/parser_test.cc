@@ -23,6 +23,8 @@ This file tests parser.h file.
 #include <string>
 #include <vector>
 
+#include "src/base/stringprintf.h"
+#include "src/base/alloc_counter.h"
 #include "src/reader/parser.h"
 #include "src/data/data_structure.h"
 
@@ -56,9 +58,9 @@ void check(const DMatrix& matrix, bool has_label, bool has_field) {
       EXPECT_EQ(matrix.Y[i], -2);
     }
     EXPECT_FLOAT_EQ(matrix.norm[i], 13.888889);
-    int col_len = matrix.row[i]->size();
+    int col_len = matrix.row[i].size();
     EXPECT_EQ(col_len, 5);
-    SparseRow *row = matrix.row[i];
+    const SparseRow *row = &matrix.row[i];
     int n = 0;
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
@@ -135,6 +137,208 @@ TEST(PARSER_TEST, Parse_csv) {
   RemoveFile(Kfilename.c_str());
 }
 
+// Parse the same buffer with and without thread pool
+void parse_in_parallel(Parser* parser, const std::string& data,
+                       bool has_label, bool has_field) {
+  write_data(Kfilename, data);
+  char* buffer = nullptr;
+  uint64 size = ReadFileToMemory(Kfilename, &buffer);
+  ThreadPool pool(3);
+  parser->setLabel(has_label);
+  parser->setThreadPool(&pool);
+  DMatrix matrix;
+  parser->Parse(buffer, size, matrix);
+  check(matrix, has_label, has_field);
+  // Parse again to the same matrix
+  parser->Parse(buffer, size, matrix);
+  check(matrix, has_label, has_field);
+  delete [] buffer;
+  RemoveFile(Kfilename.c_str());
+}
+
+TEST(PARSER_TEST, Parse_in_parallel) {
+  LibsvmParser libsvm;
+  parse_in_parallel(&libsvm, kStr, true, false);
+  parse_in_parallel(&libsvm, kStrNoy, false, false);
+  FFMParser ffm;
+  parse_in_parallel(&ffm, kStrFFM, true, true);
+  parse_in_parallel(&ffm, kStrFFMNoy, false, true);
+  CSVParser csv;
+  parse_in_parallel(&csv, kStrCSV, true, false);
+}
+
+// The chunks are reused, so parsing the blocks into the same
+// matrix does not allocate memory after the first two blocks.
+TEST(PARSER_TEST, Parse_no_allocation) {
+  std::string data;
+  for (int i = 0; i < 1000; ++i) {
+    data += kStrFFM;
+  }
+  std::string small = kStrFFM + kStrFFM;
+  DMatrix matrix;
+  FFMParser parser;
+  parser.setLabel(true);
+  parser.Parse(&data[0], data.size(), matrix);
+  parser.Parse(&data[0], data.size(), matrix);
+  uint64 before = GetAllocCount();
+  parser.Parse(&data[0], data.size(), matrix);
+  EXPECT_EQ(GetAllocCount() - before, 0);
+  ASSERT_EQ(matrix.row_length, 1000);
+  for (index_t i = 0; i < matrix.row_length; ++i) {
+    EXPECT_EQ(matrix.Y[i], 1);
+    EXPECT_FLOAT_EQ(matrix.norm[i], 13.888889);
+    ASSERT_EQ(matrix.row[i].size(), 5);
+    EXPECT_EQ(matrix.row[i][4].field_id, 4);
+  }
+  // A smaller block uses the same memory
+  parser.Parse(&small[0], small.size(), matrix);
+  EXPECT_EQ(GetAllocCount() - before, 0);
+  ASSERT_EQ(matrix.row_length, 2);
+  EXPECT_EQ(matrix.row[1].size(), 5);
+  EXPECT_EQ(matrix.row[1][3].feat_id, 3);
+}
+
+TEST(PARSER_TEST, Parse_irregular_line) {
+  // CRLF, extra blanks, empty line, exponent, and no '\n' at the end
+  std::string data = "-1 3:1e-1  5:2.5\r\n"
+                     "\n"
+                     "+1\t0:-0.5 \n"
+                     "0";
+  DMatrix matrix;
+  LibsvmParser parser;
+  parser.setLabel(true);
+  parser.Parse(&data[0], data.size(), matrix);
+  ASSERT_EQ(matrix.row_length, 3);
+  EXPECT_FLOAT_EQ(matrix.Y[0], -1);
+  EXPECT_FLOAT_EQ(matrix.Y[1], 1);
+  EXPECT_FLOAT_EQ(matrix.Y[2], 0);
+  ASSERT_EQ(matrix.row[0].size(), 2);
+  EXPECT_EQ(matrix.row[0][0].feat_id, 3);
+  EXPECT_FLOAT_EQ(matrix.row[0][0].feat_val, 0.1);
+  EXPECT_EQ(matrix.row[0][1].feat_id, 5);
+  EXPECT_FLOAT_EQ(matrix.row[0][1].feat_val, 2.5);
+  EXPECT_FLOAT_EQ(matrix.norm[0], 1.0 / 6.26);
+  ASSERT_EQ(matrix.row[1].size(), 1);
+  EXPECT_EQ(matrix.row[1][0].feat_id, 0);
+  EXPECT_FLOAT_EQ(matrix.row[1][0].feat_val, -0.5);
+  EXPECT_EQ(matrix.row[2].size(), 0);
+}
+
+TEST(PARSER_TEST, Parse_hashed_feature) {
+  std::string data = "1 user_1:1 item_22:2 7:0.5\n"
+                     "0 7:1 user_1:3\n";
+  const int kBits = 20;
+  const uint64 kMask = (1 << kBits) - 1;
+  DMatrix matrix;
+  LibsvmParser parser;
+  parser.setLabel(true);
+  parser.setFeatureHash(kBits);
+  parser.Parse(&data[0], data.size(), matrix);
+  ASSERT_EQ(matrix.row_length, 2);
+  ASSERT_EQ(matrix.row[0].size(), 3);
+  EXPECT_EQ(matrix.row[0][0].feat_id, MurmurHash64("user_1", 6) & kMask);
+  EXPECT_EQ(matrix.row[0][1].feat_id, MurmurHash64("item_22", 7) & kMask);
+  EXPECT_EQ(matrix.row[0][2].feat_id, MurmurHash64("7", 1) & kMask);
+  EXPECT_EQ(matrix.row[1][0].feat_id, matrix.row[0][2].feat_id);
+  EXPECT_EQ(matrix.row[1][1].feat_id, matrix.row[0][0].feat_id);
+  EXPECT_FLOAT_EQ(matrix.row[0][1].feat_val, 2);
+  // The field of libffm is not hashed
+  std::string ffm_data = "1 3:user_1:1 5:item_22:2\n";
+  FFMParser ffm;
+  ffm.setLabel(true);
+  ffm.setFeatureHash(kBits);
+  ffm.Parse(&ffm_data[0], ffm_data.size(), matrix);
+  ASSERT_EQ(matrix.row[0].size(), 2);
+  EXPECT_EQ(matrix.row[0][0].field_id, 3);
+  EXPECT_EQ(matrix.row[0][0].feat_id, MurmurHash64("user_1", 6) & kMask);
+  EXPECT_EQ(matrix.row[0][1].field_id, 5);
+}
+
+TEST(PARSER_TEST, Parse_with_feature_map) {
+  // Train set with many lines, so it is parsed in chunks
+  std::string train;
+  for (int i = 0; i < 200000; ++i) {
+    train += StringPrintf("1 %d:1 %lld:1\n", i % 1000,
+                          1000000000000LL + i % 7);
+  }
+  FeatureMap map;
+  LibsvmParser parser;
+  parser.setLabel(true);
+  parser.setFeatureHash(0, &map, true);
+  DMatrix matrix;
+  parser.Parse(&train[0], train.size(), matrix);
+  EXPECT_EQ(map.Size(), 1007);
+  // The ids are given in the order of first appearance
+  EXPECT_EQ(matrix.row[0][0].feat_id, 0);
+  EXPECT_EQ(matrix.row[0][1].feat_id, 1);
+  EXPECT_EQ(matrix.row[1][0].feat_id, 2);
+  EXPECT_EQ(matrix.row[1][1].feat_id, 3);
+  // The same ids in multiple threads
+  FeatureMap map_parallel;
+  ThreadPool pool(3);
+  parser.setThreadPool(&pool);
+  parser.setFeatureHash(0, &map_parallel, true);
+  DMatrix matrix_parallel;
+  parser.Parse(&train[0], train.size(), matrix_parallel);
+  ASSERT_EQ(map_parallel.Size(), map.Size());
+  for (index_t i = 0; i < map.Size(); ++i) {
+    EXPECT_EQ(map.Key(i), map_parallel.Key(i));
+  }
+  ASSERT_EQ(matrix.nodes.size(), matrix_parallel.nodes.size());
+  for (size_t i = 0; i < matrix.nodes.size(); ++i) {
+    EXPECT_EQ(matrix.nodes[i].feat_id, matrix_parallel.nodes[i].feat_id);
+  }
+  // The new features of test set are dropped
+  std::string test = "1 5:1 unknown:2\n";
+  parser.setFeatureHash(0, &map, false);
+  parser.Parse(&test[0], test.size(), matrix);
+  EXPECT_EQ(map.Size(), 1007);
+  ASSERT_EQ(matrix.row[0].size(), 1);
+  EXPECT_EQ(matrix.row[0][0].feat_id, map.Find(MurmurHash64("5", 1)));
+  EXPECT_FLOAT_EQ(matrix.norm[0], 1.0 / 5.0);
+}
+
+TEST(PARSER_TEST, Parse_libffm_group_by_field) {
+  // A short line (insertion sort) and a long line (stable_sort)
+  std::string data = "1 2:20:1 0:0:1 1:10:1 0:1:1 2:21:1\n1";
+  for (int i = 0; i < 100; ++i) {
+    data += StringPrintf(" %d:%d:1", (i * 7) % 10, i);
+  }
+  data += "\n";
+  FFMParser parser;
+  parser.setLabel(true);
+  DMatrix matrix;
+  parser.Parse(&data[0], data.size(), matrix);
+  ASSERT_EQ(matrix.row_length, 2);
+  ASSERT_EQ(matrix.row[0].size(), 5);
+  index_t feats[] = {0, 1, 10, 20, 21};
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(matrix.row[0][i].feat_id, feats[i]);
+  }
+  ASSERT_EQ(matrix.row[1].size(), 100);
+  for (int i = 1; i < 100; ++i) {
+    const Node& prev = matrix.row[1][i-1];
+    const Node& cur = matrix.row[1][i];
+    EXPECT_LE(prev.field_id, cur.field_id);
+    // The order in one field is kept
+    if (prev.field_id == cur.field_id) {
+      EXPECT_LT(prev.feat_id, cur.feat_id);
+    }
+    EXPECT_EQ(cur.field_id, (cur.feat_id * 7) % 10);
+  }
+  // The keys are moved with their nodes
+  FeatureMap map;
+  std::string hashed = "1 1:b:1 0:a:2\n1 0:a:3 1:b:4\n";
+  parser.setFeatureHash(0, &map, true);
+  parser.Parse(&hashed[0], hashed.size(), matrix);
+  EXPECT_EQ(map.Size(), 2);
+  EXPECT_EQ(matrix.row[0][0].feat_id, map.Find(MurmurHash64("a", 1)));
+  EXPECT_FLOAT_EQ(matrix.row[0][0].feat_val, 2);
+  EXPECT_EQ(matrix.row[0][1].feat_id, map.Find(MurmurHash64("b", 1)));
+  EXPECT_EQ(matrix.row[1][0].feat_id, matrix.row[0][0].feat_id);
+  EXPECT_EQ(matrix.row[1][1].feat_id, matrix.row[0][1].feat_id);
+}
+
 Parser* CreateParser(const char* format_name) {
   return CREATE_PARSER(format_name);
 }
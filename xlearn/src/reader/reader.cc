@@ -20,6 +20,8 @@ This file is the implementation of Reader class.
 
 #include "src/reader/reader.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <algorithm> // for random_shuffle
 
@@ -36,6 +38,7 @@ CLASS_REGISTER_IMPLEMENT_REGISTRY(xLearn_reader_registry, Reader);
 REGISTER_READER("memory", InmemReader);
 REGISTER_READER("disk", OndiskReader);
 REGISTER_READER("copy", CopyReader);
+REGISTER_READER("stream", StreamReader);
 
 // Check current file format and
 // return 'libsvm', 'libffm', or 'csv'.
@@ -47,7 +50,12 @@ std::string Reader::check_file_format() {
   std::string data_line;
   GetLine(file, data_line);
   Close(file);
-  // Split the first line of data
+  return check_line_format(data_line);
+}
+
+// Check the format by a line of data.
+std::string Reader::check_line_format(const std::string& data_line) {
+  // Split the line of data
   std::vector<std::string> str_list;
   SplitStringUsing(data_line, " \t", &str_list);
   // has y?
@@ -88,10 +96,10 @@ void InmemReader::Initialize(const std::string& filename) {
   filename_ = filename;
   print_info("First check if the text file has been already "
              "converted to binary format.");
-  // HashBinary() will read the first two hash value
-  // and then check it whether equal to the hash value generated
-  // by HashFile() function from current txt file.
-  if (hash_binary(filename_)) {
+  // hash_binary() will read the first two hash value
+  // and then check it whether equal to the fingerprint (and
+  // the content hash) of current txt file.
+  if (feat_map_ == nullptr && hash_binary(filename_)) {
     print_info(
       StringPrintf("Binary file (%s.bin) found. "
                    "Skip converting text to binary.",
@@ -110,35 +118,52 @@ void InmemReader::Initialize(const std::string& filename) {
 }
 
 // Check wheter current path has a binary file.
-// We use double check here, that is, we first check 
-// the hash value of a small data block, then check the whole file.
+// The first hash value is the fingerprint of the txt file, which
+// reads only a few blocks of it. The second one is the hash of the
+// whole file, which is checked only if verify_binary_ is true.
 bool InmemReader::hash_binary(const std::string& filename) {
   std::string bin_file = filename + ".bin";
   // If the ".bin" file does not exists, return false.
   if (!FileExist(bin_file.c_str())) { return false; }
   FILE* file = OpenFileOrDie(bin_file.c_str(), "r");
+  BinaryHeader header;
+  size_t len = ReadDataFromDisk(file, (char*)&header, sizeof(header));
+  Close(file);
+  // Check the format and version of binary file
+  if (len != sizeof(header) ||
+      header.magic != kBinaryMagic ||
+      header.version != kBinaryVersion ||
+      header.node_size != sizeof(Node)) {
+    return false;
+  }
   // Check the first hash value
-  uint64 hash_1 = 0;
-  ReadDataFromDisk(file, (char*)&hash_1, sizeof(hash_1));
-  if (hash_1 != HashFile(filename, true)) {
-    Close(file);
+  uint64 salt = hash_salt();
+  if (header.hash_value_1 != (FingerprintFile(filename) ^ salt)) {
     return false;
   }
   // Check the second hash value
-  uint64 hash_2 = 0;
-  ReadDataFromDisk(file, (char*)&hash_2, sizeof(hash_2));
-  if (hash_2 != HashFile(filename, false)) {
-    Close(file);
+  if (verify_binary_ &&
+      header.hash_value_2 != (HashFileContent(filename) ^ salt)) {
     return false;
   }
-  Close(file);
   return true;
 }
 
+// The binary file of the hashed features is different from
+// the binary file of the same txt file without hashing.
+uint64 InmemReader::hash_salt() {
+  return hash_bits_ == 0 ? 0 : MurmurMix64(hash_bits_);
+}
+
 // In-memory Reader can be initialized from binary file.
+// The binary file is mapped into memory and data_buf_ uses it
+// directly, so we don't need to read and copy the data, and
+// the processes that use the same file share the page cache.
 void InmemReader::init_from_binary() {
   // Init data_buf_                               
-  data_buf_.Deserialize(filename_);
+  mmap_file_.Open(filename_);
+  data_buf_.DeserializeFromBuffer(mmap_file_.data(),
+                                  mmap_file_.size());
   has_label_ = data_buf_.has_label;
   // Init data_samples_
   num_samples_ = data_buf_.row_length;
@@ -156,12 +181,15 @@ void InmemReader::init_from_txt() {
   parser_ = CreateParser(check_file_format().c_str());
   if (has_label_) parser_->setLabel(true);
   else parser_->setLabel(false);
+  init_parser();
   // Init data_buf_
   char* buffer = nullptr;
   uint64 file_size = ReadFileToMemory(filename_, &buffer);
   parser_->Parse(buffer, file_size, data_buf_);
-  data_buf_.SetHash(HashFile(filename_, true),
-                    HashFile(filename_, false));
+  // The content hash uses the buffer, so the file is read once
+  uint64 salt = hash_salt();
+  data_buf_.SetHash(FingerprintFile(filename_) ^ salt,
+                    HashBufferContent(buffer, file_size) ^ salt);
   data_buf_.has_label = has_label_;
   // Init data_samples_ 
   num_samples_ = data_buf_.row_length;
@@ -171,9 +199,13 @@ void InmemReader::init_from_txt() {
   for (int i = 0; i < order_.size(); ++i) {
     order_[i] = i;
   }
-  // Deserialize in-memory buffer to disk file.
-  std::string bin_file = filename_ + ".bin";
-  data_buf_.Serialize(bin_file);
+  // Deserialize in-memory buffer to disk file. If the features
+  // are mapped by a FeatureMap, the ids depend on the map, and
+  // hence we don't use the binary file.
+  if (feat_map_ == nullptr) {
+    std::string bin_file = filename_ + ".bin";
+    data_buf_.Serialize(bin_file);
+  }
   delete [] buffer;
 }
 
@@ -184,7 +216,7 @@ index_t InmemReader::Samples(DMatrix* &matrix) {
       // End of the data buffer
       if (i == 0) {
         if (shuffle_) {
-          random_shuffle(order_.begin(), order_.end());
+          shuffle_rows();
         }
         matrix = nullptr;
         return 0;
@@ -204,6 +236,83 @@ index_t InmemReader::Samples(DMatrix* &matrix) {
 // Return to the begining of the data buffer.
 void InmemReader::Reset() { pos_ = 0; }
 
+// Shuffle the rows by shuffle_mode_.
+void InmemReader::shuffle_rows() {
+  if (shuffle_mode_ == kShuffleBlock) {
+    shuffle_blocks();
+  } else if (shuffle_mode_ == kShufflePermute) {
+    permute_rows();
+  } else {
+    random_shuffle(order_.begin(), order_.end());
+  }
+}
+
+// The rows of a block are contiguous in the node storage, so
+// the rows of an epoch are gathered from a few pages at a time,
+// which are in the cache and the TLB.
+void InmemReader::shuffle_blocks() {
+  size_t num_row = order_.size();
+  size_t num_block = (num_row + kShuffleBlockRows - 1) / kShuffleBlockRows;
+  std::vector<index_t> block(num_block);
+  for (size_t b = 0; b < num_block; ++b) {
+    block[b] = b;
+  }
+  std::shuffle(block.begin(), block.end(), rng_);
+  size_t pos = 0;
+  for (size_t b = 0; b < num_block; ++b) {
+    size_t start = block[b] * kShuffleBlockRows;
+    size_t end = std::min(start + kShuffleBlockRows, num_row);
+    size_t begin = pos;
+    for (size_t r = start; r < end; ++r) {
+      order_[pos++] = r;
+    }
+    std::shuffle(order_.begin() + begin, order_.begin() + pos, rng_);
+  }
+}
+
+// After the copy, order_ is the identity and the next epoch reads
+// the nodes sequentially. The first copy moves the rows out of the
+// mapped binary file, and the two node storages are reused later.
+void InmemReader::permute_rows() {
+  size_t num_row = data_buf_.row_length;
+  std::vector<index_t> perm(num_row);
+  for (size_t i = 0; i < num_row; ++i) {
+    perm[i] = i;
+  }
+  std::shuffle(perm.begin(), perm.end(), rng_);
+  // Offset of each new row in the new node storage
+  std::vector<uint64> offset(num_row + 1, 0);
+  for (size_t i = 0; i < num_row; ++i) {
+    offset[i+1] = offset[i] + data_buf_.row[perm[i]].size();
+  }
+  permute_nodes_.resize(offset[num_row]);
+  std::vector<SparseRow> row(num_row);
+  std::vector<real_t> Y(num_row), norm(num_row);
+  auto copy_rows = [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i) {
+      const SparseRow& old_row = data_buf_.row[perm[i]];
+      Node* data = permute_nodes_.data() + offset[i];
+      std::copy(old_row.begin(), old_row.end(), data);
+      row[i] = SparseRow(data, old_row.size());
+      Y[i] = data_buf_.Y[perm[i]];
+      norm[i] = data_buf_.norm[perm[i]];
+    }
+  };
+  if (pool_ != nullptr) {
+    pool_->ParallelFor(0, num_row, kShuffleBlockRows, copy_rows);
+  } else {
+    copy_rows(0, num_row);
+  }
+  // The swap of vectors keeps the address of their storage
+  data_buf_.nodes.swap(permute_nodes_);
+  data_buf_.row.swap(row);
+  data_buf_.Y.swap(Y);
+  data_buf_.norm.swap(norm);
+  for (size_t i = 0; i < num_row; ++i) {
+    order_[i] = i;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Implementation of OndiskReader.
 //------------------------------------------------------------------------------
@@ -216,25 +325,20 @@ void OndiskReader::Initialize(const std::string& filename) {
   parser_ = CreateParser(check_file_format().c_str());
   if (has_label_) parser_->setLabel(true);
   else parser_->setLabel(false);
-  // Allocate memory for block
-  try {
-    this->block_ = (char*)malloc(block_size_*1024*1024);
-  } catch (std::bad_alloc&) {
-    LOG(FATAL) << "Cannot allocate enough memory for data  \
-                   block. Block size: " 
-               << block_size_ << "MB. "
-               << "You set change the block size via configuration.";
-  }
-  // Open file
+  init_parser();
+  // Open file. The memory of block is allocated in the
+  // first Samples(), so we can still set the block size.
   file_ptr_ = OpenFileOrDie(filename_.c_str(), "r");
 }
 
 // Return to the begining of the file
 void OndiskReader::Reset() {
+  stop_prefetch();
   int ret = fseek(file_ptr_, 0, SEEK_SET);
   if (ret != 0) {
     LOG(FATAL) << "Fail to return to the head of file.";
   }
+  eof_ = false;
 }
 
 // Find the last '\n' in block, and shrink back file pointer
@@ -248,23 +352,124 @@ void OndiskReader::shrink_block(char* block, size_t* ret, FILE* file) {
   *ret = index + 1;
 }
 
-// Sample data from disk file.
-index_t OndiskReader::Samples(DMatrix* &matrix) {
+// Start the background thread from current file position.
+void OndiskReader::start_prefetch() {
+  CHECK(!running_);
+  if (block_ == nullptr) {
+    block_ = (char*)malloc(block_size_*1024*1024);
+    if (block_ == nullptr) {
+      LOG(FATAL) << "Cannot allocate enough memory for data  \
+                     block. Block size: " 
+                 << block_size_ << "MB. "
+                 << "You set change the block size via configuration.";
+    }
+  }
+  buffer_.resize(depth_);
+  for (int i = 0; i < depth_; ++i) {
+    if (buffer_[i] == nullptr) {
+      buffer_[i].reset(new DMatrix);
+    }
+  }
+  std::queue<int>().swap(ready_);
+  std::queue<int>().swap(free_);
+  for (int i = 0; i < depth_; ++i) {
+    free_.push(i);
+  }
+  current_ = -1;
+  stop_ = false;
+  running_ = true;
+  prefetch_thread_ = std::thread(&OndiskReader::prefetch, this);
+}
+
+// Stop the background thread and drop the prefetched blocks.
+// Note that the file position is not defined after that, and
+// hence we need to seek the file before starting again.
+void OndiskReader::stop_prefetch() {
+  if (!running_) { return; }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  if (prefetch_thread_.joinable()) {
+    prefetch_thread_.join();
+  }
+  running_ = false;
+  current_ = -1;
+}
+
+// Read a block of data from disk file and parse it to
+// a free DMatrix, until reaching the end of file.
+void OndiskReader::prefetch() {
   // Convert MB to Byte
   uint64 read_byte = block_size_ * 1024 * 1024;
-  // Read a block of data from disk file
-  size_t ret = ReadDataFromDisk(file_ptr_, block_, read_byte);
-  if (ret == 0) {
+  for (;;) {
+    // Wait for a free DMatrix
+    int index = -1;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stop_ || !free_.empty(); });
+      if (stop_) { return; }
+      index = free_.front();
+      free_.pop();
+    }
+    // Read a block of data from disk file
+    size_t ret = ReadDataFromDisk(file_ptr_, block_, read_byte);
+    if (ret == read_byte) {
+      // Find the last '\n', and shrink back file pointer
+      shrink_block(block_, &ret, file_ptr_);
+    } // else ret < read_byte: we don't need shrink_block()
+    // Parse block to DMatrix
+    if (ret > 0) {
+      parser_->Parse(block_, ret, *buffer_[index]);
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (ret == 0) {
+        free_.push(index);
+        ready_.push(-1);
+      } else {
+        ready_.push(index);
+      }
+    }
+    cond_.notify_all();
+    if (ret == 0) { return; }
+  }
+}
+
+// Sample data from disk file.
+index_t OndiskReader::Samples(DMatrix* &matrix) {
+  if (!running_) {
+    if (eof_) {
+      matrix = nullptr;
+      return 0;
+    }
+    start_prefetch();
+  }
+  int index = -1;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // The last block can be reused by the background thread
+    if (current_ != -1) {
+      free_.push(current_);
+      current_ = -1;
+      cond_.notify_all();
+    }
+    cond_.wait(lock, [this] { return !ready_.empty(); });
+    index = ready_.front();
+    ready_.pop();
+  }
+  // End of the file
+  if (index == -1) {
+    prefetch_thread_.join();
+    running_ = false;
+    eof_ = true;
     matrix = nullptr;
     return 0;
-  } else if (ret == read_byte) {
-    // Find the last '\n', and shrink back file pointer
-    shrink_block(block_, &ret, file_ptr_);
-  } // else ret < read_byte: we don't need shrink_block()
-  // Parse block to data_sample_
-  parser_->Parse(block_, ret, data_samples_);
-  matrix = &data_samples_;
-  return data_samples_.row_length;
+  }
+  current_ = index;
+  matrix = buffer_[index].get();
+  return matrix->row_length;
 }
 
 //------------------------------------------------------------------------------
@@ -319,4 +524,132 @@ index_t CopyReader::Samples(DMatrix* &matrix) {
 // Return to the begining of the data buffer.
 void CopyReader::Reset() { pos_ = 0; }
 
+//------------------------------------------------------------------------------
+// Implementation of IndexReader
+//------------------------------------------------------------------------------
+
+void IndexReader::Initialize(const std::string& filename) {
+  LOG(FATAL) << "IndexReader cannot read the file: " << filename;
+}
+
+void IndexReader::Initialize(const DMatrix* matrix,
+                             const std::vector<index_t>& index) {
+  CHECK_NOTNULL(matrix);
+  CHECK(!index.empty());
+  data_ = matrix;
+  has_label_ = matrix->has_label;
+  order_ = index;
+  for (size_t i = 0; i < order_.size(); ++i) {
+    CHECK_LT(order_[i], matrix->row_length);
+  }
+  data_samples_.ResetMatrix(order_.size(), has_label_);
+  pos_ = 0;
+}
+
+// All the rows are sampled at once, and the rows are
+// shuffled after each pass if shuffle_ is true.
+index_t IndexReader::Samples(DMatrix* &matrix) {
+  CHECK_NOTNULL(data_);
+  if (pos_ >= order_.size()) {
+    if (shuffle_) {
+      std::shuffle(order_.begin(), order_.end(), rng_);
+    }
+    matrix = nullptr;
+    return 0;
+  }
+  for (size_t i = 0; i < order_.size(); ++i) {
+    index_t id = order_[i];
+    data_samples_.row[i] = data_->row[id];
+    data_samples_.Y[i] = data_->Y[id];
+    data_samples_.norm[i] = data_->norm[id];
+  }
+  pos_ = order_.size();
+  matrix = &data_samples_;
+  return order_.size();
+}
+
+//------------------------------------------------------------------------------
+// Implementation of StreamReader
+//------------------------------------------------------------------------------
+
+// The stream cannot be read twice, so the format is checked
+// by the first line, which is kept for the first mini-batch.
+void StreamReader::Initialize(const std::string& filename) {
+  CHECK_NE(filename.empty(), true);
+  filename_ = filename;
+  if (filename_.compare("-") == 0) {
+    file_ptr_ = stdin;
+  } else {
+    file_ptr_ = OpenFileOrDie(filename_.c_str(), "r");
+  }
+  block_.clear();
+  if (!read_line()) {
+    LOG(FATAL) << "The stream is empty: " << filename_;
+  }
+  pending_ = true;
+  std::string first_line(block_, 0, block_.size()-1);
+  parser_ = CreateParser(check_line_format(first_line).c_str());
+  if (has_label_) parser_->setLabel(true);
+  else parser_->setLabel(false);
+  init_parser();
+  num_rows_ = 0;
+}
+
+// The buffer of getline() is reused by all the lines.
+bool StreamReader::read_line() {
+  for (;;) {
+    ssize_t len = getline(&line_, &line_cap_, file_ptr_);
+    if (len < 0) { return false; }
+    // Remove the '\n' and the '\r' of DOS and windows
+    while (len > 0 && (line_[len-1] == '\n' || line_[len-1] == '\r')) {
+      len--;
+    }
+    if (len == 0) { continue; }
+    block_.append(line_, len);
+    block_.push_back('\n');
+    return true;
+  }
+}
+
+// Read and parse the next batch_size_ lines. The read blocks
+// until the lines are available, or the stream is closed.
+index_t StreamReader::Samples(DMatrix* &matrix) {
+  CHECK_NOTNULL(file_ptr_);
+  index_t rows = 0;
+  if (pending_) {
+    rows = 1;
+    pending_ = false;
+  } else {
+    block_.clear();
+  }
+  while (rows < batch_size_ && read_line()) { rows++; }
+  if (rows == 0) {
+    matrix = nullptr;
+    return 0;
+  }
+  parser_->Parse(&block_[0], block_.size(), data_samples_);
+  data_samples_.has_label = has_label_;
+  drop_nodes(&data_samples_);
+  num_rows_ += data_samples_.row_length;
+  matrix = &data_samples_;
+  return data_samples_.row_length;
+}
+
+// The nodes are removed in place, and the norm of row is not
+// changed, which is the same as the unknown features in prediction.
+void StreamReader::drop_nodes(DMatrix* matrix) {
+  if (num_feat_ == 0 && num_field_ == 0) { return; }
+  for (index_t i = 0; i < matrix->row_length; ++i) {
+    SparseRow& row = matrix->row[i];
+    Node* node = row.begin();
+    size_t size = 0;
+    for (SparseRow::iterator it = row.begin(); it != row.end(); ++it) {
+      if (num_feat_ != 0 && it->feat_id >= num_feat_) { continue; }
+      if (num_field_ != 0 && it->field_id >= num_field_) { continue; }
+      node[size++] = *it;
+    }
+    if (size != row.size()) { row = SparseRow(node, size); }
+  }
+}
+
 }  // namespace xLearn
@@ -24,8 +24,13 @@ reading data from data source.
 
 #include <string>
 #include <vector>
+#include <queue>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <algorithm>
+#include <random>
+#include <memory>
 
 #include "src/base/common.h"
 #include "src/base/class_register.h"
@@ -37,6 +42,9 @@ reading data from data source.
 namespace xLearn {
 
 const int kDefautBlockSize = 500;  // 500 MB
+const int kDefaultPrefetchDepth = 2;  // double buffering
+const int kDefaultStreamBatch = 1000;  // rows
+const index_t kShuffleBlockRows = 256;  // rows
 
 //------------------------------------------------------------------------------
 // Reader is an abstract class which can be implemented in different way,
@@ -81,7 +89,8 @@ const int kDefautBlockSize = 500;  // 500 MB
 class Reader {
  public:
   // Constructor and Desstructor
-  Reader() : shuffle_(false) {  }
+  Reader() : parser_(nullptr), shuffle_(false), pool_(nullptr),
+             hash_bits_(0), feat_map_(nullptr), map_insert_(true) {  }
   virtual ~Reader() {  }
 
   // We need to invoke the Initialize() function before
@@ -106,6 +115,9 @@ class Reader {
   // This method is only used in On-disk Reader
   virtual void SetBlockSize(int size) = 0;
 
+  // This method is only used in On-disk Reader
+  virtual void SetPrefetchDepth(int depth) = 0;
+
   // Wether current dataset has label y ?
   bool inline has_label() { return has_label_; }
 
@@ -114,6 +126,24 @@ class Reader {
     this->shuffle_ = shuffle;
   }
 
+  // Parse the text file using this thread pool.
+  // This should be invoked before Initialize().
+  void SetThreadPool(ThreadPool* pool) {
+    this->pool_ = pool;
+  }
+
+  // Hash the feature ids of the libsvm and libffm file
+  // (see Parser::setFeatureHash()). hash_bits is 0 and map
+  // is nullptr for no hashing, which is the default.
+  // This should be invoked before Initialize().
+  void SetFeatureHash(int hash_bits,
+                      FeatureMap* map = nullptr,
+                      bool insert = true) {
+    this->hash_bits_ = hash_bits;
+    this->feat_map_ = map;
+    this->map_insert_ = insert;
+  }
+
  protected:
   /* Input file name */
   std::string filename_;
@@ -127,6 +157,20 @@ class Reader {
   bool has_label_;
   /* If shuffle data ? */
   bool shuffle_;
+  /* Thread pool used by parser */
+  ThreadPool* pool_;
+  /* Feature hashing used by parser */
+  int hash_bits_;
+  FeatureMap* feat_map_;
+  bool map_insert_;
+
+  // Set the thread pool and feature hashing of parser_.
+  void init_parser() {
+    parser_->setThreadPool(pool_);
+    if (hash_bits_ > 0 || feat_map_ != nullptr) {
+      parser_->setFeatureHash(hash_bits_, feat_map_, map_insert_);
+    }
+  }
 
   // Check current file format and return
   // "libsvm", "ffm", or "csv".
@@ -135,6 +179,10 @@ class Reader {
   // data has the label y.
   std::string check_file_format();
 
+  // The same as check_file_format(), but check the
+  // given line instead of the first line of file.
+  std::string check_line_format(const std::string& data_line);
+
   // Create parser for different file format
   Parser* CreateParser(const char* format_name) {
     return CREATE_PARSER(format_name);
@@ -148,11 +196,30 @@ class Reader {
 // Sampling data from memory buffer.
 // For in-memory smaplling, the Reader will automatically convert
 // txt data to binary data, and uses this binary data in the next time.
+//
+// The rows can be shuffled at the end of each epoch in three ways:
+//
+//   kShuffleRandom   shuffle the order of the rows, which are then
+//                    gathered from the whole node storage at random.
+//   kShuffleBlock    shuffle the blocks of kShuffleBlockRows rows,
+//                    and then the rows within each block, so that
+//                    the gather stays within a few pages at a time.
+//   kShufflePermute  copy the rows to a new node storage in random
+//                    order (in parallel), so the next epoch reads the
+//                    nodes sequentially. This needs a second copy of
+//                    the nodes.
 //------------------------------------------------------------------------------
+enum ShuffleMode {
+  kShuffleRandom = 0,
+  kShuffleBlock = 1,
+  kShufflePermute = 2
+};
+
 class InmemReader : public Reader {
  public:
   // Constructor and Destructor
-  InmemReader() : pos_(0) { }
+  InmemReader() : pos_(0), verify_binary_(false),
+                  shuffle_mode_(kShuffleRandom) { }
   ~InmemReader() { }
 
   // Pre-load all the data into memory buffer.
@@ -167,6 +234,7 @@ class InmemReader : public Reader {
   // Free the memory of data matrix.
   virtual void Clear() {
     data_buf_.Release();
+    mmap_file_.Close();
   }
 
   // Return the Reader type
@@ -180,29 +248,73 @@ class InmemReader : public Reader {
     return;
   }
 
+  // This method is only used in On-Disk Reader
+  virtual void SetPrefetchDepth(int depth) {
+    // Do nothing
+    return;
+  }
+
   // If shuffle data ?
   virtual inline void SetShuffle(bool shuffle) {
     this->shuffle_ = shuffle;
     if (shuffle_ && !order_.empty()) {
-      random_shuffle(order_.begin(), order_.end());
+      shuffle_rows();
     }
   }
 
+  // Set how the rows are shuffled. This should
+  // be invoked before SetShuffle().
+  void SetShuffleMode(ShuffleMode mode) {
+    shuffle_mode_ = mode;
+  }
+
+  // Set the seed of the random generator used
+  // by kShuffleBlock and kShufflePermute.
+  void SetSeed(uint32 seed) { rng_.seed(seed); }
+
   // Get data buffer
   virtual inline DMatrix* GetMatrix() {
     return &data_buf_;
   }
 
+  // By default, the binary file is used if the fingerprint
+  // of the txt file is not changed. If verify is true, the hash
+  // of the whole txt file is also checked, which reads all of it.
+  // This should be invoked before Initialize().
+  void SetVerifyBinary(bool verify) {
+    verify_binary_ = verify;
+  }
+
  protected:
   /* Reader will load all the data 
   into this buffer */
   DMatrix data_buf_;
+  /* The mapped binary file used by data_buf_ */
+  MmapFile mmap_file_;
   /* Number of record at each samplling */
   index_t num_samples_;
   /* Position for samplling */
   index_t pos_;
   /* For random shuffle */
   std::vector<index_t> order_;
+  /* Check the hash of whole txt file */
+  bool verify_binary_;
+  /* How the rows are shuffled */
+  ShuffleMode shuffle_mode_;
+  /* Random generator for kShuffleBlock and kShufflePermute */
+  std::mt19937 rng_;
+  /* The other node storage of kShufflePermute */
+  std::vector<Node> permute_nodes_;
+
+  // Shuffle the rows by shuffle_mode_.
+  void shuffle_rows();
+
+  // Shuffle the blocks of order_, and the rows within each block.
+  void shuffle_blocks();
+
+  // Copy the rows of data_buf_ to permute_nodes_ in random
+  // order, and then swap it with the node storage of data_buf_.
+  void permute_rows();
 
   // Check wheter current path has a binary file.
   bool hash_binary(const std::string& filename);
@@ -213,6 +325,10 @@ class InmemReader : public Reader {
   // Initialize Reader from a new txt file.
   void init_from_txt();
 
+  // The hash values of the binary file also depend on the
+  // hash bits, and this value is xor-ed to them.
+  uint64 hash_salt();
+
  private:
   DISALLOW_COPY_AND_ASSIGN(InmemReader);
 };
@@ -221,21 +337,36 @@ class InmemReader : public Reader {
 // Samplling data from disk file.
 // OndiskReader is used to train very big data, which cannot be
 // loaded into main memory of current single machine.
+// The reading and parsing are pipelined: a background thread reads
+// and parses the next blocks of file into a ring of DMatrix while the
+// trainer is using the current one. The pipeline depth is the number
+// of DMatrix in the ring (2 for double buffering), and the memory
+// used by the reader is about (1 + depth) * block_size.
 //------------------------------------------------------------------------------
 class OndiskReader : public Reader {
  public:
   // Constructor and Destructor
   OndiskReader() 
-    : block_size_(500) {  }  // 500 MB by default
+    : file_ptr_(nullptr),
+      block_(nullptr),
+      block_size_(kDefautBlockSize),
+      depth_(kDefaultPrefetchDepth),
+      current_(-1),
+      running_(false),
+      stop_(false),
+      eof_(false) {  }
   ~OndiskReader() { 
     Clear();
-    Close(file_ptr_); 
+    if (file_ptr_ != nullptr) {
+      Close(file_ptr_);
+    }
   }
 
   // Create parser and open file
   virtual void Initialize(const std::string& filename);
 
-  // Sample data from disk file
+  // Sample data from disk file.
+  // The returned matrix is valid until the next invoking.
   virtual index_t Samples(DMatrix* &matrix);
 
   // Return to the head of file
@@ -243,9 +374,12 @@ class OndiskReader : public Reader {
 
   // Free the memory of data matrix.
   virtual void Clear() {
+    stop_prefetch();
     data_samples_.Release();
+    std::vector<std::unique_ptr<DMatrix>>().swap(buffer_);
     if (block_ != nullptr) {
-      delete [] block_;
+      free(block_);
+      block_ = nullptr;
     }
   }
 
@@ -257,7 +391,14 @@ class OndiskReader : public Reader {
   // This method is only used in On-Disk Reader
   virtual void SetBlockSize(int size) {
     CHECK_GT(size, 0);
-    block_size_ = size;
+    this->SetBlockSize((size_t)size);
+  }
+
+  // Set the number of blocks in pipeline.
+  virtual void SetPrefetchDepth(int depth) {
+    CHECK_GT(depth, 0);
+    stop_prefetch();
+    depth_ = depth;
   }
 
   // We cannot set shuffle for OndiskReader
@@ -268,10 +409,15 @@ class OndiskReader : public Reader {
     this->shuffle_ = false;
   }
 
-  // Set block size. Note that we need to invoke this 
-  // function before invoking the Initialize() function.    
+  // Set block size (MB). The memory of block
+  // will be re-allocated in the next Samples().
   void SetBlockSize(size_t size) {
     CHECK_GT(size, 0);
+    stop_prefetch();
+    if (block_ != nullptr) {
+      free(block_);
+      block_ = nullptr;
+    }
     this->block_size_ = size;
   }
  
@@ -282,11 +428,42 @@ class OndiskReader : public Reader {
   char* block_;
   /* Block size */
   size_t block_size_;
+  /* Pipeline depth */
+  int depth_;
+  /* Ring of the parsed blocks. The DMatrix is not copyable,
+  so the blocks are not moved when the ring is resized */
+  std::vector<std::unique_ptr<DMatrix>> buffer_;
+  /* Index of the parsed blocks ready for use.
+  -1 means the end of file */
+  std::queue<int> ready_;
+  /* Index of the free blocks */
+  std::queue<int> free_;
+  /* The block used by the trainer */
+  int current_;
+  /* Background thread for reading and parsing */
+  std::thread prefetch_thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  /* If the background thread is running */
+  bool running_;
+  /* Ask the background thread to stop */
+  bool stop_;
+  /* Reach the end of file */
+  bool eof_;
 
   // Find the last '\n' in block and 
   // shrink back file pointer.
   void shrink_block(char* block, size_t* ret, FILE* file);
 
+  // Start the background thread from current file position.
+  void start_prefetch();
+
+  // Stop the background thread and drop the prefetched blocks.
+  void stop_prefetch();
+
+  // Main loop of the background thread.
+  void prefetch();
+
  private:
   DISALLOW_COPY_AND_ASSIGN(OndiskReader);
 };
@@ -332,6 +509,12 @@ class CopyReader : public Reader {
     return;
   }
 
+  // This method is only used in On-Disk Reader
+  virtual void SetPrefetchDepth(int depth) {
+    // Do nothing
+    return;
+  }
+
   // If shuffle data ?
   virtual inline void SetShuffle(bool shuffle) {
     this->shuffle_ = shuffle;
@@ -360,6 +543,216 @@ class CopyReader : public Reader {
   DISALLOW_COPY_AND_ASSIGN(CopyReader);
 };
 
+//------------------------------------------------------------------------------
+// IndexReader samples some rows of a DMatrix that is owned by another
+// Reader, such as the InmemReader. The rows are not copied, so many
+// IndexReaders can share one dataset in memory. This is used by the
+// cross-validation, where each fold is a view of the same dataset:
+//
+//   std::vector<index_t> index;  /* the rows of this fold */
+//   IndexReader reader;
+//   reader.Initialize(inmem_reader.GetMatrix(), index);
+//
+// The matrix must not be changed while it is used by IndexReader.
+// Each IndexReader has its own random generator, so the readers can
+// be shuffled by different threads.
+//------------------------------------------------------------------------------
+class IndexReader : public Reader {
+ public:
+  // Constructor and Destructor
+  IndexReader() : data_(nullptr), pos_(0) { }
+  ~IndexReader() { }
+
+  // IndexReader has no data file. Use the following
+  // Initialize() instead.
+  virtual void Initialize(const std::string& filename);
+
+  // Use the rows of matrix given by index.
+  void Initialize(const DMatrix* matrix,
+                  const std::vector<index_t>& index);
+
+  // Sample data from the shared matrix.
+  virtual index_t Samples(DMatrix* &matrix);
+
+  // Return to the begining of the data.
+  virtual void Reset() { pos_ = 0; }
+
+  // Free the index. The shared matrix is not changed.
+  virtual void Clear() {
+    data_samples_.Release();
+    std::vector<index_t>().swap(order_);
+  }
+
+  // Return Reader type
+  virtual std::string Type() {
+    return "index";
+  }
+
+  // This method is only used in On-Disk Reader
+  virtual void SetBlockSize(int size) {
+    // Do nothing
+    return;
+  }
+
+  // This method is only used in On-Disk Reader
+  virtual void SetPrefetchDepth(int depth) {
+    // Do nothing
+    return;
+  }
+
+  // If shuffle data ?
+  virtual inline void SetShuffle(bool shuffle) {
+    this->shuffle_ = shuffle;
+    if (shuffle_ && !order_.empty()) {
+      std::shuffle(order_.begin(), order_.end(), rng_);
+    }
+  }
+
+  // Set the seed of the random generator for shuffle.
+  void SetSeed(uint32 seed) { rng_.seed(seed); }
+
+ protected:
+  /* The shared matrix */
+  const DMatrix* data_;
+  /* Position for samplling */
+  index_t pos_;
+  /* Rows of data_ used by this reader */
+  std::vector<index_t> order_;
+  /* Random generator for shuffle */
+  std::mt19937 rng_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(IndexReader);
+};
+
+//------------------------------------------------------------------------------
+// StreamReader reads an unbounded stream of data, such as the stdin
+// ("-") or a FIFO, for the online learning. Each Samples() returns the
+// next mini-batch of at most batch_size rows, and returns 0 at the end
+// of the stream. The stream cannot be read again, so Reset() does
+// nothing, and the memory used by the reader only depends on the
+// batch size:
+//
+//   StreamReader reader;
+//   reader.SetBatchSize(1000);
+//   reader.SetLimit(num_feature, num_field);
+//   reader.Initialize("-");
+//   while (reader.Samples(matrix)) { ... }
+//
+// The model size is fixed before the data is seen, so the features
+// (and fields) out of the limit are dropped from the rows.
+//------------------------------------------------------------------------------
+class StreamReader : public Reader {
+ public:
+  // Constructor and Destructor
+  StreamReader()
+    : file_ptr_(nullptr),
+      batch_size_(kDefaultStreamBatch),
+      num_feat_(0),
+      num_field_(0),
+      num_rows_(0),
+      line_(nullptr),
+      line_cap_(0),
+      pending_(false) {  }
+  ~StreamReader() { Clear(); }
+
+  // Open the stream and check the format by its first line.
+  // The filename "-" is the stdin.
+  virtual void Initialize(const std::string& filename);
+
+  // Sample the next mini-batch from the stream.
+  // The returned matrix is valid until the next invoking.
+  virtual index_t Samples(DMatrix* &matrix);
+
+  // A stream cannot be read again
+  virtual void Reset() {
+    // Do nothing
+    return;
+  }
+
+  // Free the memory and close the stream.
+  virtual void Clear() {
+    data_samples_.Release();
+    std::string().swap(block_);
+    free(line_);
+    line_ = nullptr;
+    line_cap_ = 0;
+    if (file_ptr_ != nullptr && file_ptr_ != stdin) {
+      Close(file_ptr_);
+    }
+    file_ptr_ = nullptr;
+  }
+
+  // Return the Reader type
+  virtual std::string Type() {
+    return "stream";
+  }
+
+  // This method is only used in On-Disk Reader
+  virtual void SetBlockSize(int size) {
+    // Do nothing
+    return;
+  }
+
+  // This method is only used in On-Disk Reader
+  virtual void SetPrefetchDepth(int depth) {
+    // Do nothing
+    return;
+  }
+
+  // We cannot set shuffle for StreamReader
+  virtual inline void SetShuffle(bool shuffle) {
+    if (shuffle == true) {
+      LOG(ERR) << "Cannot set shuffle for StreamReader.";
+    }
+    this->shuffle_ = false;
+  }
+
+  // Set the number of rows of each mini-batch.
+  void SetBatchSize(index_t rows) {
+    CHECK_GT(rows, 0);
+    batch_size_ = rows;
+  }
+
+  // Drop the features >= num_feature and the fields >= num_field.
+  // 0 means no limit.
+  void SetLimit(index_t num_feature, index_t num_field) {
+    num_feat_ = num_feature;
+    num_field_ = num_field;
+  }
+
+  // Number of rows read from the stream.
+  inline uint64 RowNumber() const { return num_rows_; }
+
+ protected:
+  /* The stream */
+  FILE* file_ptr_;
+  /* Number of rows of each mini-batch */
+  index_t batch_size_;
+  /* Limit of feature and field */
+  index_t num_feat_;
+  index_t num_field_;
+  /* Number of rows read */
+  uint64 num_rows_;
+  /* Text lines of the current mini-batch */
+  std::string block_;
+  /* Buffer of getline() */
+  char* line_;
+  size_t line_cap_;
+  /* The first line is read by Initialize() */
+  bool pending_;
+
+  // Append the next non-empty line to block_.
+  // Return false at the end of the stream.
+  bool read_line();
+
+  // Drop the nodes out of the limit.
+  void drop_nodes(DMatrix* matrix);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StreamReader);
+};
+
 //------------------------------------------------------------------------------
 // Class register
 //------------------------------------------------------------------------------
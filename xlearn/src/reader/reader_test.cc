@@ -108,7 +108,7 @@ void CheckLR(const DMatrix* matrix, bool has_label, bool disk) {
   }
   EXPECT_FLOAT_EQ(matrix->norm[0], 22.03274);
   for (int i = 0; i < matrix->row_length; ++i) {
-    SparseRow *row = matrix->row[i];
+    const SparseRow *row = &matrix->row[i];
     int n = 0;
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
@@ -135,7 +135,7 @@ void CheckFFM(const DMatrix* matrix, bool has_label, bool disk) {
   }
   EXPECT_FLOAT_EQ(matrix->norm[0], 22.03274);
   for (int i = 0; i < matrix->row_length; ++i) {
-    SparseRow *row = matrix->row[i];
+    const SparseRow *row = &matrix->row[i];
     int n = 0;
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
@@ -157,7 +157,7 @@ void CheckCSV(const DMatrix* matrix, bool disk) {
   EXPECT_EQ(matrix->Y[0], 0);
   EXPECT_FLOAT_EQ(matrix->norm[0], 22.03274);
   for (int i = 0; i < matrix->row_length; ++i) {
-    SparseRow *row = matrix->row[i];
+    const SparseRow *row = &matrix->row[i];
     int n = 0;
     for (SparseRow::iterator iter = row->begin();
          iter != row->end(); ++iter) {
@@ -273,6 +273,41 @@ TEST(ReaderTest, ReadFromBinary) {
   read_from_memory(ffm_no_file, 4);  
 }
 
+// The binary file is used if the fingerprint of txt file is not
+// changed, and the hash of whole file is checked by SetVerifyBinary().
+TEST(ReaderTest, VerifyBinary) {
+  string lr_file = kTestfilename + "_verify.txt";
+  write_data(lr_file, kStr);
+  const index_t kRow = 4000;  // between the sampled blocks
+  {
+    InmemReader reader;
+    reader.Initialize(lr_file);
+    EXPECT_EQ(reader.GetMatrix()->Y[kRow], 0);
+  }
+  // Change the label of kRow in place, and keep the mtime
+  struct stat st;
+  ASSERT_EQ(stat(lr_file.c_str(), &st), 0);
+  FILE* file = OpenFileOrDie(lr_file.c_str(), "r+");
+  fseek(file, kRow * kStr.size(), SEEK_SET);
+  fputc('1', file);
+  Close(file);
+  struct timespec times[2] = { st.st_atim, st.st_mtim };
+  ASSERT_EQ(utimensat(AT_FDCWD, lr_file.c_str(), times, 0), 0);
+  {
+    InmemReader reader;
+    reader.Initialize(lr_file);
+    EXPECT_EQ(reader.GetMatrix()->Y[kRow], 0);
+  }
+  {
+    InmemReader reader;
+    reader.SetVerifyBinary(true);
+    reader.Initialize(lr_file);
+    EXPECT_EQ(reader.GetMatrix()->Y[kRow], 1);
+  }
+  RemoveFile(lr_file.c_str());
+  RemoveFile((lr_file + ".bin").c_str());
+}
+
 TEST(ReaderTest, CopyReader) {
   // has label
   string lr_file = kTestfilename + "_LR.txt";
@@ -289,6 +324,190 @@ TEST(ReaderTest, CopyReader) {
   read_from_memory(ffm_no_file, 4, true); 
 }
 
+// Two folds share the rows of one InmemReader
+TEST(ReaderTest, IndexReader) {
+  string ffm_file = kTestfilename + "_ffm.txt";
+  InmemReader inmem;
+  inmem.Initialize(ffm_file);
+  const DMatrix* data = inmem.GetMatrix();
+  vector<index_t> odd, even;
+  for (index_t i = 0; i < data->row_length; ++i) {
+    (i % 2 == 0 ? even : odd).push_back(i);
+  }
+  IndexReader reader[2];
+  reader[0].Initialize(data, even);
+  reader[1].Initialize(data, odd);
+  reader[1].SetSeed(7);
+  reader[1].SetShuffle(true);
+  for (int r = 0; r < 2; ++r) {
+    for (int epoch = 0; epoch < 2; ++epoch) {
+      DMatrix* matrix = nullptr;
+      index_t num = reader[r].Samples(matrix);
+      EXPECT_EQ(num, r == 0 ? even.size() : odd.size());
+      ASSERT_TRUE(matrix != nullptr);
+      // The nodes are not copied
+      vector<bool> seen(data->row_length, false);
+      for (index_t i = 0; i < num; ++i) {
+        const Node* node = matrix->row[i].begin();
+        index_t id = (node - data->row[0].begin()) / 3;
+        ASSERT_LT(id, data->row_length);
+        EXPECT_EQ(data->row[id].begin(), node);
+        EXPECT_EQ(id % 2, r);
+        EXPECT_FALSE(seen[id]);
+        seen[id] = true;
+        EXPECT_EQ(matrix->Y[i], 1);
+      }
+      EXPECT_EQ(reader[r].Samples(matrix), 0);
+      reader[r].Reset();
+    }
+  }
+}
+
+// Each row of the file has its own feature, and every mode of
+// shuffle must give a permutation of the rows in each epoch.
+void shuffle_rows(const std::string& filename, ShuffleMode mode) {
+  const index_t kRows = 1000;
+  ThreadPool pool(2);
+  InmemReader reader;
+  reader.SetThreadPool(&pool);
+  reader.Initialize(filename);
+  reader.SetShuffleMode(mode);
+  reader.SetSeed(1);
+  reader.SetShuffle(true);
+  DMatrix* matrix = nullptr;
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    index_t num = reader.Samples(matrix);
+    ASSERT_EQ(num, kRows);
+    vector<bool> seen(kRows, false);
+    index_t moved = 0, block_change = 0;
+    for (index_t i = 0; i < num; ++i) {
+      const SparseRow& row = matrix->row[i];
+      ASSERT_EQ(row.size(), 1);
+      index_t id = row[0].feat_id;
+      ASSERT_LT(id, kRows);
+      EXPECT_FALSE(seen[id]);
+      seen[id] = true;
+      EXPECT_EQ(matrix->Y[i], id % 2);
+      if (id != i) { moved++; }
+      // The rows of a block are together
+      if (mode == kShuffleBlock && i > 0 &&
+          id / kShuffleBlockRows !=
+          matrix->row[i-1][0].feat_id / kShuffleBlockRows) {
+        block_change++;
+      }
+      // The permuted rows are read sequentially
+      if (mode == kShufflePermute && i > 0) {
+        EXPECT_EQ(matrix->row[i-1].end(), row.begin());
+      }
+    }
+    EXPECT_GT(moved, kRows / 2);
+    if (mode == kShuffleBlock) {
+      EXPECT_EQ(block_change, kRows / kShuffleBlockRows);
+    }
+    EXPECT_EQ(reader.Samples(matrix), 0);
+    reader.Reset();
+  }
+}
+
+TEST(ReaderTest, ShuffleMode) {
+  string lr_file = kTestfilename + "_shuffle.txt";
+  FILE* file = OpenFileOrDie(lr_file.c_str(), "w");
+  for (int i = 0; i < 1000; ++i) {
+    fprintf(file, "%d %d:1\n", i % 2, i);
+  }
+  Close(file);
+  shuffle_rows(lr_file, kShuffleRandom);
+  shuffle_rows(lr_file, kShuffleBlock);
+  shuffle_rows(lr_file, kShufflePermute);
+  // From the binary file, which is mapped
+  shuffle_rows(lr_file, kShufflePermute);
+  RemoveFile(lr_file.c_str());
+  RemoveFile((lr_file + ".bin").c_str());
+}
+
+// Read the file block by block in several epochs, and
+// check that every line is parsed exactly once per epoch.
+void prefetch_from_disk(const std::string& filename, int depth) {
+  OndiskReader reader;
+  reader.SetBlockSize(1);  // 1 MB
+  reader.SetPrefetchDepth(depth);
+  reader.Initialize(filename);
+  DMatrix* matrix = nullptr;
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    index_t total = 0;
+    int block_num = 0;
+    for (;;) {
+      index_t record_num = reader.Samples(matrix);
+      if (record_num == 0) { break; }
+      EXPECT_EQ(matrix->row_length, record_num);
+      for (index_t i = 0; i < record_num; ++i) {
+        EXPECT_EQ(matrix->Y[i], 1);
+        EXPECT_EQ(matrix->row[i].size(), 3);
+      }
+      total += record_num;
+      block_num++;
+    }
+    EXPECT_EQ(total, kNumLines);
+    EXPECT_GT(block_num, 1);
+    // Still at the end of file
+    EXPECT_EQ(reader.Samples(matrix), 0);
+    reader.Reset();
+  }
+  // Stop the pipeline in the middle of file
+  EXPECT_GT(reader.Samples(matrix), 0);
+  reader.SetPrefetchDepth(depth + 1);
+  reader.Reset();
+  index_t total = 0;
+  for (;;) {
+    index_t record_num = reader.Samples(matrix);
+    if (record_num == 0) { break; }
+    total += record_num;
+  }
+  EXPECT_EQ(total, kNumLines);
+}
+
+// Read a stream in mini-batches. The empty lines are skipped, and
+// the features and fields out of the limit are dropped.
+TEST(ReaderTest, StreamReader) {
+  string stream_file = kTestfilename + "_stream.txt";
+  FILE* file = OpenFileOrDie(stream_file.c_str(), "w");
+  for (int i = 0; i < 2500; ++i) {
+    fprintf(file, "%d 0:0:1 1:5:0.5 1:9:1 3:2:1\r\n", i % 2);
+    if (i % 100 == 0) { fprintf(file, "\n"); }
+  }
+  Close(file);
+  StreamReader reader;
+  reader.SetBatchSize(1000);
+  reader.SetLimit(8, 2);
+  reader.Initialize(stream_file);
+  EXPECT_EQ(reader.Type(), "stream");
+  DMatrix* matrix = nullptr;
+  index_t expect[] = {1000, 1000, 500};
+  for (int b = 0; b < 3; ++b) {
+    EXPECT_EQ(reader.Samples(matrix), expect[b]);
+    ASSERT_TRUE(matrix != nullptr);
+    for (index_t i = 0; i < matrix->row_length; ++i) {
+      ASSERT_EQ(matrix->row[i].size(), 2);
+      EXPECT_EQ(matrix->row[i][0].feat_id, 0);
+      EXPECT_EQ(matrix->row[i][1].feat_id, 5);
+      EXPECT_FLOAT_EQ(matrix->row[i][1].feat_val, 0.5);
+      EXPECT_EQ(matrix->Y[i] > 0, i % 2 == 1);
+    }
+  }
+  EXPECT_EQ(reader.Samples(matrix), 0);
+  EXPECT_EQ(reader.Samples(matrix), 0);
+  EXPECT_EQ(reader.RowNumber(), 2500);
+  reader.Clear();
+  RemoveFile(stream_file.c_str());
+}
+
+TEST(ReaderTest, PrefetchFromDisk) {
+  string ffm_file = kTestfilename + "_ffm.txt";
+  prefetch_from_disk(ffm_file, 1);
+  prefetch_from_disk(ffm_file, 2);
+  prefetch_from_disk(ffm_file, 3);
+}
+
 TEST(ReaderTest, SampleFromDisk) { 
   // has label
   string lr_file = kTestfilename + "_LR.txt";
@@ -319,6 +538,7 @@ Reader* CreateReader(const char* format_name) {
 TEST(READER_TEST, CreateReader) {
   EXPECT_TRUE(CreateReader("memory") != NULL);
   EXPECT_TRUE(CreateReader("disk") != NULL);
+  EXPECT_TRUE(CreateReader("stream") != NULL);
   EXPECT_TRUE(CreateReader("") == NULL);
   EXPECT_TRUE(CreateReader("unknow_name") == NULL);
 }
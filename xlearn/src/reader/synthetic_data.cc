@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the SyntheticData class.
+*/
+
+#include "src/reader/synthetic_data.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "src/base/file_util.h"
+
+namespace xLearn {
+
+/* Rows are written to the file in blocks of this size */
+static const size_t kWriteBlockSize = 4 * 1024 * 1024;
+
+// The splitmix64 finalizer, which hashes a feature to its weight
+static inline uint64 mix64(uint64 x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+SyntheticData::SyntheticData(const SyntheticConfig& config)
+  : config_(config) {
+  CHECK_GT(config_.num_field, 0);
+  CHECK_GT(config_.row_length, 0);
+  CHECK_GE(config_.num_feature, config_.num_field);
+  CHECK_GE(config_.zipf, 0);
+  field_size_ = config_.num_feature / config_.num_field;
+  // P(rank r) ~ 1 / (r+1)^zipf
+  cdf_.resize(field_size_);
+  double sum = 0;
+  for (index_t r = 0; r < field_size_; ++r) {
+    sum += 1.0 / pow(r + 1.0, config_.zipf);
+    cdf_[r] = sum;
+  }
+  for (index_t r = 0; r < field_size_; ++r) {
+    cdf_[r] /= sum;
+  }
+  cdf_.back() = 1.0;
+}
+
+index_t SyntheticData::draw_rank() {
+  double u = uniform();
+  return std::upper_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+}
+
+double SyntheticData::hidden_weight(index_t feat_id) const {
+  uint64 h = mix64(feat_id ^ mix64(config_.seed));
+  return (h >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+void SyntheticData::append_row(bool ffm, std::string* data) {
+  std::vector<index_t>& feats = row_;
+  feats.resize(config_.row_length);
+  double z = 0;
+  for (index_t i = 0; i < config_.row_length; ++i) {
+    feats[i] = FeatureId(i % config_.num_field, draw_rank());
+    z += hidden_weight(feats[i]);
+  }
+  z *= 2.0 / sqrt((double)config_.row_length);
+  int y = uniform() < 1.0 / (1.0 + exp(-z)) ? 1 : 0;
+  char buf[64];
+  data->push_back('0' + y);
+  for (index_t i = 0; i < config_.row_length; ++i) {
+    int len = ffm ?
+      snprintf(buf, sizeof(buf), " %u:%u:1",
+               (unsigned)(i % config_.num_field), (unsigned)feats[i]) :
+      snprintf(buf, sizeof(buf), " %u:1", (unsigned)feats[i]);
+    data->append(buf, len);
+  }
+  data->push_back('\n');
+}
+
+void SyntheticData::Generate(bool ffm, std::string* data) {
+  CHECK_NOTNULL(data);
+  data->clear();
+  rng_.seed(config_.seed);
+  for (uint64 i = 0; i < config_.num_row; ++i) {
+    append_row(ffm, data);
+  }
+}
+
+uint64 SyntheticData::WriteFile(const std::string& filename, bool ffm) {
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  rng_.seed(config_.seed);
+  std::string block;
+  block.reserve(kWriteBlockSize + 4096);
+  uint64 size = 0;
+  for (uint64 i = 0; i < config_.num_row; ++i) {
+    append_row(ffm, &block);
+    if (block.size() >= kWriteBlockSize || i + 1 == config_.num_row) {
+      size += WriteDataToDisk(file, block.data(), block.size());
+      block.clear();
+    }
+  }
+  Close(file);
+  return size;
+}
+
+}  // namespace xLearn
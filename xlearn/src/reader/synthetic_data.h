@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the SyntheticData class, which generates the
+synthetic CTR datasets used by the benchmarks.
+*/
+
+#ifndef XLEARN_READER_SYNTHETIC_DATA_H_
+#define XLEARN_READER_SYNTHETIC_DATA_H_
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// SyntheticData generates a CTR-like dataset in the libsvm or libffm
+// format. The features are split evenly into the fields, and the i-th
+// node of a row is drawn from the field (i % num_field) with a Zipfian
+// distribution: the r-th most frequent feature of a field has the
+// probability ~ 1/r^zipf (zipf = 0 is uniform). All the values are 1,
+// and the label is drawn from sigmoid(sum of the hidden weights of the
+// features), so the data can be learned.
+//
+// The output only depends on the config (including the seed), and
+// std::mt19937_64 is used without the std distributions, whose
+// output differs between the libraries. The same config gives the
+// same file:
+//
+//   SyntheticConfig config;
+//   config.num_row = 100000;
+//   config.zipf = 1.1;
+//   SyntheticData data(config);
+//   data.WriteFile("train.ffm", true);
+//------------------------------------------------------------------------------
+struct SyntheticConfig {
+  /* Number of rows */
+  uint64 num_row = 10000;
+  /* Number of fields */
+  index_t num_field = 20;
+  /* Number of features of all the fields */
+  index_t num_feature = 100000;
+  /* Number of nodes of each row */
+  index_t row_length = 20;
+  /* Zipfian exponent of the feature frequency */
+  double zipf = 1.0;
+  /* Seed of the generator */
+  uint64 seed = 0;
+};
+
+class SyntheticData {
+ public:
+  explicit SyntheticData(const SyntheticConfig& config);
+  ~SyntheticData() { }
+
+  // Generate all the rows in libffm (ffm = true) or libsvm format.
+  void Generate(bool ffm, std::string* data);
+
+  // Generate all the rows to the file and return its size.
+  uint64 WriteFile(const std::string& filename, bool ffm);
+
+  // Feature id of the rank-th most frequent feature of a field
+  index_t FeatureId(index_t field, index_t rank) const {
+    return field * field_size_ + rank;
+  }
+
+ private:
+  SyntheticConfig config_;
+  /* Number of features of each field */
+  index_t field_size_;
+  /* Cumulative probability of the ranks of a field */
+  std::vector<double> cdf_;
+  std::mt19937_64 rng_;
+  /* Feature ids of current row */
+  std::vector<index_t> row_;
+
+  // Uniform double in [0, 1) from the 53 high bits
+  double uniform() { return (rng_() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // Draw a rank of the Zipfian distribution
+  index_t draw_rank();
+
+  // Hidden weight of a feature in [-1, 1)
+  double hidden_weight(index_t feat_id) const;
+
+  // Append the next row to data
+  void append_row(bool ffm, std::string* data);
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticData);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_READER_SYNTHETIC_DATA_H_
@@ -0,0 +1,121 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the SyntheticData class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "src/base/file_util.h"
+#include "src/reader/parser.h"
+#include "src/reader/synthetic_data.h"
+
+namespace xLearn {
+
+const std::string kSyntheticFile = "./test_synthetic.ffm";
+
+SyntheticConfig small_config() {
+  SyntheticConfig config;
+  config.num_row = 2000;
+  config.num_field = 4;
+  config.num_feature = 4000;
+  config.row_length = 6;
+  config.zipf = 1.2;
+  config.seed = 7;
+  return config;
+}
+
+TEST(SYNTHETIC_DATA_TEST, Parse_ffm) {
+  SyntheticConfig config = small_config();
+  SyntheticData gen(config);
+  std::string data;
+  gen.Generate(true, &data);
+  FFMParser parser;
+  parser.setLabel(true);
+  DMatrix matrix;
+  parser.Parse(&data[0], data.size(), matrix);
+  ASSERT_EQ(matrix.row_length, config.num_row);
+  index_t positive = 0;
+  for (index_t i = 0; i < matrix.row_length; ++i) {
+    ASSERT_EQ(matrix.row[i].size(), config.row_length);
+    EXPECT_TRUE(matrix.Y[i] == 0 || matrix.Y[i] == 1);
+    positive += matrix.Y[i] == 1;
+    for (SparseRow::iterator it = matrix.row[i].begin();
+         it != matrix.row[i].end(); ++it) {
+      // Each field has its own features
+      EXPECT_LT(it->field_id, config.num_field);
+      EXPECT_EQ(it->feat_id / (config.num_feature / config.num_field),
+                it->field_id);
+      EXPECT_FLOAT_EQ(it->feat_val, 1.0);
+    }
+  }
+  // Both labels are drawn
+  EXPECT_GT(positive, 0);
+  EXPECT_LT(positive, matrix.row_length);
+}
+
+TEST(SYNTHETIC_DATA_TEST, Zipf_skew) {
+  SyntheticConfig config = small_config();
+  std::string data;
+  DMatrix matrix;
+  LibsvmParser parser;
+  parser.setLabel(true);
+  // The most frequent feature of field 0
+  for (int zipf = 0; zipf <= 1; ++zipf) {
+    config.zipf = zipf * 1.2;
+    SyntheticData gen(config);
+    gen.Generate(false, &data);
+    parser.Parse(&data[0], data.size(), matrix);
+    index_t top = 0;
+    for (index_t i = 0; i < matrix.row_length; ++i) {
+      top += matrix.row[i][0].feat_id == gen.FeatureId(0, 0);
+    }
+    if (zipf == 0) {
+      // Uniform over 1000 features
+      EXPECT_LT(top, 20);
+    } else {
+      // 1/H(1000, 1.2) = 23% of the rows
+      EXPECT_GT(top, 300);
+    }
+  }
+}
+
+TEST(SYNTHETIC_DATA_TEST, Reproducible) {
+  SyntheticConfig config = small_config();
+  SyntheticData gen(config);
+  std::string first, second;
+  gen.Generate(true, &first);
+  gen.Generate(true, &second);
+  EXPECT_EQ(first, second);
+  // The file is the same as the buffer
+  EXPECT_EQ(gen.WriteFile(kSyntheticFile, true), first.size());
+  char* buf = nullptr;
+  uint64 size = ReadFileToMemory(kSyntheticFile, &buf);
+  EXPECT_EQ(std::string(buf, size), first);
+  delete [] buf;
+  RemoveFile(kSyntheticFile.c_str());
+  // Another seed gives another dataset
+  config.seed = 8;
+  SyntheticData other(config);
+  other.Generate(true, &second);
+  EXPECT_NE(first, second);
+}
+
+}  // namespace xLearn
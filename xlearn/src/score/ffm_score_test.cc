@@ -40,7 +40,8 @@ TEST(FFMScore_Test, calc_score) {
     param.num_K = k;
     param.num_field = 3;
     // Init SparseRow
-    SparseRow row(param.num_feature);
+    std::vector<Node> nodes(param.num_feature);
+    SparseRow row(nodes.data(), nodes.size());
     for (index_t i = 0; i < param.num_feature; ++i) {
       row[i].feat_id = i;
       row[i].feat_val = 2.0;
@@ -60,14 +61,15 @@ TEST(FFMScore_Test, calc_score) {
     }
     real_t* v = model.GetParameter_v();
     index_t k_aligned = model.get_aligned_k();
+    index_t align = model.GetAlign();
     for (index_t j = 0; j < model.GetNumFeature(); ++j) {
       for (index_t f = 0; f < model.GetNumField(); ++f) {
         for (index_t d = 0; d < k_aligned; ) {
-          for (index_t s = 0; s < kAlign; s++, v++, d++) {
+          for (index_t s = 0; s < align; s++, v++, d++) {
             v[0] = (d < model.GetNumK()) ? 1.0 : 0.0;
-            v[kAlign] = 1.0;
+            v[align] = 1.0;
           }
-          v += kAlign;
+          v += align;
         }
       }
     }
@@ -18,15 +18,14 @@
 This file is the implementation of FMScore class.
 */
 
-#include <pmmintrin.h>  // for SSE
-
 #include "src/score/fm_score.h"
 #include "src/base/math.h"
+#include "src/base/scratch_arena.h"
 
 namespace xLearn {
 
 // y = sum( (V_i*V_j)(x_i * x_j) )
-// Using SSE to accelerate vector operation.
+// Using SIMD to accelerate vector operation.
 real_t FMScore::CalcScore(const SparseRow* row,
                           Model& model,
                           real_t norm) {
@@ -50,48 +49,31 @@ real_t FMScore::CalcScore(const SparseRow* row,
    *  latent factor                                        *
    *********************************************************/
   index_t aligned_k = model.get_aligned_k();
-  index_t align0 = model.get_aligned_k() * aux_size;
-  std::vector<real_t> sv(aligned_k, 0);
-  real_t* s = sv.data();
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 const XMMw = _mm_load_ps(w+d);
-      XMMs = _mm_add_ps(XMMs, _mm_mul_ps(XMMw, XMMv));
-      _mm_store_ps(s+d, XMMs);
-    }
-  }
-  __m128 XMMt = _mm_set1_ps(0.0f);
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 XMMw = _mm_load_ps(w+d);
-      __m128 XMMwv = _mm_mul_ps(XMMw, XMMv);
-      XMMt = _mm_add_ps(XMMt,
-         _mm_mul_ps(XMMwv, _mm_sub_ps(XMMs, XMMwv)));
-    }
+  real_t* sv = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+  const SIMDKernel* kernel = GetSIMDKernel(model.GetAlign());
+  // Inference model
+  if (model.GetQuantType() == kQuantFP16) {
+    return t + kernel->fm_score_fp16(row->data(),
+                                     row->data() + row->size(),
+                                     model.GetParameter_v_fp16(),
+                                     aligned_k, norm, sv);
+  } else if (model.GetQuantType() == kQuantInt8) {
+    return t + kernel->fm_score_int8(row->data(),
+                                     row->data() + row->size(),
+                                     model.GetParameter_v_int8(),
+                                     model.GetScale_v(),
+                                     aligned_k, norm, sv);
   }
-  XMMt = _mm_hadd_ps(XMMt, XMMt);
-  XMMt = _mm_hadd_ps(XMMt, XMMt);
-  real_t t_all;
-  _mm_store_ss(&t_all, XMMt);
-  t_all *= 0.5;
-  t_all += t;
-  return t_all;
+  real_t t_all = kernel->fm_score(row->data(),
+                                  row->data() + row->size(),
+                                  model.GetParameter_v(),
+                                  aligned_k, aux_size,
+                                  norm, sv);
+  return t_all + t;
 }
 
 // Calculate gradient and update current model parameters.
-// Using SSE to accelerate vector operation.
+// Using SIMD to accelerate vector operation.
 void FMScore::CalcGrad(const SparseRow* row,
                        Model& model,
                        real_t pg,
@@ -135,43 +117,13 @@ void FMScore::calc_grad_sgd(const SparseRow* row,
    *  latent factor                                        *
    *********************************************************/
   index_t aligned_k = model.get_aligned_k();
-  index_t align0 = model.get_aligned_k() * 
-                   model.GetAuxiliarySize();
-  __m128 XMMpg = _mm_set1_ps(pg);
-  __m128 XMMlr = _mm_set1_ps(learning_rate_);
-  __m128 XMMlamb = _mm_set1_ps(regu_lambda_);
-  std::vector<real_t> sv(aligned_k, 0);
-  real_t* s = sv.data();
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 const XMMw = _mm_load_ps(w+d);
-      XMMs = _mm_add_ps(XMMs, _mm_mul_ps(XMMw, XMMv));
-      _mm_store_ps(s+d, XMMs);
-    }
-  }
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    __m128 XMMpgv = _mm_mul_ps(XMMpg, XMMv);
-    for(index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 XMMw = _mm_load_ps(w+d);
-      __m128 XMMg = _mm_add_ps(_mm_mul_ps(XMMlamb, XMMw),
-        _mm_mul_ps(XMMpgv, _mm_sub_ps(XMMs,
-        _mm_mul_ps(XMMw, XMMv))));
-      XMMw = _mm_sub_ps(XMMw, _mm_mul_ps(XMMlr, XMMg));
-      _mm_store_ps(w+d, XMMw);
-    }
-  }
+  real_t* sv = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+  OptParam opt = GetOptParam();
+  GetSIMDKernel(model.GetAlign())->fm_sgd(row->data(),
+                                    row->data() + row->size(),
+                                    model.GetParameter_v(),
+                                    aligned_k, pg, norm,
+                                    opt, sv);
 }
 
 // Calculate gradient and update current model using adagrad
@@ -203,48 +155,13 @@ void FMScore::calc_grad_adagrad(const SparseRow* row,
    *  latent factor                                        *
    *********************************************************/
   index_t aligned_k = model.get_aligned_k();
-  index_t align0 = model.get_aligned_k() * 
-                   model.GetAuxiliarySize();
-  __m128 XMMpg = _mm_set1_ps(pg);
-  __m128 XMMlr = _mm_set1_ps(learning_rate_);
-  __m128 XMMlamb = _mm_set1_ps(regu_lambda_);
-  std::vector<real_t> sv(aligned_k, 0);
-  real_t* s = sv.data();
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 const XMMw = _mm_load_ps(w+d);
-      XMMs = _mm_add_ps(XMMs, _mm_mul_ps(XMMw, XMMv));
-      _mm_store_ps(s+d, XMMs);
-    }
-  }
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    __m128 XMMpgv = _mm_mul_ps(XMMpg, XMMv);
-    for(index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 XMMw = _mm_load_ps(w+d);
-      __m128 XMMwg = _mm_load_ps(w+aligned_k+d);
-      __m128 XMMg = _mm_add_ps(_mm_mul_ps(XMMlamb, XMMw),
-      _mm_mul_ps(XMMpgv, _mm_sub_ps(XMMs,
-        _mm_mul_ps(XMMw, XMMv))));
-      XMMwg = _mm_add_ps(XMMwg, _mm_mul_ps(XMMg, XMMg));
-      XMMw = _mm_sub_ps(XMMw,
-             _mm_mul_ps(XMMlr,
-             _mm_mul_ps(_mm_rsqrt_ps(XMMwg), XMMg)));
-      _mm_store_ps(w+d, XMMw);
-      _mm_store_ps(w+aligned_k+d, XMMwg);
-    }
-  }
+  real_t* sv = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+  OptParam opt = GetOptParam();
+  GetSIMDKernel(model.GetAlign())->fm_adagrad(row->data(),
+                                    row->data() + row->size(),
+                                    model.GetParameter_v(),
+                                    aligned_k, pg, norm,
+                                    opt, sv);
 }
 
 // Calculate gradient and update current model using ftrl
@@ -298,72 +215,13 @@ void FMScore::calc_grad_ftrl(const SparseRow* row,
    *  latent factor                                        *
    *********************************************************/
   index_t aligned_k = model.get_aligned_k();
-  index_t align0 = model.get_aligned_k() * 
-                   model.GetAuxiliarySize();
-  __m128 XMMpg = _mm_set1_ps(pg);
-  __m128 XMMalpha = _mm_set1_ps(alpha_);
-  __m128 XMML2 = _mm_set1_ps(lambda_2_);
-  std::vector<real_t> sv(aligned_k, 0);
-  real_t* s = sv.data();
- for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 const XMMw = _mm_load_ps(w+d);
-      XMMs = _mm_add_ps(XMMs, _mm_mul_ps(XMMw, XMMv));
-      _mm_store_ps(s+d, XMMs);
-    }
-  }
-  for (SparseRow::const_iterator iter = row->begin();
-       iter != row->end(); ++iter) {
-    index_t j1 = iter->feat_id;
-    real_t v1 = iter->feat_val;
-    real_t *w_base = model.GetParameter_v() + j1 * align0;
-    __m128 XMMv = _mm_set1_ps(v1*norm);
-    __m128 XMMpgv = _mm_mul_ps(XMMpg, XMMv);
-    for (index_t d = 0; d < aligned_k; d += kAlign) {
-      real_t* w = w_base + d;
-      real_t* wg = w_base + aligned_k + d;
-      real_t* z = w_base + aligned_k*2 + d;
-      __m128 XMMs = _mm_load_ps(s+d);
-      __m128 XMMw = _mm_load_ps(w);
-      __m128 XMMwg = _mm_load_ps(wg);
-      __m128 XMMz = _mm_load_ps(z);
-      __m128 XMMg = _mm_add_ps(
-                    _mm_mul_ps(XMML2, XMMw),
-                    _mm_mul_ps(XMMpgv,
-                    _mm_sub_ps(XMMs,
-                      _mm_mul_ps(XMMw, XMMv))));
-      __m128 XMMsigma = _mm_div_ps(
-                        _mm_sub_ps(
-                        _mm_sqrt_ps(
-                        _mm_add_ps(XMMwg,
-                        _mm_mul_ps(XMMg, XMMg))),
-                        _mm_sqrt_ps(XMMwg)), XMMalpha);
-      XMMz = _mm_add_ps(XMMz,
-             _mm_sub_ps(XMMg,
-             _mm_mul_ps(XMMsigma, XMMw)));
-      _mm_store_ps(z, XMMz);
-      XMMwg = _mm_add_ps(XMMwg,
-              _mm_mul_ps(XMMg, XMMg));
-      _mm_store_ps(wg, XMMwg);
-      // Update w. SSE mat not faster.
-      for (size_t i = 0; i < kAlign; ++i) {
-        real_t z_value = *(z+i);
-        int sign = z_value > 0 ? 1:-1;
-        if (sign * z_value <= lambda_1_) {
-          *(w+i) = 0;
-        } else {
-          *(w+i) = (sign*lambda_1_-z_value) / 
-              ((beta_ + sqrt(*(wg+i))) / alpha_ + lambda_2_);
-        }
-      }
-    }
-  }
+  real_t* sv = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+  OptParam opt = GetOptParam();
+  GetSIMDKernel(model.GetAlign())->fm_ftrl(row->data(),
+                                    row->data() + row->size(),
+                                    model.GetParameter_v(),
+                                    aligned_k, pg, norm,
+                                    opt, sv);
 }
 
 } // namespace xLearn
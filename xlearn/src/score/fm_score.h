@@ -51,6 +51,9 @@ class FMScore : public Score {
                 real_t pg,
                 real_t norm = 1.0);
 
+  // Score type
+  std::string score_type() { return "fm"; }
+
  protected:
   // Calculate gradient and update model using sgd
   void calc_grad_sgd(const SparseRow* row,
@@ -21,6 +21,7 @@ This file tests the FMScore class.
 #include "gtest/gtest.h"
 
 #include "src/base/common.h"
+#include "src/base/alloc_counter.h"
 #include "src/data/data_structure.h"
 #include "src/data/hyper_parameters.h"
 #include "src/score/score_function.h"
@@ -40,7 +41,8 @@ TEST(FMScoreTest, calc_score) {
     param.num_K = k;
     param.num_field = 3;
     // Init SparseRow
-    SparseRow row(param.num_feature);
+    std::vector<Node> nodes(param.num_feature);
+    SparseRow row(nodes.data(), nodes.size());
     for (index_t i = 0; i < param.num_feature; ++i) {
       row[i].feat_id = i;
       row[i].feat_val = 2.0;
@@ -76,4 +78,31 @@ TEST(FMScoreTest, calc_score) {
   }
 }
 
+// After the first row, the score and the gradient
+// don't allocate memory.
+TEST(FMScoreTest, no_allocation) {
+  const char* opt[] = { "sgd", "adagrad", "ftrl" };
+  for (int o = 0; o < 3; ++o) {
+    std::string opt_type = opt[o];
+    std::vector<Node> nodes(4);
+    SparseRow row(nodes.data(), nodes.size());
+    for (index_t i = 0; i < 4; ++i) {
+      row[i].feat_id = i;
+      row[i].feat_val = 0.5;
+    }
+    Model model;
+    model.Initialize("fm", "squared", 4, 0, 16, o + 1);
+    FMScore score;
+    score.Initialize(0.1, 0.01, 0.1, 1.0, 0.1, 0.1, opt_type);
+    score.CalcScore(&row, model);
+    score.CalcGrad(&row, model, 0.5);
+    uint64 before = GetAllocCount();
+    for (size_t i = 0; i < 100; ++i) {
+      real_t val = score.CalcScore(&row, model);
+      score.CalcGrad(&row, model, val - 1.0);
+    }
+    EXPECT_EQ(GetAllocCount() - before, 0);
+  }
+}
+
 } // namespace xLearn
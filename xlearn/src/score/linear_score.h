@@ -50,6 +50,9 @@ class LinearScore : public Score {
                 real_t pg,
                 real_t norm = 1.0);
 
+  // Score type
+  std::string score_type() { return "linear"; }
+
  protected:
   // Calculate gradient and update model using sgd
   void calc_grad_sgd(const SparseRow* row,
@@ -45,7 +45,8 @@ class LinearScoreTest : public ::testing::Test {
 };
 
 TEST_F(LinearScoreTest, calc_score) {
-  SparseRow row(kLength);
+  std::vector<Node> nodes(kLength);
+  SparseRow row(nodes.data(), nodes.size());
   Model model;
   model.Initialize(param.score_func,
                 param.loss_func,
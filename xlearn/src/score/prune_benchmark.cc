@@ -0,0 +1,160 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the size-vs-speed report of the pruned ffm model. The
+rows are made of a few schemas, and each schema only has some of the
+fields, so most feature/field pairs never co-occur. The latent vectors
+of these pairs are dropped by Model::Prune(), and the report compares
+the dense model with the pruned one on the same rows:
+
+  ./prune_benchmark [num_K] [num_feature] [num_row]
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/ffm_score.h"
+
+using namespace xLearn;
+
+const index_t kNumField = 40;
+const index_t kNumSchema = 4;
+const index_t kRowLength = 15;
+const int kRepeat = 5;
+
+// Schema s has the fields from 10*s to 10*s+14 (mod kNumField),
+// and feature j belongs to field j % kNumField.
+std::vector<std::vector<Node> > random_rows(index_t num_row,
+                                            index_t num_feature) {
+  index_t feat_per_field = num_feature / kNumField;
+  std::vector<std::vector<Node> > rows(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    index_t schema = rand() % kNumSchema;
+    for (index_t n = 0; n < kRowLength; ++n) {
+      index_t f = (schema * 10 + n) % kNumField;
+      index_t j = (rand() % feat_per_field) * kNumField + f;
+      rows[i].push_back(Node(f, j, 1.0));
+    }
+  }
+  return rows;
+}
+
+// Size of model parameters in byte
+uint64 model_size(Model& model) {
+  uint64 size = (model.GetNumParameter_w() + 1 +
+                 model.GetNumParameter_v()) * sizeof(real_t);
+  if (model.IsSparse()) {
+    size += (uint64)model.GetNumFeature() *
+            (model.GetNumFieldWord() * sizeof(uint64) + sizeof(index_t));
+  }
+  return size;
+}
+
+// Score all the rows and return rows/sec.
+real_t run(std::vector<std::vector<Node> >& rows,
+           Score* score, Model& model, std::vector<real_t>& out) {
+  real_t norm = 1.0 / kRowLength;
+  out.resize(rows.size());
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      SparseRow row(rows[i].data(), rows[i].size());
+      out[i] = score->CalcScore(&row, model, norm);
+    }
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  return rows.size() * kRepeat / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_K = argc > 1 ? atoi(argv[1]) : 16;
+  index_t num_feature = argc > 2 ? atoi(argv[2]) : 40000;
+  index_t num_row = argc > 3 ? atoi(argv[3]) : 20000;
+  std::vector<std::vector<Node> > rows = random_rows(num_row,
+                                                     num_feature);
+  print_info(StringPrintf("K: %u, feature: %u, field: %u, rows: %u",
+                          num_K, num_feature, kNumField, num_row));
+  // The dense model for inference has no gradient cache, and the
+  // pruned one is made from a model trained on the rows, in which
+  // the vectors of the co-occurred pairs are updated.
+  Model dense, pruned;
+  dense.Initialize("ffm", "squared", num_feature,
+                   kNumField, num_K, 1, 1.0);
+  pruned.Initialize("ffm", "squared", num_feature,
+                    kNumField, num_K, 2, 1.0);
+  index_t align0 = pruned.get_aligned_k() * 2;
+  real_t* v = pruned.GetParameter_v();
+  for (size_t i = 0; i < rows.size(); ++i) {
+    for (size_t a = 0; a < rows[i].size(); ++a) {
+      for (size_t b = 0; b < rows[i].size(); ++b) {
+        if (a == b) { continue; }
+        size_t vec = (size_t)rows[i][a].feat_id * kNumField +
+                     rows[i][b].field_id;
+        v[vec * align0 + pruned.GetAlign()] = 2.0;
+      }
+    }
+  }
+  uint64 num_vec = (uint64)num_feature * kNumField;
+  index_t kept = pruned.Prune(0);
+
+  std::vector<std::string> column;
+  std::vector<int> width(6, 13);
+  column.push_back("Model");
+  column.push_back("Size(MB)");
+  column.push_back("Kept(%)");
+  column.push_back("rows/s");
+  column.push_back("Speedup");
+  column.push_back("Max error");
+  print_row(column, width);
+  FFMScore score;
+  std::vector<real_t> expected, out;
+  real_t dense_rate = run(rows, &score, dense, expected);
+  real_t pruned_rate = run(rows, &score, pruned, out);
+  real_t max_err = 0;
+  for (size_t i = 0; i < out.size(); ++i) {
+    max_err = std::max(max_err, (real_t)fabs(out[i] - expected[i]));
+  }
+  Model* models[2] = { &dense, &pruned };
+  const char* name[2] = { "ffm-dense", "ffm-pruned" };
+  real_t rate[2] = { dense_rate, pruned_rate };
+  real_t ratio[2] = { 100.0, (real_t)(kept * 100.0 / num_vec) };
+  real_t error[2] = { 0, max_err };
+  for (int m = 0; m < 2; ++m) {
+    column.clear();
+    column.push_back(name[m]);
+    column.push_back(StringPrintf("%.2f", model_size(*models[m]) / 1048576.0));
+    column.push_back(StringPrintf("%.1f", ratio[m]));
+    column.push_back(StringPrintf("%.0f", rate[m]));
+    column.push_back(StringPrintf("%.2fx", rate[m] / dense_rate));
+    column.push_back(StringPrintf("%.2e", error[m]));
+    print_row(column, width);
+  }
+
+  return 0;
+}
@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the accuracy-vs-speed report of the quantized inference
+model. For fm and ffm, it compares the float model with its fp16 and
+int8 versions, and reports the model size, the number of rows scored
+per second and the error of the score:
+
+  ./quant_benchmark [num_K] [num_feature] [num_row]
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/fm_score.h"
+#include "src/score/ffm_score.h"
+
+using namespace xLearn;
+
+const index_t kNumField = 20;
+const index_t kRowLength = 20;
+const int kRepeat = 5;
+
+std::vector<std::vector<Node> > random_rows(index_t num_row,
+                                            index_t num_feature) {
+  std::vector<std::vector<Node> > rows(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    for (index_t j = 0; j < kRowLength; ++j) {
+      rows[i].push_back(Node(j % kNumField,
+                             rand() % num_feature,
+                             1.0));
+    }
+  }
+  return rows;
+}
+
+// Size of model parameters in byte
+uint64 model_size(Model& model) {
+  uint64 size = (model.GetNumParameter_w() +
+                 model.GetAuxiliarySize()) * sizeof(real_t);
+  uint64 num_v = model.GetNumParameter_v();
+  if (model.GetQuantType() == kQuantFP16) {
+    size += num_v * sizeof(uint16);
+  } else if (model.GetQuantType() == kQuantInt8) {
+    size += num_v * sizeof(int8) +
+            num_v / model.get_aligned_k() * sizeof(real_t);
+  } else {
+    size += num_v * sizeof(real_t);
+  }
+  return size;
+}
+
+// Score all the rows and return rows/sec.
+real_t run(std::vector<std::vector<Node> >& rows,
+           Score* score, Model& model, std::vector<real_t>& out) {
+  real_t norm = 1.0 / kRowLength;
+  out.resize(rows.size());
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      SparseRow row(rows[i].data(), rows[i].size());
+      out[i] = score->CalcScore(&row, model, norm);
+    }
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  return rows.size() * kRepeat / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_K = argc > 1 ? atoi(argv[1]) : 16;
+  index_t num_feature = argc > 2 ? atoi(argv[2]) : 20000;
+  index_t num_row = argc > 3 ? atoi(argv[3]) : 10000;
+  std::vector<std::vector<Node> > rows = random_rows(num_row,
+                                                     num_feature);
+  print_info(StringPrintf("K: %d, feature: %d, field: %d, rows: %d",
+                          num_K, num_feature, kNumField, num_row));
+  std::vector<std::string> column;
+  std::vector<int> width(7, 13);
+  column.push_back("Model");
+  column.push_back("Size(MB)");
+  column.push_back("rows/s");
+  column.push_back("Speedup");
+  column.push_back("Max error");
+  column.push_back("Mean error");
+  column.push_back("Rel. error");
+  print_row(column, width);
+
+  const char* score_func[2] = { "fm", "ffm" };
+  const char* type_name[3] = { "float", "fp16", "int8" };
+  QuantType types[3] = { kQuantNone, kQuantFP16, kQuantInt8 };
+  for (int s = 0; s < 2; ++s) {
+    Score* score = nullptr;
+    if (s == 0) {
+      score = new FMScore();
+    } else {
+      score = new FFMScore();
+    }
+    std::vector<real_t> expected, out;
+    real_t float_rate = 0;
+    for (int t = 0; t < 3; ++t) {
+      // The float model for inference has no gradient cache,
+      // and the quantized ones are made from a trained model.
+      Model model;
+      model.Initialize(score_func[s], "squared", num_feature,
+                       kNumField, num_K, t == 0 ? 1 : 2, 1.0);
+      for (index_t i = 0; i < model.GetNumParameter_w(); ++i) {
+        model.GetParameter_w()[i] = 0.01;
+      }
+      if (t != 0) { model.Quantize(types[t]); }
+      real_t rate = run(rows, score, model, out);
+      if (t == 0) {
+        expected = out;
+        float_rate = rate;
+      }
+      real_t max_err = 0, sum_err = 0, sum_abs = 0;
+      for (size_t i = 0; i < out.size(); ++i) {
+        real_t err = fabs(out[i] - expected[i]);
+        max_err = std::max(max_err, err);
+        sum_err += err;
+        sum_abs += fabs(expected[i]);
+      }
+      column.clear();
+      column.push_back(StringPrintf("%s-%s", score_func[s], type_name[t]));
+      column.push_back(StringPrintf("%.2f", model_size(model) / 1048576.0));
+      column.push_back(StringPrintf("%.0f", rate));
+      column.push_back(StringPrintf("%.2fx", rate / float_rate));
+      column.push_back(StringPrintf("%.2e", max_err));
+      column.push_back(StringPrintf("%.2e", sum_err / out.size()));
+      column.push_back(StringPrintf("%.2e", sum_err / sum_abs));
+      print_row(column, width);
+    }
+    delete score;
+  }
+
+  return 0;
+}
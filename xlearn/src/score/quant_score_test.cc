@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the score of quantized inference model.
+*/
+
+#include "gtest/gtest.h"
+
+#include <math.h>
+
+#include <vector>
+#include <random>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/fm_score.h"
+#include "src/score/ffm_score.h"
+
+namespace xLearn {
+
+const index_t kNumFeature = 100;
+const index_t kNumField = 8;
+const index_t kRowLength = 8;
+
+// Generate random rows
+void random_rows(std::vector<Node>& nodes,
+                 std::vector<SparseRow>& rows) {
+  std::mt19937 gen(0);
+  nodes.resize(100 * kRowLength);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i].feat_id = gen() % kNumFeature;
+    nodes[i].field_id = i % kRowLength;
+    nodes[i].feat_val = (gen() % 1000) / 500.0;
+  }
+  rows.clear();
+  for (size_t i = 0; i < nodes.size(); i += kRowLength) {
+    rows.push_back(SparseRow(nodes.data() + i, kRowLength));
+  }
+}
+
+// The score of the quantized model should be close to the
+// score of the float model. The error of fp16 is about
+// 2^-11 of each value and int8 is about 2^-8.
+void check_quant_score(const std::string& score_func,
+                       index_t num_K, QuantType type,
+                       real_t tolerance) {
+  Model model, quant;
+  model.Initialize(score_func, "squared", kNumFeature,
+                   kNumField, num_K, 2, 1.0);
+  quant.Initialize(score_func, "squared", kNumFeature,
+                   kNumField, num_K, 2, 1.0);
+  // Non-zero linear term and bias
+  for (index_t i = 0; i < kNumFeature; ++i) {
+    model.GetParameter_w()[i*2] = i * 0.01;
+    quant.GetParameter_w()[i*2] = i * 0.01;
+  }
+  model.GetParameter_b()[0] = 0.5;
+  quant.GetParameter_b()[0] = 0.5;
+  quant.Quantize(type);
+  EXPECT_EQ(quant.GetQuantType(), type);
+  EXPECT_EQ(quant.GetAuxiliarySize(), 1);
+  EXPECT_TRUE(quant.GetParameter_v() == nullptr);
+  Score* score = nullptr;
+  if (score_func == "fm") {
+    score = new FMScore();
+  } else {
+    score = new FFMScore();
+  }
+  std::vector<Node> nodes;
+  std::vector<SparseRow> rows;
+  random_rows(nodes, rows);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    real_t expected = score->CalcScore(&rows[i], model, 0.5);
+    real_t actual = score->CalcScore(&rows[i], quant, 0.5);
+    EXPECT_NEAR(actual, expected,
+                tolerance * (1.0 + fabs(expected)));
+  }
+  delete score;
+}
+
+TEST(QUANT_KERNEL_TEST, FFM_score) {
+  for (index_t k = 1; k <= 17; k += 4) {
+    check_quant_score("ffm", k, kQuantFP16, 2e-3);
+    check_quant_score("ffm", k, kQuantInt8, 2e-2);
+  }
+}
+
+// The score of a pruned model equals the score of the
+// float model whose dropped vectors are set to zero.
+// More than 64 fields use two words of field bitmap.
+void check_prune_score(index_t num_K, index_t num_field) {
+  Model model, pruned;
+  model.Initialize("ffm", "squared", kNumFeature,
+                   num_field, num_K, 2, 1.0);
+  pruned.Initialize("ffm", "squared", kNumFeature,
+                    num_field, num_K, 2, 1.0);
+  for (index_t i = 0; i < kNumFeature; ++i) {
+    model.GetParameter_w()[i*2] = i * 0.01;
+    pruned.GetParameter_w()[i*2] = i * 0.01;
+  }
+  // Update a third of the vectors, and set the others to zero
+  index_t align0 = model.get_aligned_k() * 2;
+  index_t num_vec = kNumFeature * num_field;
+  for (index_t i = 0; i < num_vec; ++i) {
+    if (i % 3 == 0) {
+      pruned.GetParameter_v()[i*align0 + model.GetAlign()] = 2.0;
+    } else {
+      for (index_t d = 0; d < align0; ++d) {
+        model.GetParameter_v()[i*align0 + d] = 0;
+      }
+    }
+  }
+  EXPECT_EQ(pruned.Prune(0), (num_vec + 2) / 3);
+  FFMScore score;
+  std::vector<Node> nodes;
+  std::vector<SparseRow> rows;
+  random_rows(nodes, rows);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    real_t expected = score.CalcScore(&rows[i], model, 0.5);
+    real_t actual = score.CalcScore(&rows[i], pruned, 0.5);
+    EXPECT_NEAR(actual, expected, 1e-5 * (1.0 + fabs(expected)));
+  }
+}
+
+TEST(QUANT_KERNEL_TEST, FFM_prune_score) {
+  for (index_t k = 1; k <= 17; k += 4) {
+    check_prune_score(k, kNumField);
+    check_prune_score(k, 70);
+  }
+}
+
+TEST(QUANT_KERNEL_TEST, FM_score) {
+  for (index_t k = 1; k <= 17; k += 4) {
+    check_quant_score("fm", k, kQuantFP16, 2e-3);
+    check_quant_score("fm", k, kQuantInt8, 2e-2);
+  }
+}
+
+}  // namespace xLearn
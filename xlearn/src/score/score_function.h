@@ -29,6 +29,7 @@ FM score, FFM score, and etc.
 #include "src/data/data_structure.h"
 #include "src/data/hyper_parameters.h"
 #include "src/data/model_parameters.h"
+#include "src/score/simd_kernel.h"
 
 namespace xLearn {
 
@@ -80,6 +81,25 @@ class Score {
                         real_t pg,
                         real_t norm = 1.0) = 0;
 
+  // Return the score type, which is the same as
+  // HyperParam::score_func, e.g., 'linear', 'fm', and 'ffm'.
+  virtual std::string score_type() = 0;
+
+  // Return the optimization method
+  const std::string& opt_type() const { return opt_type_; }
+
+  // Hyper-parameters passed to the SIMD kernels.
+  OptParam GetOptParam() const {
+    OptParam opt;
+    opt.learning_rate = learning_rate_;
+    opt.regu_lambda = regu_lambda_;
+    opt.alpha = alpha_;
+    opt.beta = beta_;
+    opt.lambda_1 = lambda_1_;
+    opt.lambda_2 = lambda_2_;
+    return opt;
+  }
+
  protected:
   real_t learning_rate_;
   real_t regu_lambda_;
@@ -0,0 +1,158 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the benchmark of the fm score and gradient on short
+rows, where the cost of the memory allocator is large. It compares
+the scratch buffer allocated for every row with the ScratchArena,
+and reports the rows per second and the heap allocations per row:
+
+  ./scratch_benchmark [num_row] [row_length] [num_K]
+*/
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/alloc_counter.h"
+#include "src/base/format_print.h"
+#include "src/base/scratch_arena.h"
+#include "src/base/stringprintf.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/score/fm_score.h"
+#include "src/score/simd_kernel.h"
+
+using namespace xLearn;
+
+const index_t kNumFeature = 100000;
+const int kRepeat = 5;
+
+std::vector<std::vector<Node> > random_rows(index_t num_row,
+                                            index_t row_length) {
+  std::vector<std::vector<Node> > rows(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    for (index_t j = 0; j < row_length; ++j) {
+      rows[i].push_back(Node(0, rand() % kNumFeature, 1.0));
+    }
+  }
+  return rows;
+}
+
+// Score and update all the rows. Return rows/sec,
+// and the heap allocations per row in alloc.
+template <typename Func>
+real_t run(std::vector<std::vector<Node> >& rows,
+           Func func, real_t* alloc) {
+  uint64 before = GetAllocCount();
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      func(rows[i]);
+    }
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  *alloc = (real_t)(GetAllocCount() - before) / (rows.size() * kRepeat);
+  return rows.size() * kRepeat / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_row = argc > 1 ? atoi(argv[1]) : 200000;
+  index_t row_length = argc > 2 ? atoi(argv[2]) : 4;
+  index_t num_K = argc > 3 ? atoi(argv[3]) : 4;
+  std::vector<std::vector<Node> > rows = random_rows(num_row,
+                                                     row_length);
+  print_info(StringPrintf("Rows: %d, row length: %d, K: %d",
+                          num_row, row_length, num_K));
+  Model model;
+  model.Initialize("fm", "squared", kNumFeature, 0, num_K, 1, 0.1);
+  const SIMDKernel* kernel = GetSIMDKernel(model.GetAlign());
+  index_t aligned_k = model.get_aligned_k();
+  real_t* v = model.GetParameter_v();
+  real_t norm = 1.0 / row_length;
+  OptParam opt;
+  opt.learning_rate = 0.01;
+  opt.regu_lambda = 0.0001;
+  std::string opt_type = "sgd";
+  FMScore score;
+  score.Initialize(opt.learning_rate, opt.regu_lambda,
+                   0.3, 1.0, 0.1, 0.1, opt_type);
+
+  std::vector<std::string> column;
+  std::vector<int> width(4, 16);
+  column.push_back("Scratch");
+  column.push_back("rows/s");
+  column.push_back("Speedup");
+  column.push_back("Allocs/row");
+  print_row(column, width);
+
+  // The latent factor with a new buffer for every row
+  real_t alloc = 0;
+  real_t vector_rate = run(rows, [&](std::vector<Node>& row) {
+    const Node* end = row.data() + row.size();
+    std::vector<real_t> s(aligned_k, 0);
+    real_t t = kernel->fm_score(row.data(), end, v, aligned_k,
+                                1, norm, s.data());
+    std::vector<real_t> sg(aligned_k, 0);
+    kernel->fm_sgd(row.data(), end, v, aligned_k, t - 1.0,
+                   norm, opt, sg.data());
+  }, &alloc);
+  column.clear();
+  column.push_back("vector per row");
+  column.push_back(StringPrintf("%.0f", vector_rate));
+  column.push_back("1.00x");
+  column.push_back(StringPrintf("%.2f", alloc));
+  print_row(column, width);
+
+  // The latent factor with the arena
+  real_t arena_rate = run(rows, [&](std::vector<Node>& row) {
+    const Node* end = row.data() + row.size();
+    real_t* s = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+    real_t t = kernel->fm_score(row.data(), end, v, aligned_k,
+                                1, norm, s);
+    s = ScratchArena<real_t>::ThreadLocal()->Get(aligned_k);
+    kernel->fm_sgd(row.data(), end, v, aligned_k, t - 1.0,
+                   norm, opt, s);
+  }, &alloc);
+  column.clear();
+  column.push_back("arena");
+  column.push_back(StringPrintf("%.0f", arena_rate));
+  column.push_back(StringPrintf("%.2fx", arena_rate / vector_rate));
+  column.push_back(StringPrintf("%.2f", alloc));
+  print_row(column, width);
+
+  // The whole FMScore, including the linear term, which
+  // is not comparable with the rows above.
+  real_t score_rate = run(rows, [&](std::vector<Node>& row) {
+    SparseRow sparse_row(row.data(), row.size());
+    real_t t = score.CalcScore(&sparse_row, model, norm);
+    score.CalcGrad(&sparse_row, model, t - 1.0, norm);
+  }, &alloc);
+  column.clear();
+  column.push_back("FMScore");
+  column.push_back(StringPrintf("%.0f", score_rate));
+  column.push_back("-");
+  column.push_back(StringPrintf("%.2f", alloc));
+  print_row(column, width);
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the SSE implementation of the SIMD kernels and the
+run-time dispatch of all the kernels.
+*/
+
+#include <string.h>
+#include <pmmintrin.h>  // for SSE
+
+#include "src/score/simd_kernel.h"
+#include "src/score/simd_kernel_impl.h"
+
+namespace xLearn {
+
+namespace {
+
+// 128-bit vector. SSE has no FMA, so fmadd is a mul and an add.
+struct SSEVec {
+  typedef __m128 reg;
+  static const index_t kWidth = 4;
+  static inline reg zero() { return _mm_setzero_ps(); }
+  static inline reg set1(real_t x) { return _mm_set1_ps(x); }
+  static inline reg load(const real_t* p) { return _mm_load_ps(p); }
+  static inline reg loadu(const real_t* p) { return _mm_loadu_ps(p); }
+  static inline void store(real_t* p, reg a) { _mm_store_ps(p, a); }
+  static inline void storeu(real_t* p, reg a) { _mm_storeu_ps(p, a); }
+  static inline reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static inline reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+  static inline reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  static inline reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+  static inline reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+  static inline reg rsqrt(reg a) { return _mm_rsqrt_ps(a); }
+  static inline reg fmadd(reg a, reg b, reg c) {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+  }
+  static inline real_t hsum(reg a) {
+    a = _mm_hadd_ps(a, a);
+    a = _mm_hadd_ps(a, a);
+    real_t sum;
+    _mm_store_ss(&sum, a);
+    return sum;
+  }
+  // The same conversion as HalfToFloatFast() (float16.h)
+  static inline reg load_fp16(const uint16* p) {
+    __m128i h = _mm_loadl_epi64((const __m128i*)p);
+    h = _mm_unpacklo_epi16(h, _mm_setzero_si128());
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(h,
+                   _mm_set1_epi32(0x8000)), 16);
+    __m128i abs = _mm_slli_epi32(_mm_and_si128(h,
+                  _mm_set1_epi32(0x7fff)), 13);
+    reg v = _mm_mul_ps(_mm_castsi128_ps(abs),
+                       _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+    return _mm_or_ps(v, _mm_castsi128_ps(sign));
+  }
+  // Sign extension of int8 by SSE2
+  static inline reg load_int8(const int8* p) {
+    int32 x;
+    memcpy(&x, p, sizeof(x));
+    __m128i v = _mm_cvtsi32_si128(x);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(v, 24));
+  }
+};
+
+}  // namespace
+
+const SIMDKernel* GetSSEKernel() {
+  static const SIMDKernel kernel = make_kernel<SSEVec>("sse");
+  return &kernel;
+}
+
+const SIMDKernel* GetSIMDKernel(index_t width) {
+  const SIMDKernel* kernel = nullptr;
+  switch (width) {
+    case 4: kernel = GetSSEKernel(); break;
+    case 8: kernel = GetAVX2Kernel(); break;
+    case 16: kernel = GetAVX512Kernel(); break;
+    default: break;
+  }
+  if (kernel == nullptr) {
+    LOG(FATAL) << "Unsupported SIMD width: " << width;
+  }
+  return kernel;
+}
+
+}  // namespace xLearn
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the SIMD kernels used by FMScore and FFMScore.
+*/
+
+#ifndef XLEARN_SCORE_SIMD_KERNEL_H_
+#define XLEARN_SCORE_SIMD_KERNEL_H_
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+
+namespace xLearn {
+
+//------------------------------------------------------------------------------
+// Hyper-parameters of the optimization method used by the kernels.
+//------------------------------------------------------------------------------
+struct OptParam {
+  real_t learning_rate;
+  real_t regu_lambda;
+  real_t alpha;
+  real_t beta;
+  real_t lambda_1;
+  real_t lambda_2;
+};
+
+//------------------------------------------------------------------------------
+// SIMDKernel is a table of the latent-factor kernels for fm and ffm,
+// which are implemented for the SSE, AVX2 (with FMA) and AVX-512
+// instruction sets. Each instruction set is compiled in its own
+// translation unit (simd_kernel_*.cc) with its own compiler flags, so
+// the binary can run on any x86-64 CPU. We get the kernel that
+// matches the SIMD width of current model like this:
+//
+//   const SIMDKernel* kernel = GetSIMDKernel(model.GetAlign());
+//   real_t score = kernel->ffm_score(row->data(),
+//                                    row->data() + row->size(),
+//                                    model.GetParameter_v(),
+//                                    align0, align1,
+//                                    aux_size, norm);
+//
+// All the kernels take raw pointers instead of the STL containers, and
+// hence no inline function compiled with the wider instruction set can be
+// shared with the other translation units.
+//
+// For fm, the 's' is a scratch buffer of aligned_k floats.
+// For ffm, align0 = aux_size * aligned_k, align1 = num_field * align0.
+//
+// The *_fp16 and *_int8 kernels score the rows by the quantized latent
+// factor of an inference model (see Model::Quantize()), which is
+// converted to float in the registers. Each latent vector has aligned_k
+// values, and an int8 vector has a float scale.
+//
+// The ffm_score_sparse kernel scores the rows by a pruned model (see
+// Model::Prune()), whose kept vectors are packed in v and found by the
+// field bitmap and offset of each feature. A dropped vector is zero.
+//------------------------------------------------------------------------------
+struct SIMDKernel {
+  /* Name of the instruction set */
+  const char* name;
+  /* Number of float in one register */
+  index_t width;
+
+  real_t (*ffm_score)(const Node* begin, const Node* end,
+                      const real_t* v, index_t align0,
+                      index_t align1, index_t aux_size,
+                      real_t norm);
+  void (*ffm_sgd)(const Node* begin, const Node* end,
+                  real_t* v, index_t align0, index_t align1,
+                  real_t pg, real_t norm, const OptParam& opt);
+  void (*ffm_adagrad)(const Node* begin, const Node* end,
+                      real_t* v, index_t align0, index_t align1,
+                      real_t pg, real_t norm, const OptParam& opt);
+  void (*ffm_ftrl)(const Node* begin, const Node* end,
+                   real_t* v, index_t align0, index_t align1,
+                   real_t pg, real_t norm, const OptParam& opt);
+
+  real_t (*fm_score)(const Node* begin, const Node* end,
+                     const real_t* v, index_t aligned_k,
+                     index_t aux_size, real_t norm, real_t* s);
+  void (*fm_sgd)(const Node* begin, const Node* end,
+                 real_t* v, index_t aligned_k, real_t pg,
+                 real_t norm, const OptParam& opt, real_t* s);
+  void (*fm_adagrad)(const Node* begin, const Node* end,
+                     real_t* v, index_t aligned_k, real_t pg,
+                     real_t norm, const OptParam& opt, real_t* s);
+  void (*fm_ftrl)(const Node* begin, const Node* end,
+                  real_t* v, index_t aligned_k, real_t pg,
+                  real_t norm, const OptParam& opt, real_t* s);
+
+  real_t (*ffm_score_fp16)(const Node* begin, const Node* end,
+                           const uint16* v, index_t num_field,
+                           index_t aligned_k, real_t norm);
+  real_t (*ffm_score_int8)(const Node* begin, const Node* end,
+                           const int8* v, const real_t* scale,
+                           index_t num_field, index_t aligned_k,
+                           real_t norm);
+  real_t (*fm_score_fp16)(const Node* begin, const Node* end,
+                          const uint16* v, index_t aligned_k,
+                          real_t norm, real_t* s);
+  real_t (*fm_score_int8)(const Node* begin, const Node* end,
+                          const int8* v, const real_t* scale,
+                          index_t aligned_k, real_t norm, real_t* s);
+
+  real_t (*ffm_score_sparse)(const Node* begin, const Node* end,
+                             const real_t* v, const uint64* bitmap,
+                             const index_t* offset, index_t num_word,
+                             index_t aligned_k, real_t norm);
+};
+
+// Return the kernel for the given SIMD width (4, 8 or 16).
+// Program crashes if current CPU does not support it.
+const SIMDKernel* GetSIMDKernel(index_t width);
+
+// Kernel tables of each instruction set.
+const SIMDKernel* GetSSEKernel();
+const SIMDKernel* GetAVX2Kernel();
+const SIMDKernel* GetAVX512Kernel();
+
+}  // namespace xLearn
+
+#endif  // XLEARN_SCORE_SIMD_KERNEL_H_
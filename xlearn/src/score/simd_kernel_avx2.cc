@@ -0,0 +1,96 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the AVX2 implementation of the SIMD kernels, which
+is compiled with -mavx2 -mfma. Do not call these kernels directly,
+use GetSIMDKernel() instead.
+*/
+
+#include "src/score/simd_kernel.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>  // for AVX2
+
+#include "src/score/simd_kernel_impl.h"
+
+namespace xLearn {
+
+namespace {
+
+// 256-bit vector.
+struct AVX2Vec {
+  typedef __m256 reg;
+  static const index_t kWidth = 8;
+  static inline reg zero() { return _mm256_setzero_ps(); }
+  static inline reg set1(real_t x) { return _mm256_set1_ps(x); }
+  static inline reg load(const real_t* p) { return _mm256_load_ps(p); }
+  static inline reg loadu(const real_t* p) { return _mm256_loadu_ps(p); }
+  static inline void store(real_t* p, reg a) { _mm256_store_ps(p, a); }
+  static inline void storeu(real_t* p, reg a) { _mm256_storeu_ps(p, a); }
+  static inline reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  static inline reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+  static inline reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static inline reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+  static inline reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+  static inline reg rsqrt(reg a) { return _mm256_rsqrt_ps(a); }
+  static inline reg fmadd(reg a, reg b, reg c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static inline real_t hsum(reg a) {
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(a),
+                          _mm256_extractf128_ps(a, 1));
+    t = _mm_hadd_ps(t, t);
+    t = _mm_hadd_ps(t, t);
+    return _mm_cvtss_f32(t);
+  }
+  // The same conversion as HalfToFloatFast() (float16.h), which
+  // does not need F16C that is not implied by AVX2.
+  static inline reg load_fp16(const uint16* p) {
+    __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+    __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h,
+                   _mm256_set1_epi32(0x8000)), 16);
+    __m256i abs = _mm256_slli_epi32(_mm256_and_si256(h,
+                  _mm256_set1_epi32(0x7fff)), 13);
+    reg v = _mm256_mul_ps(_mm256_castsi256_ps(abs),
+            _mm256_castsi256_ps(_mm256_set1_epi32(0x77800000)));
+    return _mm256_or_ps(v, _mm256_castsi256_ps(sign));
+  }
+  static inline reg load_int8(const int8* p) {
+    __m128i v = _mm_loadl_epi64((const __m128i*)p);
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v));
+  }
+};
+
+}  // namespace
+
+const SIMDKernel* GetAVX2Kernel() {
+  static const SIMDKernel kernel = make_kernel<AVX2Vec>("avx2");
+  return &kernel;
+}
+
+}  // namespace xLearn
+
+#else  // Compiler does not support AVX2
+
+namespace xLearn {
+
+const SIMDKernel* GetAVX2Kernel() { return nullptr; }
+
+}  // namespace xLearn
+
+#endif
@@ -0,0 +1,105 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the AVX-512 implementation of the SIMD kernels, which
+is compiled with -mavx512f. Do not call these kernels directly,
+use GetSIMDKernel() instead.
+*/
+
+#include "src/score/simd_kernel.h"
+
+#if defined(__AVX512F__)
+
+// GCC 12 warns that the _mm512_undefined_*() registers of many
+// AVX-512 intrinsics (sqrt, rsqrt14, cvt*, extract*) are used
+// uninitialized. The warnings are located in the header, so they
+// are disabled only for it.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>  // for AVX-512
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#include "src/score/simd_kernel_impl.h"
+
+namespace xLearn {
+
+namespace {
+
+// 512-bit vector.
+struct AVX512Vec {
+  typedef __m512 reg;
+  static const index_t kWidth = 16;
+  static inline reg zero() { return _mm512_setzero_ps(); }
+  static inline reg set1(real_t x) { return _mm512_set1_ps(x); }
+  static inline reg load(const real_t* p) { return _mm512_load_ps(p); }
+  static inline reg loadu(const real_t* p) { return _mm512_loadu_ps(p); }
+  static inline void store(real_t* p, reg a) { _mm512_store_ps(p, a); }
+  static inline void storeu(real_t* p, reg a) { _mm512_storeu_ps(p, a); }
+  static inline reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  static inline reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+  static inline reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  static inline reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+  static inline reg sqrt(reg a) { return _mm512_sqrt_ps(a); }
+  static inline reg rsqrt(reg a) { return _mm512_rsqrt14_ps(a); }
+  static inline reg fmadd(reg a, reg b, reg c) {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  // Add the two halves and reduce the sum as the AVX2 hsum does.
+  // (_mm512_extractf32x8_ps() would need AVX512DQ.)
+  static inline real_t hsum(reg a) {
+    __m256 lo = _mm512_castps512_ps256(a);
+    __m256 hi = _mm256_castpd_ps(
+      _mm512_extractf64x4_pd(_mm512_castps_pd(a), 1));
+    __m256 s = _mm256_add_ps(lo, hi);
+    __m128 t = _mm_add_ps(_mm256_castps256_ps128(s),
+                          _mm256_extractf128_ps(s, 1));
+    t = _mm_hadd_ps(t, t);
+    t = _mm_hadd_ps(t, t);
+    return _mm_cvtss_f32(t);
+  }
+  static inline reg load_fp16(const uint16* p) {
+    return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)p));
+  }
+  static inline reg load_int8(const int8* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(v));
+  }
+};
+
+}  // namespace
+
+const SIMDKernel* GetAVX512Kernel() {
+  static const SIMDKernel kernel = make_kernel<AVX512Vec>("avx512");
+  return &kernel;
+}
+
+}  // namespace xLearn
+
+#else  // Compiler does not support AVX-512
+
+namespace xLearn {
+
+const SIMDKernel* GetAVX512Kernel() { return nullptr; }
+
+}  // namespace xLearn
+
+#endif
@@ -0,0 +1,201 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the throughput benchmark of the SIMD kernels. It
+reports the number of rows processed per second by each kernel
+of each instruction set supported by current CPU:
+
+  ./simd_kernel_benchmark [num_K] [num_row] [row_length]
+                          [num_feature] [num_field] [group]
+
+The nodes of a row cycle through the fields, unless group is 1,
+which sorts them by field like the libffm parser does. Long rows
+with a model larger than the cache, for example:
+
+  ./simd_kernel_benchmark 16 2000 200 100000 40 1
+
+show the cost of the random access of the ffm pair loop.
+*/
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/cpu_feature.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/timer.h"
+#include "src/data/data_structure.h"
+#include "src/score/simd_kernel.h"
+
+using namespace xLearn;
+
+const int kRepeat = 5;
+
+bool field_less(const Node& a, const Node& b) {
+  return a.field_id < b.field_id;
+}
+
+std::vector<std::vector<Node> > random_rows(index_t num_row,
+                                            index_t row_length,
+                                            index_t num_feature,
+                                            index_t num_field,
+                                            bool group) {
+  std::vector<std::vector<Node> > rows(num_row);
+  for (index_t i = 0; i < num_row; ++i) {
+    for (index_t j = 0; j < row_length; ++j) {
+      rows[i].push_back(Node(j % num_field,
+                             rand() % num_feature,
+                             1.0 / row_length));
+    }
+    if (group) {
+      std::stable_sort(rows[i].begin(), rows[i].end(), field_less);
+    }
+  }
+  return rows;
+}
+
+// Model filled with w = 0.01 and aux = 1.0, so that the
+// gradient sum is always positive.
+real_t* create_model(uint64 size) {
+  real_t* model = nullptr;
+  CHECK_EQ(posix_memalign((void**)&model, 64,
+                          size * sizeof(real_t)), 0);
+  for (uint64 i = 0; i < size; ++i) {
+    model[i] = (i % 2 == 0) ? 0.01 : 1.0;
+  }
+  return model;
+}
+
+// Run one kernel over all the rows and return rows/sec.
+template <typename Func>
+real_t run(const std::vector<std::vector<Node> >& rows, Func func) {
+  Timer timer;
+  timer.tic();
+  for (int r = 0; r < kRepeat; ++r) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      func(rows[i].data(), rows[i].data() + rows[i].size());
+    }
+  }
+  real_t sec = timer.toc();
+  if (sec <= 0) { sec = 1e-3; }
+  return rows.size() * kRepeat / sec;
+}
+
+int main(int argc, char* argv[]) {
+  index_t num_K = argc > 1 ? atoi(argv[1]) : 32;
+  index_t num_row = argc > 2 ? atoi(argv[2]) : 10000;
+  index_t row_length = argc > 3 ? atoi(argv[3]) : 20;
+  index_t num_feature = argc > 4 ? atoi(argv[4]) : 2000;
+  index_t num_field = argc > 5 ? atoi(argv[5]) : 20;
+  bool group = argc > 6 ? atoi(argv[6]) != 0 : false;
+  // Multiple of the widest register
+  index_t aligned_k = (num_K + 15) / 16 * 16;
+  std::vector<std::vector<Node> > rows = random_rows(
+    num_row, row_length, num_feature, num_field, group);
+  OptParam opt;
+  opt.learning_rate = 0.1;
+  opt.regu_lambda = 0.001;
+  opt.alpha = 0.3;
+  opt.beta = 1.0;
+  opt.lambda_1 = 0.001;
+  opt.lambda_2 = 0.002;
+  real_t pg = 0.1, norm = 1.0;
+  std::vector<real_t> s(aligned_k);
+
+  print_info(StringPrintf("CPU: %s, K: %d, aligned K: %d, rows: %d",
+                          SIMDName(GetSIMDLevel()).c_str(),
+                          num_K, aligned_k, num_row));
+  print_info(StringPrintf("Row length: %d, features: %d, fields: %d, %s",
+                          row_length, num_feature, num_field,
+                          group ? "grouped by field" : "interleaved"));
+  std::vector<std::string> column;
+  std::vector<int> width(5, 16);
+  column.push_back("Kernel");
+  column.push_back("Width");
+  column.push_back("ffm(rows/s)");
+  column.push_back("fm(rows/s)");
+  column.push_back("ffm speedup");
+  print_row(column, width);
+
+  const char* names[] = { "score", "sgd", "adagrad", "ftrl" };
+  std::vector<real_t> sse_ffm(4), sse_fm(4);
+  for (int w = 4; w <= SIMDWidth(GetSIMDLevel()); w *= 2) {
+    const SIMDKernel* kernel = GetSIMDKernel(w);
+    for (int op = 0; op < 4; ++op) {
+      index_t aux_size = op == 0 ? 1 : op;
+      index_t align0 = aligned_k * aux_size;
+      index_t align1 = num_field * align0;
+      real_t* ffm = create_model((uint64)num_feature * align1);
+      real_t* fm = create_model((uint64)num_feature * align0);
+      real_t ffm_rate = 0, fm_rate = 0;
+      switch (op) {
+        case 0:
+          ffm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->ffm_score(b, e, ffm, align0, align1, 1, norm);
+          });
+          fm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->fm_score(b, e, fm, aligned_k, 1, norm, s.data());
+          });
+          break;
+        case 1:
+          ffm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->ffm_sgd(b, e, ffm, align0, align1, pg, norm, opt);
+          });
+          fm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->fm_sgd(b, e, fm, aligned_k, pg, norm, opt, s.data());
+          });
+          break;
+        case 2:
+          ffm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->ffm_adagrad(b, e, ffm, align0, align1, pg, norm, opt);
+          });
+          fm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->fm_adagrad(b, e, fm, aligned_k,
+                               pg, norm, opt, s.data());
+          });
+          break;
+        default:
+          ffm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->ffm_ftrl(b, e, ffm, align0, align1, pg, norm, opt);
+          });
+          fm_rate = run(rows, [&](const Node* b, const Node* e) {
+            kernel->fm_ftrl(b, e, fm, aligned_k, pg, norm, opt, s.data());
+          });
+          break;
+      }
+      free(ffm);
+      free(fm);
+      if (w == 4) {
+        sse_ffm[op] = ffm_rate;
+        sse_fm[op] = fm_rate;
+      }
+      column.clear();
+      column.push_back(StringPrintf("%s-%s", kernel->name, names[op]));
+      column.push_back(StringPrintf("%d", w));
+      column.push_back(StringPrintf("%.0f", ffm_rate));
+      column.push_back(StringPrintf("%.0f", fm_rate));
+      column.push_back(StringPrintf("%.2fx", ffm_rate / sse_ffm[op]));
+      print_row(column, width);
+    }
+  }
+
+  return 0;
+}
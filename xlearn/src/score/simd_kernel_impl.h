@@ -0,0 +1,650 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the generic implementation of the SIMD kernels, which
+is included by simd_kernel.cc, simd_kernel_avx2.cc and
+simd_kernel_avx512.cc. Do not include it in other files.
+*/
+
+#ifndef XLEARN_SCORE_SIMD_KERNEL_IMPL_H_
+#define XLEARN_SCORE_SIMD_KERNEL_IMPL_H_
+
+#include <math.h>
+#include <xmmintrin.h>
+
+#include "src/base/math.h"
+#include "src/score/simd_kernel.h"
+
+namespace xLearn {
+namespace {
+
+//------------------------------------------------------------------------------
+// The kernels are written once for a vector type V, which wraps the
+// intrinsics of one instruction set:
+//
+//   V::kWidth               number of float in one register
+//   V::zero(), V::set1(x)   create register
+//   V::load(p), V::store(p, a)    aligned load and store
+//   V::loadu(p), V::storeu(p, a)  unaligned load and store
+//   V::add, V::sub, V::mul, V::div, V::sqrt
+//   V::rsqrt(a)             approximate 1/sqrt(a)
+//   V::fmadd(a, b, c)       a*b+c
+//   V::hsum(a)              sum of all the elements
+//   V::load_fp16(p)         unaligned load of fp16, converted to float
+//   V::load_int8(p)         unaligned load of int8, converted to float
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// In the pair loop of ffm, the block w[j2][f1] of each pair is a
+// random cache line of a model that is much larger than the cache,
+// while w[j1][f2] stays hot for the nodes of the same field (the
+// libffm parser groups the nodes of a line by field). We prefetch
+// w[j2][f1] of the pair that is kPrefetchPairs ahead, so it arrives
+// while the current pairs are computed.
+//------------------------------------------------------------------------------
+const index_t kPrefetchPairs = 8;
+
+// Prefetch the size floats from p, 16 floats (64 bytes) at a time.
+inline void prefetch_block(const real_t* p, index_t size) {
+  for (index_t d = 0; d < size; d += 16) {
+    _mm_prefetch(reinterpret_cast<const char*>(p + d), _MM_HINT_T0);
+  }
+}
+
+// Prefetch w[j2][f1] of the pair (iter_i, iter_j + kPrefetchPairs).
+inline void prefetch_pair(const Node* iter_j, const Node* end,
+                          const real_t* w, index_t f1,
+                          index_t align0, index_t align1) {
+  if (end - iter_j <= kPrefetchPairs) { return; }
+  const Node* ahead = iter_j + kPrefetchPairs;
+  prefetch_block(w + ahead->feat_id*align1 + f1*align0, align0);
+}
+
+// y = sum( (V_i_fj*V_j_fi)(x_i * x_j) )
+template <class V>
+real_t ffm_score(const Node* begin, const Node* end,
+                 const real_t* w, index_t align0,
+                 index_t align1, index_t aux_size,
+                 real_t norm) {
+  const index_t align = V::kWidth * aux_size;
+  typename V::reg XMMt = V::zero();
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    index_t j1 = iter_i->feat_id;
+    index_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    const real_t* w1_row = w + j1*align1;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      index_t j2 = iter_j->feat_id;
+      index_t f2 = iter_j->field_id;
+      real_t v2 = iter_j->feat_val;
+      prefetch_pair(iter_j, end, w, f1, align0, align1);
+      const real_t* w1_base = w1_row + f2*align0;
+      const real_t* w2_base = w + j2*align1 + f1*align0;
+      typename V::reg XMMv = V::set1(v1*v2*norm);
+      for (index_t d = 0; d < align0; d += align) {
+        typename V::reg XMMw1 = V::load(w1_base + d);
+        typename V::reg XMMw2 = V::load(w2_base + d);
+        XMMt = V::fmadd(V::mul(XMMw1, XMMw2), XMMv, XMMt);
+      }
+    }
+  }
+  return V::hsum(XMMt);
+}
+
+// Update ffm latent factor using sgd
+template <class V>
+void ffm_sgd(const Node* begin, const Node* end,
+             real_t* w, index_t align0, index_t align1,
+             real_t pg, real_t norm, const OptParam& opt) {
+  const index_t align = V::kWidth;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMlr = V::set1(opt.learning_rate);
+  typename V::reg XMMlamb = V::set1(opt.regu_lambda);
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    index_t j1 = iter_i->feat_id;
+    index_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    real_t* w1_row = w + j1*align1;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      index_t j2 = iter_j->feat_id;
+      index_t f2 = iter_j->field_id;
+      real_t v2 = iter_j->feat_val;
+      prefetch_pair(iter_j, end, w, f1, align0, align1);
+      real_t* w1_base = w1_row + f2*align0;
+      real_t* w2_base = w + j2*align1 + f1*align0;
+      typename V::reg XMMv = V::set1(v1*v2*norm);
+      typename V::reg XMMpgv = V::mul(XMMv, XMMpg);
+      for (index_t d = 0; d < align0; d += align) {
+        real_t *w1 = w1_base + d;
+        real_t *w2 = w2_base + d;
+        typename V::reg XMMw1 = V::load(w1);
+        typename V::reg XMMw2 = V::load(w2);
+        typename V::reg XMMg1 = V::fmadd(XMMlamb, XMMw1,
+                                V::mul(XMMpgv, XMMw2));
+        typename V::reg XMMg2 = V::fmadd(XMMlamb, XMMw2,
+                                V::mul(XMMpgv, XMMw1));
+        XMMw1 = V::sub(XMMw1, V::mul(XMMlr, XMMg1));
+        XMMw2 = V::sub(XMMw2, V::mul(XMMlr, XMMg2));
+        V::store(w1, XMMw1);
+        V::store(w2, XMMw2);
+      }
+    }
+  }
+}
+
+// Update ffm latent factor using adagrad
+template <class V>
+void ffm_adagrad(const Node* begin, const Node* end,
+                 real_t* w, index_t align0, index_t align1,
+                 real_t pg, real_t norm, const OptParam& opt) {
+  const index_t align = V::kWidth * 2;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMlr = V::set1(opt.learning_rate);
+  typename V::reg XMMlamb = V::set1(opt.regu_lambda);
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    index_t j1 = iter_i->feat_id;
+    index_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    real_t* w1_row = w + j1*align1;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      index_t j2 = iter_j->feat_id;
+      index_t f2 = iter_j->field_id;
+      real_t v2 = iter_j->feat_val;
+      prefetch_pair(iter_j, end, w, f1, align0, align1);
+      real_t* w1_base = w1_row + f2*align0;
+      real_t* w2_base = w + j2*align1 + f1*align0;
+      typename V::reg XMMv = V::set1(v1*v2*norm);
+      typename V::reg XMMpgv = V::mul(XMMv, XMMpg);
+      for (index_t d = 0; d < align0; d += align) {
+        real_t *w1 = w1_base + d;
+        real_t *w2 = w2_base + d;
+        real_t *wg1 = w1 + V::kWidth;
+        real_t *wg2 = w2 + V::kWidth;
+        typename V::reg XMMw1 = V::load(w1);
+        typename V::reg XMMw2 = V::load(w2);
+        typename V::reg XMMwg1 = V::load(wg1);
+        typename V::reg XMMwg2 = V::load(wg2);
+        typename V::reg XMMg1 = V::fmadd(XMMlamb, XMMw1,
+                                V::mul(XMMpgv, XMMw2));
+        typename V::reg XMMg2 = V::fmadd(XMMlamb, XMMw2,
+                                V::mul(XMMpgv, XMMw1));
+        XMMwg1 = V::fmadd(XMMg1, XMMg1, XMMwg1);
+        XMMwg2 = V::fmadd(XMMg2, XMMg2, XMMwg2);
+        XMMw1 = V::sub(XMMw1, V::mul(XMMlr,
+                V::mul(V::rsqrt(XMMwg1), XMMg1)));
+        XMMw2 = V::sub(XMMw2, V::mul(XMMlr,
+                V::mul(V::rsqrt(XMMwg2), XMMg2)));
+        V::store(w1, XMMw1);
+        V::store(w2, XMMw2);
+        V::store(wg1, XMMwg1);
+        V::store(wg2, XMMwg2);
+      }
+    }
+  }
+}
+
+// Scalar ftrl update for one element of the model
+inline void ftrl_update_w(real_t* w, real_t z,
+                          real_t wg, const OptParam& opt) {
+  int sign = z > 0 ? 1 : -1;
+  if (sign * z <= opt.lambda_1) {
+    *w = 0;
+  } else {
+    *w = (sign*opt.lambda_1-z) /
+      ((opt.beta + sqrt(wg)) / opt.alpha + opt.lambda_2);
+  }
+}
+
+// Update ffm latent factor using ftrl
+template <class V>
+void ffm_ftrl(const Node* begin, const Node* end,
+              real_t* w, index_t align0, index_t align1,
+              real_t pg, real_t norm, const OptParam& opt) {
+  const index_t align = V::kWidth * 3;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMalpha = V::set1(opt.alpha);
+  typename V::reg XMML2 = V::set1(opt.lambda_2);
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    index_t j1 = iter_i->feat_id;
+    index_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    real_t* w1_row = w + j1*align1;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      index_t j2 = iter_j->feat_id;
+      index_t f2 = iter_j->field_id;
+      real_t v2 = iter_j->feat_val;
+      prefetch_pair(iter_j, end, w, f1, align0, align1);
+      real_t* w1_base = w1_row + f2*align0;
+      real_t* w2_base = w + j2*align1 + f1*align0;
+      typename V::reg XMMv = V::set1(v1*v2*norm);
+      typename V::reg XMMpgv = V::mul(XMMv, XMMpg);
+      for (index_t d = 0; d < align0; d += align) {
+        real_t *w1 = w1_base + d;
+        real_t *w2 = w2_base + d;
+        real_t *wg1 = w1 + V::kWidth;
+        real_t *wg2 = w2 + V::kWidth;
+        real_t *z1 = w1 + V::kWidth * 2;
+        real_t *z2 = w2 + V::kWidth * 2;
+        typename V::reg XMMw1 = V::load(w1);
+        typename V::reg XMMw2 = V::load(w2);
+        typename V::reg XMMwg1 = V::load(wg1);
+        typename V::reg XMMwg2 = V::load(wg2);
+        typename V::reg XMMz1 = V::load(z1);
+        typename V::reg XMMz2 = V::load(z2);
+        typename V::reg XMMg1 = V::fmadd(XMML2, XMMw1,
+                                V::mul(XMMpgv, XMMw2));
+        typename V::reg XMMg2 = V::fmadd(XMML2, XMMw2,
+                                V::mul(XMMpgv, XMMw1));
+        typename V::reg XMMnwg1 = V::fmadd(XMMg1, XMMg1, XMMwg1);
+        typename V::reg XMMnwg2 = V::fmadd(XMMg2, XMMg2, XMMwg2);
+        typename V::reg XMMsigma1 = V::div(
+                                    V::sub(V::sqrt(XMMnwg1),
+                                    V::sqrt(XMMwg1)), XMMalpha);
+        typename V::reg XMMsigma2 = V::div(
+                                    V::sub(V::sqrt(XMMnwg2),
+                                    V::sqrt(XMMwg2)), XMMalpha);
+        XMMz1 = V::add(XMMz1, V::sub(XMMg1, V::mul(XMMsigma1, XMMw1)));
+        XMMz2 = V::add(XMMz2, V::sub(XMMg2, V::mul(XMMsigma2, XMMw2)));
+        V::store(z1, XMMz1);
+        V::store(z2, XMMz2);
+        V::store(wg1, XMMnwg1);
+        V::store(wg2, XMMnwg2);
+        // Update w. SIMD may not faster
+        for (index_t i = 0; i < V::kWidth; ++i) {
+          ftrl_update_w(w1+i, z1[i], wg1[i], opt);
+          ftrl_update_w(w2+i, z2[i], wg2[i], opt);
+        }
+      }
+    }
+  }
+}
+
+// s = sum(V_i * x_i), which is shared by the fm score and gradient.
+template <class V>
+void fm_sum(const Node* begin, const Node* end,
+            const real_t* v, index_t aligned_k,
+            index_t align0, real_t norm, real_t* s) {
+  for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+    V::storeu(s+d, V::zero());
+  }
+  for (const Node* iter = begin; iter != end; ++iter) {
+    const real_t *w = v + iter->feat_id * align0;
+    typename V::reg XMMv = V::set1(iter->feat_val*norm);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      typename V::reg XMMs = V::loadu(s+d);
+      typename V::reg XMMw = V::load(w+d);
+      V::storeu(s+d, V::fmadd(XMMw, XMMv, XMMs));
+    }
+  }
+}
+
+// y = sum( (V_i*V_j)(x_i * x_j) )
+template <class V>
+real_t fm_score(const Node* begin, const Node* end,
+                const real_t* v, index_t aligned_k,
+                index_t aux_size, real_t norm, real_t* s) {
+  index_t align0 = aligned_k * aux_size;
+  fm_sum<V>(begin, end, v, aligned_k, align0, norm, s);
+  typename V::reg XMMt = V::zero();
+  for (const Node* iter = begin; iter != end; ++iter) {
+    const real_t *w = v + iter->feat_id * align0;
+    typename V::reg XMMv = V::set1(iter->feat_val*norm);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      typename V::reg XMMs = V::loadu(s+d);
+      typename V::reg XMMwv = V::mul(V::load(w+d), XMMv);
+      XMMt = V::fmadd(XMMwv, V::sub(XMMs, XMMwv), XMMt);
+    }
+  }
+  return V::hsum(XMMt) * 0.5;
+}
+
+// Update fm latent factor using sgd
+template <class V>
+void fm_sgd(const Node* begin, const Node* end,
+            real_t* v, index_t aligned_k, real_t pg,
+            real_t norm, const OptParam& opt, real_t* s) {
+  index_t align0 = aligned_k;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMlr = V::set1(opt.learning_rate);
+  typename V::reg XMMlamb = V::set1(opt.regu_lambda);
+  fm_sum<V>(begin, end, v, aligned_k, align0, norm, s);
+  for (const Node* iter = begin; iter != end; ++iter) {
+    real_t *w = v + iter->feat_id * align0;
+    typename V::reg XMMv = V::set1(iter->feat_val*norm);
+    typename V::reg XMMpgv = V::mul(XMMpg, XMMv);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      typename V::reg XMMs = V::loadu(s+d);
+      typename V::reg XMMw = V::load(w+d);
+      typename V::reg XMMg = V::fmadd(XMMlamb, XMMw,
+                             V::mul(XMMpgv, V::sub(XMMs,
+                             V::mul(XMMw, XMMv))));
+      XMMw = V::sub(XMMw, V::mul(XMMlr, XMMg));
+      V::store(w+d, XMMw);
+    }
+  }
+}
+
+// Update fm latent factor using adagrad
+template <class V>
+void fm_adagrad(const Node* begin, const Node* end,
+                real_t* v, index_t aligned_k, real_t pg,
+                real_t norm, const OptParam& opt, real_t* s) {
+  index_t align0 = aligned_k * 2;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMlr = V::set1(opt.learning_rate);
+  typename V::reg XMMlamb = V::set1(opt.regu_lambda);
+  fm_sum<V>(begin, end, v, aligned_k, align0, norm, s);
+  for (const Node* iter = begin; iter != end; ++iter) {
+    real_t *w = v + iter->feat_id * align0;
+    typename V::reg XMMv = V::set1(iter->feat_val*norm);
+    typename V::reg XMMpgv = V::mul(XMMpg, XMMv);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      typename V::reg XMMs = V::loadu(s+d);
+      typename V::reg XMMw = V::load(w+d);
+      typename V::reg XMMwg = V::load(w+aligned_k+d);
+      typename V::reg XMMg = V::fmadd(XMMlamb, XMMw,
+                             V::mul(XMMpgv, V::sub(XMMs,
+                             V::mul(XMMw, XMMv))));
+      XMMwg = V::fmadd(XMMg, XMMg, XMMwg);
+      XMMw = V::sub(XMMw, V::mul(XMMlr,
+             V::mul(V::rsqrt(XMMwg), XMMg)));
+      V::store(w+d, XMMw);
+      V::store(w+aligned_k+d, XMMwg);
+    }
+  }
+}
+
+// Update fm latent factor using ftrl
+template <class V>
+void fm_ftrl(const Node* begin, const Node* end,
+             real_t* v, index_t aligned_k, real_t pg,
+             real_t norm, const OptParam& opt, real_t* s) {
+  index_t align0 = aligned_k * 3;
+  typename V::reg XMMpg = V::set1(pg);
+  typename V::reg XMMalpha = V::set1(opt.alpha);
+  typename V::reg XMML2 = V::set1(opt.lambda_2);
+  fm_sum<V>(begin, end, v, aligned_k, align0, norm, s);
+  for (const Node* iter = begin; iter != end; ++iter) {
+    real_t *w_base = v + iter->feat_id * align0;
+    typename V::reg XMMv = V::set1(iter->feat_val*norm);
+    typename V::reg XMMpgv = V::mul(XMMpg, XMMv);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      real_t* w = w_base + d;
+      real_t* wg = w_base + aligned_k + d;
+      real_t* z = w_base + aligned_k*2 + d;
+      typename V::reg XMMs = V::loadu(s+d);
+      typename V::reg XMMw = V::load(w);
+      typename V::reg XMMwg = V::load(wg);
+      typename V::reg XMMz = V::load(z);
+      typename V::reg XMMg = V::fmadd(XMML2, XMMw,
+                             V::mul(XMMpgv, V::sub(XMMs,
+                             V::mul(XMMw, XMMv))));
+      typename V::reg XMMnwg = V::fmadd(XMMg, XMMg, XMMwg);
+      typename V::reg XMMsigma = V::div(V::sub(V::sqrt(XMMnwg),
+                                 V::sqrt(XMMwg)), XMMalpha);
+      XMMz = V::add(XMMz, V::sub(XMMg, V::mul(XMMsigma, XMMw)));
+      V::store(z, XMMz);
+      V::store(wg, XMMnwg);
+      // Update w. SIMD may not faster.
+      for (index_t i = 0; i < V::kWidth; ++i) {
+        ftrl_update_w(w+i, z[i], wg[i], opt);
+      }
+    }
+  }
+}
+
+// Latent vector of an inference model stored in fp16
+struct FP16Vector {
+  typedef uint16 value_type;
+  template <class V>
+  static inline typename V::reg load(const uint16* p) {
+    return V::load_fp16(p);
+  }
+};
+
+// Latent vector of an inference model stored in int8
+struct Int8Vector {
+  typedef int8 value_type;
+  template <class V>
+  static inline typename V::reg load(const int8* p) {
+    return V::load_int8(p);
+  }
+};
+
+// The ffm score of the quantized latent factor. The scale of int8
+// vectors is multiplied with x_i * x_j, and it is nullptr for fp16.
+template <class V, class Q>
+real_t ffm_score_quant(const Node* begin, const Node* end,
+                       const typename Q::value_type* v,
+                       const real_t* scale, index_t num_field,
+                       index_t aligned_k, real_t norm) {
+  typename V::reg XMMt = V::zero();
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    size_t j1 = iter_i->feat_id;
+    size_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      size_t j2 = iter_j->feat_id;
+      size_t f2 = iter_j->field_id;
+      real_t v2 = iter_j->feat_val;
+      size_t i1 = j1*num_field + f2;
+      size_t i2 = j2*num_field + f1;
+      real_t c = v1*v2*norm;
+      if (scale != nullptr) { c *= scale[i1] * scale[i2]; }
+      const typename Q::value_type* w1_base = v + i1*aligned_k;
+      const typename Q::value_type* w2_base = v + i2*aligned_k;
+      typename V::reg XMMv = V::set1(c);
+      for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+        typename V::reg XMMw1 = Q::template load<V>(w1_base + d);
+        typename V::reg XMMw2 = Q::template load<V>(w2_base + d);
+        XMMt = V::fmadd(V::mul(XMMw1, XMMw2), XMMv, XMMt);
+      }
+    }
+  }
+  return V::hsum(XMMt);
+}
+
+template <class V>
+real_t ffm_score_fp16(const Node* begin, const Node* end,
+                      const uint16* v, index_t num_field,
+                      index_t aligned_k, real_t norm) {
+  return ffm_score_quant<V, FP16Vector>(begin, end, v, nullptr,
+                                        num_field, aligned_k, norm);
+}
+
+template <class V>
+real_t ffm_score_int8(const Node* begin, const Node* end,
+                      const int8* v, const real_t* scale,
+                      index_t num_field, index_t aligned_k,
+                      real_t norm) {
+  return ffm_score_quant<V, Int8Vector>(begin, end, v, scale,
+                                        num_field, aligned_k, norm);
+}
+
+// The fm score of the quantized latent factor:
+// y = 0.5 * sum( (sum_i V_i*x_i)^2 - sum_i (V_i*x_i)^2 )
+template <class V, class Q>
+real_t fm_score_quant(const Node* begin, const Node* end,
+                      const typename Q::value_type* v,
+                      const real_t* scale, index_t aligned_k,
+                      real_t norm, real_t* s) {
+  for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+    V::storeu(s+d, V::zero());
+  }
+  typename V::reg XMMsq = V::zero();
+  for (const Node* iter = begin; iter != end; ++iter) {
+    size_t j = iter->feat_id;
+    real_t x = iter->feat_val*norm;
+    if (scale != nullptr) { x *= scale[j]; }
+    const typename Q::value_type* w = v + j*aligned_k;
+    typename V::reg XMMv = V::set1(x);
+    for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+      typename V::reg XMMwv = V::mul(Q::template load<V>(w+d), XMMv);
+      V::storeu(s+d, V::add(V::loadu(s+d), XMMwv));
+      XMMsq = V::fmadd(XMMwv, XMMwv, XMMsq);
+    }
+  }
+  typename V::reg XMMt = V::zero();
+  for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+    typename V::reg XMMs = V::loadu(s+d);
+    XMMt = V::fmadd(XMMs, XMMs, XMMt);
+  }
+  return (V::hsum(XMMt) - V::hsum(XMMsq)) * 0.5;
+}
+
+template <class V>
+real_t fm_score_fp16(const Node* begin, const Node* end,
+                     const uint16* v, index_t aligned_k,
+                     real_t norm, real_t* s) {
+  return fm_score_quant<V, FP16Vector>(begin, end, v, nullptr,
+                                       aligned_k, norm, s);
+}
+
+template <class V>
+real_t fm_score_int8(const Node* begin, const Node* end,
+                     const int8* v, const real_t* scale,
+                     index_t aligned_k, real_t norm, real_t* s) {
+  return fm_score_quant<V, Int8Vector>(begin, end, v, scale,
+                                       aligned_k, norm, s);
+}
+
+// Find the kept vector on field f of a feature, whose field bitmap
+// is b and first kept vector is base. Return nullptr if it is dropped.
+inline const real_t* find_sparse_vector(const uint64* b,
+                                        const real_t* base,
+                                        index_t aligned_k,
+                                        index_t f) {
+  index_t n = f >> 6;
+  uint64 mask = (uint64)1 << (f & 63);
+  if ((b[n] & mask) == 0) { return nullptr; }
+  size_t idx = PopCount64(b[n] & (mask - 1));
+  for (index_t w = 0; w < n; ++w) {
+    idx += PopCount64(b[w]);
+  }
+  return base + idx*aligned_k;
+}
+
+// Max number of nodes of the rows scored by ffm_score_sparse_short().
+const index_t kSparseRowLength = 256;
+
+// The ffm score of a pruned model with no more than 64 fields, for the
+// rows with no more than kSparseRowLength nodes. The bitmap word, the
+// first vector and the field bit of each node are found once, so each
+// pair only tests two bits and counts the bits before them.
+template <class V>
+real_t ffm_score_sparse_short(const Node* begin, const Node* end,
+                              const real_t* v, const uint64* bitmap,
+                              const index_t* offset, index_t aligned_k,
+                              real_t norm) {
+  uint64 word[kSparseRowLength];
+  uint64 below[kSparseRowLength];
+  const real_t* base[kSparseRowLength];
+  index_t len = end - begin;
+  for (index_t n = 0; n < len; ++n) {
+    size_t j = begin[n].feat_id;
+    word[n] = bitmap[j];
+    below[n] = ((uint64)1 << begin[n].field_id) - 1;
+    base[n] = v + (size_t)offset[j]*aligned_k;
+  }
+  typename V::reg XMMt = V::zero();
+  for (index_t n = 0; n < len; ++n) {
+    uint64 word1 = word[n];
+    uint64 below1 = below[n];
+    real_t v1 = begin[n].feat_val*norm;
+    for (index_t m = n+1; m < len; ++m) {
+      // Skip the pair if any of the two vectors is dropped.
+      // The bit of field f is below[f] + 1.
+      if (((word1 & (below[m] + 1)) == 0) |
+          ((word[m] & (below1 + 1)) == 0)) { continue; }
+      const real_t* w1_base = base[n] +
+        PopCount64(word1 & below[m]) * aligned_k;
+      const real_t* w2_base = base[m] +
+        PopCount64(word[m] & below1) * aligned_k;
+      typename V::reg XMMv = V::set1(v1*begin[m].feat_val);
+      for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+        typename V::reg XMMw1 = V::load(w1_base + d);
+        typename V::reg XMMw2 = V::load(w2_base + d);
+        XMMt = V::fmadd(V::mul(XMMw1, XMMw2), XMMv, XMMt);
+      }
+    }
+  }
+  return V::hsum(XMMt);
+}
+
+// The ffm score of a pruned model, in which the
+// pairs with a dropped vector are skipped.
+template <class V>
+real_t ffm_score_sparse(const Node* begin, const Node* end,
+                        const real_t* v, const uint64* bitmap,
+                        const index_t* offset, index_t num_word,
+                        index_t aligned_k, real_t norm) {
+  if (num_word == 1 && end - begin <= kSparseRowLength) {
+    return ffm_score_sparse_short<V>(begin, end, v, bitmap,
+                                     offset, aligned_k, norm);
+  }
+  typename V::reg XMMt = V::zero();
+  for (const Node* iter_i = begin; iter_i != end; ++iter_i) {
+    size_t j1 = iter_i->feat_id;
+    index_t f1 = iter_i->field_id;
+    real_t v1 = iter_i->feat_val;
+    for (const Node* iter_j = iter_i+1; iter_j != end; ++iter_j) {
+      size_t j2 = iter_j->feat_id;
+      const real_t* w1_base = find_sparse_vector(bitmap + j1*num_word,
+                                                 v + (size_t)offset[j1]*aligned_k,
+                                                 aligned_k, iter_j->field_id);
+      if (w1_base == nullptr) { continue; }
+      const real_t* w2_base = find_sparse_vector(bitmap + j2*num_word,
+                                                 v + (size_t)offset[j2]*aligned_k,
+                                                 aligned_k, f1);
+      if (w2_base == nullptr) { continue; }
+      typename V::reg XMMv = V::set1(v1*iter_j->feat_val*norm);
+      for (index_t d = 0; d < aligned_k; d += V::kWidth) {
+        typename V::reg XMMw1 = V::load(w1_base + d);
+        typename V::reg XMMw2 = V::load(w2_base + d);
+        XMMt = V::fmadd(V::mul(XMMw1, XMMw2), XMMv, XMMt);
+      }
+    }
+  }
+  return V::hsum(XMMt);
+}
+
+// Create the kernel table for the vector type V.
+template <class V>
+SIMDKernel make_kernel(const char* name) {
+  SIMDKernel kernel;
+  kernel.name = name;
+  kernel.width = V::kWidth;
+  kernel.ffm_score = ffm_score<V>;
+  kernel.ffm_sgd = ffm_sgd<V>;
+  kernel.ffm_adagrad = ffm_adagrad<V>;
+  kernel.ffm_ftrl = ffm_ftrl<V>;
+  kernel.fm_score = fm_score<V>;
+  kernel.fm_sgd = fm_sgd<V>;
+  kernel.fm_adagrad = fm_adagrad<V>;
+  kernel.fm_ftrl = fm_ftrl<V>;
+  kernel.ffm_score_fp16 = ffm_score_fp16<V>;
+  kernel.ffm_score_int8 = ffm_score_int8<V>;
+  kernel.fm_score_fp16 = fm_score_fp16<V>;
+  kernel.fm_score_int8 = fm_score_int8<V>;
+  kernel.ffm_score_sparse = ffm_score_sparse<V>;
+  return kernel;
+}
+
+}  // namespace
+}  // namespace xLearn
+
+#endif  // XLEARN_SCORE_SIMD_KERNEL_IMPL_H_
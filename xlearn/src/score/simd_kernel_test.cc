@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the SIMD kernels. Each kernel supported by current
+CPU is compared with the SSE kernel on random data.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/cpu_feature.h"
+#include "src/data/data_structure.h"
+#include "src/score/simd_kernel.h"
+
+namespace xLearn {
+
+const index_t kNumFeature = 20;
+const index_t kNumField = 5;
+const index_t kAlignedK = 32;
+const index_t kNumRow = 50;
+
+// Aligned buffer for the model.
+class AlignedBuffer {
+ public:
+  explicit AlignedBuffer(index_t size) : size_(size) {
+    CHECK_EQ(posix_memalign((void**)&data_, 64,
+                            size * sizeof(real_t)), 0);
+  }
+  ~AlignedBuffer() { free(data_); }
+  real_t* data() { return data_; }
+  index_t size() const { return size_; }
+
+ private:
+  real_t* data_;
+  index_t size_;
+};
+
+real_t rand_real(real_t low, real_t high) {
+  return low + (high - low) * (rand() / (real_t)RAND_MAX);
+}
+
+// Random model in the order of (feature, field, aux, k).
+// The gradient sum (aux 1) must be positive.
+std::vector<real_t> random_model(index_t num_block, index_t aux_size) {
+  std::vector<real_t> model(num_block * kAlignedK * aux_size);
+  for (index_t i = 0; i < num_block; ++i) {
+    for (index_t j = 0; j < aux_size; ++j) {
+      for (index_t d = 0; d < kAlignedK; ++d) {
+        real_t val = j == 1 ? rand_real(0.5, 1.5) : rand_real(-0.5, 0.5);
+        model[(i*aux_size + j)*kAlignedK + d] = val;
+      }
+    }
+  }
+  return model;
+}
+
+// Convert the (aux, k) order to the ffm layout of the given width.
+void to_ffm_layout(const std::vector<real_t>& src, index_t aux_size,
+                   index_t align, real_t* dst) {
+  index_t block = kAlignedK * aux_size;
+  for (index_t i = 0; i < src.size() / block; ++i) {
+    for (index_t j = 0; j < aux_size; ++j) {
+      for (index_t d = 0; d < kAlignedK; ++d) {
+        dst[i*block + (d/align)*align*aux_size + j*align + d%align] =
+          src[i*block + j*kAlignedK + d];
+      }
+    }
+  }
+}
+
+void from_ffm_layout(const real_t* src, index_t aux_size,
+                     index_t align, std::vector<real_t>& dst) {
+  index_t block = kAlignedK * aux_size;
+  for (index_t i = 0; i < dst.size() / block; ++i) {
+    for (index_t j = 0; j < aux_size; ++j) {
+      for (index_t d = 0; d < kAlignedK; ++d) {
+        dst[i*block + j*kAlignedK + d] =
+          src[i*block + (d/align)*align*aux_size + j*align + d%align];
+      }
+    }
+  }
+}
+
+std::vector<std::vector<Node> > random_rows() {
+  std::vector<std::vector<Node> > rows(kNumRow);
+  for (index_t i = 0; i < kNumRow; ++i) {
+    index_t len = 1 + rand() % 10;
+    for (index_t j = 0; j < len; ++j) {
+      Node node(rand() % kNumField,
+                (i + j) % kNumFeature,
+                rand_real(0.1, 1.0));
+      rows[i].push_back(node);
+    }
+  }
+  return rows;
+}
+
+OptParam random_opt() {
+  OptParam opt;
+  opt.learning_rate = 0.1;
+  opt.regu_lambda = 0.001;
+  opt.alpha = 0.3;
+  opt.beta = 1.0;
+  opt.lambda_1 = 0.001;
+  opt.lambda_2 = 0.002;
+  return opt;
+}
+
+void check_near(const std::vector<real_t>& a,
+                const std::vector<real_t>& b) {
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_NEAR(a[i], b[i], 1e-3 * std::max(1.0f, fabsf(b[i])));
+  }
+}
+
+// Kernels supported by current CPU.
+std::vector<const SIMDKernel*> get_kernels() {
+  std::vector<const SIMDKernel*> kernels;
+  for (index_t width = 4; width <= SIMDWidth(GetSIMDLevel()); width *= 2) {
+    kernels.push_back(GetSIMDKernel(width));
+  }
+  return kernels;
+}
+
+TEST(SIMDKernelTest, Get_kernel) {
+  EXPECT_EQ(GetSIMDKernel(4)->width, 4);
+  std::vector<const SIMDKernel*> kernels = get_kernels();
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    EXPECT_EQ(kernels[i]->width, 4 << i);
+  }
+  EXPECT_EQ(kernels.back()->width, SIMDWidth(GetSIMDLevel()));
+}
+
+TEST(SIMDKernelTest, FFM_kernel) {
+  std::vector<std::vector<Node> > rows = random_rows();
+  OptParam opt = random_opt();
+  std::vector<const SIMDKernel*> kernels = get_kernels();
+  const SIMDKernel* sse = GetSSEKernel();
+  for (index_t aux_size = 1; aux_size <= 3; ++aux_size) {
+    index_t align0 = kAlignedK * aux_size;
+    index_t align1 = kNumField * align0;
+    std::vector<real_t> init = random_model(kNumFeature*kNumField,
+                                            aux_size);
+    AlignedBuffer base(init.size());
+    to_ffm_layout(init, aux_size, sse->width, base.data());
+    for (size_t k = 1; k < kernels.size(); ++k) {
+      const SIMDKernel* kernel = kernels[k];
+      AlignedBuffer model(init.size());
+      to_ffm_layout(init, aux_size, kernel->width, model.data());
+      AlignedBuffer expect(init.size());
+      to_ffm_layout(init, aux_size, sse->width, expect.data());
+      for (index_t i = 0; i < kNumRow; ++i) {
+        const Node* begin = rows[i].data();
+        const Node* end = begin + rows[i].size();
+        real_t score = kernel->ffm_score(begin, end, model.data(),
+                                         align0, align1, aux_size, 0.5);
+        real_t score_sse = sse->ffm_score(begin, end, expect.data(),
+                                          align0, align1, aux_size, 0.5);
+        EXPECT_NEAR(score, score_sse, 1e-3);
+        if (aux_size == 1) {
+          kernel->ffm_sgd(begin, end, model.data(),
+                          align0, align1, 0.3, 0.5, opt);
+          sse->ffm_sgd(begin, end, expect.data(),
+                       align0, align1, 0.3, 0.5, opt);
+        } else if (aux_size == 2) {
+          kernel->ffm_adagrad(begin, end, model.data(),
+                              align0, align1, 0.3, 0.5, opt);
+          sse->ffm_adagrad(begin, end, expect.data(),
+                           align0, align1, 0.3, 0.5, opt);
+        } else {
+          kernel->ffm_ftrl(begin, end, model.data(),
+                           align0, align1, 0.3, 0.5, opt);
+          sse->ffm_ftrl(begin, end, expect.data(),
+                        align0, align1, 0.3, 0.5, opt);
+        }
+      }
+      std::vector<real_t> res(init.size()), res_sse(init.size());
+      from_ffm_layout(model.data(), aux_size, kernel->width, res);
+      from_ffm_layout(expect.data(), aux_size, sse->width, res_sse);
+      check_near(res, res_sse);
+    }
+  }
+}
+
+TEST(SIMDKernelTest, FM_kernel) {
+  std::vector<std::vector<Node> > rows = random_rows();
+  OptParam opt = random_opt();
+  std::vector<const SIMDKernel*> kernels = get_kernels();
+  const SIMDKernel* sse = GetSSEKernel();
+  std::vector<real_t> s(kAlignedK), s_sse(kAlignedK);
+  for (index_t aux_size = 1; aux_size <= 3; ++aux_size) {
+    std::vector<real_t> init = random_model(kNumFeature, aux_size);
+    for (size_t k = 1; k < kernels.size(); ++k) {
+      const SIMDKernel* kernel = kernels[k];
+      AlignedBuffer model(init.size());
+      AlignedBuffer expect(init.size());
+      std::copy(init.begin(), init.end(), model.data());
+      std::copy(init.begin(), init.end(), expect.data());
+      for (index_t i = 0; i < kNumRow; ++i) {
+        const Node* begin = rows[i].data();
+        const Node* end = begin + rows[i].size();
+        real_t score = kernel->fm_score(begin, end, model.data(),
+                                        kAlignedK, aux_size,
+                                        0.5, s.data());
+        real_t score_sse = sse->fm_score(begin, end, expect.data(),
+                                         kAlignedK, aux_size,
+                                         0.5, s_sse.data());
+        EXPECT_NEAR(score, score_sse, 1e-3);
+        if (aux_size == 1) {
+          kernel->fm_sgd(begin, end, model.data(), kAlignedK,
+                         0.3, 0.5, opt, s.data());
+          sse->fm_sgd(begin, end, expect.data(), kAlignedK,
+                      0.3, 0.5, opt, s_sse.data());
+        } else if (aux_size == 2) {
+          kernel->fm_adagrad(begin, end, model.data(), kAlignedK,
+                             0.3, 0.5, opt, s.data());
+          sse->fm_adagrad(begin, end, expect.data(), kAlignedK,
+                          0.3, 0.5, opt, s_sse.data());
+        } else {
+          kernel->fm_ftrl(begin, end, model.data(), kAlignedK,
+                          0.3, 0.5, opt, s.data());
+          sse->fm_ftrl(begin, end, expect.data(), kAlignedK,
+                       0.3, 0.5, opt, s_sse.data());
+        }
+      }
+      std::vector<real_t> res(model.data(), model.data() + init.size());
+      std::vector<real_t> res_sse(expect.data(),
+                                  expect.data() + init.size());
+      check_near(res, res_sse);
+    }
+  }
+}
+
+}  // namespace xLearn
@@ -28,6 +28,7 @@ This file is the implementation of the Checker class.
 #include "src/solver/checker.h"
 #include "src/base/levenshtein_distance.h"
 #include "src/base/file_util.h"
+#include "src/loss/multi_metric.h"
 
 namespace xLearn {
 
@@ -52,9 +53,13 @@ OPTIONS:
          4 -- factorization machines (FM) 
          5 -- field-aware factorization machines (FFM) 
                                                                             
-  -x <metric>          :  The metric can be 'acc', 'prec', 'recall', 'f1', 'auc' (classification), and 
-                          'mae', 'mape', 'rmsd (rmse)' (regression). On defaurt, xLearn will not print 
-                          any evaluation metric information.                                            
+  -x <metric>          :  The metric can be 'acc', 'prec', 'recall', 'f1', 'auc', 'logloss' (classification), 
+                          and 'mae', 'mape', 'rmsd (rmse)' (regression). On defaurt, xLearn will not print 
+                          any evaluation metric information. A list such as 'auc,logloss,acc' is computed 
+                          in one pass over the validation data.                                         
+                                                                                                      
+  --exact-auc          :  Compute the exact AUC by sorting all the validation scores. By default, the 
+                          AUC is approximated by counting the scores in 1e6 buckets.                    
                                                                                                       
   -p <opt_method>      :  Choose the optimization method, including 'sgd', adagrad', and 'ftrl'. On default, 
                           we use the adagrad optimization. 
@@ -72,6 +77,9 @@ OPTIONS:
   -t <txt_model_file>  :  Path of the txt model checkpoint file. On default, this option is empty 
                           and xLearn will not dump the txt model. 
                                                                              
+  -best <model_file>   :  Save the best model of early-stopping to this file in background whenever 
+                          the validation loss is improved. The file has no gradient cache. 
+                                                                             
   -l <log_file>        :  Path of the log file. Using '/tmp/xlearn_log/' by default. 
                                                                                        
   -k <number_of_K>     :  Number of the latent factor used by fm and ffm tasks. Using 4 by default. 
@@ -102,10 +110,21 @@ OPTIONS:
                                                                                        
   -f <fold_number>     :  Number of folds for cross-validation. Using 5 by default.      
                                                                                          
+  -cv_parallel <number> :  Number of folds trained at the same time in the in-memory cross-validation. 
+                          The threads are divided among them. Using 0 (all the folds) by default. 
+                                                                                         
   -nthread <thread_number> :  Number of thread for multi-thread training.                
                                                                                        
   -block <block_size>  :  Block size fot on-disk training.     
 
+  -prefetch <depth>    :  Number of blocks parsed ahead in background for on-disk training. 
+                          Using 2 (double buffering) by default. 
+
+  -shuffle <mode>      :  How the rows are shuffled in each epoch of in-memory training. 'random' 
+                          (by default) shuffles the row order, 'block' shuffles blocks of 256 rows and 
+                          the rows in them, and 'permute' copies the rows in random order, so that 
+                          each epoch reads the memory sequentially (it needs a second copy of data). 
+
   -sw <stop_window>    :  Size of stop window for early-stopping. Using 2 by default.                       
                                                                                       
   --disk               :  Open on-disk training for large-scale machine learning problems. 
@@ -117,6 +136,62 @@ OPTIONS:
                           the result is non-deterministic. Our suggestion is that you can open this flag 
                           if the training data is big and sparse. 
                                                                         
+  -hash <bits>         :  Hash the feature ids of libsvm and libffm files into 2^bits buckets 
+                          (1 ~ 31). The feature id can be any string without ':', such as 'user_123'. 
+                                                                        
+  --sparse-feat        :  Map the (hashed) feature ids to compact ids, so the model size depends on 
+                          the number of distinct features instead of the max feature id. 
+                                                                        
+  -quant <type>        :  Save the binary model as an inference-only model, which has no gradient cache 
+                          and stores the latent factor in 'fp16' or 'int8'. 
+                                                                        
+  -prune <threshold>   :  Save the binary ffm model as a pruned inference-only model, which drops the 
+                          latent vectors that are never updated or whose values are all within threshold. 
+                                                                        
+  --numa               :  Open NUMA-aware lock-free training, which trains a model replica on each 
+                          NUMA node and averages the replicas. It is useful on multi-socket machines. 
+                                                                        
+  -numa_sync <rows>    :  Number of rows between two averaging of the replicas in NUMA-aware training. 
+                          Using 0 (4096 rows for each node) by default. 
+                                                                        
+  --sync               :  Open the synchronous mini-batch training, which sums the gradients of each 
+                          mini-batch in a fixed order. The model is the same for any -nthread. 
+                                                                        
+  -sync_batch <rows>   :  Number of rows of a mini-batch in the sync training. Using 1000 by default. 
+                                                                        
+  -nworker <number>    :  Number of worker processes for the distributed training on a parameter 
+                          server. Using 0 (local training) by default. 
+                                                                        
+  -nserver <number>    :  Number of parameter server processes. Using 1 by default if -nworker is set. 
+                                                                        
+  -staleness <clocks>  :  Number of mini-batches that a worker can be ahead of the slowest worker 
+                          in the distributed training. Using -1 (asynchronous training) by default. 
+                                                                        
+  -batch <batch_size>  :  Number of rows of a mini-batch in the distributed training. 
+                          Using 1000000 by default. 
+                                                                        
+  --stream             :  Train in one pass over an unbounded stream, such as a FIFO or the stdin 
+                          (train_file is '-'). The model size is fixed by -hash (and -nfield for ffm), 
+                          and the loss (and -x metric) of each row is computed before training it. 
+                                                                        
+  -stream_batch <rows> :  Number of rows of a mini-batch in the stream training. Using 1000 by default. 
+                                                                        
+  -stream_window <rows> :  Number of the latest rows evaluated in the stream training, which is also 
+                          the number of rows between two reports. Using 100000 by default. 
+                                                                        
+  -nfield <number>     :  Number of fields of the ffm stream training. The larger fields are dropped. 
+                                                                        
+  -ckpt <file>         :  Path of the checkpoint of the stream training. Using model_file + '.ckpt' 
+                          by default. The checkpoint has no gradient cache. 
+                                                                        
+  -ckpt_rows <rows>    :  Save a checkpoint in background every <rows> rows of the stream. 
+                                                                        
+  -ckpt_sec <seconds>  :  Save a checkpoint in background every <seconds> seconds of the stream. 
+                                                                        
+  -profile <file>      :  Write the time of the phases (read, grad, predict, metric, model), the rows, 
+                          bytes and model updates, and the busy time of each thread of each epoch to 
+                          <file>, a JSON object per line, or CSV if <file> ends with '.csv'. 
+                                                                        
   --dis-es             :  Disable early-stopping in training. By default, xLearn will use early-stopping 
                           in training tasks, except for training in cross-validation. 
                                                                                           
@@ -125,6 +200,9 @@ OPTIONS:
                                                                   
   --quiet              :  Don't print any evaluation information during the training and 
                           just train the model quietly. 
+                                                                  
+  --verify-bin         :  Hash the whole txt file to check its binary cache (.bin). By default, only the 
+                          size, modification time, inode and a few sampled blocks of the file are checked. 
 ----------------------------------------------------------------------------------------------)"
     );
   } else {
@@ -146,6 +224,8 @@ OPTIONS:
   --sign                   :  Converting output to 0 and 1. 
                                                                
   --sigmoid                :  Converting output to 0~1 (problebility). 
+                                                               
+  --verify-bin             :  Hash the whole test file to check its binary cache (.bin). 
 ----------------------------------------------------------------------------------------------)"
     );
   }
@@ -161,6 +241,7 @@ void Checker::Initialize(bool is_train, int argc, char* argv[]) {
     menu_.push_back(std::string("-p"));
     menu_.push_back(std::string("-m"));
     menu_.push_back(std::string("-t"));
+    menu_.push_back(std::string("-best"));
     menu_.push_back(std::string("-l"));
     menu_.push_back(std::string("-k"));
     menu_.push_back(std::string("-r"));
@@ -169,14 +250,39 @@ void Checker::Initialize(bool is_train, int argc, char* argv[]) {
     menu_.push_back(std::string("-e"));
     menu_.push_back(std::string("-f"));
     menu_.push_back(std::string("-pre"));
+    menu_.push_back(std::string("-cv_parallel"));
     menu_.push_back(std::string("-nthread"));
     menu_.push_back(std::string("-block"));
+    menu_.push_back(std::string("-prefetch"));
+    menu_.push_back(std::string("-shuffle"));
     menu_.push_back(std::string("-sw"));
+    menu_.push_back(std::string("-numa_sync"));
+    menu_.push_back(std::string("-sync_batch"));
+    menu_.push_back(std::string("-nworker"));
+    menu_.push_back(std::string("-nserver"));
+    menu_.push_back(std::string("-staleness"));
+    menu_.push_back(std::string("-batch"));
+    menu_.push_back(std::string("-stream_batch"));
+    menu_.push_back(std::string("-stream_window"));
+    menu_.push_back(std::string("-nfield"));
+    menu_.push_back(std::string("-ckpt"));
+    menu_.push_back(std::string("-ckpt_rows"));
+    menu_.push_back(std::string("-ckpt_sec"));
+    menu_.push_back(std::string("-profile"));
+    menu_.push_back(std::string("-hash"));
+    menu_.push_back(std::string("-quant"));
+    menu_.push_back(std::string("-prune"));
     menu_.push_back(std::string("--disk"));
     menu_.push_back(std::string("--cv"));
     menu_.push_back(std::string("--dis-es"));
     menu_.push_back(std::string("--no-norm"));
     menu_.push_back(std::string("--quiet"));
+    menu_.push_back(std::string("--verify-bin"));
+    menu_.push_back(std::string("--numa"));
+    menu_.push_back(std::string("--sync"));
+    menu_.push_back(std::string("--sparse-feat"));
+    menu_.push_back(std::string("--exact-auc"));
+    menu_.push_back(std::string("--stream"));
     menu_.push_back(std::string("-alpha"));
     menu_.push_back(std::string("-beta"));
     menu_.push_back(std::string("-lambda_1"));
@@ -187,6 +293,7 @@ void Checker::Initialize(bool is_train, int argc, char* argv[]) {
     menu_.push_back(std::string("-nthread"));
     menu_.push_back(std::string("--sign"));
     menu_.push_back(std::string("--sigmoid"));
+    menu_.push_back(std::string("--verify-bin"));
   }
   // Get the user's input
   for (int i = 0; i < argc; ++i) {
@@ -224,7 +331,8 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
   /*********************************************************
    *  Check the file path of the training data             *
    *********************************************************/
-  if (FileExist(args_[1].c_str())) {
+  // "-" is the stdin of the stream training
+  if (args_[1].compare("-") == 0 || FileExist(args_[1].c_str())) {
     hyper_param.train_set_file = std::string(args_[1]);
   } else {
     print_error(
@@ -284,24 +392,17 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
       }
       i += 2;
     } else if (list[i].compare("-x") == 0) {  // metrics
-      if (list[i+1].compare("acc") != 0 &&
-          list[i+1].compare("prec") != 0 &&
-          list[i+1].compare("recall") != 0 &&
-          list[i+1].compare("f1") != 0 &&
-          list[i+1].compare("auc") != 0 &&
-          list[i+1].compare("mae") != 0 &&
-          list[i+1].compare("mape") != 0 &&
-          list[i+1].compare("rmsd") != 0 &&
-          list[i+1].compare("rmse") != 0 &&
-          list[i+1].compare("none") != 0) {
+      std::vector<std::string> metric_list;
+      if (!SplitMetricList(list[i+1], &metric_list)) {
         print_error(
           StringPrintf("Unknow metric: %s \n"
-               " -x can only be: \n"
+               " -x can only be (or a list of them split by ','): \n"
                "   acc \n"
                "   prec \n" 
                "   recall \n"
                "   f1 \n"
                "   auc\n"
+               "   logloss \n"
                "   mae \n"
                "   mape \n"
                "   rmsd \n"
@@ -345,6 +446,9 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
     } else if (list[i].compare("-t") == 0) { // txt model file
       hyper_param.txt_model_file = list[i+1];
       i += 2;
+    } else if (list[i].compare("-best") == 0) {  // best model file
+      hyper_param.best_model_file = list[i+1];
+      i += 2;
     } else if (list[i].compare("-l") == 0) {  // log file
       hyper_param.log_file = list[i+1];
       i += 2;
@@ -448,6 +552,32 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
         hyper_param.block_size = value;
       }
       i += 2;
+    } else if (list[i].compare("-prefetch") == 0) {  // pipeline depth for on-disk training
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -prefetch : '%i'. -prefetch must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.prefetch_depth = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-shuffle") == 0) {  // shuffle mode
+      if (list[i+1].compare("random") != 0 &&
+          list[i+1].compare("block") != 0 &&
+          list[i+1].compare("permute") != 0) {
+        print_error(
+          StringPrintf("Unknow shuffle mode: %s \n"
+               " -shuffle can only be: random, block and permute. \n",
+               list[i+1].c_str())
+        );
+        bo = false;
+      } else {
+        hyper_param.shuffle_mode = list[i+1];
+      }
+      i += 2;
     } else if (list[i].compare("-sw") == 0) {  // window size for early stopping
       int value = atoi(list[i+1].c_str());
       if (value < 1) {
@@ -460,6 +590,196 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
         hyper_param.stop_window = value;
       }
       i += 2;
+    } else if (list[i].compare("-hash") == 0) {  // feature hashing
+      int value = atoi(list[i+1].c_str());
+      if (value < 1 || value > 31) {
+        print_error(
+          StringPrintf("Illegal -hash : '%i'. -hash must be in the range of [1, 31].",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.hash_bits = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-quant") == 0) {  // inference model
+      if (list[i+1].compare("fp16") != 0 &&
+          list[i+1].compare("int8") != 0) {
+        print_error(
+          StringPrintf("Unknow quantization type: %s \n"
+               " -quant can only be: fp16 and int8. \n",
+               list[i+1].c_str())
+        );
+        bo = false;
+      } else {
+        hyper_param.quantize = list[i+1];
+      }
+      i += 2;
+    } else if (list[i].compare("-prune") == 0) {  // pruned model
+      real_t value = atof(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -prune : '%f'. -prune must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.prune_threshold = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-cv_parallel") == 0) {  // parallel folds
+      int value = atoi(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -cv_parallel : '%i'. -cv_parallel must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.cv_parallel = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-numa_sync") == 0) {  // rows between averaging
+      int value = atoi(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -numa_sync : '%i'. -numa_sync must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.numa_sync = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-sync_batch") == 0) {  // sync mini-batch
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -sync_batch : '%i'. -sync_batch must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.sync_batch = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-nworker") == 0) {  // number of workers
+      int value = atoi(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -nworker : '%i'. -nworker must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.num_worker = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-nserver") == 0) {  // number of servers
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -nserver : '%i'. -nserver must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.num_server = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-staleness") == 0) {  // bounded staleness
+      int value = atoi(list[i+1].c_str());
+      if (value < -1) {
+        print_error(
+          StringPrintf("Illegal -staleness : '%i'. -staleness must be greater than or equal to -1.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.staleness = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-batch") == 0) {  // mini-batch size
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -batch : '%i'. -batch must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.batch_size = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-stream_batch") == 0) {  // stream mini-batch
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -stream_batch : '%i'. -stream_batch must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.stream_batch = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-stream_window") == 0) {  // evaluated rows
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -stream_window : '%i'. -stream_window must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.stream_window = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-nfield") == 0) {  // number of fields
+      int value = atoi(list[i+1].c_str());
+      if (value <= 0) {
+        print_error(
+          StringPrintf("Illegal -nfield : '%i'. -nfield must be greater than zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.num_field = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-ckpt") == 0) {  // checkpoint file
+      hyper_param.checkpoint_file = list[i+1];
+      i += 2;
+    } else if (list[i].compare("-profile") == 0) {  // profile file
+      hyper_param.profile_file = list[i+1];
+      i += 2;
+    } else if (list[i].compare("-ckpt_rows") == 0) {  // checkpoint interval
+      int value = atoi(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -ckpt_rows : '%i'. -ckpt_rows must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.checkpoint_rows = value;
+      }
+      i += 2;
+    } else if (list[i].compare("-ckpt_sec") == 0) {  // checkpoint interval
+      int value = atoi(list[i+1].c_str());
+      if (value < 0) {
+        print_error(
+          StringPrintf("Illegal -ckpt_sec : '%i'. -ckpt_sec must be greater than or equal to zero.",
+               value)
+        );
+        bo = false;
+      } else {
+        hyper_param.checkpoint_sec = value;
+      }
+      i += 2;
+    } else if (list[i].compare("--stream") == 0) {  // stream training
+      hyper_param.stream = true;
+      i += 1;
     } else if (list[i].compare("--disk") == 0) {  // on-disk training
       hyper_param.on_disk = true;
       i += 1;
@@ -469,6 +789,18 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
     } else if (list[i].compare("--dis-lock-free") == 0) {  // lock-free training
       hyper_param.lock_free = false;
       i += 1;
+    } else if (list[i].compare("--sparse-feat") == 0) {  // compact feature ids
+      hyper_param.sparse_feature = true;
+      i += 1;
+    } else if (list[i].compare("--exact-auc") == 0) {  // exact AUC
+      hyper_param.exact_auc = true;
+      i += 1;
+    } else if (list[i].compare("--numa") == 0) {  // NUMA-aware training
+      hyper_param.numa = true;
+      i += 1;
+    } else if (list[i].compare("--sync") == 0) {  // sync mini-batch training
+      hyper_param.sync = true;
+      i += 1;
     } else if (list[i].compare("--dis-es") == 0) {  // disable early-stop
       hyper_param.early_stop = false;
       i += 1;
@@ -478,6 +810,9 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
     } else if (list[i].compare("--quiet") == 0) {  // quiet
       hyper_param.quiet = true;
       i += 1;
+    } else if (list[i].compare("--verify-bin") == 0) {  // hash whole file
+      hyper_param.verify_binary = true;
+      i += 1;
     } else if (list[i].compare("-alpha") == 0) {  // alpha
       real_t value = atof(list[i+1].c_str());
       if (value <= 0) {
@@ -543,6 +878,7 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
     }
   }
   if (!bo) { return false; }
+  if (!check_stream(hyper_param)) { return false; }
   /*********************************************************
    *  Check warning and fix conflict                       *
    *********************************************************/
@@ -550,12 +886,7 @@ bool Checker::check_train_options(HyperParam& hyper_param) {
   /*********************************************************
    *  Set default value                                    *
    *********************************************************/
-  if (hyper_param.model_file.empty() && !hyper_param.cross_validation) {
-    hyper_param.model_file = hyper_param.train_set_file + ".model";
-  }
-  if (hyper_param.metric.compare("rmse") == 0) {
-    hyper_param.metric = "rmsd";
-  }
+  set_default_train(hyper_param);
 
   return true;
 }
@@ -566,7 +897,8 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
   /*********************************************************
    *  Check file path                                      *
    *********************************************************/
-  if (!FileExist(hyper_param.train_set_file.c_str())) {
+  if (hyper_param.train_set_file.compare("-") != 0 &&
+      !FileExist(hyper_param.train_set_file.c_str())) {
     print_error(
       StringPrintf("Training data file: %s does not exist.", 
                     hyper_param.train_set_file.c_str())
@@ -584,6 +916,15 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
   /*********************************************************
    *  Check invalid value                                  *
    *********************************************************/
+  // The c_api does not go through the -hash check above
+  if (hyper_param.hash_bits < 0 || hyper_param.hash_bits > 31) {
+    print_error(
+      StringPrintf("Illegal hash_bits: %d. hash_bits must be in the "
+                   "range of [1, 31], or 0 for no hashing.",
+        hyper_param.hash_bits)
+    );
+    bo = false;
+  }
   if (hyper_param.thread_number < 0) {
     print_error(
       StringPrintf("The thread number must be greater than zero: %d.",
@@ -597,16 +938,8 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
     );
     bo = false;
   }
-  if (hyper_param.metric.compare("acc") != 0 &&
-      hyper_param.metric.compare("prec") != 0 &&
-      hyper_param.metric.compare("recall") != 0 &&
-      hyper_param.metric.compare("f1") != 0 &&
-      hyper_param.metric.compare("auc") != 0 &&
-      hyper_param.metric.compare("mae") != 0 &&
-      hyper_param.metric.compare("mape") != 0 &&
-      hyper_param.metric.compare("rmsd") != 0 &&
-      hyper_param.metric.compare("rmse") != 0 &&
-      hyper_param.metric.compare("none") != 0) {
+  std::vector<std::string> metric_list;
+  if (!SplitMetricList(hyper_param.metric, &metric_list)) {
     print_error(
       StringPrintf("Unknow evaluation metric: %s.",
         hyper_param.metric.c_str())
@@ -622,6 +955,34 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
     );
     bo = false;
   }
+  if (hyper_param.quantize.compare("none") != 0 &&
+      hyper_param.quantize.compare("fp16") != 0 &&
+      hyper_param.quantize.compare("int8") != 0) {
+    print_error(
+      StringPrintf("Unknow quantization type: %s.",
+        hyper_param.quantize.c_str())
+    );
+    bo = false;
+  }
+  if (hyper_param.shuffle_mode.compare("random") != 0 &&
+      hyper_param.shuffle_mode.compare("block") != 0 &&
+      hyper_param.shuffle_mode.compare("permute") != 0) {
+    print_error(
+      StringPrintf("Unknow shuffle mode: %s.",
+        hyper_param.shuffle_mode.c_str())
+    );
+    bo = false;
+  }
+  if (hyper_param.prune_threshold >= 0 &&
+      hyper_param.score_func.compare("ffm") != 0) {
+    print_error("Only the ffm model can be pruned.");
+    bo = false;
+  }
+  if (hyper_param.prune_threshold >= 0 &&
+      hyper_param.quantize.compare("none") != 0) {
+    print_error("A model cannot be pruned and quantized at the same time.");
+    bo = false;
+  }
   if (hyper_param.num_K > 999999) {
     print_error(
       StringPrintf("Invalid size of K: %d. "
@@ -647,6 +1008,7 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
     bo = false;
   }
   if (!bo) return false;
+  if (!check_stream(hyper_param)) { return false; }
   /*********************************************************
    *  Check warning and fix conflict                       *
    *********************************************************/
@@ -654,23 +1016,109 @@ bool Checker::check_train_param(HyperParam& hyper_param) {
   /*********************************************************
    *  Set default value                                    *
    *********************************************************/
-  if (hyper_param.model_file.empty() && !hyper_param.cross_validation) {
-    hyper_param.model_file = hyper_param.train_set_file + ".model";
+  set_default_train(hyper_param);
+
+  return true;
+}
+
+// The model of stream training is created before reading
+// any data, so its size must be given by the user.
+bool Checker::check_stream(HyperParam& hyper_param) {
+  if (!hyper_param.stream) {
+    if (hyper_param.train_set_file.compare("-") == 0) {
+      print_error("The stdin (-) can only be used by the "
+                  "stream training (--stream).");
+      return false;
+    }
+    return true;
   }
-  if (hyper_param.metric.compare("rmse") == 0) {
-    hyper_param.metric = "rmsd";
+  bool bo = true;
+  if (hyper_param.hash_bits == 0) {
+    print_error("The stream training (--stream) needs the feature "
+                "hashing (-hash) to fix the number of features.");
+    bo = false;
+  }
+  if (hyper_param.score_func.compare("ffm") == 0 &&
+      hyper_param.num_field == 0) {
+    print_error("The ffm stream training (--stream) needs the "
+                "number of fields (-nfield).");
+    bo = false;
   }
+  return bo;
+}
 
-  return true;
+// Set the default model file and checkpoint file
+void Checker::set_default_train(HyperParam& hyper_param) {
+  if (hyper_param.model_file.empty() && !hyper_param.cross_validation) {
+    if (hyper_param.train_set_file.compare("-") == 0) {
+      hyper_param.model_file = "stdin.model";
+    } else {
+      hyper_param.model_file = hyper_param.train_set_file + ".model";
+    }
+  }
+  if (hyper_param.stream && hyper_param.checkpoint_file.empty() &&
+      hyper_param.model_file.compare("none") != 0) {
+    hyper_param.checkpoint_file = hyper_param.model_file + ".ckpt";
+  }
 }
 
 // Check warning and fix conflict
 void Checker::check_conflict_train(HyperParam& hyper_param) {
+  if (hyper_param.stream) {
+    if (hyper_param.on_disk) {
+      print_warning("Stream training doesn't need on-disk training. "
+                    "xLearn has already disable the --disk option.");
+      hyper_param.on_disk = false;
+    }
+    if (hyper_param.cross_validation) {
+      print_warning("Stream training doesn't support cross-validation. "
+                    "xLearn has already disable the -cv option.");
+      hyper_param.cross_validation = false;
+    }
+    if (hyper_param.num_worker > 1) {
+      print_warning("Stream training doesn't support distributed training. "
+                    "xLearn has already disable the -nworker option.");
+      hyper_param.num_worker = 0;
+    }
+    if (hyper_param.sparse_feature) {
+      print_warning("Stream training doesn't support --sparse-feat. "
+                    "xLearn has already disable this option.");
+      hyper_param.sparse_feature = false;
+    }
+    if (!hyper_param.validate_set_file.empty()) {
+      print_warning(
+        StringPrintf("Stream training evaluates each row before training "
+                     "it, and xLearn will ignore the validation file: %s",
+                     hyper_param.validate_set_file.c_str())
+      );
+      hyper_param.validate_set_file.clear();
+    }
+    // There is no validation set
+    hyper_param.early_stop = false;
+  }
   if (hyper_param.on_disk && hyper_param.cross_validation) {
     print_warning("On-disk training doesn't support cross-validation. "
                   "xLearn has already disable the -cv option.");
     hyper_param.cross_validation = false;
   }
+  if (hyper_param.num_worker > 1 && hyper_param.cross_validation) {
+    print_warning("Distributed training doesn't support cross-validation. "
+                  "xLearn has already disable the -cv option.");
+    hyper_param.cross_validation = false;
+  }
+  if (hyper_param.num_worker > 1 && hyper_param.early_stop) {
+    print_warning("Distributed training doesn't support early-stopping. "
+                  "xLearn has already close early-stopping.");
+    hyper_param.early_stop = false;
+  }
+  if (hyper_param.sync && hyper_param.numa) {
+    print_warning("The sync training doesn't support NUMA-aware training. "
+                  "xLearn has already disable the --numa option.");
+    hyper_param.numa = false;
+  }
+  if (hyper_param.num_worker > 1 && hyper_param.num_server == 0) {
+    hyper_param.num_server = 1;
+  }
   if (hyper_param.cross_validation && hyper_param.early_stop) {
     print_warning("Cross-validation doesn't support early-stopping. "
                   "xLearn has already close early-stopping.");
@@ -701,7 +1149,8 @@ void Checker::check_conflict_train(HyperParam& hyper_param) {
   }
   if (hyper_param.metric.compare("none") != 0 &&
       hyper_param.validate_set_file.empty() &&
-      !hyper_param.cross_validation) {
+      !hyper_param.cross_validation &&
+      !hyper_param.stream) {
     print_warning(
       StringPrintf("Validation file not found, xLearn has already "
                    "disable (-x %s) option.", 
@@ -709,32 +1158,34 @@ void Checker::check_conflict_train(HyperParam& hyper_param) {
     );
     hyper_param.metric = "none";
   }
-  if (hyper_param.loss_func.compare("squared") == 0) {
-    if (hyper_param.metric.compare("acc") == 0 ||
-        hyper_param.metric.compare("prec") == 0 ||
-        hyper_param.metric.compare("recall") == 0 ||
-        hyper_param.metric.compare("f1") == 0) {
-      print_warning(
-        StringPrintf("The -x: %s metric can only be used "
-                     "in classification tasks. xLearn will "
-                     "ignore this option.",
-                     hyper_param.metric.c_str())
-      );
-      hyper_param.metric = "none";
-    }
-  } else if (hyper_param.loss_func.compare("cross-entropy") == 0) {
-    if (hyper_param.metric.compare("mae") == 0 ||
-        hyper_param.metric.compare("mape") == 0 ||
-        hyper_param.metric.compare("rmsd") == 0 ||
-        hyper_param.metric.compare("rmse") == 0) {
-      print_warning(
-        StringPrintf("The -x: %s metric can only be used "
-                     "in regression tasks. xLearn will ignore "
-                     "this option.",
-                     hyper_param.metric.c_str())
-      );
-      hyper_param.metric = "none";
+  // Remove the metrics that do not match the task
+  std::vector<std::string> metric_list;
+  if (hyper_param.metric.compare("none") != 0 &&
+      SplitMetricList(hyper_param.metric, &metric_list)) {
+    std::vector<std::string> valid_list;
+    for (size_t i = 0; i < metric_list.size(); ++i) {
+      const std::string& name = metric_list[i];
+      if (hyper_param.loss_func.compare("squared") == 0 &&
+          IsClassificationMetric(name)) {
+        print_warning(
+          StringPrintf("The -x: %s metric can only be used "
+                       "in classification tasks. xLearn will "
+                       "ignore this option.",
+                       name.c_str())
+        );
+      } else if (hyper_param.loss_func.compare("cross-entropy") == 0 &&
+                 IsRegressionMetric(name)) {
+        print_warning(
+          StringPrintf("The -x: %s metric can only be used "
+                       "in regression tasks. xLearn will ignore "
+                       "this option.",
+                       name.c_str())
+        );
+      } else {
+        valid_list.push_back(name);
+      }
     }
+    hyper_param.metric = JoinMetricList(valid_list);
   }
 }
 
@@ -802,6 +1253,9 @@ bool Checker::check_prediction_options(HyperParam& hyper_param) {
     } else if (list[i].compare("--sigmoid") == 0) {  // using sigmoid
       hyper_param.sigmoid = true;
       i += 1;
+    } else if (list[i].compare("--verify-bin") == 0) {  // hash whole file
+      hyper_param.verify_binary = true;
+      i += 1;
     } else {  // no match
       std::string similar_str;
       ss.FindSimilar(list[i], menu_, similar_str);
@@ -66,6 +66,8 @@ class Checker {
   bool check_train_param(HyperParam& hyper_param);
   bool check_prediction_options(HyperParam& hyper_param);
   bool check_prediction_param(HyperParam& hyper_param);
+  bool check_stream(HyperParam& hyper_param);
+  void set_default_train(HyperParam& hyper_param);
   void check_conflict_train(HyperParam& hyper_param);
   void check_conflict_predict(HyperParam& hyper_param);
   
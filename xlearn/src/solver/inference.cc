@@ -15,23 +15,33 @@
 //------------------------------------------------------------------------------
 
 /*
-This file is the implementation of the Predictor class.
+This file is the implementation of the Predictor
+and MemoryPredictor classes.
 */
 
 #include "src/solver/inference.h"
 #include "src/base/timer.h"
 #include "src/base/format_print.h"
+#include "src/base/file_util.h"
+#include "src/base/murmur_hash.h"
+#include "src/base/scratch_arena.h"
+
+#include <stdio.h>
+#include <math.h>
 
 #include <vector>
 #include <sstream>
+#include <thread>
 
 namespace xLearn {
 
 // Given a pre-trained model and test data, the predictor
 // will return the prediction output
 void Predictor::Predict() {
-  std::ofstream o_file(out_file_);
+  FILE* o_file = OpenFileOrDie(out_file_.c_str(), "w");
   static std::vector<real_t> out;
+  std::string buffer;
+  char str[32];
   DMatrix* matrix = nullptr;
   reader_->Reset();
   loss_->Reset();
@@ -48,10 +58,15 @@ void Predictor::Predict() {
     } else if (sign_) {
       this->sign(out, out);
     }
+    // Write the output of a batch at once
+    buffer.clear();
     for (index_t i = 0; i < out.size(); ++i) {
-      o_file << out[i] << "\n";
+      int len = snprintf(str, sizeof(str), "%g\n", out[i]);
+      buffer.append(str, len);
     }
+    WriteDataToDisk(o_file, buffer.data(), buffer.size());
   }
+  Close(o_file);
   if (reader_->has_label()) {
     print_info(
       StringPrintf("The test loss is: %.6f", 
@@ -78,4 +93,124 @@ void Predictor::sign(std::vector<real_t>& in,
   }
 }
 
+/* Minimal number of rows of each task of the in-memory prediction */
+static const size_t kPredictGrain = 256;
+
+MemoryPredictor::~MemoryPredictor() {
+  delete pool_;
+  delete score_;
+  delete model_;
+}
+
+void MemoryPredictor::Initialize(const std::string& model_file,
+                                 size_t thread_number,
+                                 bool norm) {
+  CHECK(model_ == nullptr);
+  CHECK_NE(model_file.empty(), true);
+  model_ = new Model(model_file);
+  score_ = CREATE_SCORE(model_->GetScoreFunction().c_str());
+  if (score_ == nullptr) {
+    LOG(FATAL) << "Cannot create score: "
+               << model_->GetScoreFunction();
+  }
+  if (thread_number == 0) {
+    thread_number = std::thread::hardware_concurrency();
+  }
+  pool_ = new ThreadPool(thread_number);
+  norm_ = norm;
+  num_feat_ = model_->GetNumFeature();
+  num_field_ = model_->GetNumField();
+  is_ffm_ = model_->GetScoreFunction().compare("ffm") == 0;
+  int hash_bits = model_->GetHashBits();
+  hash_feature_ = hash_bits > 0 || model_->GetFeatureMap() != nullptr;
+  hash_mask_ = hash_bits == 0 ? ~(uint64)0 :
+               ((uint64)1 << hash_bits) - 1;
+}
+
+// The ids of a hashed model come from the text of the feature
+// ids, so the id is hashed in the same way as the Parser.
+bool MemoryPredictor::map_feature(index_t id, index_t* feat) {
+  if (hash_feature_) {
+    char str[16];
+    int len = snprintf(str, sizeof(str), "%u", id);
+    uint64 key = MurmurHash64(str, len) & hash_mask_;
+    FeatureMap* map = model_->GetFeatureMap();
+    if (map != nullptr) {
+      index_t value = map->Find(key);
+      if (value == FeatureMap::kNotFound) { return false; }
+      id = value;
+    } else {
+      id = (index_t)key;
+    }
+  }
+  *feat = id;
+  return id < num_feat_;
+}
+
+void MemoryPredictor::predict_rows(size_t start, size_t end,
+                                   const uint64* indptr,
+                                   const index_t* indices,
+                                   const index_t* fields,
+                                   const real_t* values,
+                                   real_t* out,
+                                   bool sign,
+                                   bool sigmoid) {
+  ScratchArena<Node>* arena = ScratchArena<Node>::ThreadLocal();
+  for (size_t i = start; i < end; ++i) {
+    uint64 begin = indptr[i];
+    uint64 stop = indptr[i+1];
+    CHECK_LE(begin, stop);
+    Node* node = arena->Get(stop - begin);
+    size_t size = 0;
+    real_t sum = 0;
+    for (uint64 j = begin; j < stop; ++j) {
+      real_t value = values == nullptr ? 1.0 : values[j];
+      sum += value * value;
+      index_t feat;
+      if (!map_feature(indices[j], &feat)) { continue; }
+      // Only ffm uses the fields
+      index_t field = 0;
+      if (is_ffm_) {
+        field = fields[j];
+        if (field >= num_field_) { continue; }
+      }
+      node[size++] = Node(field, feat, value);
+    }
+    SparseRow row(node, size);
+    real_t norm = norm_ && sum > 0 ? 1.0f / sum : 1.0;
+    real_t score = score_->CalcScore(&row, *model_, norm);
+    if (sigmoid) {
+      score = 1.0 / (1.0 + exp(-score));
+    } else if (sign) {
+      score = score > 0 ? 1 : 0;
+    }
+    out[i] = score;
+  }
+}
+
+void MemoryPredictor::Predict(size_t num_row,
+                              const uint64* indptr,
+                              const index_t* indices,
+                              const index_t* fields,
+                              const real_t* values,
+                              real_t* out,
+                              bool sign,
+                              bool sigmoid) {
+  CHECK_NOTNULL(model_);
+  if (num_row == 0) { return; }
+  CHECK_NOTNULL(indptr);
+  CHECK_NOTNULL(out);
+  if (indptr[num_row] > indptr[0]) {
+    CHECK_NOTNULL(indices);
+  }
+  if (is_ffm_) {
+    CHECK_NOTNULL(fields);
+  }
+  pool_->ParallelFor(0, num_row, kPredictGrain,
+    [&](size_t start, size_t end) {
+      predict_rows(start, end, indptr, indices, fields,
+                   values, out, sign, sigmoid);
+  });
+}
+
 }  // namespace xLearn
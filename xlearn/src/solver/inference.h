@@ -24,10 +24,12 @@ This file defines the Predictor class.
 #include <string>
 
 #include "src/base/common.h"
+#include "src/base/thread_pool.h"
 #include "src/data/data_structure.h"
 #include "src/data/model_parameters.h"
 #include "src/reader/reader.h"
 #include "src/loss/loss.h"
+#include "src/score/score_function.h"
 
 namespace xLearn {
 
@@ -83,6 +85,82 @@ class Predictor {
   DISALLOW_COPY_AND_ASSIGN(Predictor);
 };  // class Predictor
 
+//------------------------------------------------------------------------------
+// MemoryPredictor loads a model once, and then predicts the rows
+// given by the CSR arrays of the caller, without any data file.
+// The rows are scored in the threads of its own pool, and the
+// output is written into the buffer of the caller:
+//
+//   MemoryPredictor predictor;
+//   predictor.Initialize("./model.out", 4);
+//
+//   /* Row i has the nodes indptr[i], ..., indptr[i+1]-1. The
+//   fields can be nullptr for linear and fm, and the values can
+//   be nullptr if all of them are 1.0 */
+//   predictor.Predict(num_row, indptr, indices, fields,
+//                     values, out, sign, sigmoid);
+//
+// The features that are unknown to the model are skipped, but they
+// are counted in the instance-wise normalization like the Reader.
+// Different threads can call Predict() at the same time.
+//------------------------------------------------------------------------------
+class MemoryPredictor {
+ public:
+  // Constructor and Destructor
+  MemoryPredictor()
+    : model_(nullptr), score_(nullptr), pool_(nullptr), norm_(true) { }
+  ~MemoryPredictor();
+
+  // Load the model, and create thread_number threads
+  // (0 for the number of CPUs).
+  void Initialize(const std::string& model_file,
+                  size_t thread_number = 0,
+                  bool norm = true);
+
+  // Predict num_row rows, and write the results to out[0,num_row).
+  void Predict(size_t num_row,
+               const uint64* indptr,
+               const index_t* indices,
+               const index_t* fields,
+               const real_t* values,
+               real_t* out,
+               bool sign = false,
+               bool sigmoid = false);
+
+  // The loaded model
+  Model* GetModel() { return model_; }
+
+ protected:
+  Model* model_;
+  Score* score_;
+  ThreadPool* pool_;
+  bool norm_;
+  /* Number of features and fields of the model */
+  index_t num_feat_;
+  index_t num_field_;
+  bool is_ffm_;
+  /* The ids of the model are hashed from the feature ids ? */
+  bool hash_feature_;
+  uint64 hash_mask_;
+
+  // Get the feature id of the model for the given id.
+  // Return false if the model doesn't have this feature.
+  bool map_feature(index_t id, index_t* feat);
+
+  // Predict the rows [start, end)
+  void predict_rows(size_t start, size_t end,
+                    const uint64* indptr,
+                    const index_t* indices,
+                    const index_t* fields,
+                    const real_t* values,
+                    real_t* out,
+                    bool sign,
+                    bool sigmoid);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MemoryPredictor);
+};
+
 }  // namespace xLearn
 
 #endif // XLEARN_SOLVER_INFERENCE_H_
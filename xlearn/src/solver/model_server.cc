@@ -0,0 +1,422 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of the ModelServer class.
+*/
+
+#include "src/solver/model_server.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+
+#include "src/base/stringprintf.h"
+#include "src/data/model_parameters.h"
+
+namespace xLearn {
+
+/* Number of the recent requests used for the latency */
+static const size_t kLatencyWindow = 65536;
+
+//------------------------------------------------------------------------------
+// ServeStats
+//------------------------------------------------------------------------------
+
+ServeStats::ServeStats()
+  : start_(ServeClock::now()), requests_(0), batches_(0), next_(0) { }
+
+void ServeStats::AddBatch(const std::vector<uint64>& latency) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  batches_++;
+  for (size_t i = 0; i < latency.size(); ++i) {
+    if (latency_.size() < kLatencyWindow) {
+      latency_.push_back(latency[i]);
+    } else {
+      latency_[next_] = latency[i];
+      next_ = (next_ + 1) % kLatencyWindow;
+    }
+  }
+  requests_ += latency.size();
+}
+
+uint64 ServeStats::Requests() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requests_;
+}
+
+std::string ServeStats::Report() {
+  std::vector<uint64> sorted;
+  uint64 requests, batches;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sorted = latency_;
+    requests = requests_;
+    batches = batches_;
+  }
+  uint64 p50 = 0, p99 = 0;
+  if (!sorted.empty()) {
+    std::sort(sorted.begin(), sorted.end());
+    p50 = sorted[(sorted.size() - 1) * 50 / 100];
+    p99 = sorted[(sorted.size() - 1) * 99 / 100];
+  }
+  double sec = std::chrono::duration<double>(
+      ServeClock::now() - start_).count();
+  return StringPrintf("requests=%llu batches=%llu p50_us=%llu "
+                      "p99_us=%llu qps=%.1f",
+                      (unsigned long long)requests,
+                      (unsigned long long)batches,
+                      (unsigned long long)p50,
+                      (unsigned long long)p99,
+                      sec > 0 ? requests / sec : 0.0);
+}
+
+//------------------------------------------------------------------------------
+// ModelServer
+//------------------------------------------------------------------------------
+
+ModelServer::ModelServer()
+  : thread_number_(0), norm_(true), sign_(false), sigmoid_(false),
+    max_batch_(1), wait_(0), stop_(false), quit_(false),
+    listen_fd_(-1) { }
+
+ModelServer::~ModelServer() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    quit_ = true;
+    queue_cv_.notify_one();
+  }
+  if (batcher_.joinable()) {
+    batcher_.join();
+  }
+}
+
+void ModelServer::Initialize(const std::string& model_file,
+                             size_t thread_number,
+                             bool norm,
+                             size_t max_batch,
+                             int wait_us,
+                             bool sign,
+                             bool sigmoid) {
+  CHECK(predictor_ == nullptr);
+  CHECK_GT(max_batch, 0);
+  CHECK_GE(wait_us, 0);
+  thread_number_ = thread_number;
+  norm_ = norm;
+  sign_ = sign;
+  sigmoid_ = sigmoid;
+  max_batch_ = max_batch;
+  wait_ = std::chrono::microseconds(wait_us);
+  std::string error;
+  if (!Reload(model_file, &error)) {
+    LOG(FATAL) << error;
+  }
+  batcher_ = std::thread(&ModelServer::batcher, this);
+}
+
+std::shared_ptr<MemoryPredictor> ModelServer::load(
+    const std::string& model_file) {
+  std::shared_ptr<MemoryPredictor> predictor(new MemoryPredictor);
+  predictor->Initialize(model_file, thread_number_, norm_);
+  return predictor;
+}
+
+// The new model is loaded before the swap, so the requests
+// are scored by either the old model or the new model. The file
+// is checked first, because loading a broken file is fatal.
+bool ModelServer::Reload(const std::string& model_file,
+                         std::string* error) {
+  CHECK_NOTNULL(error);
+  if (model_file.empty()) {
+    *error = "The model file is not given";
+    return false;
+  }
+  if (!Model::CheckFile(model_file, error)) {
+    return false;
+  }
+  std::shared_ptr<MemoryPredictor> predictor = load(model_file);
+  std::atomic_store(&predictor_, predictor);
+  LOG(INFO) << "Load model: " << model_file;
+  return true;
+}
+
+// A node is "field:feat:value" or "feat:value". The first token
+// is the label if it has no ':', and the label is ignored.
+ModelServer::RequestPtr ModelServer::parse(const std::string& line) {
+  RequestPtr request(new Request);
+  request->arrive = ServeClock::now();
+  const char* p = line.c_str();
+  while (*p == ' ' || *p == '\t') { ++p; }
+  if (*p == '#') {
+    request->is_command = true;
+    request->response = std::string(p + 1);
+    return request;
+  }
+  while (*p != '\0') {
+    const char* end = p;
+    while (*end != '\0' && *end != ' ' && *end != '\t') { ++end; }
+    const char* colon1 = (const char*)memchr(p, ':', end - p);
+    if (colon1 != nullptr) {
+      const char* colon2 = (const char*)memchr(colon1 + 1, ':',
+                                               end - colon1 - 1);
+      if (colon2 != nullptr) {
+        request->fields.push_back(strtoul(p, nullptr, 10));
+        request->indices.push_back(strtoul(colon1 + 1, nullptr, 10));
+        request->values.push_back(strtof(colon2 + 1, nullptr));
+      } else {
+        request->fields.push_back(0);
+        request->indices.push_back(strtoul(p, nullptr, 10));
+        request->values.push_back(strtof(colon1 + 1, nullptr));
+      }
+    }
+    p = end;
+    while (*p == ' ' || *p == '\t') { ++p; }
+  }
+  return request;
+}
+
+// The command is kept in response until it is done.
+std::string ModelServer::command(const std::string& cmd) {
+  if (cmd.compare(0, 6, "reload") == 0) {
+    size_t pos = cmd.find_first_not_of(" \t", 6);
+    std::string file = pos == std::string::npos ? "" : cmd.substr(pos);
+    std::string error;
+    return Reload(file, &error) ? "OK" : "ERROR " + error;
+  } else if (cmd.compare(0, 5, "stats") == 0) {
+    return stats_.Report();
+  }
+  return "ERROR Unknown command: " + cmd;
+}
+
+// A request without any node is answered in wait()
+void ModelServer::submit(const RequestPtr& request) {
+  if (request->is_command || request->indices.empty()) { return; }
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_.push_back(request);
+  queue_cv_.notify_one();
+}
+
+// The responses of a client are waited in order, so a command is
+// done after the previous requests of the client are answered.
+std::string ModelServer::wait(const RequestPtr& request) {
+  if (request->is_command) { return command(request->response); }
+  if (request->indices.empty()) { return "ERROR Empty request"; }
+  if (!request->done) {
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    done_cv_.wait(lock, [&request]() { return request->done.load(); });
+  }
+  return StringPrintf("%g", request->score);
+}
+
+std::string ModelServer::Handle(const std::string& line) {
+  RequestPtr request = parse(line);
+  submit(request);
+  return wait(request);
+}
+
+// The caller thread reads and submits the requests, and another
+// thread writes the responses, so the requests of one client
+// can be scored in the same micro-batch.
+void ModelServer::ServeStream(FILE* in, FILE* out) {
+  CHECK_NOTNULL(in);
+  CHECK_NOTNULL(out);
+  std::deque<RequestPtr> pending;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool eof = false;
+  std::thread writer([&]() {
+    for (;;) {
+      RequestPtr request;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return eof || !pending.empty(); });
+        if (pending.empty()) { break; }
+        request = pending.front();
+        pending.pop_front();
+      }
+      std::string response = wait(request);
+      fprintf(out, "%s\n", response.c_str());
+      bool idle = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle = pending.empty();
+      }
+      if (idle) { fflush(out); }
+    }
+    fflush(out);
+  });
+  char* buf = nullptr;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&buf, &cap, in)) != -1) {
+    while (len > 0 && (buf[len-1] == '\n' || buf[len-1] == '\r')) {
+      buf[--len] = '\0';
+    }
+    if (len == 0) { continue; }
+    RequestPtr request = parse(std::string(buf, len));
+    submit(request);
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(request);
+    cv.notify_one();
+  }
+  free(buf);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    eof = true;
+    cv.notify_one();
+  }
+  writer.join();
+}
+
+void ModelServer::ServeSocket(const std::string& path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  CHECK_LT(path.size(), sizeof(addr.sun_path));
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd_, 0);
+  if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd_, 128) != 0) {
+    LOG(FATAL) << "Cannot listen on the socket: " << path
+               << " (" << strerror(errno) << ")";
+  }
+  // The thread of each connection, and whether it has finished
+  std::vector<std::thread> threads;
+  std::vector<std::shared_ptr<std::atomic<bool>>> finished;
+  // Check the stop signal every 100 ms
+  while (!stop_) {
+    // Join the threads of the closed connections
+    for (size_t i = 0; i < threads.size(); ) {
+      if (*finished[i]) {
+        threads[i].join();
+        threads[i] = std::move(threads.back());
+        threads.pop_back();
+        finished[i] = finished.back();
+        finished.pop_back();
+      } else {
+        ++i;
+      }
+    }
+    struct pollfd pfd;
+    pfd.fd = listen_fd_;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 100) <= 0) { continue; }
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) { continue; }
+    {
+      std::lock_guard<std::mutex> lock(conn_mutex_);
+      conn_fd_.push_back(fd);
+    }
+    std::shared_ptr<std::atomic<bool>> done(new std::atomic<bool>(false));
+    finished.push_back(done);
+    threads.push_back(std::thread([this, fd, done]() {
+      FILE* in = fdopen(fd, "r");
+      FILE* out = fdopen(dup(fd), "w");
+      ServeStream(in, out);
+      fclose(out);
+      {
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        conn_fd_.erase(std::find(conn_fd_.begin(), conn_fd_.end(), fd));
+        fclose(in);
+      }
+      *done = true;
+    }));
+  }
+  close(listen_fd_);
+  listen_fd_ = -1;
+  unlink(path.c_str());
+  // Wake up the connections that are waiting for requests
+  {
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    for (size_t i = 0; i < conn_fd_.size(); ++i) {
+      shutdown(conn_fd_[i], SHUT_RD);
+    }
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+void ModelServer::batcher() {
+  std::vector<RequestPtr> batch;
+  for (;;) {
+    batch.clear();
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this]() {
+        return quit_ || !queue_.empty();
+      });
+      if (queue_.empty()) { break; }
+      // Wait for more requests until the oldest
+      // one reaches the latency budget.
+      ServeClock::time_point deadline = queue_.front()->arrive + wait_;
+      while (!quit_ && queue_.size() < max_batch_ &&
+             ServeClock::now() < deadline) {
+        queue_cv_.wait_until(lock, deadline);
+      }
+      size_t num = std::min(max_batch_, queue_.size());
+      batch.assign(queue_.begin(), queue_.begin() + num);
+      queue_.erase(queue_.begin(), queue_.begin() + num);
+    }
+    score(batch);
+  }
+}
+
+void ModelServer::score(const std::vector<RequestPtr>& batch) {
+  std::shared_ptr<MemoryPredictor> predictor =
+      std::atomic_load(&predictor_);
+  indptr_.assign(1, 0);
+  indices_.clear();
+  fields_.clear();
+  values_.clear();
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const Request& r = *batch[i];
+    indices_.insert(indices_.end(), r.indices.begin(), r.indices.end());
+    fields_.insert(fields_.end(), r.fields.begin(), r.fields.end());
+    values_.insert(values_.end(), r.values.begin(), r.values.end());
+    indptr_.push_back(indices_.size());
+  }
+  out_.resize(batch.size());
+  predictor->Predict(batch.size(), indptr_.data(), indices_.data(),
+                     fields_.data(), values_.data(), out_.data(),
+                     sign_, sigmoid_);
+  ServeClock::time_point now = ServeClock::now();
+  latency_.resize(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    batch[i]->score = out_[i];
+    latency_[i] = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - batch[i]->arrive).count();
+  }
+  stats_.AddBatch(latency_);
+  {
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      batch[i]->done = true;
+    }
+  }
+  done_cv_.notify_all();
+}
+
+}  // namespace xLearn
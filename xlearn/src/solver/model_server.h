@@ -0,0 +1,225 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the ModelServer class, which keeps a model
+in memory and scores the requests in micro-batches.
+*/
+
+#ifndef XLEARN_SOLVER_MODEL_SERVER_H_
+#define XLEARN_SOLVER_MODEL_SERVER_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+#include "src/base/common.h"
+#include "src/data/data_structure.h"
+#include "src/solver/inference.h"
+
+namespace xLearn {
+
+typedef std::chrono::steady_clock ServeClock;
+
+//------------------------------------------------------------------------------
+// ServeStats counts the requests and keeps the latency of the
+// recent requests, which are used for the p50/p99 latency.
+//------------------------------------------------------------------------------
+class ServeStats {
+ public:
+  // Constructor and Destructor
+  ServeStats();
+  ~ServeStats() { }
+
+  // Add a micro-batch and the latency (in microseconds)
+  // of each of its requests.
+  void AddBatch(const std::vector<uint64>& latency);
+
+  // Return the report, such as:
+  // "requests=100 batches=4 p50_us=80 p99_us=210 qps=1520.3"
+  std::string Report();
+
+  // Number of requests
+  uint64 Requests();
+
+ protected:
+  std::mutex mutex_;
+  ServeClock::time_point start_;
+  uint64 requests_;
+  uint64 batches_;
+  /* Latency of the recent requests, as a ring buffer */
+  std::vector<uint64> latency_;
+  size_t next_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ServeStats);
+};
+
+//------------------------------------------------------------------------------
+// ModelServer loads a model once and serves the scoring requests of
+// a stream (stdin/stdout) or the connections of a Unix domain socket.
+// Each request is one line, and the response is one line in the same
+// order:
+//
+//   [label] feat:value feat:value ...          (linear and fm)
+//   [label] field:feat:value field:feat:value   (ffm)
+//     -> the score, or "ERROR Empty request" if it has no node
+//   #reload <model_file>   -> "OK", or "ERROR <message>"
+//   #stats                 -> the report of ServeStats
+//
+// The requests of all the clients are put into one queue. A batcher
+// thread takes them as a micro-batch, when there are max_batch
+// requests or the oldest one has waited for wait_us microseconds,
+// and scores the micro-batch by the MemoryPredictor in parallel.
+//
+// The model is hot-swappable: Reload() loads the new model and then
+// replaces the old one atomically. A micro-batch that has started
+// uses the old model until it finishes, and no request is dropped.
+//
+//   ModelServer server;
+//   server.Initialize("./model.out", 4, true, 256, 1000);
+//   server.ServeStream(stdin, stdout);  /* or ServeSocket(path) */
+//
+// The batcher thread scores all the requests in the queue, and then
+// exits in the destructor.
+//------------------------------------------------------------------------------
+class ModelServer {
+ public:
+  // Constructor and Destructor
+  ModelServer();
+  ~ModelServer();
+
+  // Load the model and start the batcher thread.
+  void Initialize(const std::string& model_file,
+                  size_t thread_number = 0,
+                  bool norm = true,
+                  size_t max_batch = 256,
+                  int wait_us = 1000,
+                  bool sign = false,
+                  bool sigmoid = false);
+
+  // Serve the requests of in and write the responses to out,
+  // until the end of in.
+  void ServeStream(FILE* in, FILE* out);
+
+  // Serve the connections of the socket until Stop().
+  void ServeSocket(const std::string& path);
+
+  // Handle one line and return the response. It is blocked until
+  // the request is scored, so it is mainly used for testing.
+  std::string Handle(const std::string& line);
+
+  // Replace the model by the given model file. Return false, set
+  // error and keep current model if the file cannot be loaded.
+  bool Reload(const std::string& model_file, std::string* error);
+
+  // Stop ServeSocket(). It only sets a flag, so it can be
+  // called in a signal handler.
+  void Stop() { stop_ = true; }
+
+  // The counters of requests
+  ServeStats* Stats() { return &stats_; }
+
+ protected:
+  // A request of a client
+  struct Request {
+    Request() : is_command(false), done(false), score(0) { }
+    /* Nodes of the row */
+    std::vector<index_t> indices;
+    std::vector<index_t> fields;
+    std::vector<real_t> values;
+    /* Text of a command, which is done without scoring */
+    std::string response;
+    bool is_command;
+    ServeClock::time_point arrive;
+    std::atomic<bool> done;
+    real_t score;
+  };
+  typedef std::shared_ptr<Request> RequestPtr;
+
+  /* Current model */
+  std::shared_ptr<MemoryPredictor> predictor_;
+  /* Arguments of the MemoryPredictor */
+  size_t thread_number_;
+  bool norm_;
+  bool sign_;
+  bool sigmoid_;
+  /* Size and waiting time of a micro-batch */
+  size_t max_batch_;
+  std::chrono::microseconds wait_;
+  /* The queue of requests */
+  std::deque<RequestPtr> queue_;
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  /* Signal of the scored requests */
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  std::thread batcher_;
+  /* Stop the socket ? */
+  std::atomic<bool> stop_;
+  /* Stop the batcher thread ? */
+  bool quit_;
+  /* The CSR arrays and the output of a micro-batch */
+  std::vector<uint64> indptr_;
+  std::vector<index_t> indices_;
+  std::vector<index_t> fields_;
+  std::vector<real_t> values_;
+  std::vector<real_t> out_;
+  std::vector<uint64> latency_;
+  /* The listening socket and the connections */
+  int listen_fd_;
+  std::vector<int> conn_fd_;
+  std::mutex conn_mutex_;
+  ServeStats stats_;
+
+  // Load a model
+  std::shared_ptr<MemoryPredictor> load(const std::string& model_file);
+
+  // Parse a line to a request
+  RequestPtr parse(const std::string& line);
+
+  // Do a command and return the response
+  std::string command(const std::string& cmd);
+
+  // Put the request into the queue if it is not a command
+  void submit(const RequestPtr& request);
+
+  // Wait until the request is done, and return the response.
+  // A command is done here.
+  std::string wait(const RequestPtr& request);
+
+  // Take and score the micro-batches
+  void batcher();
+
+  // Score a micro-batch
+  void score(const std::vector<RequestPtr>& batch);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ModelServer);
+};
+
+}  // namespace xLearn
+
+#endif  // XLEARN_SOLVER_MODEL_SERVER_H_
@@ -0,0 +1,182 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the ModelServer class.
+*/
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "src/base/stringprintf.h"
+#include "src/data/model_parameters.h"
+#include "src/solver/inference.h"
+#include "src/solver/model_server.h"
+
+namespace xLearn {
+
+const index_t kNumFeat = 20;
+const int kNumLine = 50;
+
+std::string save_model(const std::string& name, real_t scale) {
+  Model model;
+  model.Initialize("fm", "cross-entropy", kNumFeat, 0, 4, 1, scale);
+  std::string filename = "./model_server_test." + name;
+  model.Serialize(filename);
+  return filename;
+}
+
+std::string make_line(int i) {
+  return StringPrintf("1 %d:0.5 %d:1.0 %d:2.0",
+                      i % kNumFeat, (i * 7) % kNumFeat, (i * 13) % kNumFeat);
+}
+
+// The score of the MemoryPredictor
+std::string expected(MemoryPredictor& predictor, int i) {
+  uint64 indptr[2] = { 0, 3 };
+  index_t indices[3] = { (index_t)(i % kNumFeat),
+                         (index_t)((i * 7) % kNumFeat),
+                         (index_t)((i * 13) % kNumFeat) };
+  real_t values[3] = { 0.5, 1.0, 2.0 };
+  real_t out;
+  predictor.Predict(1, indptr, indices, nullptr, values, &out);
+  return StringPrintf("%g", out);
+}
+
+TEST(ModelServerTest, Handle) {
+  std::string file = save_model("a", 0.66);
+  MemoryPredictor predictor;
+  predictor.Initialize(file, 1);
+  ModelServer server;
+  server.Initialize(file, 2, true, 8, 2000);
+  // The requests of 4 clients are put into the same micro-batches
+  std::vector<std::thread> threads;
+  std::vector<std::string> result(kNumLine);
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (int i = t; i < kNumLine; i += 4) {
+        result[i] = server.Handle(make_line(i));
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  for (int i = 0; i < kNumLine; ++i) {
+    EXPECT_EQ(result[i], expected(predictor, i));
+  }
+  EXPECT_EQ(server.Stats()->Requests(), kNumLine);
+  std::string stats = server.Handle("#stats");
+  EXPECT_EQ(stats.find("requests=50 "), 0);
+  EXPECT_NE(stats.find("p99_us="), std::string::npos);
+  EXPECT_EQ(server.Handle("#unknown").find("ERROR"), 0);
+  remove(file.c_str());
+}
+
+// The model is replaced while the requests are served,
+// and every request is scored by one of the models.
+TEST(ModelServerTest, Reload) {
+  std::string file_a = save_model("a", 0.66);
+  std::string file_b = save_model("b", 2.0);
+  MemoryPredictor predictor_a, predictor_b;
+  predictor_a.Initialize(file_a, 1);
+  predictor_b.Initialize(file_b, 1);
+  ModelServer server;
+  server.Initialize(file_a, 2, true, 4, 500);
+  std::vector<std::string> result(kNumLine * 10);
+  std::thread client([&]() {
+    for (size_t i = 0; i < result.size(); ++i) {
+      result[i] = server.Handle(make_line(i));
+    }
+  });
+  EXPECT_EQ(server.Handle("#reload " + file_b), "OK");
+  client.join();
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_TRUE(result[i] == expected(predictor_a, i) ||
+                result[i] == expected(predictor_b, i));
+  }
+  // After the reload, the new model is used
+  EXPECT_EQ(server.Handle(make_line(3)), expected(predictor_b, 3));
+  // A missing file keeps current model
+  EXPECT_EQ(server.Handle("#reload ./no_such_model").find("ERROR"), 0);
+  EXPECT_EQ(server.Handle(make_line(3)), expected(predictor_b, 3));
+  // So does a broken file
+  FILE* file = fopen(file_a.c_str(), "w");
+  fputs("not a model", file);
+  fclose(file);
+  EXPECT_EQ(server.Handle("#reload " + file_a).find("ERROR Invalid"), 0);
+  EXPECT_EQ(server.Handle(make_line(3)), expected(predictor_b, 3));
+  remove(file_a.c_str());
+  remove(file_b.c_str());
+}
+
+// A request without any node is not scored, and an ffm
+// model does not get a batch without fields.
+TEST(ModelServerTest, Empty_Request) {
+  Model model;
+  model.Initialize("ffm", "cross-entropy", kNumFeat, 2, 4, 1);
+  std::string file = "./model_server_test.ffm";
+  model.Serialize(file);
+  ModelServer server;
+  server.Initialize(file, 1, true, 4, 100);
+  EXPECT_EQ(server.Handle("1"), "ERROR Empty request");
+  EXPECT_EQ(server.Handle("  "), "ERROR Empty request");
+  EXPECT_EQ(server.Handle("1 0:1:0.5 1:2:1.0").find("ERROR"),
+            std::string::npos);
+  EXPECT_EQ(server.Stats()->Requests(), 1);
+  remove(file.c_str());
+}
+
+// The responses of a stream are in the order of requests
+TEST(ModelServerTest, Stream) {
+  std::string file = save_model("a", 0.66);
+  MemoryPredictor predictor;
+  predictor.Initialize(file, 1);
+  std::string input;
+  for (int i = 0; i < kNumLine; ++i) {
+    input += make_line(i) + "\n";
+    if (i == 10) { input += "#stats\n"; }
+  }
+  FILE* in = fmemopen((void*)input.data(), input.size(), "r");
+  FILE* out = tmpfile();
+  ModelServer server;
+  server.Initialize(file, 2, true, 16, 1000);
+  server.ServeStream(in, out);
+  fclose(in);
+  rewind(out);
+  char buf[256];
+  std::vector<std::string> lines;
+  while (fgets(buf, sizeof(buf), out) != nullptr) {
+    std::string line(buf);
+    lines.push_back(line.substr(0, line.size() - 1));
+  }
+  fclose(out);
+  ASSERT_EQ(lines.size(), kNumLine + 1);
+  for (int i = 0, j = 0; i < kNumLine; ++i, ++j) {
+    EXPECT_EQ(lines[j], expected(predictor, i));
+    if (i == 10) { EXPECT_EQ(lines[++j].find("requests="), 0); }
+  }
+  remove(file.c_str());
+}
+
+}  // namespace xLearn
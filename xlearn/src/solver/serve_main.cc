@@ -0,0 +1,134 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the entry for the model server of the xLearn.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "src/base/common.h"
+#include "src/base/logging.h"
+#include "src/base/stringprintf.h"
+#include "src/base/system.h"
+#include "src/solver/model_server.h"
+
+static const char* kUsage =
+"USAGE:\n"
+"     xlearn_serve <model_file> [OPTIONS]\n"
+"\n"
+" e.g.,  xlearn_serve ./model_file -socket /tmp/xlearn.sock\n"
+"\n"
+"Each request is one line of libsvm (or libffm for ffm) format without\n"
+"label, and the response is one line of score. '#reload <model_file>'\n"
+"replaces the model, and '#stats' returns the latency and throughput.\n"
+"\n"
+"OPTIONS:\n"
+"  -socket <path>   :  Serve the connections of a Unix domain socket.\n"
+"                      Using stdin and stdout by default.\n"
+"  -nthread <num>   :  Number of threads for scoring.\n"
+"  -batch <num>     :  Maximal number of requests of a micro-batch.\n"
+"                      Using 256 by default.\n"
+"  -wait <us>       :  Maximal waiting time (microseconds) of a request\n"
+"                      for a micro-batch. Using 1000 by default.\n"
+"  -l <log_file>    :  Path of the log file. Using '/tmp/xlearn_log' by default.\n"
+"  --sign           :  Converting output to 0 and 1.\n"
+"  --sigmoid        :  Converting output to 0~1 (problebility).\n"
+"  --no-norm        :  Disable instance-wise normalization.\n";
+
+xLearn::ModelServer* g_server = nullptr;
+
+void stop_server(int sig) {
+  if (g_server != nullptr) { g_server->Stop(); }
+}
+
+//------------------------------------------------------------------------------
+// The pre-defined main function
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "%s", kUsage);
+    return 1;
+  }
+  std::string model_file = argv[1];
+  std::string socket_path;
+  std::string log_file = "/tmp/xlearn_log";
+  int thread_number = 0;
+  int max_batch = 256;
+  int wait_us = 1000;
+  bool sign = false, sigmoid = false, norm = true;
+  for (int i = 2; i < argc; ++i) {
+    std::string opt = argv[i];
+    bool has_value = i + 1 < argc;
+    if (opt == "-socket" && has_value) {
+      socket_path = argv[++i];
+    } else if (opt == "-nthread" && has_value) {
+      thread_number = atoi(argv[++i]);
+    } else if (opt == "-batch" && has_value) {
+      max_batch = atoi(argv[++i]);
+    } else if (opt == "-wait" && has_value) {
+      wait_us = atoi(argv[++i]);
+    } else if (opt == "-l" && has_value) {
+      log_file = argv[++i];
+    } else if (opt == "--sign") {
+      sign = true;
+    } else if (opt == "--sigmoid") {
+      sigmoid = true;
+    } else if (opt == "--no-norm") {
+      norm = false;
+    } else {
+      fprintf(stderr, "Unknown option: %s\n\n%s", opt.c_str(), kUsage);
+      return 1;
+    }
+  }
+  if (thread_number < 0 || max_batch <= 0 || wait_us < 0) {
+    fprintf(stderr, "-nthread and -wait must be greater than or equal "
+                    "to zero, and -batch must be greater than zero.\n");
+    return 1;
+  }
+  std::string prefix = get_log_file(log_file) + "_serve";
+  InitializeLogger(StringPrintf("%s.INFO", prefix.c_str()),
+                   StringPrintf("%s.WARN", prefix.c_str()),
+                   StringPrintf("%s.ERROR", prefix.c_str()));
+
+  xLearn::ModelServer server;
+  server.Initialize(model_file, thread_number, norm,
+                    max_batch, wait_us, sign, sigmoid);
+  g_server = &server;
+  signal(SIGINT, stop_server);
+  signal(SIGTERM, stop_server);
+  signal(SIGPIPE, SIG_IGN);
+  // The responses use stdout, so the messages go to stderr
+  fprintf(stderr, "Serving model %s on %s\n", model_file.c_str(),
+          socket_path.empty() ? "stdin" : socket_path.c_str());
+  if (socket_path.empty()) {
+    server.ServeStream(stdin, stdout);
+  } else {
+    server.ServeSocket(socket_path);
+  }
+  std::string report = server.Stats()->Report();
+  LOG(INFO) << report;
+  fprintf(stderr, "%s\n", report.c_str());
+  g_server = nullptr;
+
+  return 0;
+}
@@ -20,6 +20,12 @@ This file is the implementation of the Solver class.
 
 #include "src/solver/solver.h"
 
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -27,10 +33,12 @@ This file is the implementation of the Solver class.
 #include <cstdio>
 #include <thread>
 
+#include "src/base/profiler.h"
 #include "src/base/stringprintf.h"
 #include "src/base/split_string.h"
 #include "src/base/timer.h"
 #include "src/base/system.h"
+#include "src/distributed/kv_server.h"
 
 namespace xLearn {
 
@@ -71,13 +79,28 @@ void Solver::print_logo() const {
 Reader* Solver::create_reader() {
   Reader* reader;
   std::string str = hyper_param_.on_disk ? "disk" : "memory";
+  if (hyper_param_.stream) { str = "stream"; }
   reader = CREATE_READER(str.c_str());
   if (reader == nullptr) {
     LOG(FATAL) << "Cannot create reader: " << str;
   }
+  if (reader->Type().compare("in-memory") == 0) {
+    static_cast<InmemReader*>(reader)->SetVerifyBinary(
+        hyper_param_.verify_binary);
+  }
   return reader;
 }
 
+// Get the shuffle mode of in-memory Reader by a given string
+static ShuffleMode get_shuffle_mode(const std::string& mode) {
+  if (mode.compare("block") == 0) {
+    return kShuffleBlock;
+  } else if (mode.compare("permute") == 0) {
+    return kShufflePermute;
+  }
+  return kShuffleRandom;
+}
+
 // Create Score by a given string
 Score* Solver::create_score() {
   Score* score;
@@ -103,6 +126,18 @@ Loss* Solver::create_loss() {
 // Create Metric by a given string
 Metric* Solver::create_metric() {
   Metric* metric;
+  // A list of metrics, the logloss and the exact AUC
+  // are computed by MultiMetric in one pass.
+  std::vector<std::string> list;
+  if (SplitMetricList(hyper_param_.metric, &list) &&
+      (list.size() > 1 ||
+      (list.size() == 1 && list[0] == "logloss") ||
+      (list.size() == 1 && list[0] == "auc" &&
+       hyper_param_.exact_auc))) {
+    MultiMetric* multi = new MultiMetric();
+    multi->SetMetricList(list, hyper_param_.exact_auc);
+    return multi;
+  }
   metric = CREATE_METRIC(hyper_param_.metric.c_str());
   // Note that here we do not cheack metric == nullptr
   // this is because we can set metric to "none", which 
@@ -121,6 +156,10 @@ void Solver::Initialize(int argc, char* argv[]) {
   print_logo();
   // Check and parse command line arguments
   checker(argc, argv);
+  // Fork the servers and workers before any thread is created
+  if (hyper_param_.is_train) {
+    init_distributed();
+  }
   // Initialize log file
   init_log();
   // Init train or predict
@@ -185,6 +224,98 @@ void Solver::init_log() {
               StringPrintf("%s.ERROR", prefix.c_str()));
 }
 
+// The servers and the other workers are forked from current
+// process, which becomes worker 0. Each server is a KVServer on a
+// Unix domain socket, and it exits after all the workers finish.
+// The other workers read the same data and train quietly.
+void Solver::init_distributed() {
+  int worker_num = hyper_param_.num_worker;
+  if (worker_num <= 1) { return; }
+  int server_num = hyper_param_.num_server;
+  CHECK_GT(server_num, 0);
+  std::string prefix = StringPrintf("/tmp/xlearn_ps_%d", (int)getpid());
+  print_info(
+    StringPrintf("Distributed training: %d worker(s), %d server(s)",
+         worker_num, server_num)
+  );
+  fflush(stdout);
+  for (int i = 0; i < server_num; ++i) {
+    pid_t pid = fork();
+    CHECK_GE(pid, 0);
+    if (pid == 0) {
+      KVServer server;
+      server.Initialize(worker_num);
+      bool ok = ServeSocket(&server, SocketPath(prefix, i));
+      _exit(ok ? 0 : 1);
+    }
+    children_.push_back(pid);
+  }
+  int worker_id = 0;
+  for (int i = 1; i < worker_num; ++i) {
+    pid_t pid = fork();
+    CHECK_GE(pid, 0);
+    if (pid == 0) {
+      worker_id = i;
+      children_.clear();
+      break;
+    }
+    children_.push_back(pid);
+  }
+  hyper_param_.worker_id = worker_id;
+  if (worker_id != 0) {
+    if (freopen("/dev/null", "w", stdout) == nullptr) {
+      LOG(FATAL) << "Cannot redirect the output of worker " << worker_id;
+    }
+    hyper_param_.quiet = true;
+    hyper_param_.model_file = "none";
+    hyper_param_.txt_model_file = "none";
+    hyper_param_.validate_set_file.clear();
+    hyper_param_.metric = "none";
+  }
+  transport_ = new SocketTransport();
+  transport_->Connect(prefix, server_num);
+  kv_store_ = new KVStore();
+  kv_store_->Initialize(server_num, transport_,
+                        worker_id, hyper_param_.staleness);
+  ps_worker_ = new PSWorker();
+  ps_worker_->Initialize(kv_store_, worker_id, worker_num,
+                         hyper_param_.batch_size);
+}
+
+// Wait for the forked servers and workers in the order they exit.
+// If one of them exits abnormally, the others may wait for it
+// forever, so they are killed and false is returned.
+bool Solver::wait_children() {
+  std::vector<pid_t> running = children_;
+  bool ok = true;
+  while (!running.empty()) {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR) { continue; }
+      LOG(ERR) << "Cannot wait for the child processes: "
+               << strerror(errno);
+      ok = false;
+      break;
+    }
+    std::vector<pid_t>::iterator it =
+      std::find(running.begin(), running.end(), pid);
+    if (it == running.end()) { continue; }
+    running.erase(it);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      LOG(ERR) << "Process " << pid << " exits abnormally.";
+      if (ok) {
+        for (size_t i = 0; i < running.size(); ++i) {
+          kill(running[i], SIGKILL);
+        }
+      }
+      ok = false;
+    }
+  }
+  children_.clear();
+  return ok;
+}
+
 // Initialize training task
 void Solver::init_train() {
   /*********************************************************
@@ -202,41 +333,52 @@ void Solver::init_train() {
   timer.tic();
   print_action("Read Problem ...");
   LOG(INFO) << "Start to init Reader";
-  // Split file
-  if (hyper_param_.cross_validation) {
-    CHECK_GT(hyper_param_.num_folds, 0);
-    splitor_.split(hyper_param_.train_set_file,
-                   hyper_param_.num_folds);
-    LOG(INFO) << "Split file into "
-              << hyper_param_.num_folds
-              << " parts.";
-  }
   // Get the Reader list
   int num_reader = 0;
   std::vector<std::string> file_list;
-  if (hyper_param_.cross_validation) {
-    num_reader += hyper_param_.num_folds;
-    for (int i = 0; i < hyper_param_.num_folds; ++i) {
-      std::string filename = StringPrintf("%s_%d",
-           hyper_param_.train_set_file.c_str(), i);
-      file_list.push_back(filename);
-    }
-  } else {  // do not use cross-validation
-    num_reader += 1;  // training file
-    CHECK_NE(hyper_param_.train_set_file.empty(), true);
-    file_list.push_back(hyper_param_.train_set_file);
-    if (!hyper_param_.validate_set_file.empty()) {
-      num_reader += 1;  // validation file
-      file_list.push_back(hyper_param_.validate_set_file);
-    }
+  // The cross-validation reads the training file once, and
+  // the folds are the views of it (see init_parallel_cv()).
+  num_reader += 1;  // training file
+  CHECK_NE(hyper_param_.train_set_file.empty(), true);
+  file_list.push_back(hyper_param_.train_set_file);
+  if (!hyper_param_.validate_set_file.empty() &&
+      !hyper_param_.cross_validation) {
+    num_reader += 1;  // validation file
+    file_list.push_back(hyper_param_.validate_set_file);
   }
   LOG(INFO) << "Number of Reader: " << num_reader;
   reader_.resize(num_reader, nullptr);
+  // The map is owned by the model after the model is created
+  FeatureMap* feat_map = nullptr;
+  if (hyper_param_.sparse_feature) {
+    feat_map = new FeatureMap();
+  }
   // Create Reader
   for (int i = 0; i < num_reader; ++i) {
     reader_[i] = create_reader();
+    reader_[i]->SetThreadPool(pool_);
+    // The new features of validation set are not added to the map
+    bool is_validate = !hyper_param_.cross_validation && i == 1;
+    reader_[i]->SetFeatureHash(hyper_param_.hash_bits,
+                               feat_map, !is_validate);
+    // The model size of stream training is given by the user
+    if (hyper_param_.stream) {
+      StreamReader* stream = static_cast<StreamReader*>(reader_[i]);
+      stream->SetBatchSize(hyper_param_.stream_batch);
+      stream->SetLimit((index_t)1 << hyper_param_.hash_bits,
+        hyper_param_.score_func.compare("ffm") == 0 ?
+        hyper_param_.num_field : 0);
+    }
     reader_[i]->Initialize(file_list[i]);
-    if (!hyper_param_.on_disk) {
+    // The rows shared by the folds keep the file order
+    if (!hyper_param_.on_disk && !hyper_param_.cross_validation &&
+        !hyper_param_.stream) {
+      // The validation set is only predicted, and the
+      // cheap random order is enough for it
+      if (i == 0) {
+        InmemReader* inmem = static_cast<InmemReader*>(reader_[i]);
+        inmem->SetShuffleMode(get_shuffle_mode(hyper_param_.shuffle_mode));
+      }
       reader_[i]->SetShuffle(true);
     }
     if (reader_[i] == nullptr) {
@@ -248,6 +390,7 @@ void Solver::init_train() {
     }
     if (reader_[i]->Type().compare("on-disk") == 0) {
       reader_[i]->SetBlockSize(hyper_param_.block_size);
+      reader_[i]->SetPrefetchDepth(hyper_param_.prefetch_depth);
     }
     LOG(INFO) << "Init Reader: " << file_list[i];
   }
@@ -256,7 +399,12 @@ void Solver::init_train() {
    *********************************************************/
   DMatrix* matrix = nullptr;
   index_t max_feat = 0, max_field = 0;
-  for (int i = 0; i < num_reader; ++i) {
+  // The stream can be read only once, and the number of
+  // fields of ffm is given by the user
+  if (hyper_param_.stream && hyper_param_.num_field > 0) {
+    max_field = hyper_param_.num_field - 1;
+  }
+  for (int i = 0; i < num_reader && !hyper_param_.stream; ++i) {
     while(reader_[i]->Samples(matrix)) {
       int tmp = matrix->MaxFeat();
       if (tmp > max_feat) { max_feat = tmp; }
@@ -269,6 +417,12 @@ void Solver::init_train() {
     reader_[i]->Reset();
   }
   hyper_param_.num_feature = max_feat + 1;
+  if (feat_map != nullptr) {
+    hyper_param_.num_feature = std::max(feat_map->Size(), (index_t)1);
+  } else if (hyper_param_.hash_bits > 0) {
+    // The hashed ids of the test set can be any bucket
+    hyper_param_.num_feature = (index_t)1 << hyper_param_.hash_bits;
+  }
   // Check overflow:
   // INT_MAX +  = 0
   if (hyper_param_.num_feature == 0) {
@@ -313,7 +467,9 @@ void Solver::init_train() {
                    hyper_param_.num_field,
                    hyper_param_.num_K,
                    hyper_param_.auxiliary_size,
-                   hyper_param_.model_scale);
+                   hyper_param_.model_scale,
+                   pool_);
+  model_->SetFeatureHash(hyper_param_.hash_bits, feat_map);
   index_t num_param = model_->GetNumParameter();
   hyper_param_.num_param = num_param;
   LOG(INFO) << "Number parameters: " << num_param;
@@ -344,6 +500,20 @@ void Solver::init_train() {
   loss_->Initialize(score_, pool_, 
          hyper_param_.norm, 
          hyper_param_.lock_free);
+  if (hyper_param_.sync) {
+    loss_->SetSyncMode(hyper_param_.sync_batch);
+    print_info(
+      StringPrintf("Synchronous training with mini-batch of %d rows",
+           (int)hyper_param_.sync_batch)
+    );
+  } else if (hyper_param_.numa && hyper_param_.lock_free) {
+    const std::vector<NumaNode>& nodes = GetNumaNodes();
+    loss_->SetNumaMode(nodes, hyper_param_.numa_sync);
+    print_info(
+      StringPrintf("NUMA-aware training on %d node(s)",
+           (int)nodes.size())
+    );
+  }
   LOG(INFO) << "Initialize loss function.";
   /*********************************************************
    *  Init metric                                          *
@@ -353,6 +523,90 @@ void Solver::init_train() {
     metric_->Initialize(pool_);
   }
   LOG(INFO) << "Initialize evaluation metric.";
+  if (hyper_param_.cross_validation) {
+    init_parallel_cv();
+  }
+}
+
+// Create the folds of cross-validation, and the slots that train
+// the folds at the same time. The i-th fold is the i-th contiguous
+// block of rows, which is the same as the old file splitting.
+// Each slot has a part of threads.
+void Solver::init_parallel_cv() {
+  CHECK_EQ(reader_.size(), 1);
+  CHECK_EQ(reader_[0]->Type().compare("in-memory"), 0);
+  const DMatrix* data = static_cast<InmemReader*>(reader_[0])->GetMatrix();
+  size_t num_row = data->row_length;
+  size_t num_fold = hyper_param_.num_folds;
+  if (num_row < num_fold) {
+    print_error(
+      StringPrintf("The number of rows (%lu) is less than the "
+                   "number of folds (%lu).", num_row, num_fold)
+    );
+    exit(0);
+  }
+  for (size_t i = 0; i < num_fold; ++i) {
+    size_t start = getStart(num_row, num_fold, i);
+    size_t end = getEnd(num_row, num_fold, i);
+    std::vector<index_t> train_index, test_index;
+    for (size_t r = 0; r < num_row; ++r) {
+      if (r >= start && r < end) {
+        test_index.push_back(r);
+      } else {
+        train_index.push_back(r);
+      }
+    }
+    IndexReader* train = new IndexReader();
+    train->Initialize(data, train_index);
+    train->SetSeed(i);
+    train->SetShuffle(true);
+    IndexReader* test = new IndexReader();
+    test->Initialize(data, test_index);
+    cv_train_reader_.push_back(train);
+    cv_test_reader_.push_back(test);
+  }
+  // The threads are divided among the slots
+  size_t thread_number = pool_->ThreadNumber();
+  size_t num_slot = hyper_param_.cv_parallel == 0 ? num_fold :
+      std::min(num_fold, (size_t)hyper_param_.cv_parallel);
+  num_slot = std::max((size_t)1, std::min(num_slot, thread_number));
+  size_t slot_thread = std::max((size_t)1, thread_number / num_slot);
+  for (size_t s = 0; s < num_slot; ++s) {
+    ThreadPool* pool = new ThreadPool(slot_thread);
+    Trainer::CVSlot slot;
+    // The first slot uses the initialized model
+    slot.model = model_;
+    if (s > 0) {
+      slot.model = new Model();
+      slot.model->Initialize(hyper_param_.score_func,
+                             hyper_param_.loss_func,
+                             hyper_param_.num_feature,
+                             hyper_param_.num_field,
+                             hyper_param_.num_K,
+                             hyper_param_.auxiliary_size,
+                             hyper_param_.model_scale,
+                             pool);
+    }
+    slot.loss = create_loss();
+    slot.loss->Initialize(score_, pool,
+                          hyper_param_.norm,
+                          hyper_param_.lock_free);
+    if (hyper_param_.sync) {
+      slot.loss->SetSyncMode(hyper_param_.sync_batch);
+    }
+    slot.metric = create_metric();
+    if (slot.metric != nullptr) {
+      slot.metric->Initialize(pool);
+    }
+    cv_pool_.push_back(pool);
+    cv_slot_.push_back(slot);
+  }
+  LOG(INFO) << "Cross-validation: " << num_slot << " folds in parallel, "
+            << slot_thread << " threads for each fold.";
+  print_info(
+    StringPrintf("Cross-validation: %lu fold(s) in parallel, "
+                 "%lu thread(s) for each", num_slot, slot_thread)
+  );
 }
 
 // Initialize predict task
@@ -423,6 +677,10 @@ void Solver::init_predict() {
   // Create Reader
   reader_.resize(1, create_reader());
   CHECK_NE(hyper_param_.test_set_file.empty(), true);
+  reader_[0]->SetThreadPool(pool_);
+  // Hash the features in the same way as the training data
+  reader_[0]->SetFeatureHash(model_->GetHashBits(),
+                             model_->GetFeatureMap(), false);
   reader_[0]->Initialize(hyper_param_.test_set_file);
   reader_[0]->SetShuffle(false);
   if (reader_[0] == nullptr) {
@@ -492,11 +750,28 @@ void Solver::start_train_work() {
                      early_stop,
                      stop_window,
                      quiet);
+  if (ps_worker_ != nullptr) {
+    ps_worker_->InitModel(*model_);
+    trainer.SetPSWorker(ps_worker_);
+  }
+  if (early_stop && !hyper_param_.best_model_file.empty()) {
+    model_->SetBestModelFile(hyper_param_.best_model_file);
+  }
+  Profiler profiler;
+  if (!hyper_param_.profile_file.empty()) {
+    profiler.Open(hyper_param_.profile_file, pool_);
+    trainer.SetProfiler(&profiler);
+    print_info(
+      StringPrintf("Profile of the epochs: %s",
+        hyper_param_.profile_file.c_str())
+    );
+  }
   print_action("Start to train ...");
 /******************************************************************************
  * Training under cross-validation                                            *
  ******************************************************************************/
   if (hyper_param_.cross_validation) {
+    trainer.SetParallelCV(cv_train_reader_, cv_test_reader_, cv_slot_);
     trainer.CVTrain();
     print_action("Finish Cross-Validation");
   } 
@@ -504,34 +779,68 @@ void Solver::start_train_work() {
  * Original training without cross-validation                                 *
  ******************************************************************************/
   else {
-    trainer.Train();
-    // Save binary model
-    if (save_model) {
+    if (hyper_param_.stream) {
+      if (!hyper_param_.checkpoint_file.empty()) {
+        trainer.SetCheckpoint(hyper_param_.checkpoint_file,
+                              hyper_param_.checkpoint_rows,
+                              hyper_param_.checkpoint_sec);
+      }
+      trainer.StreamTrain(hyper_param_.stream_window);
+    } else {
+      trainer.Train();
+    }
+    // Worker 0 gets the final model from the servers
+    if (ps_worker_ != nullptr) {
+      ps_worker_->Finish(*model_);
+      if (!wait_children()) {
+        print_error("The distributed training failed");
+        exit(1);
+      }
+    }
+    // Save TXT model. It is saved before the binary model,
+    // which can be quantized.
+    if (save_txt_model) {
       Timer timer;
       timer.tic();
-      print_action("Start to save model ...");
-      trainer.SaveModel(hyper_param_.model_file);
+      print_action("Start to save txt model ...");
+      trainer.SaveTxtModel(hyper_param_.txt_model_file);
       print_info(
-        StringPrintf("Model file: %s", 
-          hyper_param_.model_file.c_str())
+        StringPrintf("TXT Model file: %s", 
+          hyper_param_.txt_model_file.c_str())
       );
       print_info(
-        StringPrintf("Time cost for saving model: %.2f (sec)",
+        StringPrintf("Time cost for saving txt model: %.2f (sec)",
              timer.toc())
       );
     }
-    // Save TXT model 
-    if (save_txt_model) {
+    // Save binary model
+    if (save_model) {
       Timer timer;
       timer.tic();
-      print_action("Start to save txt model ...");
-      trainer.SaveTxtModel(hyper_param_.txt_model_file);
+      print_action("Start to save model ...");
+      if (hyper_param_.quantize.compare("none") != 0) {
+        model_->Quantize(hyper_param_.quantize.compare("fp16") == 0 ?
+                         kQuantFP16 : kQuantInt8);
+        print_info(
+          StringPrintf("Inference model (%s)",
+            hyper_param_.quantize.c_str())
+        );
+      } else if (hyper_param_.prune_threshold >= 0) {
+        uint64 num_vec = (uint64)model_->GetNumFeature() *
+                         model_->GetNumField();
+        index_t kept = model_->Prune(hyper_param_.prune_threshold);
+        print_info(
+          StringPrintf("Pruned model: %u of %llu latent vectors are kept",
+            kept, (unsigned long long)num_vec)
+        );
+      }
+      trainer.SaveModel(hyper_param_.model_file);
       print_info(
-        StringPrintf("TXT Model file: %s", 
-          hyper_param_.txt_model_file.c_str())
+        StringPrintf("Model file: %s", 
+          hyper_param_.model_file.c_str())
       );
       print_info(
-        StringPrintf("Time cost for saving txt model: %.2f (sec)",
+        StringPrintf("Time cost for saving model: %.2f (sec)",
              timer.toc())
       );
     }
@@ -570,6 +879,28 @@ void Solver::Clear() {
     }
   }
   reader_.clear();
+  // Clear cross-validation
+  for (size_t i = 0; i < cv_train_reader_.size(); ++i) {
+    delete cv_train_reader_[i];
+    delete cv_test_reader_[i];
+  }
+  for (size_t s = 0; s < cv_slot_.size(); ++s) {
+    if (cv_slot_[s].model != model_) { delete cv_slot_[s].model; }
+    delete cv_slot_[s].loss;
+    delete cv_slot_[s].metric;
+    delete cv_pool_[s];
+  }
+  cv_train_reader_.clear();
+  cv_test_reader_.clear();
+  cv_slot_.clear();
+  cv_pool_.clear();
+  // Clear distributed training
+  delete ps_worker_;
+  delete kv_store_;
+  if (transport_ != nullptr) {
+    transport_->Close();
+    delete transport_;
+  }
 }
 
 } // namespace xLearn
@@ -22,6 +22,10 @@ of the xLearn.
 #ifndef XLEARN_SOLVER_SOLVER_H_
 #define XLEARN_SOLVER_SOLVER_H_
 
+#include <sys/types.h>
+
+#include <vector>
+
 #include "src/base/common.h"
 #include "src/base/thread_pool.h"
 #include "src/data/hyper_parameters.h"
@@ -29,13 +33,16 @@ of the xLearn.
 #include "src/data/model_parameters.h"
 #include "src/reader/reader.h"
 #include "src/reader/parser.h"
-#include "src/reader/file_splitor.h"
 #include "src/score/score_function.h"
 #include "src/loss/loss.h"
 #include "src/loss/metric.h"
+#include "src/loss/multi_metric.h"
 #include "src/solver/checker.h"
 #include "src/solver/trainer.h"
 #include "src/solver/inference.h"
+#include "src/distributed/parameter_server.h"
+#include "src/distributed/transport.h"
+#include "src/distributed/ps_worker.h"
 
 namespace xLearn {
 //------------------------------------------------------------------------------
@@ -57,7 +64,10 @@ class Solver {
   Solver() 
     : score_(nullptr),
       loss_(nullptr),
-      metric_(nullptr) { }
+      metric_(nullptr),
+      transport_(nullptr),
+      kv_store_(nullptr),
+      ps_worker_(nullptr) { }
   ~Solver() { }
 
   // Ser train or predict
@@ -90,8 +100,6 @@ class Solver {
   xLearn::Model* model_;
   /* One Reader corresponds one data file */
   std::vector<xLearn::Reader*> reader_;
-  /* Split file in cross-validation */
-  xLearn::FileSpliter splitor_;
   /* linear, fm or ffm ? */
   xLearn::Score* score_;
   /* cross-entropy or squared ? */
@@ -100,6 +108,20 @@ class Solver {
   xLearn::Metric* metric_;
   /* ThreadPool for multi-thread training */
   ThreadPool* pool_;
+  /* Connections to the parameter servers */
+  xLearn::SocketTransport* transport_;
+  /* Parameters on the servers */
+  xLearn::KVStore* kv_store_;
+  /* Worker of distributed training */
+  xLearn::PSWorker* ps_worker_;
+  /* Processes forked by current process */
+  std::vector<pid_t> children_;
+  /* Folds of cross-validation, which share reader_[0] */
+  std::vector<xLearn::Reader*> cv_train_reader_;
+  std::vector<xLearn::Reader*> cv_test_reader_;
+  /* Folds trained at the same time, and their thread pools */
+  std::vector<xLearn::Trainer::CVSlot> cv_slot_;
+  std::vector<ThreadPool*> cv_pool_;
 
   // Create object by name
   xLearn::Reader* create_reader();
@@ -114,12 +136,15 @@ class Solver {
   void init_train();
   void init_predict();
   void init_log();
+  void init_distributed();
+  void init_parallel_cv();
   void checker(int argc, char* argv[]);
   void checker(HyperParam& hyper_param);
 
   // Start function
   void start_train_work();
   void start_prediction_work();
+  bool wait_children();
 
  private:
   DISALLOW_COPY_AND_ASSIGN(Solver);
@@ -21,6 +21,10 @@ This file is the implementation of the Trainer class.
 #include <stdio.h>
 #include <vector>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 #include "src/solver/trainer.h"
 #include "src/data/data_structure.h"
@@ -42,8 +46,12 @@ void Trainer::show_head_info(bool validate) {
     str_list.push_back("Test " + loss_->loss_type());
     width_list.push_back(20);
     if (metric_ != nullptr) {
-      str_list.push_back("Test " + metric_->metric_type());
-      width_list.push_back(20);
+      std::vector<std::string> type;
+      metric_->MetricTypeList(&type);
+      for (size_t i = 0; i < type.size(); ++i) {
+        str_list.push_back("Test " + type[i]);
+        width_list.push_back(20);
+      }
     }
   }
   str_list.push_back("Time cost (sec)");
@@ -59,7 +67,7 @@ void Trainer::show_head_info(bool validate) {
  *********************************************************/
 void Trainer::show_train_info(real_t tr_loss, 
                               real_t te_loss,
-                              real_t te_metric,
+                              const std::vector<real_t>& te_metric,
                               real_t time_cost, 
                               bool validate,
                               index_t epoch) {
@@ -72,8 +80,8 @@ void Trainer::show_train_info(real_t tr_loss,
   if (validate) {
     str_list.push_back(StringPrintf("%.6f", te_loss));
     width_list.push_back(20);
-    if (metric_ != nullptr) {
-      str_list.push_back(StringPrintf("%.6f", te_metric));
+    for (size_t i = 0; i < te_metric.size(); ++i) {
+      str_list.push_back(StringPrintf("%.6f", te_metric[i]));
       width_list.push_back(20);
     }
   }
@@ -88,6 +96,53 @@ void Trainer::show_train_info(real_t tr_loss,
   print_row(str_list, width_list);
 }
 
+/*********************************************************
+ *  Show info of stream training                         *
+ *********************************************************/
+void Trainer::show_stream_head() {
+  std::vector<std::string> str_list;
+  std::vector<int> width_list;
+  str_list.push_back("Rows");
+  width_list.push_back(12);
+  str_list.push_back("Window " + loss_->loss_type());
+  width_list.push_back(20);
+  if (metric_ != nullptr) {
+    std::vector<std::string> type;
+    metric_->MetricTypeList(&type);
+    for (size_t i = 0; i < type.size(); ++i) {
+      str_list.push_back("Window " + type[i]);
+      width_list.push_back(20);
+    }
+  }
+  str_list.push_back("Time cost (sec)");
+  width_list.push_back(20);
+  Color::Modifier green(Color::FG_GREEN);
+  Color::Modifier reset(Color::RESET);
+  std::cout << green << "[------------]" << reset;
+  print_row(str_list, width_list);
+}
+
+void Trainer::show_stream_info(uint64 rows,
+                               const MetricInfo& info,
+                               real_t time_cost) {
+  std::vector<std::string> str_list;
+  std::vector<int> width_list;
+  str_list.push_back(StringPrintf("%llu", (unsigned long long)rows));
+  width_list.push_back(12);
+  str_list.push_back(StringPrintf("%.6f", info.loss_val));
+  width_list.push_back(20);
+  for (size_t i = 0; i < info.metric_list.size(); ++i) {
+    str_list.push_back(StringPrintf("%.6f", info.metric_list[i]));
+    width_list.push_back(20);
+  }
+  str_list.push_back(StringPrintf("%.2f", time_cost));
+  width_list.push_back(20);
+  Color::Modifier green(Color::FG_GREEN);
+  Color::Modifier reset(Color::RESET);
+  std::cout << green << "[ Stream     ]" << reset;
+  print_row(str_list, width_list);
+}
+
 /*********************************************************
  *  Basic train                                          *
  *********************************************************/
@@ -106,25 +161,54 @@ void Trainer::Train() {
  *  Cross-Validation                                     *
  *********************************************************/
 void Trainer::CVTrain() {
-  // Use the i-th reader as validation Reader
-  for (int i = 0; i < reader_list_.size(); ++i) {
+  // The folds are given by SetParallelCV()
+  CHECK(!cv_train_.empty());
+  size_t num_fold = cv_train_.size();
+  size_t num_slot = std::min(cv_slot_.size(), num_fold);
+  std::vector<std::vector<EpochInfo> > history(num_fold);
+  std::vector<MetricInfo> info(num_fold);
+  // Each slot takes the next fold until all folds are done
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (size_t s = 0; s < num_slot; ++s) {
+    threads.push_back(std::thread([&, s]() {
+      const CVSlot& slot = cv_slot_[s];
+      bool fresh = true;
+      for (size_t i = next++; i < num_fold; i = next++) {
+        // Re-init the model parameters of the slot
+        if (!fresh) { slot.model->Reset(); }
+        fresh = false;
+        std::vector<Reader*> tr_reader(1, cv_train_[i]);
+        std::vector<Reader*> te_reader(1, cv_test_[i]);
+        Trainer fold;
+        fold.Initialize(tr_reader, epoch_, slot.model, slot.loss,
+                        slot.metric, false, stop_window_, false);
+        fold.deferred_ = true;
+        fold.train(tr_reader, te_reader);
+        history[i].swap(fold.history_);
+        info[i] = fold.metric_info_.back();
+      }
+    }));
+  }
+  for (size_t s = 0; s < threads.size(); ++s) {
+    threads[s].join();
+  }
+  for (size_t i = 0; i < num_fold; ++i) {
     print_action(
-      StringPrintf("Cross-validation: %d/%lu:", 
-        i+1, reader_list_.size())
+      StringPrintf("Cross-validation: %d/%lu:",
+        (int)i+1, num_fold)
     );
-    // Get the train Reader and test Reader
-    std::vector<Reader*> tr_reader;
-    for (int j = 0; j < reader_list_.size(); ++j) {
-      if (i == j) { continue; }
-      tr_reader.push_back(reader_list_[j]);
-    }
-    std::vector<Reader*> te_reader;
-    te_reader.push_back(reader_list_[i]);
-    if (i != 0) {
-      // Re-init current model parameters.
-      model_->Reset();
+    show_head_info(true);
+    for (size_t n = 0; n < history[i].size(); ++n) {
+      const EpochInfo& e = history[i][n];
+      show_train_info(e.tr_loss,
+                      e.te_info.loss_val,
+                      e.te_info.metric_list,
+                      e.time_cost,
+                      true,
+                      e.epoch);
     }
-    this->train(tr_reader, te_reader);
+    metric_info_.push_back(info[i]);
   }
   // Average metric for cross-validation
   show_average_metric();
@@ -135,11 +219,13 @@ void Trainer::CVTrain() {
  *********************************************************/
 void Trainer::show_average_metric() {
   real_t loss = 0;
-  real_t metric = 0;
+  std::vector<real_t> metric;
   for (size_t i = 0; i < metric_info_.size(); ++i) {
     loss += metric_info_[i].loss_val;
-    if (metric_ != nullptr) {
-      metric += metric_info_[i].metric_val;
+    const std::vector<real_t>& list = metric_info_[i].metric_list;
+    metric.resize(list.size(), 0);
+    for (size_t j = 0; j < list.size(); ++j) {
+      metric[j] += list[j];
     }
   }
   print_info(
@@ -148,11 +234,15 @@ void Trainer::show_average_metric() {
     loss / metric_info_.size())
   );
   if (metric_ != nullptr) {
-    print_info(
-      StringPrintf("Average %s: %.6f", 
-      metric_->metric_type().c_str(),
-       metric / metric_info_.size())
-    );
+    std::vector<std::string> type;
+    metric_->MetricTypeList(&type);
+    for (size_t j = 0; j < type.size() && j < metric.size(); ++j) {
+      print_info(
+        StringPrintf("Average %s: %.6f", 
+        type[j].c_str(),
+         metric[j] / metric_info_.size())
+      );
+    }
   }
 }
 
@@ -167,44 +257,63 @@ void Trainer::train(std::vector<Reader*>& train_reader,
   real_t prev_loss = kFloatMax;
   MetricInfo te_info;
   // Show header info
-  if (!quiet_) { 
+  if (!quiet_ && !deferred_) {
     show_head_info(!test_reader.empty()); 
   }
   for (int n = 1; n <= epoch_; ++n) {
     Timer timer;
     timer.tic();
+    if (profiler_ != nullptr) { profiler_->StartEpoch(n); }
     // Calc grad and update model
     real_t tr_loss = calc_gradient(train_reader);
     // we don't do any evaluation in a quiet model
     if (!quiet_) {
+      if (ps_worker_ != nullptr) {
+        Profiler::Scope scope(profiler_, Profiler::kModel);
+        ps_worker_->PullModel(*model_);
+      }
       if (!test_reader.empty()) { 
         te_info = calc_metric(test_reader); 
       }
       // show evaludation metric info
-      show_train_info(tr_loss, 
-                      te_info.loss_val,
-                      te_info.metric_val,
-                      timer.toc(), 
-                      !test_reader.empty(), 
-                      n);
+      if (deferred_) {
+        EpochInfo info;
+        info.tr_loss = tr_loss;
+        info.te_info = te_info;
+        info.time_cost = timer.toc();
+        info.epoch = n;
+        history_.push_back(info);
+      } else {
+        show_train_info(tr_loss, 
+                        te_info.loss_val,
+                        te_info.metric_list,
+                        timer.toc(), 
+                        !test_reader.empty(), 
+                        n);
+      }
       // Early-stopping
       if (early_stop_) {
         if (te_info.loss_val < best_loss) {
           best_loss = te_info.loss_val;
           best_epoch = n;
+          Profiler::Scope scope(profiler_, Profiler::kModel);
           model_->SetBestModel();
         }
         if (te_info.loss_val >= prev_loss) {
           stop_window++;
           // If the validation loss goes up conntinuously
           // in stop_window epoch, we stop training
-          if (stop_window == stop_window_) { break; }
+          if (stop_window == stop_window_) {
+            if (profiler_ != nullptr) { profiler_->EndEpoch(); }
+            break;
+          }
         } else {
           stop_window = 0;
         }
         prev_loss = te_info.loss_val;
       }
     }
+    if (profiler_ != nullptr) { profiler_->EndEpoch(); }
   }
   if (early_stop_ && best_epoch != epoch_) {  // not for cv
     print_action(
@@ -226,14 +335,164 @@ real_t Trainer::calc_gradient(std::vector<Reader*>& reader) {
     reader[i]->Reset();
     DMatrix* matrix = nullptr;
     for (;;) {
-      index_t tmp = reader[i]->Samples(matrix);
+      index_t tmp = 0;
+      {
+        Profiler::Scope scope(profiler_, Profiler::kRead);
+        tmp = reader[i]->Samples(matrix);
+      }
       if (tmp == 0) { break; }
-      loss_->CalcGrad(matrix, *model_);
+      if (profiler_ != nullptr) { profile_rows(matrix, true); }
+      {
+        Profiler::Scope scope(profiler_, Profiler::kGrad);
+        if (ps_worker_ != nullptr) {
+          ps_worker_->CalcGrad(matrix, *model_, loss_);
+        } else {
+          loss_->CalcGrad(matrix, *model_);
+        }
+      }
+      // Only the touched features are copied by SetBestModel()
+      if (early_stop_) {
+        Profiler::Scope scope(profiler_, Profiler::kModel);
+        model_->Touch(matrix);
+      }
     }
   }
   return loss_->GetLoss();
 }
 
+// The nodes of the trained rows are the updates of the model,
+// and the bytes are the rows given by the reader.
+void Trainer::profile_rows(const DMatrix* matrix, bool train) {
+  uint64 nodes = 0;
+  for (index_t i = 0; i < matrix->row_length; ++i) {
+    nodes += matrix->row[i].size();
+  }
+  uint64 bytes = nodes * sizeof(Node) +
+                 (uint64)matrix->row_length * sizeof(real_t) * 2;
+  if (train) {
+    profiler_->AddTrainRows(matrix->row_length, nodes, bytes);
+  } else {
+    profiler_->AddTestRows(matrix->row_length, bytes);
+  }
+}
+
+/*********************************************************
+ *  Stream training                                      *
+ *********************************************************/
+void Trainer::StreamTrain(index_t window) {
+  CHECK_GT(window, 0);
+  Reader* reader = reader_list_[0];
+  bool checkpoint = !ckpt_file_.empty() &&
+                    (ckpt_rows_ > 0 || ckpt_sec_ > 0);
+  if (checkpoint) { model_->SetBestModelFile(ckpt_file_); }
+  // The ring of the latest predictions and labels
+  std::vector<real_t> win_pred(window, 0);
+  std::vector<real_t> win_y(window, 0);
+  index_t win_pos = 0, win_size = 0;
+  std::vector<real_t> pred;
+  uint64 rows = 0, report_rows = 0, ckpt_rows = 0;
+  int ckpt_num = 0;
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point begin = Clock::now();
+  Clock::time_point ckpt_time = begin;
+  if (!quiet_) { show_stream_head(); }
+  // The whole stream is one record of the profiler
+  if (profiler_ != nullptr) { profiler_->StartEpoch(1); }
+  DMatrix* matrix = nullptr;
+  for (;;) {
+    index_t tmp = 0;
+    {
+      Profiler::Scope scope(profiler_, Profiler::kRead);
+      tmp = reader->Samples(matrix);
+    }
+    if (tmp == 0) { break; }
+    if (profiler_ != nullptr) { profile_rows(matrix, true); }
+    // Progressive validation: predict the rows before training them
+    if (!quiet_) {
+      if (tmp != pred.size()) { pred.resize(tmp); }
+      Profiler::Scope scope(profiler_, Profiler::kPredict);
+      loss_->Predict(matrix, *model_, pred);
+      for (index_t i = 0; i < tmp; ++i) {
+        win_pred[win_pos] = pred[i];
+        win_y[win_pos] = matrix->Y[i];
+        if (++win_pos == window) { win_pos = 0; }
+      }
+      win_size = std::min((uint64)window, (uint64)win_size + tmp);
+    }
+    {
+      Profiler::Scope scope(profiler_, Profiler::kGrad);
+      loss_->CalcGrad(matrix, *model_);
+    }
+    rows += tmp;
+    // Only the touched features are copied to the checkpoint
+    if (checkpoint) {
+      Profiler::Scope scope(profiler_, Profiler::kModel);
+      model_->Touch(matrix);
+    }
+    Clock::time_point now = Clock::now();
+    if (!quiet_ && rows - report_rows >= window) {
+      Profiler::Scope scope(profiler_, Profiler::kMetric);
+      show_stream_info(rows, stream_metric(win_pred, win_y),
+        std::chrono::duration<real_t>(now - begin).count());
+      report_rows = rows;
+    }
+    if (checkpoint &&
+        ((ckpt_rows_ > 0 && rows - ckpt_rows >= ckpt_rows_) ||
+         (ckpt_sec_ > 0 && now - ckpt_time >=
+                           std::chrono::seconds(ckpt_sec_)))) {
+      Profiler::Scope scope(profiler_, Profiler::kModel);
+      model_->SetBestModel();
+      ckpt_rows = rows;
+      ckpt_time = now;
+      ckpt_num++;
+    }
+  }
+  real_t time_cost = std::chrono::duration<real_t>(
+      Clock::now() - begin).count();
+  if (!quiet_ && rows > report_rows) {
+    // The ring is not full for a short stream
+    if (win_size < window) {
+      win_pred.resize(win_size);
+      win_y.resize(win_size);
+    }
+    if (win_size > 0) {
+      show_stream_info(rows, stream_metric(win_pred, win_y), time_cost);
+    }
+  }
+  if (checkpoint) {
+    if (rows > ckpt_rows) {
+      model_->SetBestModel();
+      ckpt_num++;
+    }
+    model_->WaitBestModel();
+    model_->SetBestModelFile("");
+  }
+  if (profiler_ != nullptr) { profiler_->EndEpoch(); }
+  print_info(
+    StringPrintf("Trained %llu rows of the stream, %d checkpoint(s), "
+                 "%.0f rows/sec",
+                 (unsigned long long)rows, ckpt_num,
+                 time_cost > 0 ? rows / time_cost : 0.0)
+  );
+}
+
+// The order of rows in the ring doesn't change the evaluation
+MetricInfo Trainer::stream_metric(const std::vector<real_t>& pred,
+                                  const std::vector<real_t>& label) {
+  MetricInfo info;
+  loss_->Reset();
+  loss_->Evalute(pred, label);
+  info.loss_val = loss_->GetLoss();
+  info.metric_val = 0;
+  if (metric_ != nullptr) {
+    metric_->Reset();
+    metric_->Accumulate(label, pred);
+    metric_->GetMetricList(&info.metric_list);
+    info.metric_val = info.metric_list[0];
+  }
+  return info;
+}
+
 /*********************************************************
  *  Calc evaluation metric                               *
  *********************************************************/
@@ -248,10 +507,19 @@ MetricInfo Trainer::calc_metric(std::vector<Reader*>& reader_list) {
   for (int i = 0; i < reader_list.size(); ++i) {
     reader_list[i]->Reset();
     for (;;) {
-      index_t tmp = reader_list[i]->Samples(matrix);
+      index_t tmp = 0;
+      {
+        Profiler::Scope scope(profiler_, Profiler::kRead);
+        tmp = reader_list[i]->Samples(matrix);
+      }
       if (tmp == 0) { break; }
+      if (profiler_ != nullptr) { profile_rows(matrix, false); }
       if (tmp != pred.size()) { pred.resize(tmp); }
-      loss_->Predict(matrix, *model_, pred);
+      {
+        Profiler::Scope scope(profiler_, Profiler::kPredict);
+        loss_->Predict(matrix, *model_, pred);
+      }
+      Profiler::Scope scope(profiler_, Profiler::kMetric);
       loss_->Evalute(pred, matrix->Y);
       if (metric_ != nullptr) {
         metric_->Accumulate(matrix->Y, pred);
@@ -260,8 +528,10 @@ MetricInfo Trainer::calc_metric(std::vector<Reader*>& reader_list) {
   }
   MetricInfo info;
   info.loss_val = loss_->GetLoss();
+  info.metric_val = 0;
   if (metric_ != nullptr) {
-    info.metric_val = metric_->GetMetric();
+    metric_->GetMetricList(&info.metric_list);
+    info.metric_val = info.metric_list[0];
   }
   return info;
 }
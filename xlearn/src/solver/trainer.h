@@ -22,13 +22,16 @@ This file defines the Trainer class.
 #define XLEARN_SOLVER_TRAINER_H_
 
 #include <vector>
+#include <string>
 
 #include "src/base/common.h"
 #include "src/base/format_print.h"
+#include "src/base/profiler.h"
 #include "src/reader/reader.h"
 #include "src/data/model_parameters.h"
 #include "src/loss/loss.h"
 #include "src/loss/metric.h"
+#include "src/distributed/ps_worker.h"
 
 namespace xLearn {
 
@@ -36,11 +39,43 @@ namespace xLearn {
 // Trainer is the core class of xLearn, which can perform
 // standard training process (training set and test set), as 
 // well as the cross-validation training process.
+//
+// The folds of cross-validation are trained at the same time.
+// Each concurrent fold uses a CVSlot, which has its own model, loss
+// and metric (and hence its own thread pool), and the readers of the
+// folds can be the views of one dataset (see IndexReader):
+//
+//   trainer.SetParallelCV(train_list, test_list, slots);
+//   trainer.CVTrain();
+//
+// The evaluation of each fold is printed in order after all the
+// folds are finished.
+//
+// The online learning trains one pass over a stream (see StreamReader),
+// and each mini-batch is evaluated before it is trained:
+//
+//   trainer.SetCheckpoint("model.ckpt", 1000000, 60);
+//   trainer.StreamTrain(100000);
+//
+// With a Profiler, the time of the phases of each epoch (or of the
+// whole stream) is written to its file (see profiler.h).
 //------------------------------------------------------------------------------
 class Trainer {
  public:
+  // Resources used by one fold at a time
+  struct CVSlot {
+    Model* model;
+    Loss* loss;
+    Metric* metric;
+  };
+
   // Constructor and Destructor
-  Trainer() {}
+  Trainer() 
+    : ps_worker_(nullptr),
+      profiler_(nullptr),
+      deferred_(false),
+      ckpt_rows_(0),
+      ckpt_sec_(0) {}
   ~Trainer() {}
 
   // Invoke this function before we use this class
@@ -68,12 +103,61 @@ class Trainer {
     quiet_ = quiet;
   }
 
+  // Train the model with a parameter server. The model is
+  // pulled from the server before each evaluation.
+  void SetPSWorker(PSWorker* worker) {
+    CHECK_NOTNULL(worker);
+    ps_worker_ = worker;
+  }
+
+  // Record the phases of each epoch of Train() and CVTrain()
+  // by the profiler, which is not used by the folds trained in
+  // parallel. nullptr (the default) for no profiling.
+  void SetProfiler(Profiler* profiler) {
+    profiler_ = profiler;
+  }
+
+  // Train the i-th fold by train_list[i] and validate it by
+  // test_list[i] in CVTrain(). At most slots.size() folds are
+  // trained at the same time. The reader_list of Initialize()
+  // is not used by CVTrain(), which needs this call first.
+  void SetParallelCV(const std::vector<Reader*>& train_list,
+                     const std::vector<Reader*>& test_list,
+                     const std::vector<CVSlot>& slots) {
+    CHECK_EQ(train_list.size(), test_list.size());
+    CHECK(!train_list.empty());
+    CHECK(!slots.empty());
+    cv_train_ = train_list;
+    cv_test_ = test_list;
+    cv_slot_ = slots;
+  }
+
   // Training without cross-validation
   void Train();
 
-  // Training using cross-validation
+  // Training using cross-validation, whose folds
+  // are given by SetParallelCV()
   void CVTrain();
 
+  // Save a checkpoint in StreamTrain() every rows rows or every
+  // sec seconds (0 for never). The checkpoint is copied from the
+  // features updated since the last one, and saved to filename
+  // in background (see Model::SetBestModel()).
+  void SetCheckpoint(const std::string& filename,
+                     uint64 rows, int sec) {
+    CHECK_NE(filename.empty(), true);
+    CHECK_GE(sec, 0);
+    ckpt_file_ = filename;
+    ckpt_rows_ = rows;
+    ckpt_sec_ = sec;
+  }
+
+  // Training in one pass over the stream of the first reader.
+  // The loss and metric of the latest window rows, which are
+  // predicted before they are trained, are printed every window
+  // rows. The memory used does not depend on the stream size.
+  void StreamTrain(index_t window);
+
   // Save model to disk file
   void SaveModel(const std::string& filename) {
     CHECK_NE(filename.empty(), true);
@@ -108,6 +192,29 @@ class Trainer {
   Metric* metric_;
   /* Store each metric info of cross-validation */
   std::vector<MetricInfo> metric_info_;
+  /* Worker of distributed training, which is nullptr by default */
+  PSWorker* ps_worker_;
+  /* Profiler of the epochs, which is nullptr by default */
+  Profiler* profiler_;
+  /* Readers and slots of the parallel cross-validation */
+  std::vector<Reader*> cv_train_;
+  std::vector<Reader*> cv_test_;
+  std::vector<CVSlot> cv_slot_;
+  /* The evaluation of an epoch */
+  struct EpochInfo {
+    real_t tr_loss;
+    MetricInfo te_info;
+    real_t time_cost;
+    int epoch;
+  };
+  /* Keep the evaluation in history_ instead of printing it,
+  which is used by the folds trained in parallel */
+  bool deferred_;
+  std::vector<EpochInfo> history_;
+  /* Checkpoint of the stream training */
+  std::string ckpt_file_;
+  uint64 ckpt_rows_;
+  int ckpt_sec_;
 
   // Basic train function
   void train(std::vector<Reader*>& train_reader,
@@ -120,14 +227,25 @@ class Trainer {
   // Calculate loss value and evaluation metric.
   MetricInfo calc_metric(std::vector<Reader*>& reader_list);
 
+  // Count a mini-batch of training (or validation) in profiler_.
+  void profile_rows(const DMatrix* matrix, bool train);
+
   // Calculate average metric for cross-validation
   void show_average_metric();
 
+  // Evaluate the predictions of the stream training
+  MetricInfo stream_metric(const std::vector<real_t>& pred,
+                           const std::vector<real_t>& label);
+
   // Print information during the training.
   void show_head_info(bool validate);
+  void show_stream_head();
+  void show_stream_info(uint64 rows,
+                        const MetricInfo& info,
+                        real_t time_cost);
   void show_train_info(real_t tr_loss, 
                        real_t te_loss,
-                       real_t te_metric,
+                       const std::vector<real_t>& te_metric,
                        real_t time_cost, 
                        bool validate,
                        index_t epoch);
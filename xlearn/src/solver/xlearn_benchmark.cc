@@ -0,0 +1,481 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the end-to-end benchmark suite of xLearn. It generates a
+synthetic CTR dataset (see synthetic_data.h) and runs the standard
+scenarios on it:
+
+  parse     bytes parsed per second of libsvm and libffm
+  memory    rows trained per second of an in-memory epoch
+  disk      rows trained per second of an on-disk epoch
+  predict   rows predicted per second
+  threads   the in-memory epoch with 1, 2, 4, ... threads
+  shuffle   rows trained per second and the test loss of each epoch
+            with the random, block and permute shuffle. The training
+            rows are sorted by label, which is the worst case of the
+            block shuffle, and the last 20% rows are the test set.
+  sync      the threads scenario of the synchronous mini-batch
+            training (see sync_batch.h)
+
+for the linear, fm and ffm models. Each result is printed as a row of
+the table, and is written as a JSON object per line to the output file,
+which can be compared between two builds:
+
+  ./xlearn_benchmark [-rows 200000] [-fields 20] [-features 1000000]
+                     [-length 20] [-zipf 1.0] [-k 4] [-epoch 2]
+                     [-nthread <hardware threads>] [-seed 0]
+                     [-scenario all|parse|memory|disk|predict|threads|shuffle|sync]
+                     [-dir .] [-o xlearn_benchmark.json]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/cpu_feature.h"
+#include "src/base/file_util.h"
+#include "src/base/format_print.h"
+#include "src/base/stringprintf.h"
+#include "src/base/thread_pool.h"
+#include "src/data/data_structure.h"
+#include "src/data/model_parameters.h"
+#include "src/loss/loss.h"
+#include "src/loss/sync_batch.h"
+#include "src/reader/parser.h"
+#include "src/reader/reader.h"
+#include "src/reader/synthetic_data.h"
+#include "src/score/score_function.h"
+
+using namespace xLearn;
+
+/* Options of the benchmark */
+struct Options {
+  SyntheticConfig data;
+  index_t num_K = 4;
+  int epoch = 2;
+  int thread = 0;
+  std::string scenario = "all";
+  std::string dir = ".";
+  std::string output = "xlearn_benchmark.json";
+};
+
+/* Result of one run */
+struct Result {
+  std::string scenario;
+  std::string model;
+  int thread;
+  uint64 rows;
+  uint64 bytes;
+  double sec;
+  /* Test loss of the shuffle scenario, or -1 */
+  double loss = -1;
+};
+
+FILE* json_file = nullptr;
+std::vector<int> width(7, 16);
+
+// Seconds of the steady clock. Timer only counts milliseconds,
+// which is too coarse for the parse of small datasets.
+double now_sec() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void print_head() {
+  std::vector<std::string> column;
+  column.push_back("Scenario");
+  column.push_back("Model");
+  column.push_back("Threads");
+  column.push_back("Sec");
+  column.push_back("Rows/s");
+  column.push_back("MB/s");
+  column.push_back("Test loss");
+  print_row(column, width);
+}
+
+// Print the result and write it to the json file
+void report(const Result& r) {
+  double rows_per_sec = r.sec > 0 ? r.rows / r.sec : 0;
+  double mb_per_sec = r.sec > 0 ? r.bytes / r.sec / 1024 / 1024 : 0;
+  std::vector<std::string> column;
+  column.push_back(r.scenario);
+  column.push_back(r.model);
+  column.push_back(StringPrintf("%d", r.thread));
+  column.push_back(StringPrintf("%.3f", r.sec));
+  column.push_back(StringPrintf("%.0f", rows_per_sec));
+  column.push_back(StringPrintf("%.1f", mb_per_sec));
+  column.push_back(r.loss >= 0 ? StringPrintf("%.5f", r.loss) : "-");
+  print_row(column, width);
+  fprintf(json_file, "{\"scenario\":\"%s\",\"model\":\"%s\","
+                     "\"threads\":%d,\"rows\":%llu,\"bytes\":%llu,"
+                     "\"sec\":%.6f,\"rows_per_sec\":%.2f,"
+                     "\"mb_per_sec\":%.3f",
+          r.scenario.c_str(), r.model.c_str(), r.thread,
+          (unsigned long long)r.rows, (unsigned long long)r.bytes,
+          r.sec, rows_per_sec, mb_per_sec);
+  if (r.loss >= 0) {
+    fprintf(json_file, ",\"test_loss\":%.6f", r.loss);
+  }
+  fprintf(json_file, "}\n");
+  fflush(json_file);
+}
+
+// Parse the whole buffer, and take the best of 3 runs
+Result run_parse(std::string& data, bool ffm, int thread) {
+  ThreadPool pool(thread);
+  Parser* parser = ffm ? static_cast<Parser*>(new FFMParser()) :
+                         static_cast<Parser*>(new LibsvmParser());
+  parser->setLabel(true);
+  parser->setThreadPool(&pool);
+  DMatrix matrix;
+  Result r;
+  r.scenario = "parse";
+  r.model = ffm ? "libffm" : "libsvm";
+  r.thread = thread;
+  r.bytes = data.size();
+  r.sec = 0;
+  for (int n = 0; n < 3; ++n) {
+    double start = now_sec();
+    parser->Parse(&data[0], data.size(), matrix);
+    double sec = now_sec() - start;
+    if (n == 0 || sec < r.sec) { r.sec = sec; }
+  }
+  r.rows = matrix.row_length;
+  delete parser;
+  return r;
+}
+
+// Train (or predict) the epochs of the file by the reader of the
+// given type ("memory" or "disk"), and return the average epoch.
+// The sync training is used if sync_batch is not zero.
+Result run_epoch(const Options& opt, const std::string& model_type,
+                 const std::string& filename, const std::string& reader_type,
+                 bool predict, int thread, index_t sync_batch = 0) {
+  ThreadPool pool(thread);
+  Reader* reader = CREATE_READER(reader_type.c_str());
+  CHECK_NOTNULL(reader);
+  reader->SetThreadPool(&pool);
+  if (reader_type == "disk") {
+    // Small blocks, so the prefetch is pipelined for small data
+    reader->SetBlockSize(16);
+    reader->SetPrefetchDepth(2);
+  }
+  reader->Initialize(filename);
+  bool ffm = model_type == "ffm";
+  Model model;
+  model.Initialize(model_type, "cross-entropy", opt.data.num_feature,
+                   ffm ? opt.data.num_field : 0, opt.num_K, 2);
+  Score* score = CREATE_SCORE(model_type.c_str());
+  std::string opt_type = "adagrad";
+  score->Initialize(0.2, 0.00002, 0.3, 1.0, 0.00001, 0.00002, opt_type);
+  Loss* loss = CREATE_LOSS("cross-entropy");
+  loss->Initialize(score, &pool, true, true);
+  if (sync_batch > 0) {
+    loss->SetSyncMode(sync_batch);
+  }
+  // Time the training tasks of the pool (the reader uses it too)
+  pool.SetTiming(!predict);
+  std::vector<double> busy;
+  double busy_sec = 0;
+  std::vector<real_t> pred;
+  Result r;
+  r.scenario = predict ? "predict" : reader_type;
+  r.model = model_type;
+  r.thread = thread;
+  r.rows = 0;
+  r.bytes = 0;
+  double start = now_sec();
+  for (int e = 0; e < opt.epoch; ++e) {
+    reader->Reset();
+    DMatrix* matrix = nullptr;
+    for (;;) {
+      index_t tmp = reader->Samples(matrix);
+      if (tmp == 0) { break; }
+      if (predict) {
+        if (tmp != pred.size()) { pred.resize(tmp); }
+        loss->Predict(matrix, model, pred);
+      } else {
+        pool.TakeTime(&busy);
+        loss->CalcGrad(matrix, model);
+        pool.TakeTime(&busy);
+        for (size_t i = 0; i < busy.size(); ++i) {
+          busy_sec += busy[i];
+        }
+      }
+      r.rows += tmp;
+    }
+  }
+  r.sec = (now_sec() - start) / opt.epoch;
+  // The training must run on the threads of the pool, or the
+  // threads scenario measures one thread at every thread count.
+  if (!predict && thread > 1) {
+    CHECK_GT(busy_sec, 0);
+  }
+  r.rows /= opt.epoch;
+  FILE* file = OpenFileOrDie(filename.c_str(), "r");
+  r.bytes = GetFileSize(file);
+  Close(file);
+  delete loss;
+  delete score;
+  delete reader;
+  return r;
+}
+
+// Write the first 80% rows of data, sorted by label, to train_file
+// and the other rows to test_file.
+void split_data(const std::string& data,
+                const std::string& train_file,
+                const std::string& test_file) {
+  std::vector<std::string> lines;
+  size_t begin = 0;
+  for (size_t end = data.find('\n'); end != std::string::npos;
+       end = data.find('\n', begin)) {
+    lines.push_back(data.substr(begin, end - begin + 1));
+    begin = end + 1;
+  }
+  size_t num_train = lines.size() * 4 / 5;
+  std::stable_sort(lines.begin(), lines.begin() + num_train,
+    [](const std::string& a, const std::string& b) {
+      return a[0] < b[0];
+  });
+  FILE* train = OpenFileOrDie(train_file.c_str(), "w");
+  FILE* test = OpenFileOrDie(test_file.c_str(), "w");
+  for (size_t i = 0; i < lines.size(); ++i) {
+    WriteDataToDisk(i < num_train ? train : test,
+                    lines[i].data(), lines[i].size());
+  }
+  Close(train);
+  Close(test);
+}
+
+// Train the epochs with the given shuffle mode, and report the
+// time of each epoch (including the shuffle) and the test loss.
+void run_shuffle(const Options& opt, const std::string& model_type,
+                 const std::string& train_file,
+                 const std::string& test_file,
+                 ShuffleMode mode, int thread) {
+  static const char* kModeName[] = { "random", "block", "permute" };
+  ThreadPool pool(thread);
+  InmemReader train, test;
+  train.SetThreadPool(&pool);
+  train.Initialize(train_file);
+  train.SetShuffleMode(mode);
+  train.SetSeed(opt.data.seed);
+  train.SetShuffle(true);
+  test.SetThreadPool(&pool);
+  test.Initialize(test_file);
+  bool ffm = model_type == "ffm";
+  Model model;
+  model.Initialize(model_type, "cross-entropy", opt.data.num_feature,
+                   ffm ? opt.data.num_field : 0, opt.num_K, 2);
+  Score* score = CREATE_SCORE(model_type.c_str());
+  std::string opt_type = "adagrad";
+  score->Initialize(0.2, 0.00002, 0.3, 1.0, 0.00001, 0.00002, opt_type);
+  Loss* loss = CREATE_LOSS("cross-entropy");
+  loss->Initialize(score, &pool, true, false);
+  std::vector<real_t> pred;
+  for (int e = 0; e < opt.epoch; ++e) {
+    Result r;
+    r.scenario = "shuffle";
+    r.model = model_type + "/" + kModeName[mode];
+    r.thread = thread;
+    r.rows = 0;
+    r.bytes = 0;
+    DMatrix* matrix = nullptr;
+    train.Reset();
+    double start = now_sec();
+    for (;;) {
+      index_t tmp = train.Samples(matrix);
+      if (tmp == 0) { break; }
+      loss->CalcGrad(matrix, model);
+      r.rows += tmp;
+      for (index_t i = 0; i < tmp; ++i) {
+        r.bytes += matrix->row[i].size() * sizeof(Node);
+      }
+    }
+    r.sec = now_sec() - start;
+    test.Reset();
+    loss->Reset();
+    for (;;) {
+      index_t tmp = test.Samples(matrix);
+      if (tmp == 0) { break; }
+      if (tmp != pred.size()) { pred.resize(tmp); }
+      loss->Predict(matrix, model, pred);
+      loss->Evalute(pred, matrix->Y);
+    }
+    r.loss = loss->GetLoss();
+    report(r);
+  }
+  delete loss;
+  delete score;
+}
+
+// Parse "-key value" options
+bool parse_options(int argc, char* argv[], Options* opt) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i+1];
+    if (key == "-rows") {
+      opt->data.num_row = atoll(value.c_str());
+    } else if (key == "-fields") {
+      opt->data.num_field = atoi(value.c_str());
+    } else if (key == "-features") {
+      opt->data.num_feature = atoi(value.c_str());
+    } else if (key == "-length") {
+      opt->data.row_length = atoi(value.c_str());
+    } else if (key == "-zipf") {
+      opt->data.zipf = atof(value.c_str());
+    } else if (key == "-seed") {
+      opt->data.seed = atoll(value.c_str());
+    } else if (key == "-k") {
+      opt->num_K = atoi(value.c_str());
+    } else if (key == "-epoch") {
+      opt->epoch = atoi(value.c_str());
+    } else if (key == "-nthread") {
+      opt->thread = atoi(value.c_str());
+    } else if (key == "-scenario") {
+      opt->scenario = value;
+    } else if (key == "-dir") {
+      opt->dir = value;
+    } else if (key == "-o") {
+      opt->output = value;
+    } else {
+      print_error(StringPrintf("Unknown option: %s", key.c_str()));
+      return false;
+    }
+  }
+  if (argc % 2 == 0) {
+    print_error(StringPrintf("Missing value of: %s", argv[argc-1]));
+    return false;
+  }
+  return opt->epoch > 0 && opt->data.num_row > 0;
+}
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  opt.data.num_row = 200000;
+  opt.data.num_feature = 1000000;
+  if (!parse_options(argc, argv, &opt)) { return 1; }
+  if (opt.thread <= 0) {
+    opt.thread = std::max(1u, std::thread::hardware_concurrency());
+  }
+  json_file = OpenFileOrDie(opt.output.c_str(), "w");
+  const SyntheticConfig& d = opt.data;
+  print_info(StringPrintf("CPU: %s, threads: %d, rows: %llu, fields: %d, "
+                          "features: %d, length: %d, zipf: %.2f, K: %d",
+                          SIMDName(GetSIMDLevel()).c_str(), opt.thread,
+                          (unsigned long long)d.num_row, d.num_field,
+                          d.num_feature, d.row_length, d.zipf, opt.num_K));
+  // The config is the first line, so the results of two
+  // runs are only compared if they have the same config.
+  fprintf(json_file, "{\"config\":{\"simd\":\"%s\",\"threads\":%d,"
+                     "\"rows\":%llu,\"fields\":%d,\"features\":%d,"
+                     "\"length\":%d,\"zipf\":%.3f,\"seed\":%llu,"
+                     "\"k\":%d,\"epoch\":%d}}\n",
+          SIMDName(GetSIMDLevel()).c_str(), opt.thread,
+          (unsigned long long)d.num_row, d.num_field, d.num_feature,
+          d.row_length, d.zipf, (unsigned long long)d.seed,
+          opt.num_K, opt.epoch);
+  // Generate the datasets
+  double start = now_sec();
+  SyntheticData gen(opt.data);
+  std::string svm_file = opt.dir + "/xlearn_benchmark.svm";
+  std::string ffm_file = opt.dir + "/xlearn_benchmark.ffm";
+  std::string train_file = opt.dir + "/xlearn_benchmark_train.txt";
+  std::string test_file = opt.dir + "/xlearn_benchmark_test.txt";
+  uint64 svm_size = gen.WriteFile(svm_file, false);
+  uint64 ffm_size = gen.WriteFile(ffm_file, true);
+  print_info(StringPrintf("Generate %s (libsvm) and %s (libffm) "
+                          "in %.2f sec", PrintSize(svm_size).c_str(),
+                          PrintSize(ffm_size).c_str(), now_sec() - start));
+  print_head();
+  const char* models[] = { "linear", "fm", "ffm" };
+  bool all = opt.scenario == "all";
+  if (all || opt.scenario == "parse") {
+    for (int ffm = 0; ffm <= 1; ++ffm) {
+      std::string data;
+      gen.Generate(ffm == 1, &data);
+      report(run_parse(data, ffm == 1, opt.thread));
+    }
+  }
+  for (int m = 0; m < 3; ++m) {
+    std::string model = models[m];
+    const std::string& file = model == "ffm" ? ffm_file : svm_file;
+    if (all || opt.scenario == "memory") {
+      report(run_epoch(opt, model, file, "memory", false, opt.thread));
+    }
+    if (all || opt.scenario == "disk") {
+      report(run_epoch(opt, model, file, "disk", false, opt.thread));
+    }
+    if (all || opt.scenario == "predict") {
+      report(run_epoch(opt, model, file, "memory", true, opt.thread));
+    }
+    if (all || opt.scenario == "threads") {
+      for (int t = 1; t < opt.thread; t *= 2) {
+        Result r = run_epoch(opt, model, file, "memory", false, t);
+        r.scenario = "threads";
+        report(r);
+      }
+      Result r = run_epoch(opt, model, file, "memory", false, opt.thread);
+      r.scenario = "threads";
+      report(r);
+    }
+    if (all || opt.scenario == "sync") {
+      for (int t = 1; t < opt.thread; t *= 2) {
+        Result r = run_epoch(opt, model, file, "memory", false, t,
+                             kDefaultSyncBatch);
+        r.scenario = "sync";
+        report(r);
+      }
+      Result r = run_epoch(opt, model, file, "memory", false, opt.thread,
+                           kDefaultSyncBatch);
+      r.scenario = "sync";
+      report(r);
+    }
+    if (all || opt.scenario == "shuffle") {
+      std::string data;
+      gen.Generate(model == "ffm", &data);
+      split_data(data, train_file, test_file);
+      for (int mode = kShuffleRandom; mode <= kShufflePermute; ++mode) {
+        run_shuffle(opt, model, train_file, test_file,
+                    static_cast<ShuffleMode>(mode), opt.thread);
+      }
+      // The binary files are of the model type
+      std::string files[] = { train_file, test_file,
+                              train_file + ".bin", test_file + ".bin" };
+      for (const std::string& f : files) {
+        if (access(f.c_str(), F_OK) == 0) { RemoveFile(f.c_str()); }
+      }
+    }
+  }
+  Close(json_file);
+  // The binary caches are only written by the in-memory reader
+  std::string files[] = { svm_file, ffm_file,
+                          svm_file + ".bin", ffm_file + ".bin" };
+  for (const std::string& f : files) {
+    if (access(f.c_str(), F_OK) == 0) { RemoveFile(f.c_str()); }
+  }
+  print_info(StringPrintf("Results: %s", opt.output.c_str()));
+  return 0;
+}